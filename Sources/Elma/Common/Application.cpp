@@ -11,6 +11,7 @@
 #include "Parallel.hpp"
 #include "Image.hpp"
 #include "Render.hpp"
+#include "RenderSession.hpp"
 #include <embree4/rtcore.h>
 #include <memory>
 #include "Timer.hpp"
@@ -26,13 +27,13 @@ using namespace elma;
 namespace {
 
 RTCDevice embreeDevice;
-std::unique_ptr<Scene> scene = nullptr;
-std::unique_ptr<Timer> timer = nullptr;
+std::unique_ptr<Scene> scene                 = nullptr;
+std::unique_ptr<Timer> timer                 = nullptr;
+std::unique_ptr<RenderSession> renderSession = nullptr;
 
 struct RenderRecords
 {
-    Image3 acc;
-    double accCount;
+    // Latest frame of the render session, swapped in whenever a new one is ready
     Image3f display;
 
     std::string sceneName;
@@ -71,15 +72,19 @@ Application::Application(const AppConfig& config)
     _pWindow = Window::Create(windowDesc, this);
     _pWindow->setWindowIcon(std::filesystem::current_path() / "Data/Fairy-Tale-Castle-Princess.ico");
 
-    renderRec.acc      = Image3{scene->camera.width, scene->camera.height};
-    renderRec.accCount = 0;
-    renderRec.display  = Image3f{scene->camera.width, scene->camera.height};
+    renderRec.display = Image3f{scene->camera.width, scene->camera.height};
 
     _initUI();
+
+    // Passes render in the background, the window only presents what is ready
+    renderSession = std::make_unique<RenderSession>(*scene);
+    renderSession->start();
 }
 
 Application::~Application()
 {
+    // The session renders on the thread pool, stop it before the pool goes away
+    renderSession.reset();
     ParallelCleanup();
     rtcReleaseDevice(embreeDevice);
 
@@ -132,34 +137,15 @@ void Application::resizeFrameBuffer(uint32_t width, uint32_t height)
 void Application::renderFrame()
 {
     /// 这里执行主要的渲染逻辑
+    /// (渲染在 RenderSession 的后台线程中进行，这里只显示最新完成的一帧)
 
-    const auto w = scene->camera.width;
-    const auto h = scene->camera.height;
-
-    glViewport(0, 0, w, h);
-    const auto img = Render(*scene);
-    
+    renderSession->present(renderRec.display);
 
-    renderRec.accCount             += 1;
-    scene->options.accumulateCount += 1;
-//    
-//    if (renderRec.accCount == 1)
-//    {
-//        ImageWrite("output.exr", img);
-//    }
-
-    Real f = Real(1.0) / (std::max(0.001, renderRec.accCount));
-    for (int y = 0; y < h; ++y) {
-        for (int x = 0; x < w; ++x) {
-            const auto acc      = renderRec.acc(x, y) + img(x, y);
-            renderRec.acc(x, y) = acc;
-
-            renderRec.display(x, y).x = std::pow((float)(std::clamp(acc.x * f, 0., 1.)), 1.0f / 2.2);
-            renderRec.display(x, y).y = std::pow((float)(std::clamp(acc.y * f, 0., 1.)), 1.0f / 2.2);
-            renderRec.display(x, y).z = std::pow((float)(std::clamp(acc.z * f, 0., 1.)), 1.0f / 2.2);
-        }
-    }
+    // The session may resize the image, so draw with the size of the frame itself
+    const auto w = renderRec.display.width;
+    const auto h = renderRec.display.height;
 
+    glViewport(0, 0, w, h);
     glRasterPos2i(-1, 1);
     glPixelZoom(1.0f, -1.0f);
     glDrawPixels(w, h, GL_RGB, GL_FLOAT, renderRec.display.data.data());
@@ -184,6 +170,7 @@ std::string Application::getKeyboardShortcutsStr()
 {
     constexpr char help[] = "ESC - Quit\n"
                             "V - Toggle VSync\n"
+                            "R - Restart rendering\n"
                             "MouseWheel - Change level of zoom\n";
 
     return help;
@@ -220,6 +207,7 @@ void Application::handleKeyboardEvent(const KeyboardEvent& keyEvent)
         else if (keyEvent.mods == ModifierFlags::None) {
             switch (keyEvent.key) {
             case Key::Escape : _pWindow->shutdown(); break;
+            case Key::R      : renderSession->restart(); break;
             default          : break;
             }
         }
@@ -280,7 +268,12 @@ void Application::_renderUI()
         ImGui::SetNextWindowBgAlpha(0.23f);
         ImGui::Begin("Render Stats");
         ImGui::Text("Scene: %s", renderRec.sceneName.c_str());
-        ImGui::Text("Acc Count = %lld", static_cast<uint64_t>(renderRec.accCount));
+        const RenderSessionStats stats = renderSession->getStats();
+        ImGui::Text("Acc Count = %lld", static_cast<long long>(stats.passes));
+        ImGui::Text("Last Pass = %.1f ms", stats.lastPassTime * 1000.0);
+        if (stats.timeToFirstFrame >= 0) {
+            ImGui::Text("First Frame = %.1f ms", stats.timeToFirstFrame * 1000.0);
+        }
 
         ImGui::End();
     }
@@ -20,9 +20,13 @@ namespace elma {
 // put emphasis on the absolute performance.
 // We choose double so that we do not need to worry about
 // numerical accuracy as much when we render.
-// Switching to floating point computation is easy --
-// just set Real = float.
+// Configuring with -DELMA_REAL_FLOAT=ON switches to single precision,
+// which halves the size of vertices, images, mipmaps and volumes.
+#ifdef ELMA_REAL_FLOAT
+using Real = float;
+#else
 using Real = double;
+#endif
 
 // Lots of PIs!
 const Real kPi         = Real(3.14159265358979323846);
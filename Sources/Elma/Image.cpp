@@ -133,6 +133,45 @@ Image3 ImageRead3(const fs::path& filename)
     return img;
 }
 
+Vector2i ImageResolution(const fs::path& filename)
+{
+    std::string extension = ToLowercase(filename.extension().string());
+    if (extension == ".jpg" || extension == ".png" || extension == ".tga" || extension == ".bmp" ||
+        extension == ".psd" || extension == ".gif" || extension == ".hdr" || extension == ".pic")
+    {
+        int w, h, n;
+        if (!stbi_info(filename.string().c_str(), &w, &h, &n)) {
+            ELMA_THROW("图像 {} 载入失败.", filename.string());
+        }
+        return Vector2i{w, h};
+    }
+    else if (extension == ".exr") {
+        EXRVersion version;
+        if (ParseEXRVersionFromFile(&version, filename.string().c_str()) != TINYEXR_SUCCESS) {
+            ELMA_THROW("图像 {} 载入失败.", filename.string());
+        }
+        EXRHeader header;
+        InitEXRHeader(&header);
+        const char* err = nullptr;
+        if (ParseEXRHeaderFromFile(&header, &version, filename.string().c_str(), &err) != TINYEXR_SUCCESS) {
+            LogError("OpenEXR error: {}", err);
+            FreeEXRErrorMessage(err);
+            ELMA_THROW("图像 {} 载入失败.", filename.string());
+        }
+        Vector2i size{header.data_window.max_x - header.data_window.min_x + 1,
+                      header.data_window.max_y - header.data_window.min_y + 1};
+        FreeEXRHeader(&header);
+        return size;
+    }
+    ELMA_THROW("不支持的图片格式: {} .", filename.string());
+}
+
+bool IsHdrImage(const fs::path& filename)
+{
+    std::string extension = ToLowercase(filename.extension().string());
+    return extension == ".exr" || stbi_is_hdr(filename.string().c_str());
+}
+
 void ImageWrite(const fs::path& filename, const Image3& image)
 {
 #ifdef _WINDOWS
@@ -52,6 +52,14 @@ Image1 ImageRead1(const fs::path& filename);
 /// Supported formats: JPG, PNG, TGA, BMP, PSD, GIF, HDR, PIC
 Image3 ImageRead3(const fs::path& filename);
 
+/// Reads only the resolution of an image file, without decoding the pixels.
+/// Supported formats: the union of the above and exr
+Vector2i ImageResolution(const fs::path& filename);
+
+/// Whether the file stores high dynamic range values (hdr, exr), as opposed to 8 or 16-bit
+/// values that ImageRead1/ImageRead3 convert from gamma 2.2.
+bool IsHdrImage(const fs::path& filename);
+
 /// Save an image to a file.
 /// Supported formats: PFM & exr
 void ImageWrite(const fs::path& filename, const Image3& image);
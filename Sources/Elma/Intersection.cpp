@@ -2,10 +2,68 @@
 #include "Material.hpp"
 #include "Ray.hpp"
 #include "Scene.hpp"
+#include "Stats.hpp"
+#include "Transform.hpp"
 #include <embree4/rtcore.h>
 
 namespace elma {
 
+ELMA_STAT_RATIO("Intersection/Rays that hit", sRayHits, sRays);
+ELMA_STAT_RATIO("Intersection/Occluded shadow rays", sOccludedShadowRays, sShadowRays);
+
+/// Fills in a path vertex from an Embree hit record.
+/// For hits on instanced geometry inst_id is the instance, and the normal is in its object space.
+static PathVertex MakePathVertex(const Scene& scene,
+                                 const Ray& ray,
+                                 const RayDifferential& ray_diff,
+                                 Real t_hit,
+                                 const Vector3& geometric_normal,
+                                 const Vector2& st,
+                                 unsigned int geom_id,
+                                 unsigned int prim_id,
+                                 unsigned int inst_id)
+{
+    PathVertex vertex;
+    vertex.position    = ray.org + ray.dir * t_hit;
+    vertex.primitiveId = prim_id;
+    vertex.st          = st;
+    // Materials and media of instances come from the shapes of their group
+    const Shape* shape = nullptr;
+    if (inst_id == RTC_INVALID_GEOMETRY_ID) {
+        assert(geom_id < scene.shapes.size());
+        vertex.shapeId = geom_id;
+        vertex.normal  = Normalize(geometric_normal);
+        shape          = &scene.shapes[geom_id];
+    }
+    else {
+        assert(inst_id < scene.shapes.size());
+        const Instance& instance = std::get<Instance>(scene.shapes[inst_id]);
+        vertex.shapeId           = inst_id;
+        vertex.groupShapeId      = geom_id;
+        vertex.normal            = Normalize(TransformNormal(instance.toLocal, geometric_normal));
+        shape                    = &instance.group->shapes[geom_id];
+    }
+    vertex.materialId       = GetMaterialId(*shape);
+    vertex.interiorMediumId = GetInteriorMediumId(*shape);
+    vertex.exteriorMediumId = GetExteriorMediumId(*shape);
+
+    ShadingInfo shading_info = ComputeShadingInfo(scene.shapes[vertex.shapeId], vertex);
+    vertex.shadingFrame      = shading_info.shadingFrame;
+    vertex.uv                = shading_info.uv;
+    vertex.meanCurvature     = shading_info.meanCurvature;
+    vertex.rayRadius         = Transfer(ray_diff, Distance(ray.org, vertex.position));
+    // vertex.ray_radius stores approximatedly dp/dx,
+    // we get uv_screen_size (du/dx) using (dp/dx)/(dp/du)
+    vertex.uvScreenSize = vertex.rayRadius / shading_info.invUvSize;
+
+    // Flip the geometry normal to the same direction as the shading normal
+    if (Dot(vertex.normal, vertex.shadingFrame.n) < 0) {
+        vertex.normal = -vertex.normal;
+    }
+
+    return vertex;
+}
+
 std::optional<PathVertex> Intersect(const Scene& scene, const Ray& ray, const RayDifferential& ray_diff)
 {
     RTCIntersectArguments rtc_args;
@@ -38,38 +96,21 @@ std::optional<PathVertex> Intersect(const Scene& scene, const Ray& ray, const Ra
       {RTC_INVALID_GEOMETRY_ID} // instance IDs
     };
     rtcIntersect1(scene.embreeScene, &rtc_rayhit, &rtc_args);
+    ++sRays;
     if (rtc_hit.geomID == RTC_INVALID_GEOMETRY_ID) {
         return {};
     };
-    assert(rtc_hit.geomID < scene.shapes.size());
-
-    PathVertex vertex;
-    vertex.position =
-        Vector3{ray.org.x, ray.org.y, ray.org.z} + Vector3{ray.dir.x, ray.dir.y, ray.dir.z} * Real(rtc_ray.tfar);
-    vertex.normal             = Normalize(Vector3{rtc_hit.Ng_x, rtc_hit.Ng_y, rtc_hit.Ng_z});
-    vertex.shapeId            = rtc_hit.geomID;
-    vertex.primitiveId        = rtc_hit.primID;
-    const Shape& shape        = scene.shapes[vertex.shapeId];
-    vertex.materialId         = GetMaterialId(shape);
-    vertex.interiorMediumId   = GetInteriorMediumId(shape);
-    vertex.exteriorMediumId   = GetExteriorMediumId(shape);
-    vertex.st                 = Vector2{rtc_hit.u, rtc_hit.v};
-
-    ShadingInfo shading_info = ComputeShadingInfo(scene.shapes[vertex.shapeId], vertex);
-    vertex.shadingFrame      = shading_info.shadingFrame;
-    vertex.uv                = shading_info.uv;
-    vertex.meanCurvature     = shading_info.meanCurvature;
-    vertex.rayRadius         = Transfer(ray_diff, Distance(ray.org, vertex.position));
-    // vertex.ray_radius stores approximatedly dp/dx,
-    // we get uv_screen_size (du/dx) using (dp/dx)/(dp/du)
-    vertex.uvScreenSize = vertex.rayRadius / shading_info.invUvSize;
-
-    // Flip the geometry normal to the same direction as the shading normal
-    if (Dot(vertex.normal, vertex.shadingFrame.n) < 0) {
-        vertex.normal = -vertex.normal;
-    }
+    ++sRayHits;
 
-    return vertex;
+    return MakePathVertex(scene,
+                          ray,
+                          ray_diff,
+                          Real(rtc_ray.tfar),
+                          Vector3{rtc_hit.Ng_x, rtc_hit.Ng_y, rtc_hit.Ng_z},
+                          Vector2{rtc_hit.u, rtc_hit.v},
+                          rtc_hit.geomID,
+                          rtc_hit.primID,
+                          rtc_hit.instID[0]);
 }
 
 bool Occluded(const Scene& scene, const Ray& ray)
@@ -88,9 +129,99 @@ bool Occluded(const Scene& scene, const Ray& ray)
     rtc_ray.mask  = (unsigned int)(-1);
     rtc_ray.time  = 0.f;
     rtc_ray.flags = 0;
-    // TODO: switch to rtcOccluded16
     rtcOccluded1(scene.embreeScene, &rtc_ray, &rtc_args);
-    return rtc_ray.tfar < 0;
+    const bool occluded = rtc_ray.tfar < 0;
+    ++sShadowRays;
+    sOccludedShadowRays += occluded;
+    return occluded;
+}
+
+/// Converts a ray batch into an Embree packet. Returns the Embree validity mask (-1 active, 0 inactive)
+/// and the number of active lanes.
+static int SetupRay16(const RayBatch& rays, RTCRay16& rtc_ray, int* rtc_valid)
+{
+    int num_valid = 0;
+    for (int i = 0; i < kRayBatchSize; i++) {
+        rtc_valid[i]      = rays.valid[i] ? -1 : 0;
+        num_valid        += rays.valid[i] != 0;
+        rtc_ray.org_x[i]  = (float)rays.orgX[i];
+        rtc_ray.org_y[i]  = (float)rays.orgY[i];
+        rtc_ray.org_z[i]  = (float)rays.orgZ[i];
+        rtc_ray.tnear[i]  = (float)rays.tNear[i];
+        rtc_ray.dir_x[i]  = (float)rays.dirX[i];
+        rtc_ray.dir_y[i]  = (float)rays.dirY[i];
+        rtc_ray.dir_z[i]  = (float)rays.dirZ[i];
+        rtc_ray.time[i]   = 0.f;
+        rtc_ray.tfar[i]   = (float)rays.tFar[i];
+        rtc_ray.mask[i]   = (unsigned int)(-1);
+        rtc_ray.id[i]     = i;
+        rtc_ray.flags[i]  = 0;
+    }
+    return num_valid;
+}
+
+void IntersectN(const Scene& scene,
+                const RayBatch& rays,
+                std::array<std::optional<PathVertex>, kRayBatchSize>& vertices)
+{
+    alignas(64) int rtc_valid[kRayBatchSize];
+    RTCRayHit16 rtc_rayhit;
+    for (auto& v : vertices) {
+        v.reset();
+    }
+    const int num_valid = SetupRay16(rays, rtc_rayhit.ray, rtc_valid);
+    sRays += num_valid;
+    if (num_valid == 0) {
+        return;
+    }
+    for (int i = 0; i < kRayBatchSize; i++) {
+        rtc_rayhit.hit.geomID[i]    = RTC_INVALID_GEOMETRY_ID;
+        rtc_rayhit.hit.primID[i]    = RTC_INVALID_GEOMETRY_ID;
+        rtc_rayhit.hit.instID[0][i] = RTC_INVALID_GEOMETRY_ID;
+    }
+
+    RTCIntersectArguments rtc_args;
+    rtcInitIntersectArguments(&rtc_args);
+    rtcIntersect16(rtc_valid, scene.embreeScene, &rtc_rayhit, &rtc_args);
+
+    const RTCHit16& rtc_hit = rtc_rayhit.hit;
+    for (int i = 0; i < kRayBatchSize; i++) {
+        if (!rays.valid[i] || rtc_hit.geomID[i] == RTC_INVALID_GEOMETRY_ID) {
+            continue;
+        }
+        ++sRayHits;
+        vertices[i] = MakePathVertex(scene,
+                                     GetRay(rays, i),
+                                     GetRayDifferential(rays, i),
+                                     Real(rtc_rayhit.ray.tfar[i]),
+                                     Vector3{rtc_hit.Ng_x[i], rtc_hit.Ng_y[i], rtc_hit.Ng_z[i]},
+                                     Vector2{rtc_hit.u[i], rtc_hit.v[i]},
+                                     rtc_hit.geomID[i],
+                                     rtc_hit.primID[i],
+                                     rtc_hit.instID[0][i]);
+    }
+}
+
+void OccludedN(const Scene& scene, const RayBatch& rays, std::array<bool, kRayBatchSize>& occluded)
+{
+    alignas(64) int rtc_valid[kRayBatchSize];
+    RTCRay16 rtc_ray;
+    occluded.fill(false);
+    const int num_valid = SetupRay16(rays, rtc_ray, rtc_valid);
+    sShadowRays += num_valid;
+    if (num_valid == 0) {
+        return;
+    }
+
+    RTCOccludedArguments rtc_args;
+    rtcInitOccludedArguments(&rtc_args);
+    rtcOccluded16(rtc_valid, scene.embreeScene, &rtc_ray, &rtc_args);
+
+    // Embree sets tfar to -inf for occluded lanes
+    for (int i = 0; i < kRayBatchSize; i++) {
+        occluded[i]          = rays.valid[i] && rtc_ray.tfar[i] < 0;
+        sOccludedShadowRays += occluded[i];
+    }
 }
 
 Spectrum Emission(const PathVertex& v, const Vector3& view_dir, const Scene& scene)
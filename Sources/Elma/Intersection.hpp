@@ -6,6 +6,7 @@
 #include "Spectrum.hpp"
 #include "Vector.hpp"
 
+#include <array>
 #include <optional>
 
 namespace elma {
@@ -26,9 +27,10 @@ struct PathVertex
     Real uvScreenSize;
     Real meanCurvature;   // For ray differential propagation.
     Real rayRadius;       // For ray differential propagation.
-    int shapeId     = -1;
-    int primitiveId = -1; // For triangle meshes. This indicates which triangle it hits.
-    int materialId  = -1;
+    int shapeId      = -1;
+    int groupShapeId = -1; // For instances, the shape of the instanced group that was hit.
+    int primitiveId  = -1; // For triangle meshes. This indicates which triangle it hits.
+    int materialId   = -1;
 
     // If the path vertex is inside a medium, these two IDs
     // are the same.
@@ -44,6 +46,15 @@ Intersect(const Scene& scene, const Ray& ray, const RayDifferential& ray_diff =
 /// Test is a ray segment Intersect with anything in a scene.
 bool Occluded(const Scene& scene, const Ray& ray);
 
+/// Intersect a packet of rays with a scene. Lanes that are invalid or miss
+/// everything get an empty optional.
+void IntersectN(const Scene& scene,
+                const RayBatch& rays,
+                std::array<std::optional<PathVertex>, kRayBatchSize>& vertices);
+
+/// Occlusion test for a packet of ray segments. Invalid lanes are reported as not occluded.
+void OccludedN(const Scene& scene, const RayBatch& rays, std::array<bool, kRayBatchSize>& occluded);
+
 /// Computes the Emission at a path vertex v, with the viewing direction
 /// pointing outwards of the intersection.
 Spectrum Emission(const PathVertex& v, const Vector3& view_dir, const Scene& scene);
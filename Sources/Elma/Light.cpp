@@ -1,4 +1,5 @@
 #include "Light.hpp"
+#include "Parallel.hpp"
 #include "Scene.hpp"
 #include "Spectrum.hpp"
 #include "Transform.hpp"
@@ -13,6 +14,14 @@ struct light_power_op
     const Scene& scene;
 };
 
+struct light_bounds_op
+{
+    std::optional<LightBounds> operator()(const DiffuseAreaLight& light) const;
+    std::optional<LightBounds> operator()(const Envmap& light) const;
+
+    const Scene& scene;
+};
+
 struct sample_point_on_light_op
 {
     PointAndNormal operator()(const DiffuseAreaLight& light) const;
@@ -61,6 +70,11 @@ Real LightPower(const Light& light, const Scene& scene)
     return std::visit(light_power_op{scene}, light);
 }
 
+std::optional<LightBounds> GetLightBounds(const Light& light, const Scene& scene)
+{
+    return std::visit(light_bounds_op{scene}, light);
+}
+
 PointAndNormal SamplePointOnLight(
     const Light& light, const Vector3& ref_point, const Vector2& rnd_param_uv, Real rnd_param_w, const Scene& scene)
 {
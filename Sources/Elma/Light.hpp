@@ -1,12 +1,14 @@
 #pragma once
 
 #include "Elma.hpp"
+#include "LightBVH.hpp"
 #include "Matrix.hpp"
 #include "PointAndNormal.hpp"
 #include "Shape.hpp"
 #include "Spectrum.hpp"
 #include "Texture.hpp"
 #include "Vector.hpp"
+#include <optional>
 #include <variant>
 
 namespace elma {
@@ -66,6 +68,25 @@ Spectrum Emission(const Light& light,
                   const PointAndNormal& point_on_light,
                   const Scene& scene);
 
+/// Where a direction falls on an environment map. Emission and PdfPointOnLight of the same direction
+/// can share it, converting the direction to spherical coordinates once.
+struct EnvmapDirection
+{
+    Vector3 localDir; // in the envmap's frame, pointing towards the envmap
+    Vector2 uv;
+};
+
+/// dir_out points outwards from the light, like the view_dir of Emission.
+EnvmapDirection ToEnvmapDirection(const Envmap& light, const Vector3& dir_out);
+
+/// PdfPointOnLight and Emission of an envmap for a converted direction.
+Real PdfPointOnLight(const Envmap& light, const EnvmapDirection& dir);
+Spectrum Emission(const Envmap& light, const EnvmapDirection& dir, Real view_footprint, const Scene& scene);
+
+/// Where and in which directions the light emits, for the light BVH. Infinitely far lights (envmaps)
+/// can't be bounded and return nullopt.
+std::optional<LightBounds> GetLightBounds(const Light& light, const Scene& scene);
+
 /// Some lights require storing sampling data structures inside. This function initialize them.
 void InitSamplingDist(Light& light, const Scene& scene);
 
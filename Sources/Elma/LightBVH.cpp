@@ -0,0 +1,324 @@
+#include "LightBVH.hpp"
+#include "LowDiscrepancy.hpp"
+
+#include <algorithm>
+
+namespace elma {
+
+namespace {
+
+constexpr int kLightBVHBuckets = 12;
+
+Real SafeSqrt(Real x)
+{
+    return std::sqrt(Max(x, Real(0)));
+}
+
+Real SafeAcos(Real x)
+{
+    return std::acos(std::clamp(x, Real(-1), Real(1)));
+}
+
+/// cos(max(a - b, 0)) and sin(max(a - b, 0)) of two angles in [0, pi] given their sines and cosines
+Real CosSubClamped(Real sin_a, Real cos_a, Real sin_b, Real cos_b)
+{
+    return cos_a > cos_b ? Real(1) : cos_a * cos_b + sin_a * sin_b;
+}
+
+Real SinSubClamped(Real sin_a, Real cos_a, Real sin_b, Real cos_b)
+{
+    return cos_a > cos_b ? Real(0) : sin_a * cos_b - cos_a * sin_b;
+}
+
+/// Rotates v around the unit vector k (Rodrigues' formula)
+Vector3 Rotate(const Vector3& v, const Vector3& k, Real theta)
+{
+    const Real cos_theta = std::cos(theta), sin_theta = std::sin(theta);
+    return v * cos_theta + Cross(k, v) * sin_theta + k * (Dot(k, v) * (1 - cos_theta));
+}
+
+/// The smallest cone around the cones (axis_a, cos_a) and (axis_b, cos_b), pbrt-v4's DirectionCone union
+std::pair<Vector3, Real> UnionCones(const Vector3& axis_a, Real cos_a, const Vector3& axis_b, Real cos_b)
+{
+    const Real theta_a = SafeAcos(cos_a), theta_b = SafeAcos(cos_b);
+    const Real theta_d = SafeAcos(Dot(axis_a, axis_b));
+    if (Min(theta_d + theta_b, kPi) <= theta_a) {
+        return {axis_a, cos_a};
+    }
+    if (Min(theta_d + theta_a, kPi) <= theta_b) {
+        return {axis_b, cos_b};
+    }
+    const Real theta_o = (theta_a + theta_d + theta_b) / 2;
+    const Vector3 wr   = Cross(axis_a, axis_b);
+    if (theta_o >= kPi || LengthSquared(wr) == 0) {
+        return {axis_a, Real(-1)};
+    }
+    return {Normalize(Rotate(axis_a, Normalize(wr), theta_o - theta_a)), std::cos(theta_o)};
+}
+
+Real SurfaceArea(const LightBounds& b)
+{
+    const Vector3 d = b.pMax - b.pMin;
+    return 2 * (d.x * d.y + d.x * d.z + d.y * d.z);
+}
+
+/// The surface area orientation heuristic of Conty Estevez and Kulla, "Importance Sampling of Many Lights
+/// with Adaptive Tree Splitting", 2018, in pbrt-v4's form: power times the solid angle the emission spreads
+/// over times the surface area, with a penalty for thin slices of a long box.
+Real EvaluateCost(const LightBounds& b, const LightBounds& parent, int dim)
+{
+    const Real theta_o     = SafeAcos(b.cosThetaO);
+    const Real theta_e     = SafeAcos(b.cosThetaE);
+    const Real theta_w     = Min(theta_o + theta_e, kPi);
+    const Real sin_theta_o = SafeSqrt(1 - b.cosThetaO * b.cosThetaO);
+    const Real spread =
+        2 * theta_w * sin_theta_o - std::cos(theta_o - 2 * theta_w) - 2 * theta_o * sin_theta_o + b.cosThetaO;
+    const Real m_omega = kTwoPi * (1 - b.cosThetaO) + kPiOverTwo * spread;
+    const Vector3 d    = parent.pMax - parent.pMin;
+    const Real kr      = d[dim] > 0 ? Max(d) / d[dim] : Real(1);
+    return b.phi * m_omega * kr * SurfaceArea(b);
+}
+
+struct BuildLight
+{
+    int lightId;
+    LightBounds bounds;
+    Vector3 centroid;
+};
+
+int CentroidBucket(const Vector3& centroid, const Vector3& cmin, const Vector3& cmax, int dim)
+{
+    const int b = int(kLightBVHBuckets * (centroid[dim] - cmin[dim]) / (cmax[dim] - cmin[dim]));
+    return std::clamp(b, 0, kLightBVHBuckets - 1);
+}
+
+/// Appends the subtree of lights[begin, end) in depth first order and returns its root
+int BuildNode(LightBVH& bvh, std::vector<BuildLight>& lights, int begin, int end, int parent)
+{
+    const int node_id = (int)bvh.nodes.size();
+    bvh.nodes.push_back(LightBVHNode{});
+    bvh.parents.push_back(parent);
+    if (end - begin == 1) {
+        bvh.nodes[node_id]                     = LightBVHNode{lights[begin].bounds, lights[begin].lightId, true};
+        bvh.lightToLeaf[lights[begin].lightId] = node_id;
+        return node_id;
+    }
+
+    LightBounds bounds = lights[begin].bounds;
+    Vector3 cmin = lights[begin].centroid, cmax = cmin;
+    for (int i = begin + 1; i < end; i++) {
+        bounds = Union(bounds, lights[i].bounds);
+        cmin   = Min(cmin, lights[i].centroid);
+        cmax   = Max(cmax, lights[i].centroid);
+    }
+
+    // Bucket the centroids along each axis and take the cheapest split
+    Real min_cost = Infinity<Real>();
+    int min_dim = -1, min_bucket = -1;
+    for (int dim = 0; dim < 3; dim++) {
+        if (cmax[dim] == cmin[dim]) {
+            continue;
+        }
+        LightBounds buckets[kLightBVHBuckets];
+        for (int i = begin; i < end; i++) {
+            LightBounds& b = buckets[CentroidBucket(lights[i].centroid, cmin, cmax, dim)];
+            b              = Union(b, lights[i].bounds);
+        }
+        // above[i] bounds the buckets from i + 1 on
+        LightBounds above[kLightBVHBuckets];
+        for (int i = kLightBVHBuckets - 2; i >= 0; i--) {
+            above[i] = Union(above[i + 1], buckets[i + 1]);
+        }
+        LightBounds below;
+        for (int split = 0; split < kLightBVHBuckets - 1; split++) {
+            below = Union(below, buckets[split]);
+            if (below.phi == 0 || above[split].phi == 0) {
+                continue;
+            }
+            const Real cost = EvaluateCost(below, bounds, dim) + EvaluateCost(above[split], bounds, dim);
+            if (cost > 0 && cost < min_cost) {
+                min_cost   = cost;
+                min_dim    = dim;
+                min_bucket = split;
+            }
+        }
+    }
+
+    int mid = (begin + end) / 2;
+    if (min_dim >= 0) {
+        auto it = std::partition(lights.begin() + begin, lights.begin() + end, [&](const BuildLight& l) {
+            return CentroidBucket(l.centroid, cmin, cmax, min_dim) <= min_bucket;
+        });
+        mid     = int(it - lights.begin());
+    }
+    if (mid == begin || mid == end) {
+        // All centroids coincide (or the costs are degenerate), split by count
+        mid = (begin + end) / 2;
+        std::nth_element(lights.begin() + begin,
+                         lights.begin() + mid,
+                         lights.begin() + end,
+                         [](const BuildLight& a, const BuildLight& b) { return a.lightId < b.lightId; });
+    }
+
+    BuildNode(bvh, lights, begin, mid, node_id);
+    const int second   = BuildNode(bvh, lights, mid, end, node_id);
+    bvh.nodes[node_id] = LightBVHNode{bounds, second, false};
+    return node_id;
+}
+
+/// The probability of sampling from the tree rather than an infinite light
+Real TreeProbability(const LightBVH& bvh)
+{
+    if (bvh.nodes.empty()) {
+        return 0;
+    }
+    return Real(1) / Real(1 + bvh.infiniteLights.size());
+}
+
+} // namespace
+
+LightBounds Union(const LightBounds& a, const LightBounds& b)
+{
+    if (a.phi == 0) {
+        return b;
+    }
+    if (b.phi == 0) {
+        return a;
+    }
+    LightBounds u;
+    u.pMin                        = Min(a.pMin, b.pMin);
+    u.pMax                        = Max(a.pMax, b.pMax);
+    std::tie(u.axis, u.cosThetaO) = UnionCones(a.axis, a.cosThetaO, b.axis, b.cosThetaO);
+    u.phi                         = a.phi + b.phi;
+    u.cosThetaE                   = Min(a.cosThetaE, b.cosThetaE);
+    u.twoSided                    = a.twoSided || b.twoSided;
+    return u;
+}
+
+Real Importance(const LightBounds& bounds, const Vector3& p, const Vector3& n)
+{
+    if (bounds.phi == 0) {
+        return 0;
+    }
+    const Vector3 pc = (bounds.pMin + bounds.pMax) / Real(2);
+    const Real dist2 = DistanceSquared(p, pc);
+    const Real r2    = DistanceSquared(bounds.pMax, pc);
+    // Clamped to keep points close to (or inside) the bounds from getting unbounded importance
+    const Real d2 = Max(dist2, Length(bounds.pMax - bounds.pMin) / 2);
+
+    // Angles of: the cone of directions from the bounds towards p (theta_b), the axis towards p (theta_w),
+    // and the smallest angle between an emitter normal and the direction towards p (theta_x)
+    const Vector3 wi       = dist2 > 0 ? (p - pc) / std::sqrt(dist2) : bounds.axis;
+    const Real cos_theta_b = dist2 < r2 ? Real(-1) : SafeSqrt(1 - r2 / dist2);
+    const Real sin_theta_b = SafeSqrt(1 - cos_theta_b * cos_theta_b);
+    Real cos_theta_w       = Dot(bounds.axis, wi);
+    if (bounds.twoSided) {
+        cos_theta_w = std::abs(cos_theta_w);
+    }
+    const Real sin_theta_w = SafeSqrt(1 - cos_theta_w * cos_theta_w);
+    const Real sin_theta_o = SafeSqrt(1 - bounds.cosThetaO * bounds.cosThetaO);
+    const Real cos_theta_x = CosSubClamped(sin_theta_w, cos_theta_w, sin_theta_o, bounds.cosThetaO);
+    const Real sin_theta_x = SinSubClamped(sin_theta_w, cos_theta_w, sin_theta_o, bounds.cosThetaO);
+    const Real cos_theta_p = CosSubClamped(sin_theta_x, cos_theta_x, sin_theta_b, cos_theta_b);
+    if (cos_theta_p <= bounds.cosThetaE) {
+        return 0;
+    }
+
+    Real importance = bounds.phi * cos_theta_p / d2;
+    if (LengthSquared(n) > 0) {
+        // The largest cosine at p of a direction towards the bounds
+        const Real cos_theta_i = std::abs(Dot(wi, n));
+        const Real sin_theta_i = SafeSqrt(1 - cos_theta_i * cos_theta_i);
+        importance *= CosSubClamped(sin_theta_i, cos_theta_i, sin_theta_b, cos_theta_b);
+    }
+    return Max(importance, Real(0));
+}
+
+LightBVH MakeLightBVH(const std::vector<std::optional<LightBounds>>& bounds)
+{
+    LightBVH bvh;
+    bvh.lightToLeaf.assign(bounds.size(), -1);
+    std::vector<BuildLight> lights;
+    for (int i = 0; i < (int)bounds.size(); i++) {
+        if (!bounds[i]) {
+            bvh.infiniteLights.push_back(i);
+        }
+        else if (bounds[i]->phi > 0) {
+            lights.push_back(BuildLight{i, *bounds[i], (bounds[i]->pMin + bounds[i]->pMax) / Real(2)});
+        }
+    }
+    if (!lights.empty()) {
+        bvh.nodes.reserve(2 * lights.size() - 1);
+        bvh.parents.reserve(2 * lights.size() - 1);
+        BuildNode(bvh, lights, 0, (int)lights.size(), -1);
+    }
+    return bvh;
+}
+
+LightSampleRecord Sample(const LightBVH& bvh, const Vector3& p, const Vector3& n, Real u)
+{
+    const Real p_tree = TreeProbability(bvh);
+    if (!bvh.infiniteLights.empty() && u >= p_tree) {
+        const int num_infinite = (int)bvh.infiniteLights.size();
+        const int i            = int((u - p_tree) / (1 - p_tree) * num_infinite);
+        return {bvh.infiniteLights[std::clamp(i, 0, num_infinite - 1)], (1 - p_tree) / num_infinite};
+    }
+    if (bvh.nodes.empty() || Importance(bvh.nodes[0].bounds, p, n) == 0) {
+        return {-1, Real(0)};
+    }
+    u = Min(u / p_tree, kOneMinusEpsilon);
+
+    int node_id = 0;
+    Real pmf    = p_tree;
+    while (!bvh.nodes[node_id].isLeaf) {
+        const int first              = node_id + 1;
+        const int second             = bvh.nodes[node_id].childOrLightId;
+        const Real first_importance  = Importance(bvh.nodes[first].bounds, p, n);
+        const Real second_importance = Importance(bvh.nodes[second].bounds, p, n);
+        // Both are zero where the looser bounds of the parent were not, no light reaches the point after all
+        if (first_importance == 0 && second_importance == 0) {
+            return {-1, Real(0)};
+        }
+        const Real p_first = first_importance / (first_importance + second_importance);
+        if (u < p_first) {
+            node_id  = first;
+            pmf     *= p_first;
+            u        = Min(u / p_first, kOneMinusEpsilon);
+        }
+        else {
+            node_id  = second;
+            pmf     *= 1 - p_first;
+            u        = Min((u - p_first) / (1 - p_first), kOneMinusEpsilon);
+        }
+    }
+    return {bvh.nodes[node_id].childOrLightId, pmf};
+}
+
+Real Pmf(const LightBVH& bvh, const Vector3& p, const Vector3& n, int light_id)
+{
+    const Real p_tree = TreeProbability(bvh);
+    int node_id       = bvh.lightToLeaf[light_id];
+    if (node_id < 0) {
+        const bool infinite =
+            std::find(bvh.infiniteLights.begin(), bvh.infiniteLights.end(), light_id) != bvh.infiniteLights.end();
+        return infinite ? (1 - p_tree) / Real(bvh.infiniteLights.size()) : Real(0);
+    }
+
+    // The probabilities of the choices on the way from the root, collected bottom up
+    Real pmf = p_tree;
+    if (Importance(bvh.nodes[0].bounds, p, n) == 0) {
+        return 0;
+    }
+    for (int parent = bvh.parents[node_id]; parent >= 0; node_id = parent, parent = bvh.parents[parent]) {
+        const Real first_importance  = Importance(bvh.nodes[parent + 1].bounds, p, n);
+        const Real second_importance = Importance(bvh.nodes[bvh.nodes[parent].childOrLightId].bounds, p, n);
+        const Real importance        = node_id == parent + 1 ? first_importance : second_importance;
+        if (importance == 0) {
+            return 0;
+        }
+        pmf *= importance / (first_importance + second_importance);
+    }
+    return pmf;
+}
+
+} // namespace elma
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Elma.hpp"
+#include "Vector.hpp"
+#include <optional>
+#include <vector>
+
+namespace elma {
+
+/// Where and in which directions one light or a cluster of lights emits, and how much (pbrt-v4's
+/// LightBounds). The emitters lie in the box [pMin, pMax], their normals within acos(cosThetaO) of axis,
+/// and each surface emits up to acos(cosThetaE) away from its normal. Two sided emitters also emit
+/// around -axis. A bounds with phi == 0 bounds nothing.
+struct LightBounds
+{
+    Vector3 pMin, pMax;
+    Vector3 axis;
+    Real phi       = 0;
+    Real cosThetaO = 1;
+    Real cosThetaE = 1;
+    bool twoSided  = false;
+};
+
+LightBounds Union(const LightBounds& a, const LightBounds& b);
+
+/// A conservative estimate of the light the bounded emitters can send to point p. n is the surface normal
+/// at p, both of its sides receive light. It is zero for points in media that receive light from all
+/// directions. Zero only if none of the emitters can illuminate p.
+Real Importance(const LightBounds& bounds, const Vector3& p, const Vector3& n);
+
+struct LightBVHNode
+{
+    LightBounds bounds;
+    int childOrLightId; // interior nodes: the second child, the first child directly follows the node
+    bool isLeaf;
+};
+
+/// A bounding volume hierarchy over the lights for many-light sampling. Sampling walks down from the root
+/// and picks each child with probability proportional to its importance for the shading point, so the
+/// lights close to the point and facing it are sampled more often than their power alone would suggest.
+/// Infinite lights (envmaps) can't be bounded: they are sampled uniformly, each as likely as the whole tree.
+struct LightBVH
+{
+    std::vector<LightBVHNode> nodes;
+    std::vector<int> parents;     // -1 for the root
+    std::vector<int> lightToLeaf; // -1 for lights that are not in the tree
+    std::vector<int> infiniteLights;
+};
+
+/// bounds[i] is nullopt for infinite lights. Lights with zero phi are never sampled.
+LightBVH MakeLightBVH(const std::vector<std::optional<LightBounds>>& bounds);
+
+/// A light picked for a shading point, with the probability of picking it
+struct LightSampleRecord
+{
+    int lightId; // -1 if no light can illuminate the point
+    Real pmf;
+};
+
+/// Sample a light for the point p with surface normal n (zero in media) given a random number in [0, 1].
+/// No light is returned if none of them can illuminate the point, so the pmfs below can sum to less than one.
+/// The pmf of the sampled light is collected on the way down, without a second traversal.
+LightSampleRecord Sample(const LightBVH& bvh, const Vector3& p, const Vector3& n, Real u);
+
+/// The probability mass function of the sampling procedure above.
+Real Pmf(const LightBVH& bvh, const Vector3& p, const Vector3& n, int light_id);
+
+} // namespace elma
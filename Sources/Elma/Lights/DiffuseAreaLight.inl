@@ -3,6 +3,77 @@ Real light_power_op::operator()(const DiffuseAreaLight& light) const
     return Luminance(light.intensity) * SurfaceArea(scene.shapes[light.shape_id]) * kPi;
 }
 
+std::optional<LightBounds> light_bounds_op::operator()(const DiffuseAreaLight& light) const
+{
+    const Shape& shape = scene.shapes[light.shape_id];
+    LightBounds bounds;
+    bounds.phi       = light_power_op{scene}(light);
+    bounds.cosThetaE = 0; // diffuse emission covers the hemisphere around the normal
+    if (const Sphere* sphere = std::get_if<Sphere>(&shape)) {
+        const Vector3 r{sphere->radius, sphere->radius, sphere->radius};
+        bounds.pMin      = sphere->position - r;
+        bounds.pMax      = sphere->position + r;
+        bounds.axis      = Vector3{0, 0, 1};
+        bounds.cosThetaO = -1; // normals in all directions
+    }
+    else if (const TriangleMesh* mesh = std::get_if<TriangleMesh>(&shape)) {
+        bounds.pMin = Vector3{Infinity<Real>(), Infinity<Real>(), Infinity<Real>()};
+        bounds.pMax = -bounds.pMin;
+        for (const Vector3f& p : mesh->positions) {
+            bounds.pMin = Min(bounds.pMin, Vector3(p));
+            bounds.pMax = Max(bounds.pMax, Vector3(p));
+        }
+        // A triangle emits on the side of its shading normals (see SamplePointOnShape), on both sides
+        // if its vertex normals disagree. Returns the area weighted normal of the emitting side.
+        auto emitting_normal = [&](const Vector3i& index, bool& both_sides) {
+            const Vector3 v0 = mesh->positions[index[0]];
+            const Vector3 v1 = mesh->positions[index[1]];
+            const Vector3 v2 = mesh->positions[index[2]];
+            const Vector3 n  = Cross(v1 - v0, v2 - v0);
+            int num_flipped  = 0;
+            if (mesh->normals.size() > 0) {
+                for (int i = 0; i < 3; i++) {
+                    num_flipped += Dot(n, mesh->normals[index[i]]) < 0;
+                }
+            }
+            both_sides = num_flipped > 0 && num_flipped < 3;
+            return num_flipped == 3 ? -n : n;
+        };
+        Vector3 normal_sum{0, 0, 0};
+        Real area_sum = 0;
+        for (const Vector3i& index : mesh->indices) {
+            bool both_sides;
+            const Vector3 n  = emitting_normal(index, both_sides);
+            normal_sum      += n;
+            area_sum        += Length(n);
+            bounds.twoSided |= both_sides;
+        }
+        if (Length(normal_sum) > Real(1e-3) * area_sum) {
+            // The normal cone around the average normal, a two sided cone also covers the flipped normals
+            bounds.axis      = Normalize(normal_sum);
+            bounds.cosThetaO = 1;
+            for (const Vector3i& index : mesh->indices) {
+                bool both_sides;
+                const Vector3 n = Normalize(emitting_normal(index, both_sides));
+                if (LengthSquared(n) > 0) {
+                    const Real cos_theta = Dot(bounds.axis, n);
+                    bounds.cosThetaO     = Min(bounds.cosThetaO, bounds.twoSided ? std::abs(cos_theta) : cos_theta);
+                }
+            }
+        }
+        else {
+            // Closed or otherwise balanced meshes
+            bounds.axis      = Vector3{0, 0, 1};
+            bounds.cosThetaO = -1;
+        }
+    }
+    else {
+        // Instances can't be area lights
+        bounds.phi = 0;
+    }
+    return bounds;
+}
+
 PointAndNormal sample_point_on_light_op::operator()(const DiffuseAreaLight& light) const
 {
     const Shape& shape = scene.shapes[light.shape_id];
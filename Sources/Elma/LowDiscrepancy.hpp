@@ -0,0 +1,145 @@
+#pragma once
+
+#include "Elma.hpp"
+
+namespace elma {
+// Building blocks for the low-discrepancy samplers, mostly following pbrt-v4.
+
+/// Largest Real below one. Fixed point to floating point conversions are clamped to it.
+constexpr Real kOneMinusEpsilon = std::is_same_v<Real, float> ? Real(0x1.fffffep-1) : Real(0x1.fffffffffffffp-1);
+
+/// 64-bit finalizer with good avalanche behavior, used to turn indices into hash values.
+inline uint64_t MixBits(uint64_t v)
+{
+    v ^= (v >> 31);
+    v *= 0x7fb5d329728ea185ull;
+    v ^= (v >> 27);
+    v *= 0x81dadef4bc2dd44dull;
+    v ^= (v >> 33);
+    return v;
+}
+
+inline uint64_t HashCombine(uint64_t a, uint64_t b)
+{
+    return MixBits(a * 0x9e3779b97f4a7c15ull ^ b);
+}
+
+inline uint32_t ReverseBits32(uint32_t v)
+{
+    v = (v << 16) | (v >> 16);
+    v = ((v & 0x00ff00ffu) << 8) | ((v & 0xff00ff00u) >> 8);
+    v = ((v & 0x0f0f0f0fu) << 4) | ((v & 0xf0f0f0f0u) >> 4);
+    v = ((v & 0x33333333u) << 2) | ((v & 0xccccccccu) >> 2);
+    v = ((v & 0x55555555u) << 1) | ((v & 0xaaaaaaaau) >> 1);
+    return v;
+}
+
+/// Spreads the lower 32 bits of x to the even bits of the result.
+inline uint64_t LeftShift2(uint64_t x)
+{
+    x &= 0xffffffffull;
+    x  = (x ^ (x << 16)) & 0x0000ffff0000ffffull;
+    x  = (x ^ (x << 8)) & 0x00ff00ff00ff00ffull;
+    x  = (x ^ (x << 4)) & 0x0f0f0f0f0f0f0f0full;
+    x  = (x ^ (x << 2)) & 0x3333333333333333ull;
+    x  = (x ^ (x << 1)) & 0x5555555555555555ull;
+    return x;
+}
+
+/// Z-order (Morton) index of a 2D coordinate, x occupies the even bits.
+inline uint64_t EncodeMorton2(uint32_t x, uint32_t y)
+{
+    return (LeftShift2(y) << 1) | LeftShift2(x);
+}
+
+inline int Log2Int(uint32_t v)
+{
+    int r = 0;
+    while (v >>= 1) {
+        r++;
+    }
+    return r;
+}
+
+inline uint32_t RoundUpPow2(uint32_t v)
+{
+    v--;
+    v |= v >> 1;
+    v |= v >> 2;
+    v |= v >> 4;
+    v |= v >> 8;
+    v |= v >> 16;
+    return v + 1;
+}
+
+/// The first two dimensions of the Sobol sequence as 32-bit fixed point values:
+/// dimension 0 is the van der Corput sequence, dimension 1 uses the Pascal matrix.
+/// Together they form a (0,2)-sequence in base 2.
+inline uint32_t SobolSample(uint64_t index, int dim)
+{
+    assert(dim == 0 || dim == 1);
+    if (dim == 0) {
+        return ReverseBits32((uint32_t)index);
+    }
+    uint32_t v = 0;
+    for (uint32_t c = 1u << 31; index; index >>= 1, c ^= c >> 1) {
+        if (index & 1) {
+            v ^= c;
+        }
+    }
+    return v;
+}
+
+/// Hash based Owen scrambling of a 32-bit fixed point value.
+/// See "Stratified Sampling for Stochastic Transparency" (Laine and Karras 2011),
+/// and the improved hash from pbrt-v4.
+inline uint32_t FastOwenScramble(uint32_t v, uint32_t seed)
+{
+    v  = ReverseBits32(v);
+    v ^= v * 0x3d20adeau;
+    v += seed;
+    v *= (seed >> 16) | 1;
+    v ^= v * 0x05526c56u;
+    v ^= v * 0x53a22864u;
+    return ReverseBits32(v);
+}
+
+inline Real FixedPointToReal(uint32_t v)
+{
+    return Min(Real(v) * Real(0x1p-32), kOneMinusEpsilon);
+}
+
+/// Element i of a random permutation of [0, l) chosen by p.
+/// "Correlated Multi-Jittered Sampling" (Kensler 2013).
+inline uint32_t PermutationElement(uint32_t i, uint32_t l, uint32_t p)
+{
+    uint32_t w = l - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    do {
+        i ^= p;
+        i *= 0xe170893du;
+        i ^= p >> 16;
+        i ^= (i & w) >> 4;
+        i ^= p >> 8;
+        i *= 0x0929eb3fu;
+        i ^= p >> 23;
+        i ^= (i & w) >> 1;
+        i *= 1 | p >> 27;
+        i *= 0x6935fa69u;
+        i ^= (i & w) >> 11;
+        i *= 0x74dcb303u;
+        i ^= (i & w) >> 2;
+        i *= 0x9e501cc3u;
+        i ^= (i & w) >> 2;
+        i *= 0xc860a3dfu;
+        i &= w;
+        i ^= i >> 5;
+    } while (i >= l);
+    return (i + p) % l;
+}
+
+} // namespace elma
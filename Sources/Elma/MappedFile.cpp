@@ -0,0 +1,108 @@
+#include "MappedFile.hpp"
+#include "Common/Error.hpp"
+
+#ifdef ELMA_IN_WINDOWS
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace elma {
+
+#ifdef ELMA_IN_WINDOWS
+
+MappedFile::MappedFile(const fs::path& filename)
+{
+    HANDLE file = CreateFileW(filename.c_str(),
+                              GENERIC_READ,
+                              FILE_SHARE_READ,
+                              nullptr,
+                              OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        ELMA_THROW("无法打开文件 {}。", filename.string());
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        ELMA_THROW("无法获取文件大小 {}。", filename.string());
+    }
+    fileHandle = file;
+    fileSize   = size_t(size.QuadPart);
+    if (fileSize == 0) {
+        return;
+    }
+    mappingHandle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle != nullptr) {
+        mapped = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (mapped == nullptr) {
+        if (mappingHandle != nullptr) {
+            CloseHandle(mappingHandle);
+        }
+        CloseHandle(file);
+        ELMA_THROW("无法映射文件 {}。", filename.string());
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (mapped != nullptr) {
+        UnmapViewOfFile(mapped);
+    }
+    if (mappingHandle != nullptr) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle != nullptr) {
+        CloseHandle(fileHandle);
+    }
+    mapped        = nullptr;
+    mappingHandle = nullptr;
+    fileHandle    = nullptr;
+}
+
+#else
+
+MappedFile::MappedFile(const fs::path& filename)
+{
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        ELMA_THROW("无法打开文件 {}。", filename.string());
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        ELMA_THROW("无法获取文件大小 {}。", filename.string());
+    }
+    fileSize = size_t(st.st_size);
+    if (fileSize > 0) {
+        void* p = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            ELMA_THROW("无法映射文件 {}。", filename.string());
+        }
+        // Parsers go through all of it, read ahead
+        madvise(p, fileSize, MADV_WILLNEED);
+        mapped = static_cast<const char*>(p);
+    }
+    // The mapping keeps the file alive
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (mapped != nullptr) {
+        munmap(const_cast<char*>(mapped), fileSize);
+    }
+}
+
+#endif
+
+} // namespace elma
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Elma.hpp"
+#include "Common/Defines.hpp"
+
+#include <string_view>
+
+namespace elma {
+
+/// A whole file mapped read-only into memory, so that parsers can scan it in place
+/// (and in parallel) instead of copying it through streams. Throws if the file can't be mapped.
+class MappedFile
+{
+public:
+    explicit MappedFile(const fs::path& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return mapped; }
+
+    size_t size() const { return fileSize; }
+
+    std::string_view view() const { return {mapped, fileSize}; }
+
+private:
+    const char* mapped = nullptr; // nullptr for empty files
+    size_t fileSize    = 0;
+#ifdef ELMA_IN_WINDOWS
+    void* fileHandle    = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+} // namespace elma
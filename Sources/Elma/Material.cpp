@@ -12,63 +12,90 @@ inline Vector3 SampleCosHemisphere(const Vector2& rnd_param)
 
 struct EvalOp
 {
-    Spectrum operator()(const Lambertian& bsdf) const;
-    Spectrum operator()(const RoughPlastic& bsdf) const;
-    Spectrum operator()(const RoughDielectric& bsdf) const;
-    Spectrum operator()(const DisneyDiffuse& bsdf) const;
-    Spectrum operator()(const DisneyMetal& bsdf) const;
-    Spectrum operator()(const DisneyGlass& bsdf) const;
-    Spectrum operator()(const DisneyClearcoat& bsdf) const;
-    Spectrum operator()(const DisneySheen& bsdf) const;
-    Spectrum operator()(const DisneyBSDF& bsdf) const;
-    Spectrum operator()(const DisneyMetal& bsdf, Real specular, Real metallic, Real specularTint, Real eta) const;
+    Spectrum operator()(const LambertianClosure& bsdf) const;
+    Spectrum operator()(const RoughPlasticClosure& bsdf) const;
+    Spectrum operator()(const RoughDielectricClosure& bsdf) const;
+    Spectrum operator()(const DisneyDiffuseClosure& bsdf) const;
+    Spectrum operator()(const DisneyMetalClosure& bsdf) const;
+    Spectrum operator()(const DisneyGlassClosure& bsdf) const;
+    Spectrum operator()(const DisneyClearcoatClosure& bsdf) const;
+    Spectrum operator()(const DisneySheenClosure& bsdf) const;
+    Spectrum operator()(const DisneyBSDFClosure& bsdf) const;
+    Spectrum
+    operator()(const DisneyMetalClosure& bsdf, Real specular, Real metallic, Real specularTint, Real eta) const;
 
     const Vector3& dirIn;
     const Vector3& dirOut;
     const PathVertex& vertex;
-    const TexturePool& texturePool;
     const TransportDirection& dir;
 };
 
 struct PdfSampleBSDFOp
 {
-    Real operator()(const Lambertian& bsdf) const;
-    Real operator()(const RoughPlastic& bsdf) const;
-    Real operator()(const RoughDielectric& bsdf) const;
-    Real operator()(const DisneyDiffuse& bsdf) const;
-    Real operator()(const DisneyMetal& bsdf) const;
-    Real operator()(const DisneyGlass& bsdf) const;
-    Real operator()(const DisneyClearcoat& bsdf) const;
-    Real operator()(const DisneySheen& bsdf) const;
-    Real operator()(const DisneyBSDF& bsdf) const;
+    Real operator()(const LambertianClosure& bsdf) const;
+    Real operator()(const RoughPlasticClosure& bsdf) const;
+    Real operator()(const RoughDielectricClosure& bsdf) const;
+    Real operator()(const DisneyDiffuseClosure& bsdf) const;
+    Real operator()(const DisneyMetalClosure& bsdf) const;
+    Real operator()(const DisneyGlassClosure& bsdf) const;
+    Real operator()(const DisneyClearcoatClosure& bsdf) const;
+    Real operator()(const DisneySheenClosure& bsdf) const;
+    Real operator()(const DisneyBSDFClosure& bsdf) const;
 
     const Vector3& dirIn;
     const Vector3& dirOut;
     const PathVertex& vertex;
-    const TexturePool& texturePool;
     const TransportDirection& dir;
 };
 
 struct SampleBSDFOp
 {
-    std::optional<BSDFSampleRecord> operator()(const Lambertian& bsdf) const;
-    std::optional<BSDFSampleRecord> operator()(const RoughPlastic& bsdf) const;
-    std::optional<BSDFSampleRecord> operator()(const RoughDielectric& bsdf) const;
-    std::optional<BSDFSampleRecord> operator()(const DisneyDiffuse& bsdf) const;
-    std::optional<BSDFSampleRecord> operator()(const DisneyMetal& bsdf) const;
-    std::optional<BSDFSampleRecord> operator()(const DisneyGlass& bsdf) const;
-    std::optional<BSDFSampleRecord> operator()(const DisneyClearcoat& bsdf) const;
-    std::optional<BSDFSampleRecord> operator()(const DisneySheen& bsdf) const;
-    std::optional<BSDFSampleRecord> operator()(const DisneyBSDF& bsdf) const;
+    std::optional<BSDFSampleRecord> operator()(const LambertianClosure& bsdf) const;
+    std::optional<BSDFSampleRecord> operator()(const RoughPlasticClosure& bsdf) const;
+    std::optional<BSDFSampleRecord> operator()(const RoughDielectricClosure& bsdf) const;
+    std::optional<BSDFSampleRecord> operator()(const DisneyDiffuseClosure& bsdf) const;
+    std::optional<BSDFSampleRecord> operator()(const DisneyMetalClosure& bsdf) const;
+    std::optional<BSDFSampleRecord> operator()(const DisneyGlassClosure& bsdf) const;
+    std::optional<BSDFSampleRecord> operator()(const DisneyClearcoatClosure& bsdf) const;
+    std::optional<BSDFSampleRecord> operator()(const DisneySheenClosure& bsdf) const;
+    std::optional<BSDFSampleRecord> operator()(const DisneyBSDFClosure& bsdf) const;
 
     const Vector3& dirIn;
     const PathVertex& vertex;
-    const TexturePool& texturePool;
     const Vector2& rndParamUV;
     const Real& rndParamW;
     const TransportDirection& dir;
 };
 
+struct PrepareBSDFOp
+{
+    BSDFClosure operator()(const Lambertian& bsdf) const;
+    BSDFClosure operator()(const RoughPlastic& bsdf) const;
+    BSDFClosure operator()(const RoughDielectric& bsdf) const;
+    BSDFClosure operator()(const DisneyDiffuse& bsdf) const;
+    BSDFClosure operator()(const DisneyMetal& bsdf) const;
+    BSDFClosure operator()(const DisneyGlass& bsdf) const;
+    BSDFClosure operator()(const DisneyClearcoat& bsdf) const;
+    BSDFClosure operator()(const DisneySheen& bsdf) const;
+    BSDFClosure operator()(const DisneyBSDF& bsdf) const;
+
+    const PathVertex& vertex;
+    const TexturePool& texturePool;
+};
+
+struct is_constant_op
+{
+    bool operator()(const Lambertian& bsdf) const;
+    bool operator()(const RoughPlastic& bsdf) const;
+    bool operator()(const RoughDielectric& bsdf) const;
+    bool operator()(const DisneyDiffuse& bsdf) const;
+    bool operator()(const DisneyMetal& bsdf) const;
+    bool operator()(const DisneyGlass& bsdf) const;
+    bool operator()(const DisneyClearcoat& bsdf) const;
+    bool operator()(const DisneySheen& bsdf) const;
+    bool operator()(const DisneyBSDF& bsdf) const;
+};
+
 struct get_texture_op
 {
     TextureSpectrum operator()(const Lambertian& bsdf) const;
@@ -92,6 +119,20 @@ struct get_texture_op
 #include "Materials/DisneySheen.inl"
 #include "Materials/DisneyBSDF.inl"
 
+BSDFClosure PrepareBSDF(const Material& material, const PathVertex& vertex, const TexturePool& texture_pool)
+{
+    return std::visit(PrepareBSDFOp{vertex, texture_pool}, material);
+}
+
+std::optional<BSDFClosure> CompileBSDF(const Material& material, const TexturePool& texture_pool)
+{
+    if (!std::visit(is_constant_op{}, material)) {
+        return {};
+    }
+    // Constant textures don't look at the vertex
+    return PrepareBSDF(material, PathVertex{}, texture_pool);
+}
+
 Spectrum Eval(const Material& material,
               const Vector3& dir_in,
               const Vector3& dir_out,
@@ -99,7 +140,7 @@ Spectrum Eval(const Material& material,
               const TexturePool& texture_pool,
               TransportDirection dir)
 {
-    return std::visit(EvalOp{dir_in, dir_out, vertex, texture_pool, dir}, material);
+    return Eval(PrepareBSDF(material, vertex, texture_pool), dir_in, dir_out, vertex, dir);
 }
 
 std::optional<BSDFSampleRecord> SampleBSDF(const Material& material,
@@ -110,7 +151,7 @@ std::optional<BSDFSampleRecord> SampleBSDF(const Material& material,
                                            const Real& rnd_param_w,
                                            TransportDirection dir)
 {
-    return std::visit(SampleBSDFOp{dir_in, vertex, texture_pool, rnd_param_uv, rnd_param_w, dir}, material);
+    return SampleBSDF(PrepareBSDF(material, vertex, texture_pool), dir_in, vertex, rnd_param_uv, rnd_param_w, dir);
 }
 
 Real PdfSampleBSDF(const Material& material,
@@ -120,7 +161,46 @@ Real PdfSampleBSDF(const Material& material,
                    const TexturePool& texture_pool,
                    TransportDirection dir)
 {
-    return std::visit(PdfSampleBSDFOp{dir_in, dir_out, vertex, texture_pool, dir}, material);
+    return PdfSampleBSDF(PrepareBSDF(material, vertex, texture_pool), dir_in, dir_out, vertex, dir);
+}
+
+Spectrum Eval(const BSDFClosure& bsdf,
+              const Vector3& dir_in,
+              const Vector3& dir_out,
+              const PathVertex& vertex,
+              TransportDirection dir)
+{
+    return std::visit(EvalOp{dir_in, dir_out, vertex, dir}, bsdf);
+}
+
+std::optional<BSDFSampleRecord> SampleBSDF(const BSDFClosure& bsdf,
+                                           const Vector3& dir_in,
+                                           const PathVertex& vertex,
+                                           const Vector2& rnd_param_uv,
+                                           const Real& rnd_param_w,
+                                           TransportDirection dir)
+{
+    return std::visit(SampleBSDFOp{dir_in, vertex, rnd_param_uv, rnd_param_w, dir}, bsdf);
+}
+
+Real PdfSampleBSDF(const BSDFClosure& bsdf,
+                   const Vector3& dir_in,
+                   const Vector3& dir_out,
+                   const PathVertex& vertex,
+                   TransportDirection dir)
+{
+    return std::visit(PdfSampleBSDFOp{dir_in, dir_out, vertex, dir}, bsdf);
+}
+
+BSDFEvalRecord EvalWithPdf(const BSDFClosure& bsdf,
+                           const Vector3& dir_in,
+                           const Vector3& dir_out,
+                           const PathVertex& vertex,
+                           TransportDirection dir)
+{
+    const EvalOp eval{dir_in, dir_out, vertex, dir};
+    const PdfSampleBSDFOp pdf{dir_in, dir_out, vertex, dir};
+    return std::visit([&](const auto& b) { return BSDFEvalRecord{eval(b), pdf(b)}; }, bsdf);
 }
 
 TextureSpectrum GetTexture(const Material& material)
@@ -119,6 +119,106 @@ using Material = std::variant<Lambertian,
                               DisneySheen,
                               DisneyBSDF>;
 
+/// The parameters of a material at a shading point: all of its textures evaluated once, so that evaluating,
+/// sampling and computing the pdf of the BSDF several times at a path vertex don't repeat the texture lookups.
+/// Roughnesses are clamped to [0.01, 1] to avoid numerical issues.
+struct LambertianClosure
+{
+    Spectrum reflectance;
+};
+
+struct RoughPlasticClosure
+{
+    Spectrum diffuseReflectance;
+    Spectrum specularReflectance;
+    Real roughness;
+    Real eta;
+};
+
+struct RoughDielectricClosure
+{
+    Spectrum specularReflectance;
+    Spectrum specularTransmittance;
+    Real roughness;
+    Real eta;
+};
+
+struct DisneyDiffuseClosure
+{
+    Spectrum baseColor;
+    Real roughness;
+    Real subsurface;
+};
+
+struct DisneyMetalClosure
+{
+    Spectrum baseColor;
+    Real roughness;
+    Real anisotropic;
+};
+
+struct DisneyGlassClosure
+{
+    Spectrum baseColor;
+    Real roughness;
+    Real anisotropic;
+    Real eta;
+};
+
+struct DisneyClearcoatClosure
+{
+    Real clearcoatGloss;
+};
+
+struct DisneySheenClosure
+{
+    Spectrum baseColor;
+    Real sheenTint;
+};
+
+struct DisneyBSDFClosure
+{
+    Spectrum baseColor;
+    Real specularTransmission;
+    Real metallic;
+    Real subsurface;
+    Real specular;
+    Real roughness;
+    Real specularTint;
+    Real anisotropic;
+    Real sheen;
+    Real sheenTint;
+    Real clearcoat;
+    Real clearcoatGloss;
+
+    Real eta;
+
+    // Probabilities of sampling the diffuse, metal, glass and clearcoat lobes from outside, computed by
+    // PrepareBSDF. In double like the sampling always computed them, so that float builds sample the same lobes.
+    double diffuseWeight   = 0;
+    double metalWeight     = 0;
+    double glassWeight     = 0;
+    double clearcoatWeight = 0;
+};
+
+/// One alternative per material, in the same order.
+using BSDFClosure = std::variant<LambertianClosure,
+                                 RoughPlasticClosure,
+                                 RoughDielectricClosure,
+                                 DisneyDiffuseClosure,
+                                 DisneyMetalClosure,
+                                 DisneyGlassClosure,
+                                 DisneyClearcoatClosure,
+                                 DisneySheenClosure,
+                                 DisneyBSDFClosure>;
+
+/// Evaluates the textures of the material at the vertex.
+BSDFClosure PrepareBSDF(const Material& material, const PathVertex& vertex, const TexturePool& texture_pool);
+
+/// The closure of a material whose textures are all constant, the same at every vertex, so that the scene can
+/// prepare it once when it's built. Empty if some texture varies over the surface.
+std::optional<BSDFClosure> CompileBSDF(const Material& material, const TexturePool& texture_pool);
+
 /// We allow non-reciprocal BRDFs, so it's important
 /// to distinguish which direction we are tracing the rays.
 enum class TransportDirection
@@ -176,6 +276,39 @@ Real PdfSampleBSDF(const Material& material,
                    const TexturePool& texture_pool,
                    TransportDirection dir = TransportDirection::TO_LIGHT);
 
+/// The same as above, for a material prepared at the vertex.
+Spectrum Eval(const BSDFClosure& bsdf,
+              const Vector3& dir_in,
+              const Vector3& dir_out,
+              const PathVertex& vertex,
+              TransportDirection dir = TransportDirection::TO_LIGHT);
+
+std::optional<BSDFSampleRecord> SampleBSDF(const BSDFClosure& bsdf,
+                                           const Vector3& dir_in,
+                                           const PathVertex& vertex,
+                                           const Vector2& rnd_param_uv,
+                                           const Real& rnd_param_w,
+                                           TransportDirection dir = TransportDirection::TO_LIGHT);
+
+Real PdfSampleBSDF(const BSDFClosure& bsdf,
+                   const Vector3& dir_in,
+                   const Vector3& dir_out,
+                   const PathVertex& vertex,
+                   TransportDirection dir = TransportDirection::TO_LIGHT);
+
+struct BSDFEvalRecord
+{
+    Spectrum f;
+    Real pdf;
+};
+
+/// Eval() and PdfSampleBSDF() in one call, for the directions that need both (multiple importance sampling).
+BSDFEvalRecord EvalWithPdf(const BSDFClosure& bsdf,
+                           const Vector3& dir_in,
+                           const Vector3& dir_out,
+                           const PathVertex& vertex,
+                           TransportDirection dir = TransportDirection::TO_LIGHT);
+
 /// Return a texture from the material for debugging.
 /// If the material contains multiple textures, return an arbitrary one.
 TextureSpectrum GetTexture(const Material& material);
@@ -1,6 +1,6 @@
 #include "../Microfacet.hpp"
 
-Spectrum EvalOp::operator()(const DisneyBSDF& bsdf) const
+Spectrum EvalOp::operator()(const DisneyBSDFClosure& bsdf) const
 {
     bool reflect = Dot(vertex.normal, dirIn) * Dot(vertex.normal, dirOut) > 0;
     // Flip the shading frame if it is inconsistent with the geometry normal
@@ -9,53 +9,56 @@ Spectrum EvalOp::operator()(const DisneyBSDF& bsdf) const
         frame = -frame;
     }
 
-    // clang-format off
-    const auto baseColor = Eval(bsdf.baseColor, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto subsurface = Eval(bsdf.subsurface, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto specular = Eval(bsdf.specular, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto specularTrans = Eval(bsdf.specularTransmission, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto specularTint = Eval(bsdf.specularTint, vertex.uv, vertex.uvScreenSize, texturePool);
-
-    const auto anisotropic = Eval(bsdf.anisotropic, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto roughness = Clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1));
-    const auto metallic = Eval(bsdf.metallic, vertex.uv, vertex.uvScreenSize, texturePool);
-
-    const auto sheen = Eval(bsdf.sheen, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto sheenTint = Eval(bsdf.sheenTint, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto clearcoat = Eval(bsdf.clearcoat, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto gloss = Eval(bsdf.clearcoatGloss, vertex.uv, vertex.uvScreenSize, texturePool);
-    // clang-format on
+    const auto specular      = bsdf.specular;
+    const auto specularTrans = bsdf.specularTransmission;
+    const auto specularTint  = bsdf.specularTint;
+    const auto metallic      = bsdf.metallic;
+    const auto sheen         = bsdf.sheen;
+    const auto clearcoat     = bsdf.clearcoat;
+
+    auto diffuseBSDF   = DisneyDiffuseClosure{bsdf.baseColor, bsdf.roughness, bsdf.subsurface};
+    auto metalBSDF     = DisneyMetalClosure{bsdf.baseColor, bsdf.roughness, bsdf.anisotropic};
+    auto clearcoatBSDF = DisneyClearcoatClosure{bsdf.clearcoatGloss};
+    auto glassBSDF     = DisneyGlassClosure{bsdf.baseColor, bsdf.roughness, bsdf.anisotropic, bsdf.eta};
+    auto sheenBSDF     = DisneySheenClosure{bsdf.baseColor, bsdf.sheenTint};
 
-    auto diffuseBSDF   = DisneyDiffuse{bsdf.baseColor, bsdf.roughness, bsdf.subsurface};
-    auto metalBSDF     = DisneyMetal{bsdf.baseColor, bsdf.roughness, bsdf.anisotropic};
-    auto clearcoatBSDF = DisneyClearcoat{bsdf.clearcoatGloss};
-    auto glassBSDF     = DisneyGlass{bsdf.baseColor, bsdf.roughness, bsdf.anisotropic, bsdf.eta};
-    auto sheenBSDF     = DisneySheen{bsdf.baseColor, bsdf.sheenTint};
+    auto eval = EvalOp{dirIn, dirOut, vertex, dir};
 
-    auto eval = EvalOp{dirIn, dirOut, vertex, texturePool, dir};
+    // Lobes of zero weight would only add zeros, they're skipped
+    const Real diffuseW   = (1 - specularTrans) * (1 - metallic);
+    const Real sheenW     = (1 - metallic) * sheen;
+    const Real metalW     = 1 - specularTrans * (1 - metallic);
+    const Real clearcoatW = Real(0.25) * clearcoat;
+    const Real glassW     = (1 - metallic) * specularTrans;
 
     if (Dot(dirIn, vertex.normal) <= 0) {
         // inside
-        return (1.0 - metallic) * specularTrans * eval(glassBSDF);
+        return glassW != 0 ? glassW * eval(glassBSDF) : MakeZeroSpectrum();
     }
 
     const auto eta = Dot(vertex.normal, dirIn) > 0 ? bsdf.eta : 1 / bsdf.eta;
 
-    const auto f_diffuse = eval(diffuseBSDF);
-    const auto f_metal   = eval(metalBSDF, specular, metallic, specularTint, eta);
-    const auto f_cc      = eval(clearcoatBSDF);
-    const auto f_glass   = eval(glassBSDF);
-    const auto f_sheen   = eval(sheenBSDF);
-
     // blend things together
-    return (1.0 - specularTrans) * (1.0 - metallic) * f_diffuse + // diffuse
-           (1.0 - metallic) * sheen * f_sheen +                   // sheen
-           (1.0 - specularTrans * (1.0 - metallic)) * f_metal +   // metal
-           Real(0.25) * clearcoat * f_cc +                        // clearcoat
-           (1.0 - metallic) * specularTrans * f_glass;
+    Spectrum f = MakeZeroSpectrum();
+    if (diffuseW != 0) {
+        f = diffuseW * eval(diffuseBSDF);
+    }
+    if (sheenW != 0) {
+        f = f + sheenW * eval(sheenBSDF);
+    }
+    if (metalW != 0) {
+        f = f + metalW * eval(metalBSDF, specular, metallic, specularTint, eta);
+    }
+    if (clearcoatW != 0) {
+        f = f + clearcoatW * eval(clearcoatBSDF);
+    }
+    if (glassW != 0) {
+        f = f + glassW * eval(glassBSDF);
+    }
+    return f;
 }
 
-Real PdfSampleBSDFOp::operator()(const DisneyBSDF& bsdf) const
+Real PdfSampleBSDFOp::operator()(const DisneyBSDFClosure& bsdf) const
 {
     bool reflect = Dot(vertex.normal, dirIn) * Dot(vertex.normal, dirOut) > 0;
     // Flip the shading frame if it is inconsistent with the geometry normal
@@ -64,53 +67,35 @@ Real PdfSampleBSDFOp::operator()(const DisneyBSDF& bsdf) const
         frame = -frame;
     }
 
-    // clang-format off
-    const auto baseColor = Eval(bsdf.baseColor, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto subsurface = Eval(bsdf.subsurface, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto specular = Eval(bsdf.specular, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto specularTrans = Eval(bsdf.specularTransmission, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto specularTint = Eval(bsdf.specularTint, vertex.uv, vertex.uvScreenSize, texturePool);
-
-    const auto anisotropic = Eval(bsdf.anisotropic, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto roughness = Clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1));
-    const auto metallic = Eval(bsdf.metallic, vertex.uv, vertex.uvScreenSize, texturePool);
-
-    const auto sheen = Eval(bsdf.sheen, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto sheenTint = Eval(bsdf.sheenTint, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto clearcoat = Eval(bsdf.clearcoat, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto gloss = Eval(bsdf.clearcoatGloss, vertex.uv, vertex.uvScreenSize, texturePool);
-    // clang-format on
-
-    auto pdf = PdfSampleBSDFOp{dirIn, dirOut, vertex, texturePool, dir};
+    auto pdf = PdfSampleBSDFOp{dirIn, dirOut, vertex, dir};
 
-    auto diffuseBSDF   = DisneyDiffuse{bsdf.baseColor, bsdf.roughness, bsdf.subsurface};
-    auto metalBSDF     = DisneyMetal{bsdf.baseColor, bsdf.roughness, bsdf.anisotropic};
-    auto clearcoatBSDF = DisneyClearcoat{bsdf.clearcoatGloss};
-    auto glassBSDF     = DisneyGlass{bsdf.baseColor, bsdf.roughness, bsdf.anisotropic, bsdf.eta};
-    //    auto sheenBSDF     = DisneySheen{bsdf.baseColor, bsdf.sheenTint};
-
-    // 4 weights
-    auto diffuseW   = (1.0 - metallic) * (1.0 - specularTrans);
-    auto metalW     = 1.0 - specularTrans * (1.0 - metallic);
-    auto glassW     = (1.0 - metallic) * specularTrans;
-    auto clearcoatW = 0.25 * clearcoat;
-
-    // normalize to [0,1]
-    const auto totalW  = diffuseW + metalW + glassW + clearcoatW;
-    diffuseW          /= totalW;
-    metalW            /= totalW;
-    glassW            /= totalW;
-    clearcoatW        /= totalW;
+    auto diffuseBSDF   = DisneyDiffuseClosure{bsdf.baseColor, bsdf.roughness, bsdf.subsurface};
+    auto metalBSDF     = DisneyMetalClosure{bsdf.baseColor, bsdf.roughness, bsdf.anisotropic};
+    auto clearcoatBSDF = DisneyClearcoatClosure{bsdf.clearcoatGloss};
+    auto glassBSDF     = DisneyGlassClosure{bsdf.baseColor, bsdf.roughness, bsdf.anisotropic, bsdf.eta};
 
     if (Dot(dirIn, vertex.normal) <= 0) {
         return pdf(glassBSDF);
     }
 
-    return pdf(diffuseBSDF) * diffuseW + pdf(metalBSDF) * metalW + pdf(glassBSDF) * glassW +
-           pdf(clearcoatBSDF) * clearcoatW;
+    // Lobes of zero weight are never sampled
+    double p = 0;
+    if (bsdf.diffuseWeight != 0) {
+        p = pdf(diffuseBSDF) * bsdf.diffuseWeight;
+    }
+    if (bsdf.metalWeight != 0) {
+        p += pdf(metalBSDF) * bsdf.metalWeight;
+    }
+    if (bsdf.glassWeight != 0) {
+        p += pdf(glassBSDF) * bsdf.glassWeight;
+    }
+    if (bsdf.clearcoatWeight != 0) {
+        p += pdf(clearcoatBSDF) * bsdf.clearcoatWeight;
+    }
+    return Real(p);
 }
 
-std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyBSDF& bsdf) const
+std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyBSDFClosure& bsdf) const
 {
     // Flip the shading frame if it is inconsistent with the geometry normal
     Frame frame = vertex.shadingFrame;
@@ -118,55 +103,24 @@ std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyBSDF& bsdf)
         frame = -frame;
     }
 
-    // clang-format off
-    const auto baseColor = Eval(bsdf.baseColor, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto subsurface = Eval(bsdf.subsurface, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto specular = Eval(bsdf.specular, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto specularTrans = Eval(bsdf.specularTransmission, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto specularTint = Eval(bsdf.specularTint, vertex.uv, vertex.uvScreenSize, texturePool);
-
-    const auto anisotropic = Eval(bsdf.anisotropic, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto roughness = Clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1));
-    const auto metallic = Eval(bsdf.metallic, vertex.uv, vertex.uvScreenSize, texturePool);
-
-    const auto sheen = Eval(bsdf.sheen, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto sheenTint = Eval(bsdf.sheenTint, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto clearcoat = Eval(bsdf.clearcoat, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto gloss = Eval(bsdf.clearcoatGloss, vertex.uv, vertex.uvScreenSize, texturePool);
-    // clang-format on
+    auto sample = SampleBSDFOp{dirIn, vertex, rndParamUV, rndParamW, dir};
 
-    auto sample = SampleBSDFOp{dirIn, vertex, texturePool, rndParamUV, rndParamW, dir};
-
-    auto diffuseBSDF   = DisneyDiffuse{bsdf.baseColor, bsdf.roughness, bsdf.subsurface};
-    auto metalBSDF     = DisneyMetal{bsdf.baseColor, bsdf.roughness, bsdf.anisotropic};
-    auto clearcoatBSDF = DisneyClearcoat{bsdf.clearcoatGloss};
-    auto glassBSDF     = DisneyGlass{bsdf.baseColor, bsdf.roughness, bsdf.anisotropic, bsdf.eta};
-    //    auto sheenBSDF     = DisneySheen{bsdf.baseColor, bsdf.sheenTint};
+    auto diffuseBSDF   = DisneyDiffuseClosure{bsdf.baseColor, bsdf.roughness, bsdf.subsurface};
+    auto metalBSDF     = DisneyMetalClosure{bsdf.baseColor, bsdf.roughness, bsdf.anisotropic};
+    auto clearcoatBSDF = DisneyClearcoatClosure{bsdf.clearcoatGloss};
+    auto glassBSDF     = DisneyGlassClosure{bsdf.baseColor, bsdf.roughness, bsdf.anisotropic, bsdf.eta};
 
     if (Dot(dirIn, vertex.normal) <= 0) {
         return sample(glassBSDF);
     }
 
-    // 4 weights
-    auto diffuseW   = (1.0 - metallic) * (1.0 - specularTrans);
-    auto metalW     = 1.0 - specularTrans * (1.0 - metallic);
-    auto glassW     = (1.0 - metallic) * specularTrans;
-    auto clearcoatW = 0.25 * clearcoat;
-
-    // normalize to [0,1]
-    const auto totalW  = diffuseW + metalW + glassW + clearcoatW;
-    diffuseW          /= totalW;
-    metalW            /= totalW;
-    glassW            /= totalW;
-    clearcoatW        /= totalW;
-
-    if (rndParamW < diffuseW) {
+    if (rndParamW < bsdf.diffuseWeight) {
         return sample(diffuseBSDF);
     }
-    else if (rndParamW < diffuseW + metalW) {
+    else if (rndParamW < bsdf.diffuseWeight + bsdf.metalWeight) {
         return sample(metalBSDF);
     }
-    else if (rndParamW < diffuseW + metalW + glassW) {
+    else if (rndParamW < bsdf.diffuseWeight + bsdf.metalWeight + bsdf.glassWeight) {
         return sample(glassBSDF);
     }
     else {
@@ -174,6 +128,50 @@ std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyBSDF& bsdf)
     }
 }
 
+BSDFClosure PrepareBSDFOp::operator()(const DisneyBSDF& bsdf) const
+{
+    // clang-format off
+    DisneyBSDFClosure closure{
+      Eval(bsdf.baseColor, vertex.uv, vertex.uvScreenSize, texturePool),
+      Eval(bsdf.specularTransmission, vertex.uv, vertex.uvScreenSize, texturePool),
+      Eval(bsdf.metallic, vertex.uv, vertex.uvScreenSize, texturePool),
+      Eval(bsdf.subsurface, vertex.uv, vertex.uvScreenSize, texturePool),
+      Eval(bsdf.specular, vertex.uv, vertex.uvScreenSize, texturePool),
+      Clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1)),
+      Eval(bsdf.specularTint, vertex.uv, vertex.uvScreenSize, texturePool),
+      Eval(bsdf.anisotropic, vertex.uv, vertex.uvScreenSize, texturePool),
+      Eval(bsdf.sheen, vertex.uv, vertex.uvScreenSize, texturePool),
+      Eval(bsdf.sheenTint, vertex.uv, vertex.uvScreenSize, texturePool),
+      Eval(bsdf.clearcoat, vertex.uv, vertex.uvScreenSize, texturePool),
+      Eval(bsdf.clearcoatGloss, vertex.uv, vertex.uvScreenSize, texturePool),
+      bsdf.eta};
+    // clang-format on
+
+    // 4 weights, the sheen isn't sampled
+    const double specularTrans = closure.specularTransmission;
+    const double metallic      = closure.metallic;
+    const double diffuseW      = (1.0 - metallic) * (1.0 - specularTrans);
+    const double metalW        = 1.0 - specularTrans * (1.0 - metallic);
+    const double glassW        = (1.0 - metallic) * specularTrans;
+    const double clearcoatW    = 0.25 * closure.clearcoat;
+
+    // normalize to [0,1]
+    const double totalW     = diffuseW + metalW + glassW + clearcoatW;
+    closure.diffuseWeight   = diffuseW / totalW;
+    closure.metalWeight     = metalW / totalW;
+    closure.glassWeight     = glassW / totalW;
+    closure.clearcoatWeight = clearcoatW / totalW;
+    return closure;
+}
+
+bool is_constant_op::operator()(const DisneyBSDF& bsdf) const
+{
+    return IsConstant(bsdf.baseColor) && IsConstant(bsdf.specularTransmission) && IsConstant(bsdf.metallic) &&
+           IsConstant(bsdf.subsurface) && IsConstant(bsdf.specular) && IsConstant(bsdf.roughness) &&
+           IsConstant(bsdf.specularTint) && IsConstant(bsdf.anisotropic) && IsConstant(bsdf.sheen) &&
+           IsConstant(bsdf.sheenTint) && IsConstant(bsdf.clearcoat) && IsConstant(bsdf.clearcoatGloss);
+}
+
 TextureSpectrum get_texture_op::operator()(const DisneyBSDF& bsdf) const
 {
     return bsdf.baseColor;
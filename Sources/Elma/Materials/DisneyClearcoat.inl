@@ -1,6 +1,6 @@
 #include "../Microfacet.hpp"
 
-Spectrum EvalOp::operator()(const DisneyClearcoat& bsdf) const
+Spectrum EvalOp::operator()(const DisneyClearcoatClosure& bsdf) const
 {
     if (Dot(vertex.normal, dirIn) < 0 || Dot(vertex.normal, dirOut) < 0) {
         // No light below the surface
@@ -12,7 +12,7 @@ Spectrum EvalOp::operator()(const DisneyClearcoat& bsdf) const
         frame = -frame;
     }
 
-    const auto gloss = Eval(bsdf.clearcoatGloss, vertex.uv, vertex.uvScreenSize, texturePool);
+    const auto gloss = bsdf.clearcoatGloss;
     const auto h     = Normalize(dirIn + dirOut);
 
     const auto F0 = Real(0.04);
@@ -25,7 +25,7 @@ Spectrum EvalOp::operator()(const DisneyClearcoat& bsdf) const
     return MakeConstSpectrum(0.25) * F * D * G / AbsDot(frame.n, dirIn);
 }
 
-Real PdfSampleBSDFOp::operator()(const DisneyClearcoat& bsdf) const
+Real PdfSampleBSDFOp::operator()(const DisneyClearcoatClosure& bsdf) const
 {
     if (Dot(vertex.normal, dirIn) < 0 || Dot(vertex.normal, dirOut) < 0) {
         // No light below the surface
@@ -37,7 +37,7 @@ Real PdfSampleBSDFOp::operator()(const DisneyClearcoat& bsdf) const
         frame = -frame;
     }
 
-    const auto gloss = Eval(bsdf.clearcoatGloss, vertex.uv, vertex.uvScreenSize, texturePool);
+    const auto gloss = bsdf.clearcoatGloss;
     const auto h     = Normalize(dirIn + dirOut);
 
     const auto D = elma::GTR1(AbsDot(frame.n, h), Lerp(Real(0.1), Real(0.001), gloss));
@@ -45,7 +45,7 @@ Real PdfSampleBSDFOp::operator()(const DisneyClearcoat& bsdf) const
     return Real(0.25) * D * AbsDot(frame.n, h) / AbsDot(h, dirOut);
 }
 
-std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyClearcoat& bsdf) const
+std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyClearcoatClosure& bsdf) const
 {
     if (Dot(vertex.normal, dirIn) < 0) {
         // No light below the surface
@@ -57,7 +57,7 @@ std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyClearcoat&
         frame = -frame;
     }
 
-    const auto gloss  = Eval(bsdf.clearcoatGloss, vertex.uv, vertex.uvScreenSize, texturePool);
+    const auto gloss  = bsdf.clearcoatGloss;
     const auto alpha  = Lerp(Real(0.1), Real(0.001), gloss);
     const auto alpha2 = alpha * alpha;
 
@@ -73,6 +73,16 @@ std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyClearcoat&
     return BSDFSampleRecord{reflected, Real(1.5) /* eta */, Real(0.25) /* roughness */};
 }
 
+BSDFClosure PrepareBSDFOp::operator()(const DisneyClearcoat& bsdf) const
+{
+    return DisneyClearcoatClosure{Eval(bsdf.clearcoatGloss, vertex.uv, vertex.uvScreenSize, texturePool)};
+}
+
+bool is_constant_op::operator()(const DisneyClearcoat& bsdf) const
+{
+    return IsConstant(bsdf.clearcoatGloss);
+}
+
 TextureSpectrum get_texture_op::operator()(const DisneyClearcoat& bsdf) const
 {
     return MakeConstantSpectrumTexture(MakeZeroSpectrum());
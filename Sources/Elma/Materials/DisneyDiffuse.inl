@@ -1,4 +1,4 @@
-Spectrum EvalOp::operator()(const DisneyDiffuse& bsdf) const
+Spectrum EvalOp::operator()(const DisneyDiffuseClosure& bsdf) const
 {
     if (Dot(vertex.normal, dirIn) < 0 || Dot(vertex.normal, dirOut) < 0) {
         // No light below the surface
@@ -10,11 +10,9 @@ Spectrum EvalOp::operator()(const DisneyDiffuse& bsdf) const
         frame = -frame;
     }
 
-    // clang-format off
-    const auto baseColor = Eval(bsdf.baseColor, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto subsurface = Eval(bsdf.subsurface, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto roughness = Clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1));
-    // clang-format on
+    const auto baseColor  = bsdf.baseColor;
+    const auto subsurface = bsdf.subsurface;
+    const auto roughness  = bsdf.roughness;
 
     const auto h         = Normalize(dirIn + dirOut);
     const auto n_dot_out = AbsDot(frame.n, dirOut);
@@ -40,7 +38,7 @@ Spectrum EvalOp::operator()(const DisneyDiffuse& bsdf) const
     return Lerp(dd, ss, subsurface);
 }
 
-Real PdfSampleBSDFOp::operator()(const DisneyDiffuse& bsdf) const
+Real PdfSampleBSDFOp::operator()(const DisneyDiffuseClosure& bsdf) const
 {
     if (Dot(vertex.normal, dirIn) < 0 || Dot(vertex.normal, dirOut) < 0) {
         // No light below the surface
@@ -55,7 +53,7 @@ Real PdfSampleBSDFOp::operator()(const DisneyDiffuse& bsdf) const
     return AbsDot(frame.n, dirOut) * kInvPi;
 }
 
-std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyDiffuse& bsdf) const
+std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyDiffuseClosure& bsdf) const
 {
     if (Dot(vertex.normal, dirIn) < 0) {
         // No light below the surface
@@ -67,10 +65,22 @@ std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyDiffuse& bs
         frame = -frame;
     }
     
-    const auto roughness =
-        Clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1));
+    return BSDFSampleRecord{SampleCosHemisphere(rndParamUV), Real(1) /* eta */, bsdf.roughness /* roughness */};
+}
 
-    return BSDFSampleRecord{SampleCosHemisphere(rndParamUV), Real(1) /* eta */, roughness /* roughness */};
+BSDFClosure PrepareBSDFOp::operator()(const DisneyDiffuse& bsdf) const
+{
+    // clang-format off
+    return DisneyDiffuseClosure{
+      Eval(bsdf.baseColor, vertex.uv, vertex.uvScreenSize, texturePool),
+      Clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1)),
+      Eval(bsdf.subsurface, vertex.uv, vertex.uvScreenSize, texturePool)};
+    // clang-format on
+}
+
+bool is_constant_op::operator()(const DisneyDiffuse& bsdf) const
+{
+    return IsConstant(bsdf.baseColor) && IsConstant(bsdf.roughness) && IsConstant(bsdf.subsurface);
 }
 
 TextureSpectrum get_texture_op::operator()(const DisneyDiffuse& bsdf) const
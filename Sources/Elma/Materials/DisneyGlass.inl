@@ -1,6 +1,6 @@
 #include "../Microfacet.hpp"
 
-Spectrum EvalOp::operator()(const DisneyGlass& bsdf) const
+Spectrum EvalOp::operator()(const DisneyGlassClosure& bsdf) const
 {
     bool reflect = Dot(vertex.normal, dirIn) * Dot(vertex.normal, dirOut) > 0;
     Frame frame  = vertex.shadingFrame;
@@ -10,11 +10,9 @@ Spectrum EvalOp::operator()(const DisneyGlass& bsdf) const
 
     const auto eta = Dot(vertex.normal, dirIn) > 0 ? bsdf.eta : 1 / bsdf.eta;
 
-    // clang-format off
-    const auto baseColor  = Eval(bsdf.baseColor, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto anisotropic = Eval(bsdf.anisotropic, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto roughness = Clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1));
-    // clang-format on
+    const auto baseColor   = bsdf.baseColor;
+    const auto anisotropic = bsdf.anisotropic;
+    const auto roughness   = bsdf.roughness;
 
     const auto aspect = std::sqrt(kOne<Real> - Real(0.9) * anisotropic);
     const auto ax     = std::max(Real(0.0001), roughness * roughness / aspect);
@@ -49,7 +47,7 @@ Spectrum EvalOp::operator()(const DisneyGlass& bsdf) const
            (n_dot_in * sqrtDenom * sqrtDenom);
 }
 
-Real PdfSampleBSDFOp::operator()(const DisneyGlass& bsdf) const
+Real PdfSampleBSDFOp::operator()(const DisneyGlassClosure& bsdf) const
 {
     bool reflect = Dot(vertex.normal, dirIn) * Dot(vertex.normal, dirOut) > 0;
     // Flip the shading frame if it is inconsistent with the geometry normal
@@ -60,10 +58,8 @@ Real PdfSampleBSDFOp::operator()(const DisneyGlass& bsdf) const
 
     const auto eta = Dot(vertex.normal, dirIn) > 0 ? bsdf.eta : 1 / bsdf.eta;
 
-    // clang-format off
-    const auto anisotropic = Eval(bsdf.anisotropic, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto roughness = Clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1));
-    // clang-format on
+    const auto anisotropic = bsdf.anisotropic;
+    const auto roughness   = bsdf.roughness;
 
     const auto aspect = std::sqrt(kOne<Real> - Real(0.9) * anisotropic);
     const auto ax     = std::max(Real(0.0001), roughness * roughness / aspect);
@@ -95,7 +91,7 @@ Real PdfSampleBSDFOp::operator()(const DisneyGlass& bsdf) const
     return (1 - F) * D * G * std::abs(eta * eta * h_dot_out / (sqrtDenom * sqrtDenom) * h_dot_in / Dot(frame.n, dirIn));
 }
 
-std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyGlass& bsdf) const
+std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyGlassClosure& bsdf) const
 {
     Frame frame = vertex.shadingFrame;
     if (Dot(frame.n, dirIn) * Dot(vertex.normal, dirIn) < 0) {
@@ -104,10 +100,8 @@ std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyGlass& bsdf
 
     const auto eta = Dot(vertex.normal, dirIn) > 0 ? bsdf.eta : 1 / bsdf.eta;
 
-    // clang-format off
-    const auto anisotropic = Eval(bsdf.anisotropic, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto roughness = Clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1));
-    // clang-format on
+    const auto anisotropic = bsdf.anisotropic;
+    const auto roughness   = bsdf.roughness;
 
     const auto aspect = std::sqrt(kOne<Real> - Real(0.9) * anisotropic);
     const auto ax     = std::max(Real(0.0001), roughness * roughness / aspect);
@@ -144,6 +138,22 @@ std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyGlass& bsdf
     return BSDFSampleRecord{refracted, eta /* eta */, roughness /* roughness */};
 }
 
+BSDFClosure PrepareBSDFOp::operator()(const DisneyGlass& bsdf) const
+{
+    // clang-format off
+    return DisneyGlassClosure{
+      Eval(bsdf.baseColor, vertex.uv, vertex.uvScreenSize, texturePool),
+      Clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1)),
+      Eval(bsdf.anisotropic, vertex.uv, vertex.uvScreenSize, texturePool),
+      bsdf.eta};
+    // clang-format on
+}
+
+bool is_constant_op::operator()(const DisneyGlass& bsdf) const
+{
+    return IsConstant(bsdf.baseColor) && IsConstant(bsdf.roughness) && IsConstant(bsdf.anisotropic);
+}
+
 TextureSpectrum get_texture_op::operator()(const DisneyGlass& bsdf) const
 {
     return bsdf.baseColor;
@@ -1,6 +1,6 @@
 #include "../Microfacet.hpp"
 
-Spectrum EvalOp::operator()(const DisneyMetal& bsdf) const
+Spectrum EvalOp::operator()(const DisneyMetalClosure& bsdf) const
 {
     if (Dot(vertex.normal, dirIn) < 0 || Dot(vertex.normal, dirOut) < 0) {
         // No light below the surface
@@ -12,11 +12,9 @@ Spectrum EvalOp::operator()(const DisneyMetal& bsdf) const
         frame = -frame;
     }
 
-    // clang-format off
-    const auto baseColor = Eval(bsdf.baseColor, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto anisotropic = Eval(bsdf.anisotropic, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto roughness = Clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1));
-    // clang-format on
+    const auto baseColor   = bsdf.baseColor;
+    const auto anisotropic = bsdf.anisotropic;
+    const auto roughness   = bsdf.roughness;
 
     const auto aspect = std::sqrt(kOne<Real> - Real(0.9) * anisotropic);
     const auto ax     = std::max(Real(0.0001), roughness * roughness / aspect);
@@ -32,7 +30,8 @@ Spectrum EvalOp::operator()(const DisneyMetal& bsdf) const
     return MakeConstSpectrum(0.25) * F * D * G / AbsDot(frame.n, dirIn);
 }
 
-Spectrum EvalOp::operator()(const DisneyMetal& bsdf, Real specular, Real metallic, Real specularTint, Real eta) const
+Spectrum
+EvalOp::operator()(const DisneyMetalClosure& bsdf, Real specular, Real metallic, Real specularTint, Real eta) const
 {
     if (Dot(vertex.normal, dirIn) < 0 || Dot(vertex.normal, dirOut) < 0) {
         // No light below the surface
@@ -44,11 +43,9 @@ Spectrum EvalOp::operator()(const DisneyMetal& bsdf, Real specular, Real metalli
         frame = -frame;
     }
 
-    // clang-format off
-    const auto baseColor = Eval(bsdf.baseColor, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto anisotropic = Eval(bsdf.anisotropic, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto roughness = Clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1));
-    // clang-format on
+    const auto baseColor   = bsdf.baseColor;
+    const auto anisotropic = bsdf.anisotropic;
+    const auto roughness   = bsdf.roughness;
 
     const auto aspect = std::sqrt(kOne<Real> - Real(0.9) * anisotropic);
     const auto ax     = std::max(Real(0.0001), roughness * roughness / aspect);
@@ -57,8 +54,8 @@ Spectrum EvalOp::operator()(const DisneyMetal& bsdf, Real specular, Real metalli
     const auto h = Normalize(dirIn + dirOut);
 
     const auto Ks     = Lerp(MakeConstSpectrum(1), elma::CalculateTint(baseColor), specularTint);
-    const auto R0_eta = std::pow((eta - 1.0) / (eta + 1.0), 2);
-    const auto C      = specular * R0_eta * (1.0 - metallic) * Ks + metallic * baseColor;
+    const auto R0_eta = Sqr((eta - 1) / (eta + 1));
+    const auto C      = specular * R0_eta * (1 - metallic) * Ks + metallic * baseColor;
     const auto F      = elma::SchlickFresnel(C, Dot(h, dirOut));
 
     const auto D = elma::GGXAnisotropic(ToLocal(frame, h), ax, ay);
@@ -68,7 +65,7 @@ Spectrum EvalOp::operator()(const DisneyMetal& bsdf, Real specular, Real metalli
     return MakeConstSpectrum(0.25) * F * D * G / AbsDot(frame.n, dirIn);
 }
 
-Real PdfSampleBSDFOp::operator()(const DisneyMetal& bsdf) const
+Real PdfSampleBSDFOp::operator()(const DisneyMetalClosure& bsdf) const
 {
     if (Dot(vertex.normal, dirIn) < 0 || Dot(vertex.normal, dirOut) < 0) {
         // No light below the surface
@@ -80,10 +77,8 @@ Real PdfSampleBSDFOp::operator()(const DisneyMetal& bsdf) const
         frame = -frame;
     }
 
-    // clang-format off
-    const auto anisotropic = Eval(bsdf.anisotropic, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto roughness = Clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1));
-    // clang-format on
+    const auto anisotropic = bsdf.anisotropic;
+    const auto roughness   = bsdf.roughness;
 
     const auto aspect = std::sqrt(kOne<Real> - Real(0.9) * anisotropic);
     const auto ax     = std::max(Real(0.0001), roughness * roughness / aspect);
@@ -98,7 +93,7 @@ Real PdfSampleBSDFOp::operator()(const DisneyMetal& bsdf) const
     return Real(0.25) * D * G / AbsDot(frame.n, dirIn);
 }
 
-std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyMetal& bsdf) const
+std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyMetalClosure& bsdf) const
 {
     if (Dot(vertex.normal, dirIn) < 0) {
         // No light below the surface
@@ -110,10 +105,8 @@ std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyMetal& bsdf
         frame = -frame;
     }
 
-    // clang-format off
-    const auto anisotropic = Eval(bsdf.anisotropic, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto roughness = Clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1));
-    // clang-format on
+    const auto anisotropic = bsdf.anisotropic;
+    const auto roughness   = bsdf.roughness;
 
     const auto aspect = std::sqrt(kOne<Real> - Real(0.9) * anisotropic);
     const auto ax     = std::max(Real(0.0001), roughness * roughness / aspect);
@@ -127,6 +120,21 @@ std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneyMetal& bsdf
     return BSDFSampleRecord{reflected, Real(1) /* eta */, roughness /* roughness */};
 }
 
+BSDFClosure PrepareBSDFOp::operator()(const DisneyMetal& bsdf) const
+{
+    // clang-format off
+    return DisneyMetalClosure{
+      Eval(bsdf.baseColor, vertex.uv, vertex.uvScreenSize, texturePool),
+      Clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1)),
+      Eval(bsdf.anisotropic, vertex.uv, vertex.uvScreenSize, texturePool)};
+    // clang-format on
+}
+
+bool is_constant_op::operator()(const DisneyMetal& bsdf) const
+{
+    return IsConstant(bsdf.baseColor) && IsConstant(bsdf.roughness) && IsConstant(bsdf.anisotropic);
+}
+
 TextureSpectrum get_texture_op::operator()(const DisneyMetal& bsdf) const
 {
     return bsdf.baseColor;
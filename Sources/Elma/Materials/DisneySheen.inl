@@ -1,6 +1,6 @@
 #include "../Microfacet.hpp"
 
-Spectrum EvalOp::operator()(const DisneySheen& bsdf) const
+Spectrum EvalOp::operator()(const DisneySheenClosure& bsdf) const
 {
     if (Dot(vertex.normal, dirIn) < 0 || Dot(vertex.normal, dirOut) < 0) {
         // No light below the surface
@@ -15,8 +15,8 @@ Spectrum EvalOp::operator()(const DisneySheen& bsdf) const
     // sheen 材质的颜色根据 sheenTint 参数在白色和自身颜色之间变化。
     // 它的目的是模拟光在表面上的掠角，因此它将主要用于布料或粗糙表面上的反向反射，以补充由于只模拟单散射的几何术语而损失的能量。
 
-    const auto baseColor = Eval(bsdf.baseColor, vertex.uv, vertex.uvScreenSize, texturePool);
-    const auto sheenTint = Eval(bsdf.sheenTint, vertex.uv, vertex.uvScreenSize, texturePool);
+    const auto baseColor = bsdf.baseColor;
+    const auto sheenTint = bsdf.sheenTint;
 
     const auto h         = Normalize(dirIn + dirOut);
     const auto h_dot_out = AbsDot(h, dirOut);
@@ -28,7 +28,7 @@ Spectrum EvalOp::operator()(const DisneySheen& bsdf) const
     return color * elma::SchlickWeight(h_dot_out) * n_dot_out;
 }
 
-Real PdfSampleBSDFOp::operator()(const DisneySheen& bsdf) const
+Real PdfSampleBSDFOp::operator()(const DisneySheenClosure& bsdf) const
 {
     if (Dot(vertex.normal, dirIn) < 0 || Dot(vertex.normal, dirOut) < 0) {
         // No light below the surface
@@ -43,7 +43,7 @@ Real PdfSampleBSDFOp::operator()(const DisneySheen& bsdf) const
     return AbsDot(frame.n, dirOut) / kPi;
 }
 
-std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneySheen& bsdf) const
+std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneySheenClosure& bsdf) const
 {
     if (Dot(vertex.normal, dirIn) < 0) {
         // No light below the surface
@@ -59,6 +59,17 @@ std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const DisneySheen& bsdf
       ToWorld(frame, SampleCosHemisphere(rndParamUV)), Real(0) /* eta */, Real(1) /* roughness */};
 }
 
+BSDFClosure PrepareBSDFOp::operator()(const DisneySheen& bsdf) const
+{
+    return DisneySheenClosure{Eval(bsdf.baseColor, vertex.uv, vertex.uvScreenSize, texturePool),
+                              Eval(bsdf.sheenTint, vertex.uv, vertex.uvScreenSize, texturePool)};
+}
+
+bool is_constant_op::operator()(const DisneySheen& bsdf) const
+{
+    return IsConstant(bsdf.baseColor) && IsConstant(bsdf.sheenTint);
+}
+
 TextureSpectrum get_texture_op::operator()(const DisneySheen& bsdf) const
 {
     return bsdf.baseColor;
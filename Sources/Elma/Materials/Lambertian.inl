@@ -1,4 +1,4 @@
-Spectrum EvalOp::operator()(const Lambertian& bsdf) const
+Spectrum EvalOp::operator()(const LambertianClosure& bsdf) const
 {
     if (Dot(vertex.normal, dirIn) < 0 || Dot(vertex.normal, dirOut) < 0) {
         // No light below the surface
@@ -12,10 +12,10 @@ Spectrum EvalOp::operator()(const Lambertian& bsdf) const
         frame = -frame;
     }
 
-    return fmax(Dot(frame.n, dirOut), Real(0)) * Eval(bsdf.reflectance, vertex.uv, vertex.uvScreenSize, texturePool) / kPi;
+    return Max(Dot(frame.n, dirOut), Real(0)) * bsdf.reflectance / kPi;
 }
 
-Real PdfSampleBSDFOp::operator()(const Lambertian& bsdf) const
+Real PdfSampleBSDFOp::operator()(const LambertianClosure& bsdf) const
 {
     if (Dot(vertex.normal, dirIn) < 0 || Dot(vertex.normal, dirOut) < 0) {
         // No light below the surface
@@ -31,7 +31,7 @@ Real PdfSampleBSDFOp::operator()(const Lambertian& bsdf) const
     return fmax(Dot(frame.n, dirOut), Real(0)) / kPi;
 }
 
-std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const Lambertian& bsdf) const
+std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const LambertianClosure& bsdf) const
 {
     // For Lambertian, we importance sample the cosine hemisphere domain.
     if (Dot(vertex.normal, dirIn) < 0) {
@@ -48,6 +48,16 @@ std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const Lambertian& bsdf)
       ToWorld(frame, SampleCosHemisphere(rndParamUV)), Real(0) /* eta */, Real(1) /* roughness */};
 }
 
+BSDFClosure PrepareBSDFOp::operator()(const Lambertian& bsdf) const
+{
+    return LambertianClosure{Eval(bsdf.reflectance, vertex.uv, vertex.uvScreenSize, texturePool)};
+}
+
+bool is_constant_op::operator()(const Lambertian& bsdf) const
+{
+    return IsConstant(bsdf.reflectance);
+}
+
 TextureSpectrum get_texture_op::operator()(const Lambertian& bsdf) const
 {
     return bsdf.reflectance;
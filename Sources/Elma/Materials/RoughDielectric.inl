@@ -1,6 +1,6 @@
 #include "../Microfacet.hpp"
 
-Spectrum EvalOp::operator()(const RoughDielectric& bsdf) const
+Spectrum EvalOp::operator()(const RoughDielectricClosure& bsdf) const
 {
     bool reflect = Dot(vertex.normal, dirIn) * Dot(vertex.normal, dirOut) > 0;
     // Flip the shading frame if it is inconsistent with the geometry normal
@@ -12,9 +12,9 @@ Spectrum EvalOp::operator()(const RoughDielectric& bsdf) const
     // (internal/external), otherwise we use external/internal.
     Real eta = Dot(vertex.normal, dirIn) > 0 ? bsdf.eta : 1 / bsdf.eta;
 
-    Spectrum Ks    = Eval(bsdf.specularReflectance, vertex.uv, vertex.uvScreenSize, texturePool);
-    Spectrum Kt    = Eval(bsdf.specularTransmittance, vertex.uv, vertex.uvScreenSize, texturePool);
-    Real roughness = Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool);
+    Spectrum Ks    = bsdf.specularReflectance;
+    Spectrum Kt    = bsdf.specularTransmittance;
+    Real roughness = bsdf.roughness;
 
     Vector3 half_vector;
     if (reflect) {
@@ -31,9 +31,6 @@ Spectrum EvalOp::operator()(const RoughDielectric& bsdf) const
         half_vector = -half_vector;
     }
 
-    // Clamp roughness to avoid numerical issues.
-    roughness = std::clamp(roughness, Real(0.01), Real(1));
-
     // Compute F / D / G
     // Note that we use the incoming direction
     // for evaluating the Fresnel reflection amount.
@@ -70,7 +67,7 @@ Spectrum EvalOp::operator()(const RoughDielectric& bsdf) const
     }
 }
 
-Real PdfSampleBSDFOp::operator()(const RoughDielectric& bsdf) const
+Real PdfSampleBSDFOp::operator()(const RoughDielectricClosure& bsdf) const
 {
     bool reflect = Dot(vertex.normal, dirIn) * Dot(vertex.normal, dirOut) > 0;
     // Flip the shading frame if it is inconsistent with the geometry normal
@@ -98,9 +95,7 @@ Real PdfSampleBSDFOp::operator()(const RoughDielectric& bsdf) const
         half_vector = -half_vector;
     }
 
-    Real roughness = Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool);
-    // Clamp roughness to avoid numerical issues.
-    roughness = std::clamp(roughness, Real(0.01), Real(1));
+    Real roughness = bsdf.roughness;
 
     // We sample the visible normals, also we use F to determine
     // whether to sample reflection or refraction
@@ -120,7 +115,7 @@ Real PdfSampleBSDFOp::operator()(const RoughDielectric& bsdf) const
     }
 }
 
-std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const RoughDielectric& bsdf) const
+std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const RoughDielectricClosure& bsdf) const
 {
     // If we are going into the surface, then we use normal eta
     // (internal/external), otherwise we use external/internal.
@@ -130,9 +125,7 @@ std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const RoughDielectric&
     if (Dot(frame.n, dirIn) * Dot(vertex.normal, dirIn) < 0) {
         frame = -frame;
     }
-    Real roughness = Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool);
-    // Clamp roughness to avoid numerical issues.
-    roughness = std::clamp(roughness, Real(0.01), Real(1));
+    Real roughness = bsdf.roughness;
     // Sample a micro normal and transform it to world space -- this is our half-vector.
     Real alpha                 = roughness * roughness;
     Vector3 local_dir_in       = ToLocal(frame, dirIn);
@@ -170,11 +163,26 @@ std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const RoughDielectric&
             half_vector = -half_vector;
         }
         Real h_dot_out    = std::sqrt(h_dot_out_sq);
-        Vector3 refracted = -dirIn / eta + (fabs(h_dot_in) / eta - h_dot_out) * half_vector;
+        Vector3 refracted = -dirIn / eta + (std::abs(h_dot_in) / eta - h_dot_out) * half_vector;
         return BSDFSampleRecord{refracted, eta, roughness};
     }
 }
 
+BSDFClosure PrepareBSDFOp::operator()(const RoughDielectric& bsdf) const
+{
+    return RoughDielectricClosure{
+      Eval(bsdf.specularReflectance, vertex.uv, vertex.uvScreenSize, texturePool),
+      Eval(bsdf.specularTransmittance, vertex.uv, vertex.uvScreenSize, texturePool),
+      std::clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1)),
+      bsdf.eta};
+}
+
+bool is_constant_op::operator()(const RoughDielectric& bsdf) const
+{
+    return IsConstant(bsdf.specularReflectance) && IsConstant(bsdf.specularTransmittance) &&
+           IsConstant(bsdf.roughness);
+}
+
 TextureSpectrum get_texture_op::operator()(const RoughDielectric& bsdf) const
 {
     return bsdf.specularReflectance;
@@ -1,6 +1,6 @@
 #include "../Microfacet.hpp"
 
-Spectrum EvalOp::operator()(const RoughPlastic& bsdf) const
+Spectrum EvalOp::operator()(const RoughPlasticClosure& bsdf) const
 {
     if (Dot(vertex.normal, dirIn) < 0 || Dot(vertex.normal, dirOut) < 0) {
         // No light below the surface
@@ -26,11 +26,9 @@ Spectrum EvalOp::operator()(const RoughPlastic& bsdf) const
         return MakeZeroSpectrum();
     }
 
-    Spectrum Kd    = Eval(bsdf.diffuseReflectance, vertex.uv, vertex.uvScreenSize, texturePool);
-    Spectrum Ks    = Eval(bsdf.specularReflectance, vertex.uv, vertex.uvScreenSize, texturePool);
-    Real roughness = Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool);
-    // Clamp roughness to avoid numerical issues.
-    roughness = std::clamp(roughness, Real(0.01), Real(1));
+    Spectrum Kd    = bsdf.diffuseReflectance;
+    Spectrum Ks    = bsdf.specularReflectance;
+    Real roughness = bsdf.roughness;
 
     // We first account for the dielectric layer.
 
@@ -59,7 +57,7 @@ Spectrum EvalOp::operator()(const RoughPlastic& bsdf) const
     return (spec_contrib + diffuse_contrib) * n_dot_out;
 }
 
-Real PdfSampleBSDFOp::operator()(const RoughPlastic& bsdf) const
+Real PdfSampleBSDFOp::operator()(const RoughPlasticClosure& bsdf) const
 {
     if (Dot(vertex.normal, dirIn) < 0 || Dot(vertex.normal, dirOut) < 0) {
         // No light below the surface
@@ -79,15 +77,13 @@ Real PdfSampleBSDFOp::operator()(const RoughPlastic& bsdf) const
         return 0;
     }
 
-    Spectrum S = Eval(bsdf.specularReflectance, vertex.uv, vertex.uvScreenSize, texturePool);
-    Spectrum R = Eval(bsdf.diffuseReflectance, vertex.uv, vertex.uvScreenSize, texturePool);
+    Spectrum S = bsdf.specularReflectance;
+    Spectrum R = bsdf.diffuseReflectance;
     Real lS = Luminance(S), lR = Luminance(R);
     if (lS + lR <= 0) {
         return 0;
     }
-    Real roughness = Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool);
-    // Clamp roughness to avoid numerical issues.
-    roughness = std::clamp(roughness, Real(0.01), Real(1));
+    Real roughness = bsdf.roughness;
     // We use the reflectance to determine whether to choose specular sampling lobe or diffuse.
     Real spec_prob = lS / (lS + lR);
     Real diff_prob = 1 - spec_prob;
@@ -104,7 +100,7 @@ Real PdfSampleBSDFOp::operator()(const RoughPlastic& bsdf) const
     return spec_prob + diff_prob;
 }
 
-std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const RoughPlastic& bsdf) const
+std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const RoughPlasticClosure& bsdf) const
 {
     if (Dot(vertex.normal, dirIn) < 0) {
         // No light below the surface
@@ -117,8 +113,8 @@ std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const RoughPlastic& bsd
     }
 
     // We use the reflectance to choose between sampling the dielectric or diffuse layer.
-    Spectrum Ks = Eval(bsdf.specularReflectance, vertex.uv, vertex.uvScreenSize, texturePool);
-    Spectrum Kd = Eval(bsdf.diffuseReflectance, vertex.uv, vertex.uvScreenSize, texturePool);
+    Spectrum Ks = bsdf.specularReflectance;
+    Spectrum Kd = bsdf.diffuseReflectance;
     Real lS = Luminance(Ks), lR = Luminance(Kd);
     if (lS + lR <= 0) {
         return {};
@@ -128,10 +124,8 @@ std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const RoughPlastic& bsd
         // Sample from the specular lobe.
 
         // Convert the incoming direction to local coordinates
-        Vector3 local_dir_in = ToLocal(frame, dirIn);
-        Real roughness       = Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool);
-        // Clamp roughness to avoid numerical issues.
-        roughness                  = std::clamp(roughness, Real(0.01), Real(1));
+        Vector3 local_dir_in       = ToLocal(frame, dirIn);
+        Real roughness             = bsdf.roughness;
         Real alpha                 = roughness * roughness;
         Vector3 local_micro_normal = elma::SampleVisibleNormals(local_dir_in, alpha, rndParamUV);
 
@@ -150,6 +144,20 @@ std::optional<BSDFSampleRecord> SampleBSDFOp::operator()(const RoughPlastic& bsd
     }
 }
 
+BSDFClosure PrepareBSDFOp::operator()(const RoughPlastic& bsdf) const
+{
+    return RoughPlasticClosure{
+      Eval(bsdf.diffuseReflectance, vertex.uv, vertex.uvScreenSize, texturePool),
+      Eval(bsdf.specularReflectance, vertex.uv, vertex.uvScreenSize, texturePool),
+      std::clamp(Eval(bsdf.roughness, vertex.uv, vertex.uvScreenSize, texturePool), Real(0.01), Real(1)),
+      bsdf.eta};
+}
+
+bool is_constant_op::operator()(const RoughPlastic& bsdf) const
+{
+    return IsConstant(bsdf.diffuseReflectance) && IsConstant(bsdf.specularReflectance) && IsConstant(bsdf.roughness);
+}
+
 TextureSpectrum get_texture_op::operator()(const RoughPlastic& bsdf) const
 {
     return bsdf.diffuseReflectance;
@@ -10,6 +10,18 @@ Spectrum get_majorant_op::operator()(const HeterogeneousMedium& m)
     }
 }
 
+MajorantIterator get_majorant_iterator_op::operator()(const HeterogeneousMedium& m)
+{
+    if (!m.majorantGrid.maxValues.empty()) {
+        return MakeDDAIterator(m.majorantGrid, ray, tMax);
+    }
+    // Constant densities (or grids without local bounds) are bounded by their maximum everywhere
+    MajorantIterator iter;
+    iter.tMax     = tMax;
+    iter.sigmaMaj = GetMaxValue(m.density);
+    return iter;
+}
+
 Spectrum get_sigma_s_op::operator()(const HeterogeneousMedium& m)
 {
     Spectrum density = Lookup(m.density, p);
@@ -23,3 +35,10 @@ Spectrum get_sigma_a_op::operator()(const HeterogeneousMedium& m)
     Spectrum albedo  = Lookup(m.albedo, p);
     return density * (Real(1) - albedo);
 }
+
+MediumProperties get_medium_properties_op::operator()(const HeterogeneousMedium& m)
+{
+    Spectrum density = Lookup(m.density, p);
+    Spectrum albedo  = Lookup(m.albedo, p);
+    return MediumProperties{density * (Real(1) - albedo), density * albedo};
+}
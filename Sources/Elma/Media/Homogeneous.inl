@@ -3,6 +3,14 @@ Spectrum get_majorant_op::operator()(const HomogeneousMedium& m)
     return m.sigmaA + m.sigmaS;
 }
 
+MajorantIterator get_majorant_iterator_op::operator()(const HomogeneousMedium& m)
+{
+    MajorantIterator iter;
+    iter.tMax     = tMax;
+    iter.sigmaMaj = m.sigmaA + m.sigmaS;
+    return iter;
+}
+
 Spectrum get_sigma_s_op::operator()(const HomogeneousMedium& m)
 {
     return m.sigmaS;
@@ -12,3 +20,8 @@ Spectrum get_sigma_a_op::operator()(const HomogeneousMedium& m)
 {
     return m.sigmaA;
 }
+
+MediumProperties get_medium_properties_op::operator()(const HomogeneousMedium& m)
+{
+    return MediumProperties{m.sigmaA, m.sigmaS};
+}
@@ -1,7 +1,87 @@
 #include <variant>
+#include <vector>
 #include "Medium.hpp"
 
 namespace elma {
+
+/// A majorant iterator over the cells of the grid pierced by the ray between 0 and t_max, following pbrt-v4's
+/// DDAMajorantIterator.
+static MajorantIterator MakeDDAIterator(const MajorantGrid& grid, const Ray& ray, Real t_max)
+{
+    MajorantIterator iter;
+    // Clip the ray to the bounding box of the grid.
+    // https://github.com/mmp/pbrt-v3/blob/master/src/core/geometry.h#L1388
+    Real t0 = 0, t1 = t_max;
+    for (int i = 0; i < 3; i++) {
+        Real tnear = (grid.posMin[i] - ray.org[i]) / ray.dir[i];
+        Real tfar  = (grid.posMax[i] - ray.org[i]) / ray.dir[i];
+        if (tnear > tfar) {
+            std::swap(tnear, tfar);
+        }
+        // A ray parallel to a slab and starting on it gives NaNs, which leave the interval alone
+        t0 = tnear > t0 ? tnear : t0;
+        t1 = tfar < t1 ? tfar : t1;
+        if (t0 > t1) {
+            return iter;
+        }
+    }
+    iter.tMin = t0;
+    iter.tMax = t1;
+    iter.grid = &grid;
+
+    // Walk the grid in its [0, 1]^3 coordinates
+    const Vector3 extent = grid.posMax - grid.posMin;
+    const Vector3 p_grid = (ray.org + ray.dir * t0 - grid.posMin) / extent;
+    Vector3 d_grid       = ray.dir / extent;
+    for (int i = 0; i < 3; i++) {
+        // -0 would pass the sign test below and cross the first boundary at t = -inf
+        if (d_grid[i] == 0) {
+            d_grid[i] = 0;
+        }
+        const int res  = grid.resolution[i];
+        iter.cell[i]   = std::clamp(int(p_grid[i] * res), 0, res - 1);
+        iter.deltaT[i] = 1 / (std::abs(d_grid[i]) * res);
+        if (d_grid[i] >= 0) {
+            // Infinite for rays parallel to the axis
+            iter.nextCrossingT[i] = t0 + (Real(iter.cell[i] + 1) / res - p_grid[i]) / d_grid[i];
+            iter.step[i]          = 1;
+            iter.cellLimit[i]     = res;
+        }
+        else {
+            iter.nextCrossingT[i] = t0 + (Real(iter.cell[i]) / res - p_grid[i]) / d_grid[i];
+            iter.step[i]          = -1;
+            iter.cellLimit[i]     = -1;
+        }
+    }
+    return iter;
+}
+
+std::optional<MajorantSegment> Next(MajorantIterator& iter)
+{
+    if (iter.tMin >= iter.tMax) {
+        return std::nullopt;
+    }
+    if (!iter.grid) {
+        const MajorantSegment segment{iter.tMin, iter.tMax, iter.sigmaMaj};
+        iter.tMin = iter.tMax;
+        return segment;
+    }
+
+    // Leave the cell through the closest of its boundaries
+    const Vector3& next_t = iter.nextCrossingT;
+    const int axis        = next_t.x < next_t.y ? (next_t.x < next_t.z ? 0 : 2) : (next_t.y < next_t.z ? 1 : 2);
+    const Real t_exit     = Min(iter.tMax, next_t[axis]);
+    const MajorantSegment segment{iter.tMin, t_exit, GetMaxValue(*iter.grid, iter.cell)};
+
+    iter.tMin                 = t_exit;
+    iter.cell[axis]          += iter.step[axis];
+    iter.nextCrossingT[axis] += iter.deltaT[axis];
+    if (iter.cell[axis] == iter.cellLimit[axis]) {
+        iter.tMin = iter.tMax;
+    }
+    return segment;
+}
+
 struct get_majorant_op
 {
     Spectrum operator()(const HomogeneousMedium& m);
@@ -10,6 +90,15 @@ struct get_majorant_op
     const Ray& ray;
 };
 
+struct get_majorant_iterator_op
+{
+    MajorantIterator operator()(const HomogeneousMedium& m);
+    MajorantIterator operator()(const HeterogeneousMedium& m);
+
+    const Ray& ray;
+    Real tMax;
+};
+
 struct get_sigma_s_op
 {
     Spectrum operator()(const HomogeneousMedium& m);
@@ -26,6 +115,14 @@ struct get_sigma_a_op
     const Vector3& p;
 };
 
+struct get_medium_properties_op
+{
+    MediumProperties operator()(const HomogeneousMedium& m);
+    MediumProperties operator()(const HeterogeneousMedium& m);
+
+    const Vector3& p;
+};
+
 #include "Media/Homogeneous.inl"
 #include "Media/Heterogeneous.inl"
 
@@ -34,6 +131,11 @@ Spectrum GetMajorant(const std::variant<HomogeneousMedium, HeterogeneousMedium>&
     return std::visit(get_majorant_op{ray}, medium);
 }
 
+MajorantIterator GetMajorantIterator(const Medium& medium, const Ray& ray, Real t_max)
+{
+    return std::visit(get_majorant_iterator_op{ray, t_max}, medium);
+}
+
 Spectrum GetSigmaS(const std::variant<HomogeneousMedium, HeterogeneousMedium>& medium, const Vector3& p)
 {
     return std::visit(get_sigma_s_op{p}, medium);
@@ -44,4 +146,9 @@ Spectrum GetSigmaA(const std::variant<HomogeneousMedium, HeterogeneousMedium>& m
     return std::visit(get_sigma_a_op{p}, medium);
 }
 
+MediumProperties GetMediumProperties(const Medium& medium, const Vector3& p)
+{
+    return std::visit(get_medium_properties_op{p}, medium);
+}
+
 } // namespace elma
\ No newline at end of file
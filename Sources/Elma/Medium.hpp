@@ -1,8 +1,10 @@
 #pragma once
 
+#include "Pcg.hpp"
 #include "PhaseFunction.hpp"
 #include "Spectrum.hpp"
 #include "Volume.hpp"
+#include <optional>
 #include <variant>
 
 namespace elma {
@@ -21,18 +23,95 @@ struct HomogeneousMedium : public MediumBase
 struct HeterogeneousMedium : public MediumBase
 {
     VolumeSpectrum albedo, density;
+    // Local bounds of a grid density, see MakeMajorantGrid(). Empty for constant densities.
+    MajorantGrid majorantGrid;
 };
 
 using Medium = std::variant<HomogeneousMedium, HeterogeneousMedium>;
 
+struct MediumProperties
+{
+    Spectrum sigmaA, sigmaS;
+};
+
+/// A piece [tMin, tMax] of a ray over which sigma_t = sigma_s + sigma_a never exceeds sigmaMaj
+struct MajorantSegment
+{
+    Real tMin, tMax;
+    Spectrum sigmaMaj;
+};
+
+/// Walks the majorant segments of a ray front to back: a single segment for homogeneous media and constant
+/// densities, the cells of the majorant grid pierced by the ray for grid densities (a 3D DDA, "A Fast Voxel
+/// Traversal Algorithm for Ray Tracing", Amanatides and Woo 1987).
+struct MajorantIterator
+{
+    // The part of the ray not visited yet, empty once tMin >= tMax
+    Real tMin = 0, tMax = 0;
+    // Without a grid, the majorant of the single segment
+    const MajorantGrid* grid = nullptr;
+    Spectrum sigmaMaj;
+    // DDA state in grid cells: the current cell, the ray distance to the next cell boundary on each axis,
+    // the distance between two boundaries, the step direction and the cell index where the ray leaves the grid.
+    Vector3i cell, step, cellLimit;
+    Vector3 nextCrossingT, deltaT;
+};
+
 /// the maximum of sigma_t = sigma_s + sigma_a over the whole space
 Spectrum GetMajorant(const Medium& medium, const Ray& ray);
+/// The majorant segments of ray.org + t ray.dir for t in [0, t_max], ray.dir has to be normalized
+MajorantIterator GetMajorantIterator(const Medium& medium, const Ray& ray, Real t_max);
+std::optional<MajorantSegment> Next(MajorantIterator& iter);
 Spectrum GetSigmaS(const Medium& medium, const Vector3& p);
 Spectrum GetSigmaA(const Medium& medium, const Vector3& p);
+/// sigma_a and sigma_s together, looking up the volumes once
+MediumProperties GetMediumProperties(const Medium& medium, const Vector3& p);
 
 inline PhaseFunction GetPhaseFunction(const Medium& medium)
 {
     return std::visit([&](const auto& m) { return m.phaseFunction; }, medium);
 }
 
+/// Samples tentative collisions along ray up to t_max by delta tracking against the majorant segments, with the
+/// majorant of the spectral channel `channel` as the density (pbrt-v4's SampleT_maj). At each of them,
+/// callback(p, medium_properties, sigma_maj, T_maj) gets the majorant transmittance T_maj since the previous
+/// collision, and stops the tracking by returning false.
+/// Returns the majorant transmittance from the last collision to t_max, or one if the callback stopped.
+template<typename F>
+Spectrum SampleMajorantCollisions(const Medium& medium,
+                                  const Ray& ray,
+                                  Real t_max,
+                                  int channel,
+                                  Pcg32State& rng,
+                                  F&& callback)
+{
+    MajorantIterator iter = GetMajorantIterator(medium, ray, t_max);
+    Spectrum T_maj        = MakeConstSpectrum(1);
+    while (std::optional<MajorantSegment> segment = Next(iter)) {
+        const Spectrum& sigma_maj = segment->sigmaMaj;
+        // Clamp infinite segments so that channels with a zero majorant get 0 * dt = 0
+        const Real t_end = Min(segment->tMax, std::numeric_limits<Real>::max());
+        if (sigma_maj[channel] == 0) {
+            T_maj *= Exp(-(t_end - segment->tMin) * sigma_maj);
+            continue;
+        }
+        Real t = segment->tMin;
+        while (true) {
+            const Real t_next = t - std::log(1 - NextPcg32Real<Real>(rng)) / sigma_maj[channel];
+            if (t_next >= t_end) {
+                T_maj *= Exp(-(t_end - t) * sigma_maj);
+                break;
+            }
+            T_maj           *= Exp(-(t_next - t) * sigma_maj);
+            t                = t_next;
+            const Vector3 p  = ray.org + ray.dir * t;
+            if (!callback(p, GetMediumProperties(medium, p), sigma_maj, T_maj)) {
+                return MakeConstSpectrum(1);
+            }
+            T_maj = MakeConstSpectrum(1);
+        }
+    }
+    return T_maj;
+}
+
 } // namespace elma
\ No newline at end of file
@@ -17,7 +17,16 @@ template<typename T> inline T SchlickFresnel(const T& F0, Real cos_theta)
 
 inline Real FresnelDielectric(Real n_dot_i, Real n_dot_t, Real eta)
 {
-    assert(n_dot_i >= 0 && n_dot_t >= 0 && eta > 0);
+    assert(eta > 0);
+    // Cosines of grazing directions can come out slightly negative due to rounding,
+    // especially in single precision.
+    assert(n_dot_i >= -Real(1e-3) && n_dot_t >= -Real(1e-3));
+    n_dot_i = Max(n_dot_i, Real(0));
+    n_dot_t = Max(n_dot_t, Real(0));
+    if (n_dot_i == 0 && n_dot_t == 0) {
+        // Grazing on both sides: everything is reflected
+        return 1;
+    }
     Real rs = (n_dot_i - eta * n_dot_t) / (n_dot_i + eta * n_dot_t);
     Real rp = (eta * n_dot_i - n_dot_t) / (eta * n_dot_i + n_dot_t);
     Real F  = (rs * rs + rp * rp) / 2;
@@ -27,6 +36,8 @@ inline Real FresnelDielectric(Real n_dot_i, Real n_dot_t, Real eta)
 inline Real FresnelDielectric(Real n_dot_i, Real eta)
 {
     assert(eta > 0);
+    // Dot products of unit vectors can exceed one by a few ulps.
+    n_dot_i         = Clamp(n_dot_i, Real(-1), Real(1));
     Real n_dot_t_sq = 1 - (1 - n_dot_i * n_dot_i) / (eta * eta);
     if (n_dot_t_sq < 0) {
         // total internal reflection
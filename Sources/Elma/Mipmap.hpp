@@ -10,6 +10,13 @@ template<typename T> struct Mipmap
     std::vector<Image<T>> images;
 };
 
+/// Number of levels of the mipmap of an image with this resolution.
+inline int GetNumMipmapLevels(int width, int height)
+{
+    int size = Max(width, height);
+    return std::min((int)std::ceil(std::log2(Real(size)) + 1), kMaxMipmapLevels);
+}
+
 template<typename T> inline int GetWidth(const Mipmap<T>& mipmap)
 {
     assert(mipmap.images.size() > 0);
@@ -25,8 +32,7 @@ template<typename T> inline int GetHeight(const Mipmap<T>& mipmap)
 template<typename T> inline Mipmap<T> MakeMipmap(const Image<T>& img)
 {
     Mipmap<T> mipmap;
-    int size       = Max(img.width, img.height);
-    int num_levels = std::min((int)std::ceil(std::log2(Real(size)) + 1), kMaxMipmapLevels);
+    int num_levels = GetNumMipmapLevels(img.width, img.height);
     mipmap.images.push_back(img);
     for (int i = 1; i < num_levels; i++) {
         const Image<T>& prev_img = mipmap.images.back();
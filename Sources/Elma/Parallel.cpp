@@ -1,11 +1,16 @@
 #include "Parallel.hpp"
-#include <list>
 #include <thread>
 #include <condition_variable>
 #include <vector>
+#include <memory>
 #include <cassert>
 
-// From https://github.com/mmp/pbrt-v3/blob/master/src/core/parallel.cpp
+// Work-stealing scheduler. Every participating thread owns a Chase-Lev deque
+// (Lê et al. 2013, "Correct and Efficient Work-Stealing for Weak Memory Models").
+// A loop is pushed as one range task; whoever runs a range splits off its upper
+// half onto its own deque until a leaf is left, so the owner pops small ranges
+// from the bottom while idle threads steal big ranges from the top.
+// Threads waiting on a (possibly nested) loop keep running tasks until it is done.
 
 namespace elma {
 
@@ -24,37 +29,6 @@ private:
     int count;
 };
 
-static std::vector<std::thread> sThreads;
-static bool sShutdownThreads = false;
-struct ParallelForLoop;
-static ParallelForLoop* sWorkList = nullptr;
-static std::mutex sWorkListMutex;
-
-struct ParallelForLoop
-{
-    ParallelForLoop(std::function<void(int)> func1D, int64_t maxIndex, int64_t chunkSize)
-    : func1D(std::move(func1D)), maxIndex(maxIndex), chunkSize(chunkSize)
-    {
-    }
-
-    ParallelForLoop(const std::function<void(Vector2i)>& f, const Vector2i count)
-    : func2D(f), maxIndex(count[0] * count[1]), chunkSize(1)
-    {
-        nX = count[0];
-    }
-
-    std::function<void(int)> func1D;
-    std::function<void(Vector2i)> func2D;
-    const int64_t maxIndex;
-    const int64_t chunkSize;
-    int64_t nextIndex     = 0;
-    int activeWorkers     = 0;
-    ParallelForLoop* next = nullptr;
-    int nX                = -1;
-
-    bool Finished() const { return nextIndex >= maxIndex && activeWorkers == 0; }
-};
-
 void Barrier::Wait()
 {
     std::unique_lock<std::mutex> lock(mutex);
@@ -71,188 +45,350 @@ void Barrier::Wait()
     }
 }
 
-static std::condition_variable workListCondition;
+struct ParallelForLoop;
+
+struct RangeTask
+{
+    ParallelForLoop* loop;
+    // Chunk range [chunkBegin, chunkEnd)
+    int64_t chunkBegin;
+    int64_t chunkEnd;
+};
 
-static void worker_thread_func(const int tIndex, std::shared_ptr<Barrier> barrier)
+struct ParallelForLoop
 {
-    ThreadIndex = tIndex;
+    ParallelForLoop(const std::function<void(int64_t)>& func, int64_t count, int64_t chunkSize, int64_t leafChunks)
+    : func(func), count(count), chunkSize(chunkSize), leafChunks(leafChunks),
+      numChunks((count + chunkSize - 1) / chunkSize), remainingChunks(numChunks)
+    {
+        // Every split creates one task and happens only on ranges larger than a leaf,
+        // so the number of tasks is bounded by twice the number of leaves.
+        tasks.resize(2 * (numChunks / leafChunks) + 2);
+    }
 
-    // The main thread sets up a barrier so that it can be sure that all
-    // workers have called ProfilerWorkerThreadInit() before it continues
-    // (and actually starts the profiling system).
-    barrier->Wait();
+    /// Returns nullptr when the task storage is exhausted; the caller then runs the range itself.
+    RangeTask* NewTask(int64_t chunk_begin, int64_t chunk_end)
+    {
+        const int64_t slot = nextTask.fetch_add(1, std::memory_order_relaxed);
+        if (slot >= (int64_t)tasks.size()) {
+            return nullptr;
+        }
+        tasks[slot] = RangeTask{this, chunk_begin, chunk_end};
+        return &tasks[slot];
+    }
 
-    // Release our reference to the Barrier so that it's freed once all of
-    // the threads have cleared it.
-    barrier.reset();
+    bool Finished() const { return remainingChunks.load(std::memory_order_acquire) == 0; }
 
-    std::unique_lock<std::mutex> lock(sWorkListMutex);
-    while (!sShutdownThreads) {
-        if (!sWorkList) {
-            // Sleep until there are more tasks to run
-            workListCondition.wait(lock);
+    const std::function<void(int64_t)>& func;
+    const int64_t count;
+    const int64_t chunkSize;
+    const int64_t leafChunks;
+    const int64_t numChunks;
+    std::atomic<int64_t> remainingChunks;
+    std::vector<RangeTask> tasks;
+    std::atomic<int64_t> nextTask = 0;
+    // Set when the loop was issued from a thread outside the pool, which sleeps instead of helping.
+    bool hasExternalWaiter        = false;
+};
+
+/// Fixed-capacity Chase-Lev deque. Only the owner calls Push/Pop, any thread may Steal.
+class WorkStealingQueue
+{
+public:
+    static constexpr int64_t kCapacity = 1024;
+
+    bool Push(RangeTask* task)
+    {
+        const int64_t b = bottom.load(std::memory_order_relaxed);
+        const int64_t t = top.load(std::memory_order_acquire);
+        if (b - t >= kCapacity) {
+            return false;
         }
-        else {
-            // Get work from _workList_ and run loop iterations
-            ParallelForLoop& loop = *sWorkList;
-
-            // Run a chunk of loop iterations for _loop_
-
-            // Find the set of loop iterations to run next
-            int64_t indexStart = loop.nextIndex;
-            int64_t indexEnd   = std::min(indexStart + loop.chunkSize, loop.maxIndex);
-
-            // Update _loop_ to reflect iterations this thread will run
-            loop.nextIndex = indexEnd;
-            if (loop.nextIndex == loop.maxIndex)
-                sWorkList = loop.next;
-            loop.activeWorkers++;
-
-            // Run loop indices in _[indexStart, indexEnd)_
-            lock.unlock();
-            for (int64_t index = indexStart; index < indexEnd; ++index) {
-                if (loop.func1D) {
-                    loop.func1D((int)index);
-                }
-                // Handle other types of loops
-                else {
-                    assert(loop.func2D != nullptr);
-                    loop.func2D(Vector2i{int(index % loop.nX), int(index / loop.nX)});
+        tasks[b & (kCapacity - 1)].store(task, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    RangeTask* Pop()
+    {
+        const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        RangeTask* task = nullptr;
+        if (t <= b) {
+            task = tasks[b & (kCapacity - 1)].load(std::memory_order_relaxed);
+            if (t == b) {
+                // Last element, race against thieves
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    task = nullptr;
                 }
+                bottom.store(b + 1, std::memory_order_relaxed);
             }
-            lock.lock();
+        }
+        else {
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
 
-            // Update _loop_ to reflect completion of iterations
-            loop.activeWorkers--;
-            if (loop.Finished()) {
-                workListCondition.notify_all();
-            }
+    RangeTask* Steal()
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        RangeTask* task = tasks[t & (kCapacity - 1)].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
         }
+        return task;
+    }
+
+    bool Empty() const { return top.load() >= bottom.load(); }
+
+private:
+    alignas(64) std::atomic<int64_t> top    = 0;
+    alignas(64) std::atomic<int64_t> bottom = 0;
+    alignas(64) std::atomic<RangeTask*> tasks[kCapacity];
+};
+
+thread_local int ThreadIndex;
+
+static std::vector<std::thread> sThreads;
+static std::vector<std::unique_ptr<WorkStealingQueue>> sQueues;
+static std::atomic<bool> sShutdownThreads = false;
+
+// Idle workers sleep on this condition; sWakeEpoch changes whenever new work may be visible.
+static std::mutex sSleepMutex;
+static std::condition_variable sSleepCondition;
+static std::atomic<int> sSleepingWorkers = 0;
+static uint64_t sWakeEpoch               = 0;
+
+// Loops issued by threads outside the pool are handed over through this list.
+static std::mutex sExternalMutex;
+static std::condition_variable sExternalCondition;
+static std::vector<RangeTask*> sExternalTasks;
+static std::atomic<int> sNumExternalTasks = 0;
+
+// Queue of the calling thread, null for threads that are not part of the pool.
+static thread_local WorkStealingQueue* tQueue = nullptr;
+static thread_local uint32_t tStealSeed       = 0;
+
+// Leaves are sized so that each thread sees this many tasks per loop on average.
+static constexpr int64_t kTasksPerThread = 64;
+// Number of failed steal rounds before an idle worker goes to sleep.
+static constexpr int kSpinCount          = 64;
+
+static void WakeWorkers()
+{
+    // Pairs with the increment in worker_thread_func: either we see the sleeper,
+    // or the sleeper sees the task we just published.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sSleepingWorkers.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(sSleepMutex);
+        ++sWakeEpoch;
+        sSleepCondition.notify_all();
     }
 }
 
-void parallel_for(const std::function<void(int)>& func, int64_t count, int64_t chunkSize)
+static bool HasVisibleWork()
 {
-    // Run iterations immediately if not using threads or if _count_ is small
-    if (sThreads.empty() || count < chunkSize) {
-        for (int i = 0; i < (int)count; i++) {
-            func(i);
+    if (sNumExternalTasks.load() > 0) {
+        return true;
+    }
+    for (const auto& queue : sQueues) {
+        if (!queue->Empty()) {
+            return true;
         }
-        return;
     }
+    return false;
+}
 
-    // Create and enqueue _ParallelForLoop_ for this loop
-    ParallelForLoop loop(func, count, chunkSize);
-    sWorkListMutex.lock();
-    loop.next = sWorkList;
-    sWorkList = &loop;
-    sWorkListMutex.unlock();
-
-    // Notify worker threads of work to be done
-    std::unique_lock<std::mutex> lock(sWorkListMutex);
-    workListCondition.notify_all();
+static RangeTask* FindTask()
+{
+    if (tQueue) {
+        if (RangeTask* task = tQueue->Pop()) {
+            return task;
+        }
+    }
 
-    // Help out with parallel loop iterations in the current thread
-    while (!loop.Finished()) {
-        // Run a chunk of loop iterations for _loop_
+    // Visit victims starting from a random one so thieves don't pile onto the same deque.
+    const int num_queues = (int)sQueues.size();
+    tStealSeed           = tStealSeed * 1664525u + 1013904223u;
+    const int start      = int((uint64_t(tStealSeed >> 8) * uint64_t(num_queues)) >> 24);
+    for (int i = 0; i < num_queues; ++i) {
+        WorkStealingQueue* victim = sQueues[(start + i) % num_queues].get();
+        if (victim == tQueue) {
+            continue;
+        }
+        if (RangeTask* task = victim->Steal()) {
+            return task;
+        }
+    }
 
-        // Find the set of loop iterations to run next
-        int64_t indexStart = loop.nextIndex;
-        int64_t indexEnd   = std::min(indexStart + loop.chunkSize, loop.maxIndex);
+    if (sNumExternalTasks.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(sExternalMutex);
+        if (!sExternalTasks.empty()) {
+            RangeTask* task = sExternalTasks.back();
+            sExternalTasks.pop_back();
+            sNumExternalTasks.fetch_sub(1);
+            return task;
+        }
+    }
+    return nullptr;
+}
 
-        // Update _loop_ to reflect iterations this thread will run
-        loop.nextIndex = indexEnd;
-        if (loop.nextIndex == loop.maxIndex) {
-            sWorkList = loop.next;
+static void RunTask(const RangeTask& task)
+{
+    ParallelForLoop& loop = *task.loop;
+    int64_t begin         = task.chunkBegin;
+    int64_t end           = task.chunkEnd;
+
+    // Split off the upper half until a leaf is left
+    while (tQueue && end - begin > loop.leafChunks) {
+        const int64_t mid = begin + (end - begin) / 2;
+        RangeTask* half   = loop.NewTask(mid, end);
+        if (!half || !tQueue->Push(half)) {
+            break;
         }
-        loop.activeWorkers++;
+        WakeWorkers();
+        end = mid;
+    }
 
-        // Run loop indices in _[indexStart, indexEnd)_
-        lock.unlock();
-        for (int64_t index = indexStart; index < indexEnd; ++index) {
-            if (loop.func1D) {
-                loop.func1D((int)index);
-            }
-            // Handle other types of loops
-            else {
-                assert(loop.func2D != nullptr);
-                loop.func2D(Vector2i{int(index % loop.nX), int(index / loop.nX)});
-            }
+    for (int64_t chunk = begin; chunk < end; ++chunk) {
+        const int64_t index_start = chunk * loop.chunkSize;
+        const int64_t index_end   = std::min(index_start + loop.chunkSize, loop.count);
+        for (int64_t index = index_start; index < index_end; ++index) {
+            loop.func(index);
         }
-        lock.lock();
+    }
 
-        // Update _loop_ to reflect completion of iterations
-        loop.activeWorkers--;
+    // The loop object lives on the issuing thread's stack, don't touch it after the last decrement
+    // unless someone outside the pool is sleeping on it.
+    const bool has_external_waiter = loop.hasExternalWaiter;
+    if (loop.remainingChunks.fetch_sub(end - begin, std::memory_order_acq_rel) == end - begin) {
+        if (has_external_waiter) {
+            std::lock_guard<std::mutex> lock(sExternalMutex);
+            sExternalCondition.notify_all();
+        }
     }
 }
 
-thread_local int ThreadIndex;
+static void worker_thread_func(const int tIndex, std::shared_ptr<Barrier> barrier)
+{
+    ThreadIndex = tIndex;
+    tQueue      = sQueues[tIndex].get();
+    tStealSeed  = uint32_t(tIndex) * 2654435761u + 1u;
 
-void ParallelFor(std::function<void(Vector2i)> func, const Vector2i count)
+    // Make sure every worker has registered itself before ParallelInit returns.
+    barrier->Wait();
+
+    // Release our reference to the Barrier so that it's freed once all of
+    // the threads have cleared it.
+    barrier.reset();
+
+    int idle_rounds = 0;
+    while (!sShutdownThreads.load(std::memory_order_acquire)) {
+        if (RangeTask* task = FindTask()) {
+            RunTask(*task);
+            idle_rounds = 0;
+            continue;
+        }
+
+        if (++idle_rounds < kSpinCount) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Nothing to steal for a while, go to sleep until new work is published
+        std::unique_lock<std::mutex> lock(sSleepMutex);
+        sSleepingWorkers.fetch_add(1);
+        const uint64_t epoch = sWakeEpoch;
+        if (!HasVisibleWork()) {
+            sSleepCondition.wait(lock, [epoch] { return sWakeEpoch != epoch || sShutdownThreads.load(); });
+        }
+        sSleepingWorkers.fetch_sub(1);
+        idle_rounds = 0;
+    }
+}
+
+void ParallelFor(const std::function<void(int64_t)>& func, int64_t count, int64_t chunk_size)
 {
-    // Launch worker threads if needed
-    if (sThreads.empty() || count.x * count.y <= 1) {
-        for (int y = 0; y < count.y; ++y) {
-            for (int x = 0; x < count.x; ++x) {
-                func(Vector2i{x, y});
-            }
+    chunk_size = std::max(chunk_size, int64_t(1));
+
+    // Run iterations immediately if not using threads or if _count_ is small
+    if (sThreads.empty() || count <= chunk_size) {
+        for (int64_t i = 0; i < count; i++) {
+            func(i);
         }
         return;
     }
 
-    ParallelForLoop loop(std::move(func), count);
-    {
-        std::lock_guard<std::mutex> lock(sWorkListMutex);
-        loop.next = sWorkList;
-        sWorkList = &loop;
+    const int64_t num_chunks  = (count + chunk_size - 1) / chunk_size;
+    const int64_t leaf_chunks = std::max(num_chunks / (kTasksPerThread * (int64_t)sQueues.size()), int64_t(1));
+    ParallelForLoop loop(func, count, chunk_size, leaf_chunks);
+    RangeTask* root = loop.NewTask(0, loop.numChunks);
+
+    if (!tQueue) {
+        // Issued from a thread that owns no deque: hand the loop to the pool and wait.
+        loop.hasExternalWaiter = true;
+        {
+            std::lock_guard<std::mutex> lock(sExternalMutex);
+            sExternalTasks.push_back(root);
+            sNumExternalTasks.fetch_add(1);
+        }
+        WakeWorkers();
+
+        std::unique_lock<std::mutex> lock(sExternalMutex);
+        sExternalCondition.wait(lock, [&loop] { return loop.Finished(); });
+        return;
     }
 
-    std::unique_lock<std::mutex> lock(sWorkListMutex);
-    workListCondition.notify_all();
+    if (tQueue->Push(root)) {
+        WakeWorkers();
+    }
+    else {
+        RunTask(*root);
+    }
 
-    // Help out with parallel loop iterations in the current thread
+    // Help out until every chunk of this loop is done. Tasks picked up here may belong to
+    // other loops, which is what makes nested ParallelFor calls safe.
     while (!loop.Finished()) {
-        // Run a chunk of loop iterations for _loop_
-
-        // Find the set of loop iterations to run next
-        int64_t indexStart = loop.nextIndex;
-        int64_t indexEnd   = std::min(indexStart + loop.chunkSize, loop.maxIndex);
-
-        // Update _loop_ to reflect iterations this thread will run
-        loop.nextIndex = indexEnd;
-        if (loop.nextIndex == loop.maxIndex) {
-            sWorkList = loop.next;
+        if (RangeTask* task = FindTask()) {
+            RunTask(*task);
         }
-        loop.activeWorkers++;
-
-        // Run loop indices in _[indexStart, indexEnd)_
-        lock.unlock();
-        for (int64_t index = indexStart; index < indexEnd; ++index) {
-            if (loop.func1D) {
-                loop.func1D((int)index);
-            }
-            // Handle other types of loops
-            else {
-                assert(loop.func2D != nullptr);
-                loop.func2D(Vector2i{int(index % loop.nX), int(index / loop.nX)});
-            }
+        else {
+            std::this_thread::yield();
         }
-        lock.lock();
-
-        // Update _loop_ to reflect completion of iterations
-        loop.activeWorkers--;
     }
 }
 
+void ParallelFor(std::function<void(Vector2i)> func, const Vector2i count)
+{
+    const int64_t num_x = count.x;
+    ParallelFor([&func, num_x](int64_t index) { func(Vector2i{int(index % num_x), int(index / num_x)}); },
+                int64_t(count.x) * int64_t(count.y));
+}
+
 void ParallelInit(int num_threads)
 {
     assert(sThreads.size() == 0);
+    num_threads = std::max(num_threads, 1);
     ThreadIndex = 0;
 
-    // Create a barrier so that we can be sure all worker threads get past
-    // their call to ProfilerWorkerThreadInit() before we return from this
-    // function.  In turn, we can be sure that the profiling system isn't
-    // started until after all worker threads have done that.
+    sQueues.clear();
+    for (int i = 0; i < num_threads; ++i) {
+        sQueues.push_back(std::make_unique<WorkStealingQueue>());
+    }
+    tQueue     = sQueues[0].get();
+    tStealSeed = 1u;
+
+    // Create a barrier so that we can be sure all worker threads have picked up
+    // their queue before we return from this function.
     std::shared_ptr<Barrier> barrier = std::make_shared<Barrier>(num_threads);
 
     // Launch one fewer worker thread than the total number we want doing
@@ -267,20 +403,25 @@ void ParallelInit(int num_threads)
 void ParallelCleanup()
 {
     if (sThreads.empty()) {
+        sQueues.clear();
+        tQueue = nullptr;
         return;
     }
 
     {
-        std::lock_guard<std::mutex> lock(sWorkListMutex);
+        std::lock_guard<std::mutex> lock(sSleepMutex);
         sShutdownThreads = true;
-        workListCondition.notify_all();
+        ++sWakeEpoch;
+        sSleepCondition.notify_all();
     }
 
     for (std::thread& thread : sThreads) {
         thread.join();
     }
     sThreads.erase(sThreads.begin(), sThreads.end());
+    sQueues.clear();
+    tQueue           = nullptr;
     sShutdownThreads = false;
 }
 
-} // namespace elma
\ No newline at end of file
+} // namespace elma
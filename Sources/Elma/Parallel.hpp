@@ -7,7 +7,8 @@
 #include <atomic>
 
 namespace elma {
-// From https://github.com/mmp/pbrt-v3/blob/master/src/core/parallel.h
+// Interface from https://github.com/mmp/pbrt-v3/blob/master/src/core/parallel.h,
+// backed by a work-stealing scheduler. ParallelFor may be called from inside a loop body.
 extern thread_local int ThreadIndex;
 
 void ParallelFor(const std::function<void(int64_t)>& func, int64_t count, int64_t chunk_size = 1);
@@ -133,15 +133,16 @@ void SkipToIdx(std::fstream& fs, const short version, const size_t idx)
     fs.ignore(sizeof(short) * 2);
 }
 
-template<typename Precision> std::vector<Vector3> LoadPosition(ZStream& zs, int num_vertices)
+template<typename Precision> VertexPositions LoadPosition(ZStream& zs, int num_vertices, const Matrix4x4& to_world)
 {
-    std::vector<Vector3> vertices(num_vertices);
+    VertexPositions vertices(num_vertices);
     for (int i = 0; i < (int)num_vertices; i++) {
         Precision x, y, z;
         zs.read(&x, sizeof(Precision));
         zs.read(&y, sizeof(Precision));
         zs.read(&z, sizeof(Precision));
-        vertices[i] = Vector3{x, y, z};
+        // Transform before rounding to float
+        vertices[i] = TransformPoint(to_world, Vector3{x, y, z});
     }
     return vertices;
 }
@@ -219,13 +220,10 @@ TriangleMesh LoadSerialized(const fs::path& filename, int shape_index, const Mat
 
     TriangleMesh mesh;
     if (file_double_precision) {
-        mesh.positions = LoadPosition<double>(zs, vertex_count);
+        mesh.positions = LoadPosition<double>(zs, vertex_count, to_world);
     }
     else {
-        mesh.positions = LoadPosition<float>(zs, vertex_count);
-    }
-    for (auto& p : mesh.positions) {
-        p = TransformPoint(to_world, p);
+        mesh.positions = LoadPosition<float>(zs, vertex_count, to_world);
     }
 
     if (flags & EHasNormals) {
@@ -0,0 +1,252 @@
+#include "MeshCache.hpp"
+#include "MappedFile.hpp"
+#include "Common/Error.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <random>
+
+namespace elma {
+
+namespace {
+
+constexpr char kMeshCacheMagic[8]    = {'E', 'L', 'M', 'A', 'M', 'S', 'H', '\0'};
+constexpr uint32_t kMeshCacheVersion = 2;
+constexpr size_t kMeshCacheAlignment = 64;
+
+std::atomic<bool> sMeshCacheEnabled = true;
+
+struct MeshCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t realSize; // normals, uvs and the sampling distribution are stored as Real
+    uint64_t key;
+    uint64_t sourceSize; // a replaced source with an older time stamp still invalidates the cache
+    uint64_t numPositions;
+    uint64_t numTriangles;
+    uint64_t numNormals;
+    uint64_t numUvs;
+    uint64_t numPmf;
+    uint64_t numCdf;
+    uint64_t numAliasBins;
+    double totalArea;
+    uint64_t contentHash; // of everything after the header
+};
+
+enum MeshCacheArray
+{
+    kPositions,
+    kIndices,
+    kNormals,
+    kUvs,
+    kPmf,
+    kCdf,
+    kAliasBins,
+    kNumMeshCacheArrays
+};
+
+struct MeshCacheLayout
+{
+    size_t offsets[kNumMeshCacheArrays];
+    size_t sizes[kNumMeshCacheArrays];
+    size_t fileSize;
+};
+
+size_t AlignUp(size_t offset)
+{
+    return (offset + kMeshCacheAlignment - 1) / kMeshCacheAlignment * kMeshCacheAlignment;
+}
+
+MeshCacheLayout GetLayout(const MeshCacheHeader& header)
+{
+    MeshCacheLayout layout;
+    layout.sizes[kPositions] = header.numPositions * sizeof(Vector3f);
+    layout.sizes[kIndices]   = header.numTriangles * sizeof(Vector3i);
+    layout.sizes[kNormals]   = header.numNormals * sizeof(Vector3);
+    layout.sizes[kUvs]       = header.numUvs * sizeof(Vector2);
+    layout.sizes[kPmf]       = header.numPmf * sizeof(Real);
+    layout.sizes[kCdf]       = header.numCdf * sizeof(Real);
+    layout.sizes[kAliasBins] = header.numAliasBins * sizeof(AliasBin);
+    size_t offset            = AlignUp(sizeof(MeshCacheHeader));
+    for (int i = 0; i < kNumMeshCacheArrays; i++) {
+        layout.offsets[i] = offset;
+        offset            = AlignUp(offset + layout.sizes[i]);
+    }
+    layout.fileSize = offset;
+    return layout;
+}
+
+uint64_t Mix(uint64_t h)
+{
+    // MurmurHash3 finalizer
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+/// A fast 64 bit hash, eight bytes at a time. Not cryptographic, it only detects damaged files.
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0)
+{
+    const char* p = static_cast<const char*>(data);
+    uint64_t h    = Mix(seed ^ size);
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        h = (h ^ Mix(word)) * 0x9e3779b97f4a7c15ull;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p, size);
+    return Mix(h ^ tail);
+}
+
+template<typename Array> void CopyArray(Array& dst, const char* src, size_t count)
+{
+    dst.resize(count);
+    memcpy(dst.data(), src, count * sizeof(typename Array::value_type));
+}
+
+} // namespace
+
+MeshCacheEntry GetMeshCacheEntry(const fs::path& source,
+                                 std::string_view type,
+                                 int shape_index,
+                                 const Matrix4x4& to_world,
+                                 bool face_normals)
+{
+    double xform[16];
+    for (int i = 0; i < 16; i++) {
+        xform[i] = to_world(i / 4, i % 4);
+    }
+    uint64_t key = HashBytes(type.data(), type.size(), kMeshCacheVersion);
+    key          = HashBytes(xform, sizeof(xform), key);
+    key          = HashBytes(&shape_index, sizeof(shape_index), key);
+    key          = HashBytes(&face_normals, sizeof(face_normals), key);
+    key          = Mix(key ^ sizeof(Real));
+
+    fs::path cache_file = source;
+    cache_file += std::format(".{:016x}.elmamesh", key);
+    return MeshCacheEntry{cache_file, key};
+}
+
+std::optional<TriangleMesh> ReadMeshCache(const MeshCacheEntry& entry, const fs::path& source)
+{
+    std::error_code cache_ec, source_ec, size_ec;
+    const auto cache_time      = fs::last_write_time(entry.cacheFile, cache_ec);
+    const auto source_time     = fs::last_write_time(source, source_ec);
+    const uint64_t source_size = fs::file_size(source, size_ec);
+    if (cache_ec || source_ec || size_ec || cache_time < source_time) {
+        return std::nullopt;
+    }
+
+    try {
+        const MappedFile file(entry.cacheFile);
+        MeshCacheHeader header;
+        if (file.size() < sizeof(header)) {
+            return std::nullopt;
+        }
+        memcpy(&header, file.data(), sizeof(header));
+        if (memcmp(header.magic, kMeshCacheMagic, sizeof(kMeshCacheMagic)) != 0 ||
+            header.version != kMeshCacheVersion || header.realSize != sizeof(Real) || header.key != entry.key ||
+            header.sourceSize != source_size) {
+            return std::nullopt;
+        }
+        const MeshCacheLayout layout = GetLayout(header);
+        const size_t data_offset     = layout.offsets[0];
+        if (layout.fileSize != file.size() ||
+            HashBytes(file.data() + data_offset, file.size() - data_offset) != header.contentHash) {
+            LogWarn("网格缓存 {} 已损坏，重新加载源文件。", entry.cacheFile.string());
+            return std::nullopt;
+        }
+
+        const char* data = file.data();
+        TriangleMesh mesh;
+        CopyArray(mesh.positions, data + layout.offsets[kPositions], header.numPositions);
+        CopyArray(mesh.indices, data + layout.offsets[kIndices], header.numTriangles);
+        CopyArray(mesh.normals, data + layout.offsets[kNormals], header.numNormals);
+        CopyArray(mesh.uvs, data + layout.offsets[kUvs], header.numUvs);
+        CopyArray(mesh.triangleSampler.pmf, data + layout.offsets[kPmf], header.numPmf);
+        CopyArray(mesh.triangleSampler.cdf, data + layout.offsets[kCdf], header.numCdf);
+        CopyArray(mesh.triangleSampler.aliasBins, data + layout.offsets[kAliasBins], header.numAliasBins);
+        mesh.totalArea = Real(header.totalArea);
+        return mesh;
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+}
+
+void WriteMeshCache(const MeshCacheEntry& entry, const fs::path& source, const TriangleMesh& mesh)
+{
+    std::error_code ec;
+    const uint64_t source_size = fs::file_size(source, ec);
+    if (ec) {
+        return;
+    }
+    MeshCacheHeader header;
+    memcpy(header.magic, kMeshCacheMagic, sizeof(kMeshCacheMagic));
+    header.version      = kMeshCacheVersion;
+    header.realSize     = sizeof(Real);
+    header.key          = entry.key;
+    header.sourceSize   = source_size;
+    header.numPositions = mesh.positions.size();
+    header.numTriangles = mesh.indices.size();
+    header.numNormals   = mesh.normals.size();
+    header.numUvs       = mesh.uvs.size();
+    header.numPmf       = mesh.triangleSampler.pmf.size();
+    header.numCdf       = mesh.triangleSampler.cdf.size();
+    header.numAliasBins = mesh.triangleSampler.aliasBins.size();
+    header.totalArea    = mesh.totalArea;
+
+    const MeshCacheLayout layout = GetLayout(header);
+    std::vector<char> buffer(layout.fileSize, 0);
+    const void* arrays[kNumMeshCacheArrays] = {mesh.positions.data(),
+                                               mesh.indices.data(),
+                                               mesh.normals.data(),
+                                               mesh.uvs.data(),
+                                               mesh.triangleSampler.pmf.data(),
+                                               mesh.triangleSampler.cdf.data(),
+                                               mesh.triangleSampler.aliasBins.data()};
+    for (int i = 0; i < kNumMeshCacheArrays; i++) {
+        if (layout.sizes[i] > 0) {
+            memcpy(buffer.data() + layout.offsets[i], arrays[i], layout.sizes[i]);
+        }
+    }
+    const size_t data_offset = layout.offsets[0];
+    header.contentHash       = HashBytes(buffer.data() + data_offset, buffer.size() - data_offset);
+    memcpy(buffer.data(), &header, sizeof(header));
+
+    // Written under a temporary name and renamed, so that concurrent renders never map half a file
+    fs::path tmp_file = entry.cacheFile;
+    tmp_file += std::format(".{:08x}.tmp", std::random_device{}());
+    {
+        std::ofstream ofs(tmp_file, std::ios::binary);
+        ofs.write(buffer.data(), buffer.size());
+        if (!ofs) {
+            ofs.close();
+            fs::remove(tmp_file, ec);
+            LogWarn("无法写入网格缓存 {}。", entry.cacheFile.string());
+            return;
+        }
+    }
+    fs::rename(tmp_file, entry.cacheFile, ec);
+    if (ec) {
+        fs::remove(tmp_file, ec);
+        LogWarn("无法写入网格缓存 {}。", entry.cacheFile.string());
+    }
+}
+
+void SetMeshCacheEnabled(bool enabled)
+{
+    sMeshCacheEnabled = enabled;
+}
+
+bool IsMeshCacheEnabled()
+{
+    return sMeshCacheEnabled;
+}
+
+} // namespace elma
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Elma.hpp"
+#include "Matrix.hpp"
+#include "Shape.hpp"
+
+#include <optional>
+#include <string_view>
+
+namespace elma {
+
+/// Elma's binary mesh cache. A mesh loaded from an obj/ply/serialized file is written next to the
+/// source as "<source>.<key>.elmamesh", the key hashing everything baked into the mesh (the loader,
+/// shape index, transform and normal mode). The file holds a versioned header, then 64 byte aligned
+/// arrays: float positions, int indices, Real normals and uvs, and the triangle sampling distribution.
+/// The header records sizeof(Real), so a file written with the other Real type is rebuilt.
+/// A content hash over the arrays guards against truncated or corrupted files.
+struct MeshCacheEntry
+{
+    fs::path cacheFile;
+    uint64_t key;
+};
+
+MeshCacheEntry GetMeshCacheEntry(const fs::path& source,
+                                 std::string_view type,
+                                 int shape_index,
+                                 const Matrix4x4& to_world,
+                                 bool face_normals);
+
+/// Maps the cache if it exists, is at least as new as the source and is valid.
+std::optional<TriangleMesh> ReadMeshCache(const MeshCacheEntry& entry, const fs::path& source);
+
+/// Writes the mesh (with its triangle sampling distribution built) to the cache. Failures only log
+/// a warning, the cache is an optimization.
+void WriteMeshCache(const MeshCacheEntry& entry, const fs::path& source, const TriangleMesh& mesh);
+
+/// The cache is on by default.
+void SetMeshCacheEnabled(bool enabled);
+bool IsMeshCacheEnabled();
+
+} // namespace elma
@@ -1,170 +1,309 @@
 #include "ParseObj.hpp"
+#include "MappedFile.hpp"
+#include "Parallel.hpp"
 #include "Transform.hpp"
 #include "Common/Error.hpp"
 
-#include <fstream>
-#include <functional>
-#include <map>
-#include <regex>
-#include <string>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <string_view>
 
 namespace elma {
 
-// https://stackoverflow.com/questions/216823/how-to-trim-a-stdstring
-// trim from start
-static inline std::string& LeftTrim(std::string& s)
+// The file is mapped and cut into chunks at line boundaries. Chunks are parsed in parallel into
+// their own pools, with positions and normals already transformed. The pools are then
+// concatenated, and a single pass over the faces merges the corners that share the same
+// position/uv/normal triple into one vertex, numbered in order of first use.
+
+namespace {
+
+constexpr size_t kObjChunkBytes = size_t(1) << 20;
+
+/// One corner of a face, as indices into the position/uv/normal pools. -1 when absent.
+struct ObjCorner
 {
-    s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](unsigned char ch) { return !std::isspace(ch); }));
-    return s;
-}
+    int v, vt, vn;
+};
 
-// trim from end
-static inline std::string& RightTrim(std::string& s)
+/// Bits of ObjChunk::relativeCorners, which indices of a corner were negative in the file
+enum : uint8_t
 {
-    s.erase(std::find_if(s.rbegin(), s.rend(), [](unsigned char ch) { return !std::isspace(ch); }).base(), s.end());
-    return s;
+    kRelativeV  = 1,
+    kRelativeVt = 2,
+    kRelativeVn = 4
+};
+
+struct ObjChunk
+{
+    std::vector<Vector3> positions; // transformed to world space
+    std::vector<Vector2> uvs;
+    std::vector<Vector3> normals; // transformed to world space
+    std::vector<ObjCorner> corners; // three per triangle, quads are split in two
+    // Negative indices count back from the end of a pool. Until the pools of the previous chunks
+    // are known they are relative to the start of this chunk's pools (and may be negative).
+    std::vector<std::pair<int /* corner */, uint8_t /* kRelative bits */>> relativeCorners;
+};
+
+inline bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
 }
 
-// trim from both ends
-static inline std::string& Trim(std::string& s)
+inline const char* SkipSpaces(const char* p, const char* end)
 {
-    return LeftTrim(RightTrim(s));
+    while (p != end && IsSpace(*p)) {
+        p++;
+    }
+    return p;
 }
 
-static std::vector<int> SplitFaceStr(const std::string& s)
+/// Parses a number after optional spaces. Leaves `p` and `value` alone if there is none.
+template<typename T> bool ParseNumber(const char*& p, const char* end, T& value)
 {
-    std::regex rgx("/");
-    std::sregex_token_iterator first{begin(s), end(s), rgx, -1}, last;
-    std::vector<std::string> list{first, last};
-    std::vector<int> result;
-    for (auto& i : list) {
-        if (i != "")
-            result.push_back(std::stoi(i));
-        else
-            result.push_back(0);
+    const char* q = SkipSpaces(p, end);
+    if (q != end && *q == '+') {
+        q++;
+    }
+    auto [ptr, ec] = std::from_chars(q, end, value);
+    if (ec != std::errc()) {
+        return false;
     }
-    while (result.size() < 3)
-        result.push_back(0);
+    p = ptr;
+    return true;
+}
 
-    return result;
+/// Parses one "v", "v/vt", "v//vn" or "v/vt/vn" face corner into file indices (1-based, negative
+/// for relative, 0 when absent). Returns false at the end of the line.
+bool ParseCorner(const char*& p, const char* end, int (&index)[3], const fs::path& filename)
+{
+    p = SkipSpaces(p, end);
+    if (p == end || *p == '#') {
+        return false;
+    }
+    index[0] = index[1] = index[2] = 0;
+    for (int k = 0; k < 3; k++) {
+        if (p != end && *p != '/' && !ParseNumber(p, end, index[k])) {
+            break;
+        }
+        if (p == end || *p != '/') {
+            break;
+        }
+        p++;
+    }
+    if ((p != end && !IsSpace(*p)) || index[0] == 0) {
+        ELMA_THROW("obj 文件 {} 包含无法解析的面数据。", filename.string());
+    }
+    return true;
 }
 
-struct ObjVertex
+void ParseChunk(const char* p,
+                const char* end,
+                const Matrix4x4& to_world,
+                const Matrix4x4& inv_to_world,
+                ObjChunk& chunk,
+                const fs::path& filename)
 {
-    ObjVertex(const std::vector<int>& id) : v(id[0] - 1), vt(id[1] - 1), vn(id[2] - 1) { }
+    while (p != end) {
+        const char* line_end = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (line_end == nullptr) {
+            line_end = end;
+        }
+        const char* q = SkipSpaces(p, line_end);
+        p             = line_end == end ? end : line_end + 1;
+        if (q == line_end || *q == '#') { // comment
+            continue;
+        }
 
-    bool operator<(const ObjVertex& vertex) const
-    {
-        if (v != vertex.v) {
-            return v < vertex.v;
+        const char c0 = q[0];
+        const char c1 = q + 1 != line_end ? q[1] : ' ';
+        const char c2 = q + 2 < line_end ? q[2] : ' ';
+        if (c0 == 'v' && IsSpace(c1)) { // vertices
+            Real x = 0, y = 0, z = 0, w = 1;
+            q++;
+            ParseNumber(q, line_end, x);
+            ParseNumber(q, line_end, y);
+            ParseNumber(q, line_end, z);
+            ParseNumber(q, line_end, w);
+            chunk.positions.push_back(TransformPoint(to_world, Vector3{x, y, z} / w));
         }
-        if (vt != vertex.vt) {
-            return vt < vertex.vt;
+        else if (c0 == 'v' && c1 == 't' && IsSpace(c2)) {
+            Real s = 0, t = 0;
+            q += 2;
+            ParseNumber(q, line_end, s);
+            ParseNumber(q, line_end, t);
+            chunk.uvs.push_back(Vector2{s, 1 - t});
         }
-        if (vn != vertex.vn) {
-            return vn < vertex.vn;
+        else if (c0 == 'v' && c1 == 'n' && IsSpace(c2)) {
+            Real x = 0, y = 0, z = 0;
+            q += 2;
+            ParseNumber(q, line_end, x);
+            ParseNumber(q, line_end, y);
+            ParseNumber(q, line_end, z);
+            chunk.normals.push_back(TransformNormal(inv_to_world, Normalize(Vector3{x, y, z})));
         }
-        return false;
+        else if (c0 == 'f' && IsSpace(c1)) {
+            q++;
+            ObjCorner corners[4];
+            uint8_t relative[4] = {0, 0, 0, 0};
+            int num_corners     = 0;
+            int index[3];
+            while (ParseCorner(q, line_end, index, filename)) {
+                if (num_corners == 4) {
+                    ELMA_THROW("obj 文件 {} 包含非三角面数据，读取失败。", filename.string());
+                }
+                const int pool_sizes[3] = {
+                  (int)chunk.positions.size(), (int)chunk.uvs.size(), (int)chunk.normals.size()};
+                int resolved[3];
+                for (int k = 0; k < 3; k++) {
+                    if (index[k] > 0) {
+                        resolved[k] = index[k] - 1;
+                    }
+                    else if (index[k] == 0) {
+                        resolved[k] = -1;
+                    }
+                    else {
+                        resolved[k]            = pool_sizes[k] + index[k];
+                        relative[num_corners] |= uint8_t(1 << k);
+                    }
+                }
+                corners[num_corners++] = ObjCorner{resolved[0], resolved[1], resolved[2]};
+            }
+            if (num_corners < 3) {
+                ELMA_THROW("obj 文件 {} 包含无法解析的面数据。", filename.string());
+            }
+            // A quad is split along its 0-2 diagonal
+            constexpr int kQuadCorners[6] = {0, 1, 2, 0, 2, 3};
+            for (int k = 0; k < (num_corners == 4 ? 6 : 3); k++) {
+                const int c = kQuadCorners[k];
+                if (relative[c] != 0) {
+                    chunk.relativeCorners.emplace_back((int)chunk.corners.size(), relative[c]);
+                }
+                chunk.corners.push_back(corners[c]);
+            }
+        } // Currently ignore other tokens
     }
+}
 
-    int v, vt, vn;
-};
-
-size_t GetVertexId(const ObjVertex& vertex,
-                   const std::vector<Vector3>& pos_pool,
-                   const std::vector<Vector2>& st_pool,
-                   const std::vector<Vector3>& nor_pool,
-                   const Matrix4x4& to_world,
-                   std::vector<Vector3>& pos,
-                   std::vector<Vector2>& st,
-                   std::vector<Vector3>& nor,
-                   std::map<ObjVertex, size_t>& vertex_map)
+/// Concatenates the pools of all chunks in parallel, `offsets` receives the start of each chunk.
+template<typename T>
+std::vector<T> Concatenate(std::vector<ObjChunk>& chunks, std::vector<T> ObjChunk::*pool, std::vector<int>& offsets)
 {
-    auto it = vertex_map.find(vertex);
-    if (it != vertex_map.end()) {
-        return it->second;
+    offsets.resize(chunks.size());
+    size_t total = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        offsets[i]  = (int)total;
+        total      += (chunks[i].*pool).size();
     }
-    size_t id = pos.size();
-    pos.push_back(TransformPoint(to_world, pos_pool[vertex.v]));
-    if (vertex.vt != -1)
-        st.push_back(st_pool[vertex.vt]);
-    if (vertex.vn != -1) {
-        nor.push_back(TransformNormal(Inverse(to_world), nor_pool[vertex.vn]));
-    }
-    vertex_map[vertex] = id;
-    return id;
+    std::vector<T> result(total);
+    ParallelFor(
+        [&](int64_t i) {
+            std::vector<T>& src = chunks[i].*pool;
+            std::copy(src.begin(), src.end(), result.begin() + offsets[i]);
+            std::vector<T>().swap(src);
+        },
+        chunks.size());
+    return result;
 }
 
+} // namespace
+
 TriangleMesh ParseObj(const fs::path& filename, const Matrix4x4& to_world)
 {
-    std::vector<Vector3> pos_pool;
-    std::vector<Vector3> nor_pool;
-    std::vector<Vector2> st_pool;
-    std::map<ObjVertex, size_t> vertex_map;
-    TriangleMesh mesh;
+    const MappedFile file(filename);
+    const char* begin = file.data();
+    const char* end   = begin + file.size();
 
-    std::ifstream ifs(filename.c_str(), std::ifstream::in);
-    if (!ifs.is_open()) {
-        ELMA_THROW("无法打开 obj 文件 {}.", filename.string());
+    // Chunk boundaries, moved to the start of the next line
+    const size_t num_chunks = std::max(file.size() / kObjChunkBytes, size_t(1));
+    std::vector<const char*> bounds(num_chunks + 1, end);
+    bounds[0] = begin;
+    for (size_t i = 1; i < num_chunks; i++) {
+        const char* p = begin + i * file.size() / num_chunks;
+        p         = std::max(p, bounds[i - 1]);
+        auto* eol = p == end ? nullptr : static_cast<const char*>(std::memchr(p, '\n', end - p));
+        bounds[i] = eol == nullptr ? end : eol + 1;
     }
-    while (ifs.good()) {
-        std::string line;
-        std::getline(ifs, line);
-        line = Trim(line);
-        if (line.size() == 0 || line[0] == '#') { // comment
-            continue;
-        }
 
-        std::stringstream ss(line);
-        std::string token;
-        ss >> token;
-        if (token == "v") { // vertices
-            Real x, y, z, w = 1;
-            ss >> x >> y >> z >> w;
-            pos_pool.push_back(Vector3{x, y, z} / w);
-        }
-        else if (token == "vt") {
-            Real s, t, w;
-            ss >> s >> t >> w;
-            st_pool.push_back(Vector2{s, 1 - t});
-        }
-        else if (token == "vn") {
-            Real x, y, z;
-            ss >> x >> y >> z;
-            nor_pool.push_back(Normalize(Vector3{x, y, z}));
+    const Matrix4x4 inv_to_world = Inverse(to_world);
+    std::vector<ObjChunk> chunks(num_chunks);
+    std::vector<std::exception_ptr> errors(num_chunks);
+    ParallelFor(
+        [&](int64_t i) {
+            try {
+                ParseChunk(bounds[i], bounds[i + 1], to_world, inv_to_world, chunks[i], filename);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        },
+        num_chunks);
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
         }
-        else if (token == "f") {
-            std::string i0, i1, i2;
-            ss >> i0 >> i1 >> i2;
-            std::vector<int> i0f = SplitFaceStr(i0);
-            std::vector<int> i1f = SplitFaceStr(i1);
-            std::vector<int> i2f = SplitFaceStr(i2);
-
-            ObjVertex v0(i0f), v1(i1f), v2(i2f);
-            size_t v0id = GetVertexId(
-                v0, pos_pool, st_pool, nor_pool, to_world, mesh.positions, mesh.uvs, mesh.normals, vertex_map);
-            size_t v1id = GetVertexId(
-                v1, pos_pool, st_pool, nor_pool, to_world, mesh.positions, mesh.uvs, mesh.normals, vertex_map);
-            size_t v2id = GetVertexId(
-                v2, pos_pool, st_pool, nor_pool, to_world, mesh.positions, mesh.uvs, mesh.normals, vertex_map);
-            mesh.indices.push_back(Vector3i{v0id, v1id, v2id});
-
-            std::string i3;
-            if (ss >> i3) {
-                std::vector<int> i3f = SplitFaceStr(i3);
-                ObjVertex v3(i3f);
-                size_t v3id = GetVertexId(
-                    v3, pos_pool, st_pool, nor_pool, to_world, mesh.positions, mesh.uvs, mesh.normals, vertex_map);
-                mesh.indices.push_back(Vector3i{v0id, v2id, v3id});
+    }
+
+    std::vector<int> v_offsets, vt_offsets, vn_offsets;
+    const std::vector<Vector3> pos_pool = Concatenate(chunks, &ObjChunk::positions, v_offsets);
+    const std::vector<Vector2> st_pool  = Concatenate(chunks, &ObjChunk::uvs, vt_offsets);
+    const std::vector<Vector3> nor_pool = Concatenate(chunks, &ObjChunk::normals, vn_offsets);
+    ParallelFor(
+        [&](int64_t i) {
+            for (auto [corner, relative] : chunks[i].relativeCorners) {
+                ObjCorner& c = chunks[i].corners[corner];
+                c.v += relative & kRelativeV ? v_offsets[i] : 0;
+                c.vt += relative & kRelativeVt ? vt_offsets[i] : 0;
+                c.vn += relative & kRelativeVn ? vn_offsets[i] : 0;
+            }
+        },
+        num_chunks);
+
+    // Merge identical corners. The first vertex using a position is found through `first_use`,
+    // the other ones (different uv or normal) are chained through `next_use`.
+    size_t num_corners = 0;
+    for (const ObjChunk& chunk : chunks) {
+        num_corners += chunk.corners.size();
+    }
+    std::vector<int> first_use(pos_pool.size(), -1);
+    std::vector<int> next_use;
+    std::vector<ObjCorner> vertices;
+    TriangleMesh mesh;
+    mesh.indices.resize(num_corners / 3);
+    size_t corner = 0;
+    for (const ObjChunk& chunk : chunks) {
+        for (const ObjCorner& c : chunk.corners) {
+            if (c.v < 0 || c.v >= (int)pos_pool.size() || c.vt >= (int)st_pool.size() ||
+                c.vn >= (int)nor_pool.size() || c.vt < -1 || c.vn < -1) {
+                ELMA_THROW("obj 文件 {} 的面索引越界。", filename.string());
             }
-            std::string i4;
-            if (ss >> i4) {
-                ELMA_THROW("obj 文件 {} 包含非三角面数据，读取失败。", filename.string());
+            int id = first_use[c.v];
+            while (id != -1 && (vertices[id].vt != c.vt || vertices[id].vn != c.vn)) {
+                id = next_use[id];
             }
-        } // Currently ignore other tokens
+            if (id == -1) {
+                id = (int)vertices.size();
+                vertices.push_back(c);
+                next_use.push_back(first_use[c.v]);
+                first_use[c.v] = id;
+            }
+            mesh.indices[corner / 3][corner % 3] = id;
+            corner++;
+        }
     }
 
+    mesh.positions.resize(vertices.size());
+    ParallelFor(
+        [&](int64_t i) { mesh.positions[i] = Vector3f(pos_pool[vertices[i].v]); }, vertices.size(), 4096);
+    // Like the vertices, uvs and normals are numbered in order of first use
+    for (const ObjCorner& c : vertices) {
+        if (c.vt != -1) {
+            mesh.uvs.push_back(st_pool[c.vt]);
+        }
+        if (c.vn != -1) {
+            mesh.normals.push_back(nor_pool[c.vn]);
+        }
+    }
     return mesh;
 }
 
-} // namespace elma
\ No newline at end of file
+} // namespace elma
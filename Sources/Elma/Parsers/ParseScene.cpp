@@ -1,10 +1,14 @@
 #include "ParseScene.hpp"
 #include <pugixml.hpp>
 #include "LoadSerialized.hpp"
+#include "MeshCache.hpp"
 #include "ParseObj.hpp"
 #include "ParsePly.hpp"
+#include "Parallel.hpp"
 #include "ShapeUtils.hpp"
+#include "Timer.hpp"
 #include "Transform.hpp"
+#include <atomic>
 #include <map>
 #include <regex>
 #include "Common/Error.hpp"
@@ -19,7 +23,8 @@ const Filter kDefaultFilter        = Box{Real(1)};
 
 struct ParsedSampler
 {
-    int sampleCount = 4;
+    SamplerType type = SamplerType::Independent;
+    int sampleCount  = 4;
 };
 
 enum class TextureType
@@ -578,8 +583,8 @@ RenderOptions ParseIntegrator(pugi::xml_node node, const std::map<std::string, s
 {
     RenderOptions options;
     std::string type = node.attribute("type").value();
-    if (type == "path") {
-        options.integrator = Integrator::Path;
+    if (type == "path" || type == "wavefrontPath" || type == "wavefront_path") {
+        options.integrator = type == "path" ? Integrator::Path : Integrator::WavefrontPath;
         for (auto child : node.children()) {
             std::string name = child.attribute("name").value();
             if (name == "maxDepth") {
@@ -588,6 +593,24 @@ RenderOptions ParseIntegrator(pugi::xml_node node, const std::map<std::string, s
             else if (name == "rrDepth") {
                 options.rrDepth = ParseInteger(child.attribute("value").value(), default_map);
             }
+            else if (name == "adaptiveThreshold" || name == "adaptive_threshold") {
+                options.adaptiveThreshold = ParseFloat(child.attribute("value").value(), default_map);
+            }
+            else if (name == "adaptiveMinSamples" || name == "adaptive_min_samples") {
+                options.adaptiveMinSamples = ParseInteger(child.attribute("value").value(), default_map);
+            }
+            else if (name == "lightSampler" || name == "light_sampler") {
+                const std::string light_sampler = ParseString(child.attribute("value").value(), default_map);
+                if (light_sampler == "power") {
+                    options.lightSampler = LightSamplerType::Power;
+                }
+                else if (light_sampler == "bvh") {
+                    options.lightSampler = LightSamplerType::BVH;
+                }
+                else {
+                    ELMA_THROW("不支持的光源采样(lightSampler)类型：{}。", light_sampler);
+                }
+            }
         }
     }
     else if (type == "volpath") {
@@ -630,6 +653,25 @@ RenderOptions ParseIntegrator(pugi::xml_node node, const std::map<std::string, s
     else {
         ELMA_THROW("不支持的积分器(Integrator)类型：{}。", type);
     }
+    // Options shared by all integrators
+    for (auto child : node.children()) {
+        std::string name = child.attribute("name").value();
+        if (name == "textureCacheSize" || name == "texture_cache_size") {
+            options.textureCacheBudget = int64_t(ParseInteger(child.attribute("value").value(), default_map)) << 20;
+        }
+        else if (name == "textureTileLayout" || name == "texture_tile_layout") {
+            const std::string layout = ParseString(child.attribute("value").value(), default_map);
+            if (layout == "rowMajor" || layout == "row_major") {
+                options.textureTileLayout = TileLayout::RowMajor;
+            }
+            else if (layout == "morton") {
+                options.textureTileLayout = TileLayout::Morton;
+            }
+            else {
+                ELMA_THROW("不支持的纹理分块布局(textureTileLayout)：{}。", layout);
+            }
+        }
+    }
     return options;
 }
 
@@ -701,15 +743,30 @@ VolumeSpectrum ParseVolumeSpectrum(pugi::xml_node node, const std::map<std::stri
     }
     else if (type == "gridvolume") {
         std::string filename;
+        std::string storage = "dense";
+        int bits            = 32;
         for (auto child : node.children()) {
             std::string name = child.attribute("name").value();
             if (name == "filename") {
                 filename = ParseString(child.attribute("value").value(), default_map);
             }
+            else if (name == "storage") {
+                storage = ParseString(child.attribute("value").value(), default_map);
+            }
+            else if (name == "bits") {
+                // Bits per channel of the bricks, 8 and 16 quantize the voxels
+                bits = ParseInteger(child.attribute("value").value(), default_map);
+            }
         }
         if (filename.empty()) {
             ELMA_THROW("未设置 Grid Volume 的引用。");
         }
+        if (storage == "sparse" || fs::path(filename).extension() == ".elmavol") {
+            return LoadBrickVolumeFromFile<Spectrum>(filename, VolumeEncodingFromBits(bits));
+        }
+        if (storage != "dense") {
+            ELMA_THROW("不支持的 Grid Volume 存储方式：{}。", storage);
+        }
         return LoadVolumeFromFile<Spectrum>(filename);
     }
     else {
@@ -775,6 +832,7 @@ std::tuple<std::string /* ID */, Medium> ParseMedium(pugi::xml_node node,
         VolumeSpectrum albedo  = ConstantVolume<Spectrum>{MakeConstSpectrum(1)};
         VolumeSpectrum density = ConstantVolume<Spectrum>{MakeConstSpectrum(1)};
         Real scale             = 1;
+        int majorant_grid      = kMajorantGridResolution;
         for (auto child : node.children()) {
             std::string name = child.attribute("name").value();
             if (name == "albedo") {
@@ -786,13 +844,24 @@ std::tuple<std::string /* ID */, Medium> ParseMedium(pugi::xml_node node,
             else if (name == "scale") {
                 scale = ParseFloat(child.attribute("value").value(), default_map);
             }
+            else if (name == "majorantGrid") {
+                // Cells per axis of the local majorants, 1 bounds the whole grid by its maximum
+                majorant_grid = ParseInteger(child.attribute("value").value(), default_map);
+            }
             else if (std::string(child.name()) == "phase") {
                 phase_func = ParsePhaseFunction(child, default_map);
             }
         }
         // scale only applies to density!!
         SetScale(density, scale);
-        return std::make_tuple(id, HeterogeneousMedium{{phase_func}, albedo, density});
+        MajorantGrid majorants;
+        if (const GridVolume<Spectrum>* grid = std::get_if<GridVolume<Spectrum>>(&density)) {
+            majorants = MakeMajorantGrid(*grid, majorant_grid);
+        }
+        else if (const BrickVolume<Spectrum>* bricks = std::get_if<BrickVolume<Spectrum>>(&density)) {
+            majorants = MakeMajorantGrid(*bricks, majorant_grid);
+        }
+        return std::make_tuple(id, HeterogeneousMedium{{phase_func}, albedo, density, std::move(majorants)});
     }
     else {
         ELMA_THROW("不支持的介质(Medium)类型：{}。", type);
@@ -857,8 +926,14 @@ ParseSensor(pugi::xml_node node,
         }
         else if (std::string(child.name()) == "sampler") {
             std::string name = child.attribute("type").value();
-            if (name != "independent") {
-                std::cerr << "Warning: the renderer currently only supports independent samplers." << std::endl;
+            if (name == "sobol" || name == "zsobol") {
+                sampler.type = SamplerType::ZSobol;
+            }
+            else if (name == "paddedSobol" || name == "padded_sobol" || name == "ldsampler") {
+                sampler.type = SamplerType::PaddedSobol;
+            }
+            else if (name != "independent") {
+                LogWarn("不支持的采样器类型：{}，使用 independent 采样器。", name);
             }
             for (auto grand_child : child.children()) {
                 std::string name = grand_child.attribute("name").value();
@@ -1243,6 +1318,93 @@ ParseBSDF(pugi::xml_node node,
     return std::make_tuple("", Material{});
 }
 
+/// A mesh file referenced by a shape. The files are read after the XML walk, all at once on the thread pool.
+struct MeshFile
+{
+    int shapeId;      // in the shape list the mesh belongs to
+    std::string type; // obj, serialized or ply
+    std::string filename;
+    int shapeIndex;
+    Matrix4x4 toWorld;
+    bool faceNormals;
+};
+
+TriangleMesh LoadMeshFile(const MeshFile& file)
+{
+    TriangleMesh mesh;
+    if (file.type == "obj") {
+        mesh = ParseObj(file.filename, file.toWorld);
+    }
+    else if (file.type == "serialized") {
+        mesh = LoadSerialized(file.filename, file.shapeIndex, file.toWorld);
+    }
+    else {
+        mesh = ParsePLY(file.filename, file.toWorld);
+    }
+    if (file.faceNormals) {
+        mesh.normals = std::vector<Vector3>{};
+    }
+    else if (mesh.normals.empty()) {
+        mesh.normals = ComputeNormal(mesh.positions, mesh.indices);
+    }
+    return mesh;
+}
+
+/// Loads the mesh files into their shapes, in parallel, and returns the seconds it took.
+/// Meshes come from the binary mesh cache when it is up to date, otherwise the cache is written.
+/// The first error of a file is rethrown once all the loads are done.
+Real LoadMeshFiles(const std::vector<MeshFile>& mesh_files, std::vector<Shape>& shapes)
+{
+    Timer timer;
+    tick(timer);
+    const bool use_cache = IsMeshCacheEnabled();
+    std::atomic<int> num_cached{0};
+    std::vector<std::exception_ptr> errors(mesh_files.size());
+    ParallelFor(
+        [&](int64_t i) {
+            const MeshFile& file = mesh_files[i];
+            try {
+                const MeshCacheEntry cache_entry =
+                  GetMeshCacheEntry(file.filename, file.type, file.shapeIndex, file.toWorld, file.faceNormals);
+                std::optional<TriangleMesh> cached;
+                if (use_cache) {
+                    cached = ReadMeshCache(cache_entry, file.filename);
+                }
+                TriangleMesh loaded = cached ? std::move(*cached) : LoadMeshFile(file);
+                // Keep the material, media and light IDs assigned by the parser
+                auto& mesh           = std::get<TriangleMesh>(shapes[file.shapeId]);
+                mesh.positions       = std::move(loaded.positions);
+                mesh.indices         = std::move(loaded.indices);
+                mesh.normals         = std::move(loaded.normals);
+                mesh.uvs             = std::move(loaded.uvs);
+                mesh.triangleSampler = std::move(loaded.triangleSampler);
+                mesh.totalArea       = loaded.totalArea;
+                if (cached) {
+                    num_cached++;
+                }
+                else {
+                    // Built here instead of in the scene, so that the cache holds it
+                    InitSamplingDist(shapes[file.shapeId]);
+                    if (use_cache) {
+                        WriteMeshCache(cache_entry, file.filename, mesh);
+                    }
+                }
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        },
+        mesh_files.size());
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    if (use_cache && !mesh_files.empty()) {
+        LogInfo("{} 个网格中有 {} 个从网格缓存加载", mesh_files.size(), num_cached.load());
+    }
+    return tick(timer);
+}
+
 Shape parse_shape(pugi::xml_node node,
                   std::vector<Material>& materials,
                   std::map<std::string /* name id */, int /* index id */>& material_map,
@@ -1252,6 +1414,7 @@ Shape parse_shape(pugi::xml_node node,
                   std::map<std::string /* name id */, int /* index id */>& medium_map,
                   std::vector<Light>& lights,
                   const std::vector<Shape>& shapes,
+                  std::vector<MeshFile>& mesh_files,
                   const std::map<std::string, std::string>& default_map)
 {
     int material_id        = -1;
@@ -1320,100 +1483,28 @@ Shape parse_shape(pugi::xml_node node,
 
     Shape shape;
     std::string type = node.attribute("type").value();
-    if (type == "obj") {
-        std::string filename;
-        Matrix4x4 to_world = Matrix4x4::identity();
-        bool face_normals  = false;
+    if (type == "obj" || type == "serialized" || type == "ply") {
+        MeshFile file{(int)shapes.size(), type, "", 0, Matrix4x4::identity(), false};
         for (auto child : node.children()) {
             std::string name = child.attribute("name").value();
             if (name == "filename") {
-                filename = ParseString(child.attribute("value").value(), default_map);
+                file.filename = ParseString(child.attribute("value").value(), default_map);
             }
             else if (name == "toWorld" || name == "to_world") {
                 if (std::string(child.name()) == "transform") {
-                    to_world = ParseTransform(child, default_map);
-                }
-            }
-            else if (name == "faceNormals" || name == "face_normals") {
-                face_normals = ParseBoolean(child.attribute("value").value(), default_map);
-            }
-        }
-        shape      = ParseObj(filename, to_world);
-        auto& mesh = std::get<TriangleMesh>(shape);
-        if (face_normals) {
-            mesh.normals = std::vector<Vector3>{};
-        }
-        else {
-            if (mesh.normals.size() == 0) {
-                mesh.normals = ComputeNormal(mesh.positions, mesh.indices);
-            }
-        }
-    }
-    else if (type == "serialized") {
-        std::string filename;
-        int shape_index    = 0;
-        Matrix4x4 to_world = Matrix4x4::identity();
-        bool face_normals  = false;
-        for (auto child : node.children()) {
-            std::string name = child.attribute("name").value();
-            if (name == "filename") {
-                filename = ParseString(child.attribute("value").value(), default_map);
-            }
-            else if (name == "toWorld" || name == "to_world") {
-                if (std::string(child.name()) == "transform") {
-                    to_world = ParseTransform(child, default_map);
+                    file.toWorld = ParseTransform(child, default_map);
                 }
             }
             else if (name == "shapeIndex" || name == "shape_index") {
-                shape_index = ParseInteger(child.attribute("value").value(), default_map);
+                file.shapeIndex = ParseInteger(child.attribute("value").value(), default_map);
             }
             else if (name == "faceNormals" || name == "face_normals") {
-                face_normals = ParseBoolean(child.attribute("value").value(), default_map);
-            }
-        }
-        shape      = LoadSerialized(filename, shape_index, to_world);
-        auto& mesh = std::get<TriangleMesh>(shape);
-        if (face_normals) {
-            mesh.normals = std::vector<Vector3>{};
-        }
-        else {
-            if (mesh.normals.empty()) {
-                mesh.normals = ComputeNormal(mesh.positions, mesh.indices);
-            }
-        }
-    }
-    else if (type == "ply") {
-        std::string filename;
-        int shape_index    = 0;
-        Matrix4x4 to_world = Matrix4x4::identity();
-        bool face_normals  = false;
-        for (auto child : node.children()) {
-            std::string name = child.attribute("name").value();
-            if (name == "filename") {
-                filename = ParseString(child.attribute("value").value(), default_map);
-            }
-            else if (name == "toWorld" || name == "to_world") {
-                if (std::string(child.name()) == "transform") {
-                    to_world = ParseTransform(child, default_map);
-                }
-            }
-            else if (name == "shapeIndex" || name == "shape_index") {
-                shape_index = ParseInteger(child.attribute("value").value(), default_map);
-            }
-            else if (name == "faceNormals" || name == "face_normals") {
-                face_normals = ParseBoolean(child.attribute("value").value(), default_map);
-            }
-        }
-        shape      = ParsePLY(filename, to_world);
-        auto& mesh = std::get<TriangleMesh>(shape);
-        if (face_normals) {
-            mesh.normals = std::vector<Vector3>{};
-        }
-        else {
-            if (mesh.normals.empty()) {
-                mesh.normals = ComputeNormal(mesh.positions, mesh.indices);
+                file.faceNormals = ParseBoolean(child.attribute("value").value(), default_map);
             }
         }
+        // Filled in by LoadMeshFiles
+        shape = TriangleMesh{};
+        mesh_files.push_back(file);
     }
     else if (type == "sphere") {
         Vector3 center{0, 0, 0};
@@ -1506,8 +1597,86 @@ Shape parse_shape(pugi::xml_node node,
     return shape;
 }
 
+/// <shape type="shapegroup" id="..."> holds shapes that are only rendered through instances.
+std::shared_ptr<const ShapeGroup>
+ParseShapeGroup(pugi::xml_node node,
+                const RTCDevice& embree_device,
+                std::vector<Material>& materials,
+                std::map<std::string /* name id */, int /* index id */>& material_map,
+                const std::map<std::string /* name id */, ParsedTexture>& texture_map,
+                TexturePool& texture_pool,
+                std::vector<Medium>& media,
+                std::map<std::string /* name id */, int /* index id */>& medium_map,
+                std::vector<Light>& lights,
+                const std::map<std::string, std::string>& default_map,
+                Real& load_seconds)
+{
+    std::vector<Shape> group_shapes;
+    std::vector<MeshFile> mesh_files;
+    for (auto child : node.children()) {
+        if (std::string(child.name()) != "shape") {
+            continue;
+        }
+        Shape s = parse_shape(child,
+                              materials,
+                              material_map,
+                              texture_map,
+                              texture_pool,
+                              media,
+                              medium_map,
+                              lights,
+                              group_shapes,
+                              mesh_files,
+                              default_map);
+        if (IsLight(s)) {
+            ELMA_THROW("形状组(shapegroup)中不支持面光源。");
+        }
+        group_shapes.push_back(s);
+    }
+    // The group's Embree scene is built right away, so its meshes can't wait for the rest of the scene
+    load_seconds += LoadMeshFiles(mesh_files, group_shapes);
+    return std::make_shared<const ShapeGroup>(embree_device, std::move(group_shapes));
+}
+
+/// <shape type="instance"> places a shape group with its own toWorld transform.
+Instance ParseInstance(pugi::xml_node node,
+                       const std::map<std::string /* name id */, std::shared_ptr<const ShapeGroup>>& shape_group_map,
+                       const std::map<std::string, std::string>& default_map)
+{
+    Instance instance;
+    instance.toWorld = Matrix4x4::identity();
+    for (auto child : node.children()) {
+        std::string name = child.name();
+        if (name == "ref") {
+            std::string id = child.attribute("id").value();
+            auto it        = shape_group_map.find(id);
+            if (it == shape_group_map.end()) {
+                ELMA_THROW("没有找到形状组(shapegroup)引用 '{}'。", id);
+            }
+            instance.group = it->second;
+        }
+        else if (name == "transform") {
+            std::string name_value = child.attribute("name").value();
+            if (name_value == "toWorld" || name_value == "to_world") {
+                instance.toWorld = ParseTransform(child, default_map);
+            }
+        }
+        else if (name == "emitter" || name == "bsdf") {
+            LogWarn("实例(instance)不支持 '{}'，已忽略。", name);
+        }
+    }
+    if (!instance.group) {
+        ELMA_THROW("实例(instance)未引用形状组(shapegroup)。");
+    }
+    instance.toLocal = Inverse(instance.toWorld);
+    return instance;
+}
+
 std::unique_ptr<Scene> ParseScene(pugi::xml_node node, const RTCDevice& embree_device)
 {
+    Timer timer;
+    tick(timer);
+    SceneBuildTimes build_times;
     RenderOptions options;
     Camera camera(Matrix4x4::identity(), kDefaultFov, kDefaultRes, kDefaultRes, kDefaultFilter, -1 /*medium_id*/);
     std::string filename = kDefaultFilename;
@@ -1518,6 +1687,8 @@ std::unique_ptr<Scene> ParseScene(pugi::xml_node node, const RTCDevice& embree_d
     std::vector<Medium> media;
     std::map<std::string /* name id */, int /* index id */> medium_map;
     std::vector<Shape> shapes;
+    std::vector<MeshFile> mesh_files;
+    std::map<std::string /* name id */, std::shared_ptr<const ShapeGroup>> shape_group_map;
     std::vector<Light> lights;
     // For <default> tags
     // e.g., <default name="spp" value="4096"/> will map "spp" to "4096"
@@ -1531,11 +1702,14 @@ std::unique_ptr<Scene> ParseScene(pugi::xml_node node, const RTCDevice& embree_d
         }
         else if (name == "integrator") {
             options = ParseIntegrator(child, default_map);
+            // Before the textures, so that the in-memory ones are tiled with it too
+            SetTextureCacheLayout(*texture_pool.cache, options.textureTileLayout);
         }
         else if (name == "sensor") {
             ParsedSampler sampler;
             std::tie(camera, filename, sampler) = ParseSensor(child, media, medium_map, default_map);
             options.samplesPerPixel             = sampler.sampleCount;
+            options.sampler                     = sampler.type;
         }
         else if (name == "bsdf") {
             std::string material_name;
@@ -1546,6 +1720,26 @@ std::unique_ptr<Scene> ParseScene(pugi::xml_node node, const RTCDevice& embree_d
                 materials.push_back(m);
             }
         }
+        else if (name == "shape" && std::string(child.attribute("type").value()) == "shapegroup") {
+            std::string id = child.attribute("id").value();
+            if (id.empty() || shape_group_map.find(id) != shape_group_map.end()) {
+                ELMA_THROW("形状组(shapegroup)的 ID 为空或重复：'{}'。", id);
+            }
+            shape_group_map[id] = ParseShapeGroup(child,
+                                                  embree_device,
+                                                  materials,
+                                                  material_map,
+                                                  texture_map,
+                                                  texture_pool,
+                                                  media,
+                                                  medium_map,
+                                                  lights,
+                                                  default_map,
+                                                  build_times.loadMeshes);
+        }
+        else if (name == "shape" && std::string(child.attribute("type").value()) == "instance") {
+            shapes.push_back(ParseInstance(child, shape_group_map, default_map));
+        }
         else if (name == "shape") {
             Shape s = parse_shape(child,
                                   materials,
@@ -1556,6 +1750,7 @@ std::unique_ptr<Scene> ParseScene(pugi::xml_node node, const RTCDevice& embree_d
                                   medium_map,
                                   lights,
                                   shapes,
+                                  mesh_files,
                                   default_map);
             shapes.push_back(s);
         }
@@ -1665,7 +1860,12 @@ std::unique_ptr<Scene> ParseScene(pugi::xml_node node, const RTCDevice& embree_d
                   Vector3i{0, 2, 3}
                 };
                 mesh.normals     = {direction, direction, direction, direction};
-                intensity       *= ((dist * dist) / (length * length));
+                // Positions are stored in single precision, which is coarse this far from the origin:
+                // normalize with the area of the quad that is actually stored, not length^2
+                const Vector3 p0 = mesh.positions[0], p1 = mesh.positions[1], p2 = mesh.positions[2],
+                              p3 = mesh.positions[3];
+                Real area        = (Length(Cross(p1 - p0, p2 - p0)) + Length(Cross(p2 - p0, p3 - p0))) / 2;
+                intensity       *= ((dist * dist) / area);
                 Shape s          = mesh;
                 Material m       = Lambertian{MakeConstantSpectrumTexture(MakeZeroSpectrum())};
                 int material_id  = materials.size();
@@ -1689,8 +1889,28 @@ std::unique_ptr<Scene> ParseScene(pugi::xml_node node, const RTCDevice& embree_d
             }
         }
     }
-    return std::make_unique<Scene>(
-        embree_device, camera, materials, shapes, lights, media, envmap_light_id, texture_pool, options, filename);
+    SetTextureCacheBudget(*texture_pool.cache, options.textureCacheBudget);
+    build_times.parse       = tick(timer) - build_times.loadMeshes;
+    build_times.loadMeshes += LoadMeshFiles(mesh_files, shapes);
+
+    auto scene = std::make_unique<Scene>(
+        embree_device, camera, materials, std::move(shapes), lights, media, envmap_light_id, texture_pool, options,
+        filename);
+    scene->buildTimes.parse      = build_times.parse;
+    scene->buildTimes.loadMeshes = build_times.loadMeshes;
+    const SceneBuildTimes& t     = scene->buildTimes;
+    LogInfo("场景构造耗时（秒）：解析 {:.3f}，加载网格 {:.3f}（{} 个文件），注册 Embree {:.3f}，构建 BVH {:.3f}，"
+            "形状采样分布 {:.3f}，光源采样分布 {:.3f}，光源功率 {:.3f}，光源 BVH {:.3f}",
+            t.parse,
+            t.loadMeshes,
+            mesh_files.size(),
+            t.registerEmbree,
+            t.commitEmbree,
+            t.shapeSampling,
+            t.lightSampling,
+            t.lightPower,
+            t.lightBvh);
+    return scene;
 }
 
 std::unique_ptr<Scene> ParseScene(const fs::path& filename, const RTCDevice& embree_device)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Elma.hpp"
+#include "Simd.hpp"
 #include "Vector.hpp"
 #include <vector>
 
@@ -15,7 +16,8 @@ inline Real UnitAngle(const Vector3& u, const Vector3& v)
         return 2 * asin(Real(0.5) * Length(v - u));
 }
 
-inline std::vector<Vector3> ComputeNormal(const std::vector<Vector3>& vertices, const std::vector<Vector3i>& indices)
+template<typename Positions>
+inline std::vector<Vector3> ComputeNormal(const Positions& vertices, const std::vector<Vector3i>& indices)
 {
     std::vector<Vector3> normals(vertices.size(), Vector3{0, 0, 0});
 
@@ -23,9 +25,9 @@ inline std::vector<Vector3> ComputeNormal(const std::vector<Vector3>& vertices,
     for (auto& index : indices) {
         Vector3 n = Vector3{0, 0, 0};
         for (int i = 0; i < 3; ++i) {
-            const Vector3& v0 = vertices[index[i]];
-            const Vector3& v1 = vertices[index[(i + 1) % 3]];
-            const Vector3& v2 = vertices[index[(i + 2) % 3]];
+            const Vector3 v0 = vertices[index[i]];
+            const Vector3 v1 = vertices[index[(i + 1) % 3]];
+            const Vector3 v2 = vertices[index[(i + 2) % 3]];
             Vector3 side1 = v1 - v0, side2 = v2 - v0;
             if (i == 0) {
                 n      = Cross(side1, side2);
@@ -40,16 +42,8 @@ inline std::vector<Vector3> ComputeNormal(const std::vector<Vector3>& vertices,
         }
     }
 
-    for (auto& n : normals) {
-        Real l = Length(n);
-        if (l != 0) {
-            n = n / l;
-        }
-        else {
-            // degenerate normals, set it to 0
-            n = Vector3{0, 0, 0};
-        }
-    }
+    // degenerate normals are set to 0
+    BatchNormalize(normals.data(), normals.data(), (int)normals.size());
     return normals;
 }
 
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "Stats.hpp"
+
+namespace elma {
+/// Statistics of PathTracing() and of the wavefront path tracer
+ELMA_STAT_DISTRIBUTION("Path/Bounces", sPathBounces);
+ELMA_STAT_COUNTER("Path/Russian roulette terminations", sRussianRouletteTerminations);
+ELMA_STAT_COUNTER("Path/BSDF sampling failures", sBSDFSamplingFailures);
+ELMA_STAT_COUNTER("Path/Zero pdf BSDF samples", sZeroPdfBSDFSamples);
+} // namespace elma
@@ -1,22 +1,25 @@
 #pragma once
 
+#include "PathStats.hpp"
 #include "Scene.hpp"
-#include "Pcg.hpp"
+#include "Sampler.hpp"
 
 namespace elma {
 /// Unidirectional path tracing
 Spectrum PathTracing(const Scene& scene,
                      int x,
                      int y, /* pixel coordinates */
-                     Pcg32State& rng)
+                     Sampler& sampler)
 {
     int w = scene.camera.width, h = scene.camera.height;
-    Vector2 screen_pos((x + NextPcg32Real<Real>(rng)) / w, (y + NextPcg32Real<Real>(rng)) / h);
+    Vector2 pixel_uv = Next2D(sampler);
+    Vector2 screen_pos((x + pixel_uv.x) / w, (y + pixel_uv.y) / h);
     Ray ray                  = SamplePrimary(scene.camera, screen_pos);
     RayDifferential ray_diff = InitRayDifferential(w, h);
 
     std::optional<PathVertex> vertex_ = Intersect(scene, ray, ray_diff);
     if (!vertex_) {
+        sPathBounces.report(0);
         // Hit background. Account for the environment map if needed.
         if (HasEnvmap(scene)) {
             const Light& envmap = GetEnvmap(scene);
@@ -64,6 +67,7 @@ Spectrum PathTracing(const Scene& scene,
     // We iteratively sum up path contributions from paths with different number of vertices
     // If max_depth == -1, we rely on Russian roulette for path termination.
     int max_depth = scene.options.maxDepth;
+    int bounces   = 0;
     for (int num_vertices = 3; max_depth == -1 || num_vertices <= max_depth + 1; num_vertices++) {
         // We are at v_i, and all the path contribution on and before has been accounted for.
         // Now we need to somehow generate v_{i+1} to account for paths with more vertices.
@@ -92,30 +96,38 @@ Spectrum PathTracing(const Scene& scene,
         // our hemisphere sampling.
 
         // Let's implement this!
-        const Material& mat = scene.materials[vertex.materialId];
+        bounces++;
+        // The textures of the material are looked up once here, for all the evaluations below.
+        const BSDFClosure bsdf = PrepareBSDF(scene, vertex);
 
         // First, we sample a point on the light source.
         // We do this by first picking a light source, then pick a point on it.
-        Vector2 light_uv{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng)};
-        Real light_w                  = NextPcg32Real<Real>(rng);
-        Real shape_w                  = NextPcg32Real<Real>(rng);
-        int light_id                  = SampleLight(scene, light_w);
-        const Light& light            = scene.lights[light_id];
-        PointAndNormal point_on_light = SamplePointOnLight(light, vertex.position, light_uv, shape_w, scene);
+        // The light is picked for this vertex: lights close to it and facing it are more likely.
+        Vector2 light_uv                     = Next2D(sampler);
+        Real light_w                         = Next1D(sampler);
+        Real shape_w                         = Next1D(sampler);
+        const LightSampleRecord light_sample = SampleLight(scene, vertex.position, vertex.normal, light_w);
+        const int light_id                   = light_sample.lightId;
 
         // Next, we compute w1*C1/p1. We store C1/p1 in C1.
         Spectrum C1 = MakeZeroSpectrum();
         Real w1     = 0;
         // Remember "current_path_throughput" already stores all the path contribution on and before v_i.
         // So we only need to compute G(v_{i}, v_{i+1}) * f(v_{i-1}, v_{i}, v_{i+1}) * L(v_{i}, v_{i+1})
-        {
+        // No light is picked if none of them can reach the vertex.
+        if (light_id >= 0) {
+            const Light& light            = scene.lights[light_id];
+            PointAndNormal point_on_light = SamplePointOnLight(light, vertex.position, light_uv, shape_w, scene);
+
             // Let's first deal with C1 = G * f * L.
             // Let's first compute G.
             Real G = 0;
             Vector3 dir_light;
             // The geometry term is different between directional light sources and
             // others. Currently we only have environment maps as directional light sources.
-            if (!IsEnvmap(light)) {
+            const Envmap* envmap = std::get_if<Envmap>(&light);
+            EnvmapDirection envmap_dir;
+            if (!envmap) {
                 dir_light = Normalize(point_on_light.position - vertex.position);
                 // If the point on light is occluded, G is 0. So we need to test for occlusion.
                 // To avoid self intersection, we need to set the tnear of the ray
@@ -138,6 +150,8 @@ Spectrum PathTracing(const Scene& scene,
                 // The direction from envmap towards the point is stored in
                 // point_on_light.normal.
                 dir_light = -point_on_light.normal;
+                // The pdf and the emission below share the conversion to the envmap's coordinates.
+                envmap_dir = ToEnvmapDirection(*envmap, point_on_light.normal);
                 // If the point on light is occluded, G is 0. So we need to test for occlusion.
                 // To avoid self intersection, we need to set the tnear of the ray
                 // to a small "epsilon" which we define as c_shadow_epsilon as a global constant.
@@ -155,7 +169,8 @@ Spectrum PathTracing(const Scene& scene,
             // Before we proceed, we first compute the probability density p1(v1)
             // The probability density for light sampling to sample our point is
             // just the probability of sampling a light times the probability of sampling a point
-            Real p1 = LightPmf(scene, light_id) * PdfPointOnLight(light, point_on_light, vertex.position, scene);
+            Real p1 = light_sample.pmf * (envmap ? PdfPointOnLight(*envmap, envmap_dir)
+                                                 : PdfPointOnLight(light, point_on_light, vertex.position, scene));
 
             // We don't need to continue the computation if G is 0.
             // Also sometimes there can be some numerical issue such that we generate
@@ -164,7 +179,8 @@ Spectrum PathTracing(const Scene& scene,
                 // Let's compute f (BSDF) next.
                 Vector3 dir_view = -ray.dir;
                 assert(vertex.materialId >= 0);
-                Spectrum f = Eval(mat, dir_view, dir_light, vertex, scene.texturePool);
+                const BSDFEvalRecord bsdf_eval = EvalWithPdf(bsdf, dir_view, dir_light, vertex);
+                Spectrum f                     = bsdf_eval.f;
 
                 // Evaluate the emission
                 // We set the footprint to zero since it is not fully clear how
@@ -172,7 +188,8 @@ Spectrum PathTracing(const Scene& scene,
                 // One way is to use a roughness based heuristics, but we have multi-layered BRDFs.
                 // See "Real-time Shading with Filtered Importance Sampling" from Colbert et al.
                 // for the roughness based heuristics.
-                Spectrum L = Emission(light, -dir_light, Real(0), point_on_light, scene);
+                Spectrum L = envmap ? Emission(*envmap, envmap_dir, Real(0), scene)
+                                    : Emission(light, -dir_light, Real(0), point_on_light, scene);
 
                 // C1 is just a product of all of them!
                 C1 = G * f * L;
@@ -185,7 +202,7 @@ Spectrum PathTracing(const Scene& scene,
                 // Therefore we only need to account for the generation of the vertex v_{i+1}.
 
                 // The probability density for our hemispherical sampling to sample
-                Real p2 = PdfSampleBSDF(mat, dir_view, dir_light, vertex, scene.texturePool);
+                Real p2 = bsdf_eval.pdf;
                 // !!!! IMPORTANT !!!!
                 // In general, p1 and p2 now live in different spaces!!
                 // our BSDF API outputs a probability density in the solid angle measure
@@ -208,11 +225,12 @@ Spectrum PathTracing(const Scene& scene,
 
         // Let's do the hemispherical sampling next.
         Vector3 dir_view = -ray.dir;
-        Vector2 bsdf_rnd_param_uv{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng)};
-        Real bsdf_rnd_param_w = NextPcg32Real<Real>(rng);
-        auto bsdf_sample_ = SampleBSDF(mat, dir_view, vertex, scene.texturePool, bsdf_rnd_param_uv, bsdf_rnd_param_w);
+        Vector2 bsdf_rnd_param_uv = Next2D(sampler);
+        Real bsdf_rnd_param_w     = Next1D(sampler);
+        auto bsdf_sample_         = SampleBSDF(bsdf, dir_view, vertex, bsdf_rnd_param_uv, bsdf_rnd_param_w);
         if (!bsdf_sample_) {
             // BSDF sampling failed. Abort the loop.
+            ++sBSDFSamplingFailures;
             break;
         }
         const BSDFSampleRecord& bsdf_sample = *bsdf_sample_;
@@ -243,10 +261,12 @@ Spectrum PathTracing(const Scene& scene,
             G = 1;
         }
 
-        Spectrum f = Eval(mat, dir_view, dir_bsdf, vertex, scene.texturePool);
-        Real p2    = PdfSampleBSDF(mat, dir_view, dir_bsdf, vertex, scene.texturePool);
+        const BSDFEvalRecord bsdf_eval = EvalWithPdf(bsdf, dir_view, dir_bsdf, vertex);
+        Spectrum f                     = bsdf_eval.f;
+        Real p2                        = bsdf_eval.pdf;
         if (p2 <= 0) {
             // Numerical issue -- we generated some invalid rays.
+            ++sZeroPdfBSDFSamples;
             break;
         }
 
@@ -270,7 +290,8 @@ Spectrum PathTracing(const Scene& scene,
             assert(light_id >= 0);
             const Light& light = scene.lights[light_id];
             PointAndNormal light_point{bsdf_vertex->position, bsdf_vertex->normal};
-            Real p1 = LightPmf(scene, light_id) * PdfPointOnLight(light, light_point, vertex.position, scene);
+            Real p1 = LightPmf(scene, vertex.position, vertex.normal, light_id) *
+                      PdfPointOnLight(light, light_point, vertex.position, scene);
             Real w2 = (p2 * p2) / (p1 * p1 + p2 * p2);
 
             C2       /= p2;
@@ -278,21 +299,15 @@ Spectrum PathTracing(const Scene& scene,
         }
         else if (!bsdf_vertex && HasEnvmap(scene)) {
             // G & f are already computed.
-            const Light& light = GetEnvmap(scene);
-            Spectrum L         = Emission(light,
-                                  -dir_bsdf,        // pointing outwards from light
-                                  ray_diff.spread,
-                                  PointAndNormal{}, // dummy parameter for envmap
-                                  scene);
-            Spectrum C2        = G * f * L;
+            // The emission and the pdf share the conversion of the direction to the envmap's coordinates.
+            const Envmap& envmap      = std::get<Envmap>(GetEnvmap(scene));
+            const EnvmapDirection dir = ToEnvmapDirection(envmap, -dir_bsdf); // pointing outwards from light
+            Spectrum L                = Emission(envmap, dir, ray_diff.spread, scene);
+            Spectrum C2               = G * f * L;
             // Next let's compute p1(v2): the probability of the light source sampling
             // directly drawing the direction bsdf_dir.
-            PointAndNormal light_point{
-              Vector3{0, 0, 0},
-              -dir_bsdf
-            }; // pointing outwards from light
-            Real p1 =
-                LightPmf(scene, scene.envmapLightId) * PdfPointOnLight(light, light_point, vertex.position, scene);
+            Real p1 = LightPmf(scene, vertex.position, vertex.normal, scene.envmapLightId) *
+                      PdfPointOnLight(envmap, dir);
             Real w2 = (p2 * p2) / (p1 * p1 + p2 * p2);
 
             C2       /= p2;
@@ -306,11 +321,15 @@ Spectrum PathTracing(const Scene& scene,
 
         // Update rays/intersection/current_path_throughput/current_pdf
         // Russian roulette heuristics
+        // The roulette number is drawn even when it is not used so that every bounce
+        // consumes the same sampler dimensions.
         Real rr_prob = 1;
+        Real rr_w    = Next1D(sampler);
         if (num_vertices - 1 >= scene.options.rrDepth) {
             rr_prob = Min(Max((1 / eta_scale) * current_path_throughput), Real(0.95));
-            if (NextPcg32Real<Real>(rng) > rr_prob) {
+            if (rr_w > rr_prob) {
                 // Terminate the path
+                ++sRussianRouletteTerminations;
                 break;
             }
         }
@@ -319,6 +338,7 @@ Spectrum PathTracing(const Scene& scene,
         vertex                  = *bsdf_vertex;
         current_path_throughput = current_path_throughput * (G * f) / (p2 * rr_prob);
     }
+    sPathBounces.report(bounces);
     return radiance;
 }
 
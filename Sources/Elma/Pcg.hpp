@@ -44,13 +44,13 @@ inline Pcg32State InitPcg32(uint64_t stream_id = 1, uint64_t seed = 0x31e241f862
     return s;
 }
 
-template<typename T> T NextPcg32Real(Pcg32State& rng)
+template<typename T> inline T NextPcg32Real(Pcg32State& rng)
 {
     return T(0);
 }
 
 // https://github.com/wjakob/pcg32/blob/master/pcg32.h
-template<> float NextPcg32Real(Pcg32State& rng)
+template<> inline float NextPcg32Real(Pcg32State& rng)
 {
     union
     {
@@ -63,7 +63,7 @@ template<> float NextPcg32Real(Pcg32State& rng)
 }
 
 // https://github.com/wjakob/pcg32/blob/master/pcg32.h
-template<> double NextPcg32Real(Pcg32State& rng)
+template<> inline double NextPcg32Real(Pcg32State& rng)
 {
     union
     {
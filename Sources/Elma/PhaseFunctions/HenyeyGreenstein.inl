@@ -28,7 +28,7 @@ std::optional<Vector3> SamplePhaseFunctionOp::operator()(const HenyeyGreenstein&
         Real z   = 1 - 2 * randParam.x;
         Real r   = std::sqrt(std::fmax(Real(0), 1 - z * z));
         Real phi = 2 * kPi * randParam.y;
-        return Vector3{r * cos(phi), r * sin(phi), z};
+        return Vector3{r * std::cos(phi), r * std::sin(phi), z};
     }
     else {
         Real tmp           = (p.g * p.g - 1) / (2 * randParam.x * p.g - (p.g + 1));
@@ -36,7 +36,7 @@ std::optional<Vector3> SamplePhaseFunctionOp::operator()(const HenyeyGreenstein&
         Real sin_elevation = std::sqrt(Max(1 - cos_elevation * cos_elevation, Real(0)));
         Real azimuth       = 2 * kPi * randParam.y;
         elma::Frame frame(dirIn);
-        return ToWorld(frame, Vector3{sin_elevation * cos(azimuth), sin_elevation * sin(azimuth), cos_elevation});
+        return ToWorld(frame, Vector3{sin_elevation * std::cos(azimuth), sin_elevation * std::sin(azimuth), cos_elevation});
     }
 }
 
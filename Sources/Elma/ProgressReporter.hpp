@@ -1,7 +1,7 @@
 #pragma once
 
 #include "Elma.hpp"
-#include <mutex>
+#include <atomic>
 
 namespace elma {
 /// For printing how much work is done for an operation.
@@ -11,34 +11,16 @@ class ProgressReporter
 public:
     ProgressReporter(uint64_t total_work) : totalWork(total_work), workDone(0) { }
 
-    void update(uint64_t num)
-    {
-        std::lock_guard<std::mutex> lock(mutex);
-        workDone        += num;
-        Real work_ratio  = (Real)workDone / (Real)totalWork;
-        //        fprintf(stdout,
-        //                "\r %.2f Percent Done (%llu / %llu)",
-        //                work_ratio * Real(100.0),
-        //                (unsigned long long)work_done,
-        //                (unsigned long long)total_work);
-    }
+    // An atomic add, so that the tiles of a render don't serialize on a lock
+    void update(uint64_t num) { workDone.fetch_add(num, std::memory_order_relaxed); }
 
-    void done()
-    {
-        workDone = totalWork;
-        //        fprintf(stdout,
-        //                "\r %.2f Percent Done (%llu / %llu)\n",
-        //                Real(100.0),
-        //                (unsigned long long)work_done,
-        //                (unsigned long long)total_work);
-    }
+    void done() { workDone.store(totalWork, std::memory_order_relaxed); }
 
-    uint64_t getWorkDone() const { return workDone; }
+    uint64_t getWorkDone() const { return workDone.load(std::memory_order_relaxed); }
 
 private:
     const uint64_t totalWork;
-    uint64_t workDone;
-    std::mutex mutex;
+    std::atomic<uint64_t> workDone;
 };
 
 } // namespace elma
\ No newline at end of file
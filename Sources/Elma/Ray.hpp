@@ -34,6 +34,49 @@ struct RayDifferential
     Real radius = 0, spread = 0; // The units are pixels.
 };
 
+/// Number of rays traced together by IntersectN/OccludedN, matches Embree's widest packet.
+constexpr int kRayBatchSize = 16;
+
+/// A packet of rays in structure-of-arrays layout, so that it maps directly onto
+/// Embree's SIMD packet traversal. Lanes with valid[i] == 0 are skipped.
+struct RayBatch
+{
+    Real orgX[kRayBatchSize], orgY[kRayBatchSize], orgZ[kRayBatchSize];
+    Real dirX[kRayBatchSize], dirY[kRayBatchSize], dirZ[kRayBatchSize];
+    Real tNear[kRayBatchSize], tFar[kRayBatchSize];
+    // Ray differentials, only used by IntersectN.
+    Real radius[kRayBatchSize], spread[kRayBatchSize];
+    int valid[kRayBatchSize] = {};
+};
+
+inline void SetRay(RayBatch& batch, int lane, const Ray& ray, const RayDifferential& ray_diff = RayDifferential{})
+{
+    batch.orgX[lane]   = ray.org.x;
+    batch.orgY[lane]   = ray.org.y;
+    batch.orgZ[lane]   = ray.org.z;
+    batch.dirX[lane]   = ray.dir.x;
+    batch.dirY[lane]   = ray.dir.y;
+    batch.dirZ[lane]   = ray.dir.z;
+    batch.tNear[lane]  = ray.tNear;
+    batch.tFar[lane]   = ray.tFar;
+    batch.radius[lane] = ray_diff.radius;
+    batch.spread[lane] = ray_diff.spread;
+    batch.valid[lane]  = 1;
+}
+
+inline Ray GetRay(const RayBatch& batch, int lane)
+{
+    return Ray{Vector3{batch.orgX[lane], batch.orgY[lane], batch.orgZ[lane]},
+               Vector3{batch.dirX[lane], batch.dirY[lane], batch.dirZ[lane]},
+               batch.tNear[lane],
+               batch.tFar[lane]};
+}
+
+inline RayDifferential GetRayDifferential(const RayBatch& batch, int lane)
+{
+    return RayDifferential{batch.radius[lane], batch.spread[lane]};
+}
+
 /// These functions propagate the ray differential information.
 inline RayDifferential InitRayDifferential(int w, int h)
 {
@@ -4,15 +4,19 @@
 #include "Parallel.hpp"
 #include "PathTracing.hpp"
 #include "VolPathTracing.hpp"
+#include "WavefrontPathTracing.hpp"
 #include "Pcg.hpp"
 #include "ProgressReporter.hpp"
 #include "Scene.hpp"
+#include "Stats.hpp"
 #include "Common/Error.hpp"
 
+#include <algorithm>
+
 namespace elma {
 
 /// Render auxiliary buffers e.g., depth.
-Image3 AuxRender(const Scene& scene)
+Image3 AuxRender(const Scene& scene, const RenderCancel* cancel)
 {
     int w = scene.camera.width, h = scene.camera.height;
     Image3 img(w, h);
@@ -23,6 +27,9 @@ Image3 AuxRender(const Scene& scene)
 
     ParallelFor(
         [&](const Vector2i& tile) {
+            if (IsCancelled(cancel)) {
+                return;
+            }
             int x0 = tile[0] * tile_size;
             int x1 = Min(x0 + tile_size, w);
             int y0 = tile[1] * tile_size;
@@ -53,7 +60,7 @@ Image3 AuxRender(const Scene& scene)
                             const auto& texture = GetTexture(mat);
                             auto* t             = std::get_if<ImageTexture<Spectrum>>(&texture);
                             if (t != nullptr) {
-                                const Mipmap3& mipmap = GetImage3(scene.texturePool, t->texture_id);
+                                const CachedMipmap3& mipmap = GetImage3(scene.texturePool, t->texture_id);
                                 Vector2 uv{Modulo(vertex->uv[0] * t->uScale, Real(1)),
                                            Modulo(vertex->uv[1] * t->vScale, Real(1))};
                                 // ray_diff.radius stores approximatedly dpdx,
@@ -79,7 +86,7 @@ Image3 AuxRender(const Scene& scene)
     return img;
 }
 
-Image3 PathRender(const Scene& scene)
+Image3 PathRender(const Scene& scene, const RenderCancel* cancel)
 {
     int w = scene.camera.width, h = scene.camera.height;
     Image3 img(w, h);
@@ -92,19 +99,23 @@ Image3 PathRender(const Scene& scene)
     ProgressReporter reporter(num_tiles_x * num_tiles_y);
     ParallelFor(
         [&](const Vector2i& tile) {
-            // Use a different rng stream for each thread.
-            const auto idx = tile[1] * num_tiles_x + tile[0];
-            Pcg32State rng = InitPcg32(idx, wyhash64(wyhash64(num_acc) + idx));
-            int x0         = tile[0] * tile_size;
-            int x1         = Min(x0 + tile_size, w);
-            int y0         = tile[1] * tile_size;
-            int y1         = Min(y0 + tile_size, h);
+            if (IsCancelled(cancel)) {
+                return;
+            }
+            // Samples are indexed per pixel, so each tile can have its own sampler.
+            // Accumulated frames continue the sequence where the previous frame stopped.
+            const int spp   = SamplesPerPass(scene.options);
+            Sampler sampler = MakeSampler(scene.options.sampler, w, h, scene.options.samplesPerPixel);
+            int x0          = tile[0] * tile_size;
+            int x1          = Min(x0 + tile_size, w);
+            int y0          = tile[1] * tile_size;
+            int y1          = Min(y0 + tile_size, h);
             for (int y = y0; y < y1; y++) {
                 for (int x = x0; x < x1; x++) {
                     Spectrum radiance = MakeZeroSpectrum();
-                    int spp           = scene.options.samplesPerPixel;
                     for (int s = 0; s < spp; s++) {
-                        radiance += PathTracing(scene, x, y, rng);
+                        StartPixelSample(sampler, Vector2i{x, y}, int64_t(num_acc) * spp + s);
+                        radiance += CountSample(PathTracing(scene, x, y, sampler));
                     }
                     img(x, y) = radiance / Real(spp);
                 }
@@ -116,7 +127,169 @@ Image3 PathRender(const Scene& scene)
     return img;
 }
 
-Image3 VolPathRender(const Scene& scene)
+/// Running statistics of the samples taken at one pixel, used by adaptive sampling.
+struct PixelStatistics
+{
+    Spectrum mean;
+    // Welford's online variance of the luminance
+    Real lumMean;
+    Real lumM2;
+    int count;
+};
+
+inline void AddSample(PixelStatistics& stats, const Spectrum& L)
+{
+    stats.count++;
+    const Real inv_count  = Real(1) / stats.count;
+    stats.mean           += (L - stats.mean) * inv_count;
+    const Real lum        = Luminance(L);
+    const Real delta      = lum - stats.lumMean;
+    stats.lumMean        += delta * inv_count;
+    stats.lumM2          += delta * (lum - stats.lumMean);
+}
+
+/// Standard error of the mean luminance relative to the mean itself.
+inline Real RelativeError(const PixelStatistics& stats)
+{
+    if (stats.count < 2) {
+        return Infinity<Real>();
+    }
+    const Real variance = stats.lumM2 / (stats.count - 1);
+    // Don't chase noise in (nearly) black pixels
+    return std::sqrt(variance / stats.count) / Max(stats.lumMean, Real(1e-3));
+}
+
+/// Path tracing with a total budget of samplesPerPixel * #pixels. Every pixel first gets
+/// adaptiveMinSamples samples; after that, rounds of samples only go to pixels whose relative
+/// error is above adaptiveThreshold, until they converge or the budget runs out.
+Image3 AdaptivePathRender(const Scene& scene, Image1* sample_count, const RenderCancel* cancel)
+{
+    int w = scene.camera.width, h = scene.camera.height;
+
+    constexpr int tile_size = 16;
+    int num_tiles_x         = (w + tile_size - 1) / tile_size;
+    int num_tiles_y         = (h + tile_size - 1) / tile_size;
+    int num_acc             = scene.options.accumulateCount;
+
+    // A single pixel never takes more than this multiple of the average budget.
+    constexpr int max_sample_scale = 8;
+    const int spp                  = scene.options.samplesPerPixel;
+    const int min_spp              = Clamp(scene.options.adaptiveMinSamples, 2, Max(spp, 2));
+    const int max_spp              = Max(spp * max_sample_scale, min_spp);
+    const Real threshold           = scene.options.adaptiveThreshold;
+    const int64_t budget           = int64_t(w) * int64_t(h) * spp;
+
+    // Value-initialized, every pixel starts without samples
+    std::vector<PixelStatistics> pixels(w * h);
+    std::vector<uint8_t> active(w * h, 1);
+    std::vector<int> active_tiles(num_tiles_x * num_tiles_y);
+    for (int idx = 0; idx < num_tiles_x * num_tiles_y; idx++) {
+        active_tiles[idx] = idx;
+    }
+
+    int64_t num_active = int64_t(w) * int64_t(h);
+    int64_t used       = 0;
+    int round_spp      = min_spp;
+    while (true) {
+        ParallelFor(
+            [&](int64_t i) {
+                if (IsCancelled(cancel)) {
+                    return;
+                }
+                // The sample index of a pixel is its running sample count, so later rounds
+                // continue the pixel's sequence.
+                const int idx   = active_tiles[i];
+                Sampler sampler = MakeSampler(scene.options.sampler, w, h, max_spp);
+                int x0          = (idx % num_tiles_x) * tile_size;
+                int x1          = Min(x0 + tile_size, w);
+                int y0          = (idx / num_tiles_x) * tile_size;
+                int y1          = Min(y0 + tile_size, h);
+                for (int y = y0; y < y1; y++) {
+                    for (int x = x0; x < x1; x++) {
+                        if (!active[y * w + x]) {
+                            continue;
+                        }
+                        PixelStatistics& pixel = pixels[y * w + x];
+                        const int n            = Min(round_spp, max_spp - pixel.count);
+                        for (int s = 0; s < n; s++) {
+                            StartPixelSample(sampler, Vector2i{x, y}, int64_t(num_acc) * max_spp + pixel.count);
+                            AddSample(pixel, CountSample(PathTracing(scene, x, y, sampler)));
+                        }
+                    }
+                }
+            },
+            (int64_t)active_tiles.size());
+
+        // Find the pixels that still need samples, and count what was spent (pixels stop at max_spp, so
+        // a round can take less than round_spp from some of them).
+        num_active = 0;
+        used       = 0;
+        for (int i = 0; i < w * h; i++) {
+            const PixelStatistics& pixel = pixels[i];
+            active[i]                    = pixel.count < max_spp && RelativeError(pixel) > threshold;
+            num_active                  += active[i];
+            used                        += pixel.count;
+        }
+
+        const int64_t remaining = budget - used;
+        if (num_active == 0 || remaining <= 0 || IsCancelled(cancel)) {
+            break;
+        }
+        if (remaining < num_active) {
+            // Not a sample left for every unconverged pixel: the last ones go to the noisiest pixels.
+            std::vector<int> candidates;
+            for (int i = 0; i < w * h; i++) {
+                if (active[i]) {
+                    candidates.push_back(i);
+                }
+            }
+            std::nth_element(candidates.begin(),
+                             candidates.begin() + remaining,
+                             candidates.end(),
+                             [&](int a, int b) { return RelativeError(pixels[a]) > RelativeError(pixels[b]); });
+            for (size_t k = remaining; k < candidates.size(); k++) {
+                active[candidates[k]] = 0;
+            }
+            num_active = remaining;
+        }
+
+        // The tiles of the pixels that get the next round
+        active_tiles.clear();
+        for (int idx = 0; idx < num_tiles_x * num_tiles_y; idx++) {
+            int x0           = (idx % num_tiles_x) * tile_size;
+            int x1           = Min(x0 + tile_size, w);
+            int y0           = (idx / num_tiles_x) * tile_size;
+            int y1           = Min(y0 + tile_size, h);
+            bool tile_active = false;
+            for (int y = y0; y < y1 && !tile_active; y++) {
+                for (int x = x0; x < x1 && !tile_active; x++) {
+                    tile_active = active[y * w + x];
+                }
+            }
+            if (tile_active) {
+                active_tiles.push_back(idx);
+            }
+        }
+
+        // Spread what is left over the unconverged pixels, a few samples at a time so that
+        // pixels are re-evaluated before they soak up the whole budget.
+        round_spp = (int)Clamp(remaining / num_active, int64_t(1), int64_t(min_spp));
+    }
+
+    Image3 img(w, h);
+    for (int i = 0; i < w * h; i++) {
+        img(i) = pixels[i].mean;
+    }
+    if (sample_count) {
+        *sample_count = Image1(w, h);
+        for (int i = 0; i < w * h; i++) {
+            (*sample_count)(i) = Real(pixels[i].count);
+        }
+    }
+    return img;
+}
+
+Image3 VolPathRender(const Scene& scene, const RenderCancel* cancel)
 {
     int w = scene.camera.width, h = scene.camera.height;
     Image3 img(w, h);
@@ -124,6 +297,7 @@ Image3 VolPathRender(const Scene& scene)
     constexpr int tile_size = 16;
     int num_tiles_x         = (w + tile_size - 1) / tile_size;
     int num_tiles_y         = (h + tile_size - 1) / tile_size;
+    int num_acc             = scene.options.accumulateCount;
 
     auto f = VolPathTracing;
     if (scene.options.volPathVersion == 1) {
@@ -148,20 +322,23 @@ Image3 VolPathRender(const Scene& scene)
     ProgressReporter reporter(num_tiles_x * num_tiles_y);
     ParallelFor(
         [&](const Vector2i& tile) {
-            // Use a different rng stream for each thread.
-            Pcg32State rng = InitPcg32(tile[1] * num_tiles_x + tile[0]);
-            int x0         = tile[0] * tile_size;
-            int x1         = Min(x0 + tile_size, w);
-            int y0         = tile[1] * tile_size;
-            int y1         = Min(y0 + tile_size, h);
+            if (IsCancelled(cancel)) {
+                return;
+            }
+            const int spp   = SamplesPerPass(scene.options);
+            Sampler sampler = MakeSampler(scene.options.sampler, w, h, scene.options.samplesPerPixel);
+            int x0          = tile[0] * tile_size;
+            int x1          = Min(x0 + tile_size, w);
+            int y0          = tile[1] * tile_size;
+            int y1          = Min(y0 + tile_size, h);
             for (int y = y0; y < y1; y++) {
                 for (int x = x0; x < x1; x++) {
                     Spectrum radiance = MakeZeroSpectrum();
-                    int spp           = scene.options.samplesPerPixel;
                     for (int s = 0; s < spp; s++) {
-                        Spectrum L = f(scene, x, y, rng);
+                        StartPixelSample(sampler, Vector2i{x, y}, int64_t(num_acc) * spp + s);
+                        Spectrum L = CountSample(f(scene, x, y, sampler));
                         if (IsFinite(L)) {
-                            // Hacky: exclude NaNs in the rendering.
+                            // Hacky: exclude NaNs in the rendering (counted in the statistics).
                             radiance += L;
                         }
                     }
@@ -175,19 +352,35 @@ Image3 VolPathRender(const Scene& scene)
     return img;
 }
 
-Image3 Render(const Scene& scene)
+static Image3 RenderImage(const Scene& scene, Image1* sample_count, const RenderCancel* cancel)
 {
+    if (scene.options.integrator == Integrator::Path && scene.options.adaptiveThreshold > 0) {
+        return AdaptivePathRender(scene, sample_count, cancel);
+    }
+
+    if (sample_count) {
+        // Every pixel gets the same number of samples in all other modes.
+        *sample_count = Image1(scene.camera.width, scene.camera.height);
+        std::fill(sample_count->data.begin(), sample_count->data.end(), Real(SamplesPerPass(scene.options)));
+    }
+
     if (scene.options.integrator == Integrator::Depth || scene.options.integrator == Integrator::ShadingNormal ||
         scene.options.integrator == Integrator::MeanCurvature ||
         scene.options.integrator == Integrator::RayDifferential || scene.options.integrator == Integrator::MipmapLevel)
     {
-        return AuxRender(scene);
+        if (sample_count) {
+            std::fill(sample_count->data.begin(), sample_count->data.end(), Real(1));
+        }
+        return AuxRender(scene, cancel);
     }
     else if (scene.options.integrator == Integrator::Path) {
-        return PathRender(scene);
+        return PathRender(scene, cancel);
+    }
+    else if (scene.options.integrator == Integrator::WavefrontPath) {
+        return WavefrontPathRender(scene, cancel);
     }
     else if (scene.options.integrator == Integrator::VolPath) {
-        return VolPathRender(scene);
+        return VolPathRender(scene, cancel);
     }
     else {
         ELMA_UNREACHABLE();
@@ -195,4 +388,16 @@ Image3 Render(const Scene& scene)
     }
 }
 
+Image3 Render(const Scene& scene, Image1* sample_count, const RenderCancel* cancel, StatsReport* stats)
+{
+    if (stats) {
+        ResetStats();
+    }
+    Image3 img = RenderImage(scene, sample_count, cancel);
+    if (stats) {
+        *stats = GetStats();
+    }
+    return img;
+}
+
 } // namespace elma
\ No newline at end of file
@@ -2,11 +2,39 @@
 
 #include "Elma.hpp"
 #include "Image.hpp"
+#include "Spectrum.hpp"
+#include "Stats.hpp"
+#include <atomic>
 #include <memory>
 
 namespace elma {
 struct Scene;
 
-Image3 Render(const Scene& scene);
+/// Raised by another thread to abandon a render: tiles that haven't started yet are skipped,
+/// so the returned image is incomplete and should be thrown away.
+using RenderCancel = std::atomic<bool>;
+
+inline bool IsCancelled(const RenderCancel* cancel)
+{
+    return cancel != nullptr && cancel->load(std::memory_order_relaxed);
+}
+
+ELMA_STAT_RATIO("Render/Non-finite samples", sNonFiniteSamples, sSamples);
+
+/// Counts the NaN and infinite samples of the path tracers.
+inline Spectrum CountSample(const Spectrum& L)
+{
+    ++sSamples;
+    sNonFiniteSamples += !IsFinite(L);
+    return L;
+}
+
+/// Renders the scene. If `sample_count` is given, it receives the number of samples
+/// taken at every pixel (an AOV for auditing adaptive sampling). If `stats` is given, the statistics
+/// (Stats.hpp) are reset before rendering and it receives the ones of the render.
+Image3 Render(const Scene& scene,
+              Image1* sample_count       = nullptr,
+              const RenderCancel* cancel = nullptr,
+              StatsReport* stats         = nullptr);
 
 } // namespace elma
\ No newline at end of file
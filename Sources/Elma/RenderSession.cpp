@@ -0,0 +1,144 @@
+#include "RenderSession.hpp"
+#include "Parallel.hpp"
+#include "Scene.hpp"
+#include "Common/Error.hpp"
+
+namespace elma {
+
+void RenderSession::start()
+{
+    if (thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = false;
+        if (restartRequested) {
+            restartTime = Clock::now();
+        }
+    }
+    thread = std::thread([this] { run(); });
+}
+
+void RenderSession::stop()
+{
+    if (!thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+        cancel        = true;
+    }
+    thread.join();
+}
+
+void RenderSession::restart(SceneEdit edit)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (edit) {
+        pendingEdits.push_back(std::move(edit));
+    }
+    restartRequested       = true;
+    restartTime            = Clock::now();
+    stats.timeToFirstFrame = -1;
+    cancel                 = true;
+}
+
+bool RenderSession::present(Image3f& frame)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!frontIsFresh) {
+        return false;
+    }
+    std::swap(frame, front);
+    frontIsFresh = false;
+    return true;
+}
+
+RenderSessionStats RenderSession::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void RenderSession::run()
+{
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopRequested) {
+                break;
+            }
+            if (restartRequested) {
+                // Nothing renders right now, so the scene can be changed safely
+                for (const SceneEdit& edit : pendingEdits) {
+                    edit(scene);
+                }
+                pendingEdits.clear();
+                scene.options.accumulateCount = 0;
+                accumulated                   = Image3(scene.camera.width, scene.camera.height);
+                stats.passes                  = 0;
+                restartRequested              = false;
+            }
+            // Requests made from here on cancel the pass below
+            cancel = false;
+        }
+
+        const Clock::time_point pass_start = Clock::now();
+        Image3 pass;
+        try {
+            pass = Render(scene, nullptr, &cancel);
+        }
+        catch (const std::exception& e) {
+            LogError(e.what());
+            break;
+        }
+        if (cancel) {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.cancelledPasses++;
+            continue;
+        }
+        scene.options.accumulateCount++;
+        publish(pass, pass_start);
+    }
+}
+
+void RenderSession::publish(const Image3& pass, Clock::time_point pass_start)
+{
+    const int w = accumulated.width, h = accumulated.height;
+    if (back.width != w || back.height != h) {
+        back = Image3f(w, h);
+    }
+
+    // Accumulate and tonemap in one sweep over the pixels
+    const Real inv_count = Real(1) / Real(scene.options.accumulateCount);
+    ParallelFor(
+        [&](int64_t y) {
+            for (int x = 0; x < w; x++) {
+                Vector3& acc  = accumulated(x, int(y));
+                acc          += pass(x, int(y));
+                for (int c = 0; c < 3; c++) {
+                    back(x, int(y))[c] = std::pow(float(Clamp(acc[c] * inv_count, Real(0), Real(1))), 1.f / 2.2f);
+                }
+            }
+        },
+        h, 8);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (restartRequested) {
+        // The pass finished just before a restart, it is already out of date
+        stats.cancelledPasses++;
+        return;
+    }
+    std::swap(front, back);
+    frontIsFresh                = true;
+    const Clock::time_point now = Clock::now();
+    stats.passes++;
+    stats.lastPassTime = std::chrono::duration<Real>(now - pass_start).count();
+    if (stats.timeToFirstFrame < 0) {
+        stats.timeToFirstFrame = std::chrono::duration<Real>(now - restartTime).count();
+    }
+}
+
+} // namespace elma
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Elma.hpp"
+#include "Image.hpp"
+#include "Render.hpp"
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace elma {
+struct Scene;
+
+struct RenderSessionStats
+{
+    int64_t passes;          // passes accumulated since the last (re)start
+    int64_t cancelledPasses; // passes thrown away by restarts and stops, over the lifetime of the session
+    Real timeToFirstFrame;   // seconds from the last (re)start to its first published frame, negative while pending
+    Real lastPassTime;       // seconds spent in the last completed pass
+};
+
+/// Progressive rendering in the background: a driver thread renders one pass after another on the
+/// thread pool and accumulates them. After every pass it publishes the average, gamma corrected for
+/// display, so a viewer never waits for a render and never sees a half written frame.
+/// Frames are exchanged by swapping buffers, nothing is copied.
+///
+/// The scene belongs to the session while it runs. Changes (e.g. moving the camera) go through
+/// restart(), which abandons the current pass and applies them on the driver thread before the
+/// accumulation starts over.
+class RenderSession
+{
+public:
+    using SceneEdit = std::function<void(Scene&)>;
+
+    explicit RenderSession(Scene& scene) : scene(scene) { }
+
+    ~RenderSession() { stop(); }
+
+    RenderSession(const RenderSession&)            = delete;
+    RenderSession& operator=(const RenderSession&) = delete;
+
+    void start();
+
+    /// Cancels the current pass and waits for the driver thread. Accumulated passes are kept,
+    /// start() continues from them.
+    void stop();
+
+    /// Starts the accumulation over, after applying `edit` to the scene.
+    void restart(SceneEdit edit = {});
+
+    /// If a frame was published since the last call, swaps it into `frame` and returns true.
+    /// `frame` is then owned by the caller until the next call.
+    bool present(Image3f& frame);
+
+    RenderSessionStats getStats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void run();
+    void publish(const Image3& pass, Clock::time_point pass_start);
+
+    Scene& scene;
+    std::thread thread;
+    RenderCancel cancel = false;
+
+    // Shared with the driver thread
+    mutable std::mutex mutex;
+    bool stopRequested    = false;
+    bool restartRequested = true;
+    std::vector<SceneEdit> pendingEdits;
+    Image3f front;     // latest published frame
+    bool frontIsFresh = false;
+    RenderSessionStats stats{0, 0, -1, 0};
+    Clock::time_point restartTime;
+
+    // Only touched by the driver thread
+    Image3 accumulated;
+    Image3f back;
+};
+
+} // namespace elma
@@ -0,0 +1,70 @@
+#include "Sampler.hpp"
+#include "LowDiscrepancy.hpp"
+#include "Stats.hpp"
+#include "Common/Error.hpp"
+
+namespace elma {
+
+struct StartPixelSampleOp
+{
+    void operator()(IndependentSampler& sampler) const;
+    void operator()(PaddedSobolSampler& sampler) const;
+    void operator()(ZSobolSampler& sampler) const;
+
+    const Vector2i& pixel;
+    int64_t sampleIndex;
+};
+
+struct Next1DOp
+{
+    Real operator()(IndependentSampler& sampler) const;
+    Real operator()(PaddedSobolSampler& sampler) const;
+    Real operator()(ZSobolSampler& sampler) const;
+};
+
+struct Next2DOp
+{
+    Vector2 operator()(IndependentSampler& sampler) const;
+    Vector2 operator()(PaddedSobolSampler& sampler) const;
+    Vector2 operator()(ZSobolSampler& sampler) const;
+};
+
+ELMA_STAT_COUNTER("Sampler/Pixel samples", sPixelSamples);
+ELMA_STAT_COUNTER("Sampler/Dimensions", sDimensions);
+
+// Implementations of the individual samplers.
+#include "Samplers/Independent.inl"
+#include "Samplers/PaddedSobol.inl"
+#include "Samplers/ZSobol.inl"
+
+Sampler MakeSampler(SamplerType type, int width, int height, int samples_per_pixel, uint64_t seed)
+{
+    samples_per_pixel = Max(samples_per_pixel, 1);
+    switch (type) {
+    case SamplerType::Independent: return IndependentSampler{seed, InitPcg32()};
+    case SamplerType::PaddedSobol: return PaddedSobolSampler{samples_per_pixel, seed, 0, 0, 0};
+    case SamplerType::ZSobol:      return MakeZSobolSampler(width, height, samples_per_pixel, seed);
+    }
+    ELMA_UNREACHABLE();
+    return IndependentSampler{seed, InitPcg32()};
+}
+
+void StartPixelSample(Sampler& sampler, const Vector2i& pixel, int64_t sample_index)
+{
+    ++sPixelSamples;
+    std::visit(StartPixelSampleOp{pixel, sample_index}, sampler);
+}
+
+Real Next1D(Sampler& sampler)
+{
+    ++sDimensions;
+    return std::visit(Next1DOp{}, sampler);
+}
+
+Vector2 Next2D(Sampler& sampler)
+{
+    sDimensions += 2;
+    return std::visit(Next2DOp{}, sampler);
+}
+
+} // namespace elma
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Elma.hpp"
+#include "Pcg.hpp"
+#include "Vector.hpp"
+#include <variant>
+
+namespace elma {
+
+// A sampler hands out the random numbers of one pixel sample as a sequence of dimensions.
+// The integrators always consume dimensions in the same order (pixel position first,
+// then a fixed set per bounce), so that low-discrepancy samplers can stratify each decision
+// of the path separately.
+// Sample indices beyond samplesPerPixel (e.g. when accumulating frames) start a new, independently
+// scrambled pass of the sequence.
+
+enum class SamplerType
+{
+    Independent,
+    PaddedSobol,
+    ZSobol
+};
+
+/// Plain uniform random numbers from a PCG stream per pixel sample.
+struct IndependentSampler
+{
+    uint64_t seed;
+    Pcg32State rng;
+};
+
+/// Owen-scrambled Sobol (0,2)-sequence for every pair of dimensions, with the sample index
+/// shuffled independently per pixel and dimension ("padding").
+struct PaddedSobolSampler
+{
+    int samplesPerPixel;
+    uint64_t seed;
+
+    uint64_t pixelHash;
+    int sampleIndex;
+    int dimension;
+};
+
+/// Owen-scrambled Sobol points laid out over the image along a Z-order curve, so that neighboring
+/// pixels are stratified against each other as well (blue-noise-like error distribution).
+/// "Screen-Space Blue-Noise Diffusion of Monte Carlo Sampling Error via Hierarchical Ordering
+/// of Pixels" (Ahmed and Wonka 2020), implemented as in pbrt-v4.
+struct ZSobolSampler
+{
+    int log2SamplesPerPixel;
+    int numBase4Digits;
+    uint64_t seed;
+
+    uint64_t mortonIndex;
+    uint64_t passSeed;
+    int dimension;
+};
+
+using Sampler = std::variant<IndependentSampler, PaddedSobolSampler, ZSobolSampler>;
+
+Sampler MakeSampler(SamplerType type, int width, int height, int samples_per_pixel, uint64_t seed = 0);
+
+/// Resets the sampler to the first dimension of sample `sample_index` of `pixel`.
+void StartPixelSample(Sampler& sampler, const Vector2i& pixel, int64_t sample_index);
+
+/// Next dimension, in [0, 1).
+Real Next1D(Sampler& sampler);
+
+/// Next two dimensions, in [0, 1)^2.
+Vector2 Next2D(Sampler& sampler);
+
+} // namespace elma
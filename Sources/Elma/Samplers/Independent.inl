@@ -0,0 +1,17 @@
+void StartPixelSampleOp::operator()(IndependentSampler& sampler) const
+{
+    // One stream per pixel, one starting point per sample
+    sampler.rng = InitPcg32(EncodeMorton2(pixel.x, pixel.y), HashCombine(sampler.seed, uint64_t(sampleIndex)));
+}
+
+Real Next1DOp::operator()(IndependentSampler& sampler) const
+{
+    return NextPcg32Real<Real>(sampler.rng);
+}
+
+Vector2 Next2DOp::operator()(IndependentSampler& sampler) const
+{
+    Real x = NextPcg32Real<Real>(sampler.rng);
+    Real y = NextPcg32Real<Real>(sampler.rng);
+    return Vector2{x, y};
+}
@@ -0,0 +1,25 @@
+void StartPixelSampleOp::operator()(PaddedSobolSampler& sampler) const
+{
+    const int64_t pass  = sampleIndex / sampler.samplesPerPixel;
+    sampler.sampleIndex = int(sampleIndex % sampler.samplesPerPixel);
+    sampler.pixelHash   = HashCombine(HashCombine(sampler.seed, uint64_t(pass)), EncodeMorton2(pixel.x, pixel.y));
+    sampler.dimension   = 0;
+}
+
+Real Next1DOp::operator()(PaddedSobolSampler& sampler) const
+{
+    const uint64_t hash  = HashCombine(sampler.pixelHash, uint64_t(sampler.dimension));
+    const uint32_t index = PermutationElement(sampler.sampleIndex, sampler.samplesPerPixel, uint32_t(hash));
+    sampler.dimension++;
+    return FixedPointToReal(FastOwenScramble(SobolSample(index, 0), uint32_t(hash >> 32)));
+}
+
+Vector2 Next2DOp::operator()(PaddedSobolSampler& sampler) const
+{
+    const uint64_t hash  = HashCombine(sampler.pixelHash, uint64_t(sampler.dimension));
+    const uint32_t index = PermutationElement(sampler.sampleIndex, sampler.samplesPerPixel, uint32_t(hash));
+    const uint64_t bits  = MixBits(hash);
+    sampler.dimension   += 2;
+    return Vector2{FixedPointToReal(FastOwenScramble(SobolSample(index, 0), uint32_t(bits))),
+                   FixedPointToReal(FastOwenScramble(SobolSample(index, 1), uint32_t(bits >> 32)))};
+}
@@ -0,0 +1,90 @@
+inline ZSobolSampler MakeZSobolSampler(int width, int height, int samples_per_pixel, uint64_t seed)
+{
+    ZSobolSampler sampler;
+    sampler.log2SamplesPerPixel = Log2Int(RoundUpPow2(uint32_t(samples_per_pixel)));
+    const int log2_resolution   = Log2Int(RoundUpPow2(uint32_t(Max(Max(width, height), 1))));
+    sampler.numBase4Digits      = log2_resolution + (sampler.log2SamplesPerPixel + 1) / 2;
+    sampler.seed                = seed;
+    sampler.mortonIndex         = 0;
+    sampler.passSeed            = seed;
+    sampler.dimension           = 0;
+    return sampler;
+}
+
+/// Index into the Sobol sequence for the current dimension: the base-4 digits of the Morton index
+/// are shuffled with a permutation that depends on the higher digits and the dimension.
+inline uint64_t ZSobolSampleIndex(const ZSobolSampler& sampler)
+{
+    // All permutations of 4 elements
+    static const uint8_t permutations[24][4] = {
+      {0, 1, 2, 3},
+      {0, 1, 3, 2},
+      {0, 2, 1, 3},
+      {0, 2, 3, 1},
+      {0, 3, 1, 2},
+      {0, 3, 2, 1},
+      {1, 0, 2, 3},
+      {1, 0, 3, 2},
+      {1, 2, 0, 3},
+      {1, 2, 3, 0},
+      {1, 3, 0, 2},
+      {1, 3, 2, 0},
+      {2, 0, 1, 3},
+      {2, 0, 3, 1},
+      {2, 1, 0, 3},
+      {2, 1, 3, 0},
+      {2, 3, 0, 1},
+      {2, 3, 1, 0},
+      {3, 0, 1, 2},
+      {3, 0, 2, 1},
+      {3, 1, 0, 2},
+      {3, 1, 2, 0},
+      {3, 2, 0, 1},
+      {3, 2, 1, 0}
+    };
+
+    uint64_t sample_index = 0;
+    // With an odd power of two samples per pixel, the last digit is a base-2 digit
+    const bool pow2_samples = sampler.log2SamplesPerPixel & 1;
+    const int last_digit    = pow2_samples ? 1 : 0;
+    const uint64_t dim_hash = 0x55555555u * uint64_t(sampler.dimension);
+    for (int i = sampler.numBase4Digits - 1; i >= last_digit; --i) {
+        const int digit_shift        = 2 * i - (pow2_samples ? 1 : 0);
+        int digit                    = (sampler.mortonIndex >> digit_shift) & 3;
+        const uint64_t higher_digits = sampler.mortonIndex >> (digit_shift + 2);
+        const int p                  = (MixBits(higher_digits ^ dim_hash) >> 24) % 24;
+        digit                        = permutations[p][digit];
+        sample_index                |= uint64_t(digit) << digit_shift;
+    }
+    if (pow2_samples) {
+        const int digit  = sampler.mortonIndex & 1;
+        sample_index    |= digit ^ (MixBits((sampler.mortonIndex >> 1) ^ dim_hash) & 1);
+    }
+    return sample_index;
+}
+
+void StartPixelSampleOp::operator()(ZSobolSampler& sampler) const
+{
+    const int64_t pass         = sampleIndex >> sampler.log2SamplesPerPixel;
+    const uint64_t local_index = uint64_t(sampleIndex) & ((uint64_t(1) << sampler.log2SamplesPerPixel) - 1);
+    sampler.mortonIndex        = (EncodeMorton2(pixel.x, pixel.y) << sampler.log2SamplesPerPixel) | local_index;
+    sampler.passSeed           = HashCombine(sampler.seed, uint64_t(pass));
+    sampler.dimension          = 0;
+}
+
+Real Next1DOp::operator()(ZSobolSampler& sampler) const
+{
+    const uint64_t index = ZSobolSampleIndex(sampler);
+    const uint64_t hash  = HashCombine(sampler.passSeed, uint64_t(sampler.dimension));
+    sampler.dimension++;
+    return FixedPointToReal(FastOwenScramble(SobolSample(index, 0), uint32_t(hash)));
+}
+
+Vector2 Next2DOp::operator()(ZSobolSampler& sampler) const
+{
+    const uint64_t index = ZSobolSampleIndex(sampler);
+    const uint64_t hash  = HashCombine(sampler.passSeed, uint64_t(sampler.dimension));
+    sampler.dimension   += 2;
+    return Vector2{FixedPointToReal(FastOwenScramble(SobolSample(index, 0), uint32_t(hash))),
+                   FixedPointToReal(FastOwenScramble(SobolSample(index, 1), uint32_t(hash >> 32)))};
+}
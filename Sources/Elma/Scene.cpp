@@ -1,12 +1,14 @@
 #include "Scene.hpp"
+#include "Parallel.hpp"
 #include "TableDist.hpp"
+#include "Timer.hpp"
 
 namespace elma {
 
 Scene::Scene(const RTCDevice& embree_device,
              const Camera& camera,
              const std::vector<Material>& materials,
-             const std::vector<Shape>& shapes,
+             std::vector<Shape> shapes,
              const std::vector<Light>& lights,
              const std::vector<Medium>& media,
              int envmap_light_id,
@@ -16,7 +18,7 @@ Scene::Scene(const RTCDevice& embree_device,
 : embreeDevice(embree_device),
   camera(camera),
   materials(materials),
-  shapes(shapes),
+  shapes(std::move(shapes)),
   lights(lights),
   media(media),
   envmapLightId(envmap_light_id),
@@ -24,15 +26,26 @@ Scene::Scene(const RTCDevice& embree_device,
   options(options),
   outputFilename(output_filename)
 {
+    Timer timer;
+    tick(timer);
+
+    compiledBSDFs.reserve(this->materials.size());
+    for (const Material& material : this->materials) {
+        compiledBSDFs.push_back(CompileBSDF(material, texturePool));
+    }
+
     // Register the geometry to Embree
     embreeScene = rtcNewScene(embree_device);
     // We don't care about build time.
     rtcSetSceneBuildQuality(embreeScene, RTC_BUILD_QUALITY_HIGH);
     rtcSetSceneFlags(embreeScene, RTC_SCENE_FLAG_ROBUST);
+    // Serial, the geometry IDs have to match the shape IDs. Cheap: meshes are shared, not copied.
     for (const Shape& shape : this->shapes) {
         RegisterEmbree(shape, embree_device, embreeScene);
     }
+    buildTimes.registerEmbree = tick(timer);
     rtcCommitScene(embreeScene);
+    buildTimes.commitEmbree = tick(timer);
 
     // Get scene bounding box from Embree
     RTCBounds embree_bounds;
@@ -44,20 +57,25 @@ Scene::Scene(const RTCDevice& embree_device,
     // build shape & light sampling distributions if necessary
     // TODO: const_cast is a bit ugly...
     std::vector<Shape>& mod_shapes = const_cast<std::vector<Shape>&>(this->shapes);
-    for (Shape& shape : mod_shapes) {
-        InitSamplingDist(shape);
-    }
+    ParallelFor([&](int64_t i) { InitSamplingDist(mod_shapes[i]); }, mod_shapes.size());
+    buildTimes.shapeSampling       = tick(timer);
     std::vector<Light>& mod_lights = const_cast<std::vector<Light>&>(this->lights);
-    for (Light& light : mod_lights) {
-        InitSamplingDist(light, *this);
-    }
+    ParallelFor([&](int64_t i) { InitSamplingDist(mod_lights[i], *this); }, mod_lights.size());
+    buildTimes.lightSampling = tick(timer);
 
-    // build a sampling distributino for all the lights
+    // build a sampling distributino for all the lights (area light powers need the shape areas from above)
     std::vector<Real> power(this->lights.size());
-    for (int i = 0; i < (int)this->lights.size(); i++) {
-        power[i] = LightPower(this->lights[i], *this);
-    }
-    lightDist = MakeTableDist1d(power);
+    ParallelFor([&](int64_t i) { power[i] = LightPower(this->lights[i], *this); }, power.size());
+    lightDist             = MakeTableDist1d(power, TableDistMethod::Alias);
+    buildTimes.lightPower = tick(timer);
+
+    // and the light BVH, without the lights that emit nothing
+    std::vector<std::optional<LightBounds>> light_bounds(this->lights.size());
+    ParallelFor(
+        [&](int64_t i) { light_bounds[i] = power[i] > 0 ? GetLightBounds(this->lights[i], *this) : LightBounds{}; },
+        light_bounds.size());
+    lightBvh            = MakeLightBVH(light_bounds);
+    buildTimes.lightBvh = tick(timer);
 }
 
 Scene::~Scene()
@@ -77,4 +95,21 @@ Real LightPmf(const Scene& scene, int light_id)
     return Pmf(scene.lightDist, light_id);
 }
 
+LightSampleRecord SampleLight(const Scene& scene, const Vector3& ref_point, const Vector3& normal, Real u)
+{
+    if (scene.options.lightSampler == LightSamplerType::Power) {
+        const int light_id = SampleLight(scene, u);
+        return {light_id, LightPmf(scene, light_id)};
+    }
+    return Sample(scene.lightBvh, ref_point, normal, u);
+}
+
+Real LightPmf(const Scene& scene, const Vector3& ref_point, const Vector3& normal, int light_id)
+{
+    if (scene.options.lightSampler == LightSamplerType::Power) {
+        return LightPmf(scene, light_id);
+    }
+    return Pmf(scene.lightBvh, ref_point, normal, light_id);
+}
+
 } // namespace elma
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "Light.hpp"
 #include "Material.hpp"
 #include "Medium.hpp"
+#include "Sampler.hpp"
 #include "Shape.hpp"
 #include "Volume.hpp"
 
@@ -20,20 +21,52 @@ enum class Integrator
     RayDifferential, // visualize radius & spread
     MipmapLevel,
     Path,
+    WavefrontPath,
     VolPath
 };
 
+/// How next event estimation picks a light
+enum class LightSamplerType
+{
+    Power, // proportional to the light power, the same for every shading point
+    BVH    // through the light BVH, favoring the lights close to the shading point and facing it
+};
+
 struct RenderOptions
 {
     Integrator integrator = Integrator::Path;
     int samplesPerPixel   = 4;
+    SamplerType sampler   = SamplerType::Independent;
     int accumulateCount   = 0;
+    // When > 0, a render takes only this many of the samplesPerPixel samples of every pixel, the
+    // accumulateCount-th group of them, so that passes add up to the same image as a single render
+    // (progressive rendering with a time budget). 0 takes all of them.
+    int samplesPerPass    = 0;
     int maxDepth          = -1;
     int rrDepth           = 5;
     int volPathVersion    = 0;
     int maxNullCollisions = 1'000;
+    // Adaptive sampling for the path integrator, disabled when the threshold is 0.
+    // A pixel stops once the relative standard error of its mean luminance drops below the threshold,
+    // and samplesPerPixel becomes the average budget that is shared among the unconverged pixels.
+    Real adaptiveThreshold = 0;
+    int adaptiveMinSamples = 8;
+    // Memory budget of the texture cache in bytes, "textureCacheSize" in megabytes in the scene file.
+    int64_t textureCacheBudget = kDefaultTextureCacheBudget;
+    // Texel order within the tiles of the texture cache,
+    // "textureTileLayout" ("rowMajor" or "morton") in the scene file.
+    TileLayout textureTileLayout = TileLayout::RowMajor;
+    // Light selection of the path integrators, "lightSampler" ("power" or "bvh") in the scene file.
+    // The light BVH is opt-in until renders of real scenes show it ahead at equal time.
+    LightSamplerType lightSampler = LightSamplerType::Power;
 };
 
+/// Samples per pixel taken by one render.
+inline int SamplesPerPass(const RenderOptions& options)
+{
+    return options.samplesPerPass > 0 ? options.samplesPerPass : options.samplesPerPixel;
+}
+
 /// Bounding sphere
 struct BSphere
 {
@@ -41,6 +74,19 @@ struct BSphere
     Vector3 center;
 };
 
+/// Seconds spent in each phase of building a scene, to see where startup goes.
+struct SceneBuildTimes
+{
+    Real parse          = 0; // the XML walk: materials, textures, shape groups (without their mesh files)
+    Real loadMeshes     = 0; // reading and preparing obj/ply/serialized files, in parallel
+    Real registerEmbree = 0;
+    Real commitEmbree   = 0; // the BVH build, parallelized by Embree itself
+    Real shapeSampling  = 0; // per shape sampling distributions, in parallel
+    Real lightSampling  = 0; // per light sampling distributions (e.g. the envmap luminance scan), in parallel
+    Real lightPower     = 0;
+    Real lightBvh       = 0;
+};
+
 /// A "Scene" contains the camera, materials, geometry (shapes), lights,
 /// and also the rendering options such as number of samples per pixel or
 /// the parameters of our renderer.
@@ -51,7 +97,7 @@ struct Scene
     Scene(const RTCDevice& embree_device,
           const Camera& camera,
           const std::vector<Material>& materials,
-          const std::vector<Shape>& shapes,
+          std::vector<Shape> shapes,
           const std::vector<Light>& lights,
           const std::vector<Medium>& media,
           int envmap_light_id, /* -1 if the scene has no envmap */
@@ -67,11 +113,14 @@ struct Scene
     // We decide to maintain a copy of the scene here.
     // This allows us to manage the memory of the scene ourselves and decouple
     // from the scene parser, but it's obviously less efficient.
+    // The shapes are moved in rather than copied: Embree reads the triangle meshes in place.
     Camera camera;
     // For now we use stl vectors to store scene content.
     // This wouldn't work if we want to extend this to run on GPUs.
     // If we want to port this to GPUs later, we need to maintain a thrust vector or something similar.
     const std::vector<Material> materials;
+    // The closures of the materials with constant textures, prepared once here (see CompileBSDF())
+    std::vector<std::optional<BSDFClosure>> compiledBSDFs;
     const std::vector<Shape> shapes;
     const std::vector<Light> lights;
     const std::vector<Medium> media;
@@ -86,6 +135,9 @@ struct Scene
 
     // For sampling lights
     TableDist1D lightDist;
+    LightBVH lightBvh;
+
+    SceneBuildTimes buildTimes;
 };
 
 /// Sample a light source from the scene given a random number u \in [0, 1]
@@ -94,6 +146,20 @@ int SampleLight(const Scene& scene, Real u);
 /// The probability mass function of the sampling procedure above.
 Real LightPmf(const Scene& scene, int light_id);
 
+/// Sample a light source for the shading point ref_point with surface normal normal (zero in media),
+/// as scene.options.lightSampler says. The light id is -1 if no light can illuminate the point.
+LightSampleRecord SampleLight(const Scene& scene, const Vector3& ref_point, const Vector3& normal, Real u);
+
+/// The probability mass function of the sampling procedure above.
+Real LightPmf(const Scene& scene, const Vector3& ref_point, const Vector3& normal, int light_id);
+
+/// The BSDF of the material hit at the vertex, compiled with the scene when its textures are constant.
+inline BSDFClosure PrepareBSDF(const Scene& scene, const PathVertex& vertex)
+{
+    const std::optional<BSDFClosure>& compiled = scene.compiledBSDFs[vertex.materialId];
+    return compiled ? *compiled : PrepareBSDF(scene.materials[vertex.materialId], vertex, scene.texturePool);
+}
+
 inline bool HasEnvmap(const Scene& scene)
 {
     return scene.envmapLightId != -1;
@@ -105,14 +171,19 @@ inline const Light& GetEnvmap(const Scene& scene)
     return scene.lights[scene.envmapLightId];
 }
 
+// Ray offsets relative to the scene size. Single precision positions carry about 1e-7 relative
+// error (Embree works in float either way), so the float build needs a larger margin.
+constexpr Real kRelativeRayEpsilon = std::is_same_v<Real, float> ? Real(1e-4) : Real(1e-5);
+constexpr Real kMaxRayEpsilon      = std::is_same_v<Real, float> ? Real(0.05) : Real(0.01);
+
 inline Real GetShadowEpsilon(const Scene& scene)
 {
-    return Min(scene.bounds.radius * Real(1e-5), Real(0.01));
+    return Min(scene.bounds.radius * kRelativeRayEpsilon, kMaxRayEpsilon);
 }
 
 inline Real GetIntersectionEpsilon(const Scene& scene)
 {
-    return Min(scene.bounds.radius * Real(1e-5), Real(0.01));
+    return Min(scene.bounds.radius * kRelativeRayEpsilon, kMaxRayEpsilon);
 }
 
 } // namespace elma
\ No newline at end of file
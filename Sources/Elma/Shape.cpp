@@ -2,6 +2,8 @@
 #include "Intersection.hpp"
 #include "PointAndNormal.hpp"
 #include "Ray.hpp"
+#include "Transform.hpp"
+#include "Common/Error.hpp"
 #include <embree4/rtcore.h>
 #include <variant>
 
@@ -11,6 +13,7 @@ struct RegisterEmbreeOp
 {
     uint32_t operator()(const Sphere& sphere) const;
     uint32_t operator()(const TriangleMesh& mesh) const;
+    uint32_t operator()(const Instance& instance) const;
 
     const RTCDevice& device;
     const RTCScene& scene;
@@ -20,6 +23,7 @@ struct SamplePointOnShapeOp
 {
     PointAndNormal operator()(const Sphere& sphere) const;
     PointAndNormal operator()(const TriangleMesh& mesh) const;
+    PointAndNormal operator()(const Instance& instance) const;
 
     const Vector3& ref_point;
     const Vector2& uv; // for selecting a point on a 2D surface
@@ -30,12 +34,14 @@ struct SurfaceAreaOp
 {
     Real operator()(const Sphere& sphere) const;
     Real operator()(const TriangleMesh& mesh) const;
+    Real operator()(const Instance& instance) const;
 };
 
 struct PdfPointOnShapeOp
 {
     Real operator()(const Sphere& sphere) const;
     Real operator()(const TriangleMesh& mesh) const;
+    Real operator()(const Instance& instance) const;
 
     const PointAndNormal& pointOnShape;
     const Vector3& refPoint;
@@ -45,18 +51,42 @@ struct InitSamplingDistOp
 {
     void operator()(Sphere& sphere) const;
     void operator()(TriangleMesh& mesh) const;
+    void operator()(Instance& instance) const;
 };
 
 struct ComputeShadingInfoOp
 {
     ShadingInfo operator()(const Sphere& sphere) const;
     ShadingInfo operator()(const TriangleMesh& mesh) const;
+    ShadingInfo operator()(const Instance& instance) const;
 
     const PathVertex& vertex;
 };
 
 #include "Shapes/Sphere.inl"
 #include "Shapes/TriangleMesh.inl"
+#include "Shapes/Instance.inl"
+
+ShapeGroup::ShapeGroup(const RTCDevice& device, std::vector<Shape>&& group_shapes) : shapes(std::move(group_shapes))
+{
+    for (const Shape& shape : shapes) {
+        if (std::holds_alternative<Instance>(shape)) {
+            ELMA_THROW("形状组(shapegroup)中不能包含实例(instance)。");
+        }
+    }
+    embreeScene = rtcNewScene(device);
+    rtcSetSceneBuildQuality(embreeScene, RTC_BUILD_QUALITY_HIGH);
+    rtcSetSceneFlags(embreeScene, RTC_SCENE_FLAG_ROBUST);
+    for (const Shape& shape : shapes) {
+        RegisterEmbree(shape, device, embreeScene);
+    }
+    rtcCommitScene(embreeScene);
+}
+
+ShapeGroup::~ShapeGroup()
+{
+    rtcReleaseScene(embreeScene);
+}
 
 uint32_t RegisterEmbree(const Shape& shape, const RTCDevice& device, const RTCScene& scene)
 {
@@ -68,24 +98,24 @@ PointAndNormal SamplePointOnShape(const Shape& shape, const Vector3& ref_point,
     return std::visit(SamplePointOnShapeOp{ref_point, uv, w}, shape);
 }
 
-Real PdfPointOnShape(const std::variant<Sphere, TriangleMesh>& shape,
+Real PdfPointOnShape(const Shape& shape,
                      const PointAndNormal& point_on_shape,
                      const Vector3& ref_point)
 {
     return std::visit(PdfPointOnShapeOp{point_on_shape, ref_point}, shape);
 }
 
-Real SurfaceArea(const std::variant<Sphere, TriangleMesh>& shape)
+Real SurfaceArea(const Shape& shape)
 {
     return std::visit(SurfaceAreaOp{}, shape);
 }
 
-void InitSamplingDist(std::variant<Sphere, TriangleMesh>& shape)
+void InitSamplingDist(Shape& shape)
 {
     return std::visit(InitSamplingDistOp{}, shape);
 }
 
-ShadingInfo ComputeShadingInfo(const std::variant<Sphere, TriangleMesh>& shape, const PathVertex& vertex)
+ShadingInfo ComputeShadingInfo(const Shape& shape, const PathVertex& vertex)
 {
     return std::visit(ComputeShadingInfoOp{vertex}, shape);
 }
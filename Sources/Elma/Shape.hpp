@@ -2,9 +2,12 @@
 
 #include "Elma.hpp"
 #include "Frame.hpp"
+#include "Matrix.hpp"
 #include "TableDist.hpp"
 #include "Vector.hpp"
 #include <embree4/rtcore.h>
+#include <memory>
+#include <new>
 #include <variant>
 #include <vector>
 
@@ -40,10 +43,32 @@ struct Sphere : public ShapeBase
     Real radius;
 };
 
+/// Allocates 16 extra bytes after the last element. Embree reads vertices with 16 byte loads, so a
+/// float3 vertex array has to be padded before Embree can use it in place.
+template<typename T> struct EmbreePaddedAllocator
+{
+    using value_type = T;
+
+    EmbreePaddedAllocator() = default;
+
+    template<typename U> EmbreePaddedAllocator(const EmbreePaddedAllocator<U>&) { }
+
+    T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T) + 16, std::align_val_t{16})); }
+
+    void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t{16}); }
+
+    template<typename U> bool operator==(const EmbreePaddedAllocator<U>&) const { return true; }
+};
+
+/// Single precision vertex positions, shared with Embree instead of copied into its own buffers.
+using VertexPositions = std::vector<Vector3f, EmbreePaddedAllocator<Vector3f>>;
+
 struct TriangleMesh : public ShapeBase
 {
     /// TODO: make these portable to GPUs
-    std::vector<Vector3> positions;
+    /// Positions and indices are the Embree vertex and index buffers: they must not be resized
+    /// once the mesh is registered.
+    VertexPositions positions;
     std::vector<Vector3i> indices;
     std::vector<Vector3> normals;
     std::vector<Vector2> uvs;
@@ -53,9 +78,34 @@ struct TriangleMesh : public ShapeBase
     TableDist1D triangleSampler;
 };
 
+struct ShapeGroup;
+
+/// A placement of a shape group (Mitsuba's shapegroup/instance). The shapes of the group are stored
+/// once, in object space, and live in their own Embree scene that every instance of the group refers to
+/// through an RTC_GEOMETRY_TYPE_INSTANCE geometry, so repeated assets cost one transform per copy.
+/// Materials and media come from the shapes of the group. Instances can't be area lights.
+struct Instance : public ShapeBase
+{
+    std::shared_ptr<const ShapeGroup> group;
+    Matrix4x4 toWorld;
+    Matrix4x4 toLocal;
+};
+
 // To add more shapes, first create a struct for the shape, add it to the variant below,
 // then implement all the relevant functions below.
-using Shape = std::variant<Sphere, TriangleMesh>;
+using Shape = std::variant<Sphere, TriangleMesh, Instance>;
+
+/// Shapes shared by instances, with the Embree scene built over them.
+struct ShapeGroup
+{
+    ShapeGroup(const RTCDevice& device, std::vector<Shape>&& shapes);
+    ~ShapeGroup();
+    ShapeGroup(const ShapeGroup&)            = delete;
+    ShapeGroup& operator=(const ShapeGroup&) = delete;
+
+    const std::vector<Shape> shapes; // no instances, the Embree geometry ID is the index
+    RTCScene embreeScene;
+};
 
 /// Add the shape to an Embree scene.
 uint32_t RegisterEmbree(const Shape& shape, const RTCDevice& device, const RTCScene& scene);
@@ -0,0 +1,64 @@
+uint32_t RegisterEmbreeOp::operator()(const Instance& instance) const
+{
+    RTCGeometry rtc_geom = rtcNewGeometry(device, RTC_GEOMETRY_TYPE_INSTANCE);
+    rtcSetGeometryInstancedScene(rtc_geom, instance.group->embreeScene);
+    float xform[16];
+    for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++) {
+            xform[c * 4 + r] = (float)instance.toWorld(r, c);
+        }
+    }
+    rtcSetGeometryTransform(rtc_geom, 0, RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR, xform);
+    rtcCommitGeometry(rtc_geom);
+    uint32_t geomID = rtcAttachGeometry(scene, rtc_geom);
+    rtcReleaseGeometry(rtc_geom);
+    return geomID;
+}
+
+// Instances are never area lights (the parser rejects emitters inside shape groups),
+// so they are not sampled.
+
+PointAndNormal SamplePointOnShapeOp::operator()(const Instance&) const
+{
+    ELMA_UNREACHABLE();
+}
+
+Real SurfaceAreaOp::operator()(const Instance&) const
+{
+    ELMA_UNREACHABLE();
+}
+
+Real PdfPointOnShapeOp::operator()(const Instance&) const
+{
+    ELMA_UNREACHABLE();
+}
+
+void InitSamplingDistOp::operator()(Instance&) const { }
+
+/// How much the instance transform stretches lengths on the surface at a hit, the geometric mean of the
+/// stretch along the two (object space) tangents of the shading frame. A stretch along the normal doesn't
+/// change the surface, so non-uniform scales are handled, up to the shear between the tangents.
+static Real InstanceScale(const Instance& instance, const Frame& local_frame)
+{
+    return std::sqrt(Length(TransformVector(instance.toWorld, local_frame.x)) *
+                     Length(TransformVector(instance.toWorld, local_frame.y)));
+}
+
+ShadingInfo ComputeShadingInfoOp::operator()(const Instance& instance) const
+{
+    // Shade the hit in the object space of the group, then bring the frame to world space
+    assert(vertex.groupShapeId >= 0 && vertex.groupShapeId < (int)instance.group->shapes.size());
+    PathVertex local = vertex;
+    local.position   = TransformPoint(instance.toLocal, vertex.position);
+    local.normal     = Normalize(TransformNormal(instance.toWorld, vertex.normal));
+    ShadingInfo info = ComputeShadingInfo(instance.group->shapes[vertex.groupShapeId], local);
+
+    Vector3 n       = Normalize(TransformNormal(instance.toLocal, info.shadingFrame.n));
+    Vector3 tangent = TransformVector(instance.toWorld, info.shadingFrame.x);
+    tangent         = Normalize(tangent - n * Dot(n, tangent));
+    Frame shading_frame(tangent, Cross(n, tangent), n);
+
+    // Curvature and dp/duv are lengths in object space
+    const Real scale = InstanceScale(instance, info.shadingFrame);
+    return ShadingInfo{info.uv, shading_frame, info.meanCurvature / scale, info.invUvSize * scale};
+}
@@ -2,19 +2,14 @@ uint32_t RegisterEmbreeOp::operator()(const TriangleMesh &mesh) const {
     RTCGeometry rtc_geom = rtcNewGeometry(device, RTC_GEOMETRY_TYPE_TRIANGLE);
     // A geomID is the ID associated with the shape inside Embree.
     uint32_t geomID = rtcAttachGeometry(scene, rtc_geom);
-    Vector4f *positions = (Vector4f*)rtcSetNewGeometryBuffer(
+    // Embree reads the mesh in place, the positions are padded for its 16 byte loads
+    static_assert(sizeof(Vector3f) == 3 * sizeof(float) && sizeof(Vector3i) == 3 * sizeof(int));
+    rtcSetSharedGeometryBuffer(
         rtc_geom, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3,
-        sizeof(Vector4f), mesh.positions.size());
-    Vector3i *triangles = (Vector3i*)rtcSetNewGeometryBuffer(
+        mesh.positions.data(), 0, sizeof(Vector3f), mesh.positions.size());
+    rtcSetSharedGeometryBuffer(
         rtc_geom, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3,
-        sizeof(Vector3i), mesh.indices.size());
-    for (int i = 0; i < (int)mesh.positions.size(); i++) {
-        Vector3 position = mesh.positions[i];
-        positions[i] = Vector4f{(float)position[0], (float)position[1], (float)position[2], 0.f};
-    }
-    for (int i = 0; i < (int)mesh.indices.size(); i++) {
-        triangles[i] = mesh.indices[i];
-    }
+        mesh.indices.data(), 0, sizeof(Vector3i), mesh.indices.size());
     rtcSetGeometryVertexAttributeCount(rtc_geom, 1);
     rtcCommitGeometry(rtc_geom);
     rtcReleaseGeometry(rtc_geom);
@@ -57,6 +52,10 @@ Real PdfPointOnShapeOp::operator()(const TriangleMesh &mesh) const {
 }
 
 void InitSamplingDistOp::operator()(TriangleMesh &mesh) const {
+    if (!mesh.indices.empty() && mesh.triangleSampler.pmf.size() == mesh.indices.size()) {
+        // Already built when the mesh was loaded (or read from the mesh cache)
+        return;
+    }
     std::vector<Real> tri_areas(mesh.indices.size(), Real(0));
     Real total_area = 0;
     for (int tri_id = 0; tri_id < (int)mesh.indices.size(); tri_id++) {
@@ -69,7 +68,7 @@ void InitSamplingDistOp::operator()(TriangleMesh &mesh) const {
         tri_areas[tri_id] = Length(Cross(e1, e2)) / 2;
         total_area += tri_areas[tri_id];
     }
-    mesh.triangleSampler  = MakeTableDist1d(tri_areas);
+    mesh.triangleSampler  = MakeTableDist1d(tri_areas, TableDistMethod::Alias);
     mesh.totalArea        = total_area;
 }
 
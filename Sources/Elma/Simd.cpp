@@ -0,0 +1,132 @@
+#include "Simd.hpp"
+
+namespace elma {
+
+static_assert(sizeof(Vector3) == 3 * sizeof(Real), "the batched kernels read Vector3 arrays as packed Reals");
+
+namespace {
+
+/// Four consecutive Vector3 (12 Reals) to their x, y and z components
+inline void LoadTransposed(const Vector3* p, Real4& x, Real4& y, Real4& z)
+{
+#if defined(ELMA_SIMD_SSE)
+    // m0 = x0 y0 z0 x1, m1 = y1 z1 x2 y2, m2 = z2 x3 y3 z3
+    const __m128 m0 = _mm_loadu_ps(&p[0].x);
+    const __m128 m1 = _mm_loadu_ps(&p[1].y);
+    const __m128 m2 = _mm_loadu_ps(&p[2].z);
+    x.v = _mm_shuffle_ps(m0, _mm_shuffle_ps(m1, m2, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+    y.v = _mm_shuffle_ps(_mm_shuffle_ps(m0, m1, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(m1, m2, _MM_SHUFFLE(2, 2, 3, 3)),
+                         _MM_SHUFFLE(2, 0, 2, 0));
+    z.v = _mm_shuffle_ps(_mm_shuffle_ps(m0, m1, _MM_SHUFFLE(1, 1, 2, 2)), m2, _MM_SHUFFLE(3, 0, 2, 0));
+#elif defined(ELMA_SIMD_AVX)
+    // m0 = x0 y0 z0 x1, m1 = y1 z1 x2 y2, m2 = z2 x3 y3 z3
+    const __m256d m0 = _mm256_loadu_pd(&p[0].x);
+    const __m256d m1 = _mm256_loadu_pd(&p[1].y);
+    const __m256d m2 = _mm256_loadu_pd(&p[2].z);
+    // a = x0 y0 | x2 y2, b = z0 x1 | z2 x3, c = y1 z1 | y3 z3
+    const __m256d a = _mm256_permute2f128_pd(m0, m1, 0x30);
+    const __m256d b = _mm256_permute2f128_pd(m0, m2, 0x21);
+    const __m256d c = _mm256_permute2f128_pd(m1, m2, 0x30);
+    x.v             = _mm256_blend_pd(a, b, 0b1010);
+    y.v             = _mm256_shuffle_pd(a, c, 0b0101);
+    z.v             = _mm256_blend_pd(b, c, 0b1010);
+#else
+    x = MakeReal4(p[0].x, p[1].x, p[2].x, p[3].x);
+    y = MakeReal4(p[0].y, p[1].y, p[2].y, p[3].y);
+    z = MakeReal4(p[0].z, p[1].z, p[2].z, p[3].z);
+#endif
+}
+
+/// The inverse of LoadTransposed
+inline void StoreTransposed(const Real4& x, const Real4& y, const Real4& z, Vector3* p)
+{
+#if defined(ELMA_SIMD_SSE)
+    const __m128 m0 = _mm_shuffle_ps(_mm_shuffle_ps(x.v, y.v, _MM_SHUFFLE(0, 0, 0, 0)),
+                                     _mm_shuffle_ps(z.v, x.v, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+    const __m128 m1 = _mm_shuffle_ps(_mm_shuffle_ps(y.v, z.v, _MM_SHUFFLE(1, 1, 1, 1)),
+                                     _mm_shuffle_ps(x.v, y.v, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+    const __m128 m2 = _mm_shuffle_ps(_mm_shuffle_ps(z.v, x.v, _MM_SHUFFLE(3, 3, 2, 2)),
+                                     _mm_shuffle_ps(y.v, z.v, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+    _mm_storeu_ps(&p[0].x, m0);
+    _mm_storeu_ps(&p[1].y, m1);
+    _mm_storeu_ps(&p[2].z, m2);
+#elif defined(ELMA_SIMD_AVX)
+    const __m256d a = _mm256_shuffle_pd(x.v, y.v, 0b0000);
+    const __m256d b = _mm256_blend_pd(z.v, x.v, 0b1010);
+    const __m256d c = _mm256_shuffle_pd(y.v, z.v, 0b1111);
+    _mm256_storeu_pd(&p[0].x, _mm256_permute2f128_pd(a, b, 0x20));
+    _mm256_storeu_pd(&p[1].y, _mm256_permute2f128_pd(c, a, 0x30));
+    _mm256_storeu_pd(&p[2].z, _mm256_permute2f128_pd(b, c, 0x31));
+#else
+    alignas(4 * sizeof(Real)) Real xs[4], ys[4], zs[4];
+    Store(x, xs);
+    Store(y, ys);
+    Store(z, zs);
+    for (int i = 0; i < 4; i++) {
+        p[i] = Vector3{xs[i], ys[i], zs[i]};
+    }
+#endif
+}
+
+} // namespace
+
+void BatchDot(const Vector3* a, const Vector3* b, Real* out, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        Real4 ax, ay, az, bx, by, bz;
+        LoadTransposed(a + i, ax, ay, az);
+        LoadTransposed(b + i, bx, by, bz);
+        Store(MulAdd(az, bz, MulAdd(ay, by, ax * bx)), out + i);
+    }
+    for (; i < count; i++) {
+        out[i] = Dot(a[i], b[i]);
+    }
+}
+
+void BatchCross(const Vector3* a, const Vector3* b, Vector3* out, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        Real4 ax, ay, az, bx, by, bz;
+        LoadTransposed(a + i, ax, ay, az);
+        LoadTransposed(b + i, bx, by, bz);
+        StoreTransposed(ay * bz - az * by, az * bx - ax * bz, ax * by - ay * bx, out + i);
+    }
+    for (; i < count; i++) {
+        out[i] = Cross(a[i], b[i]);
+    }
+}
+
+void BatchNormalize(const Vector3* v, Vector3* out, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        Real4 x, y, z;
+        LoadTransposed(v + i, x, y, z);
+        // Zero vectors stay zero, like Normalize(): 0 times a large finite reciprocal
+        const Real4 l   = Max(Sqrt(MulAdd(z, z, MulAdd(y, y, x * x))), MakeReal4(std::numeric_limits<Real>::min()));
+        const Real4 inv = MakeReal4(1) / l;
+        StoreTransposed(x * inv, y * inv, z * inv, out + i);
+    }
+    for (; i < count; i++) {
+        out[i] = Normalize(v[i]);
+    }
+}
+
+void BatchExp(const Spectrum* s, Spectrum* out, int count)
+{
+    // Spectra are three Reals each: the array is 3 * count Reals exponentiated four at a time
+    const Real* in = &s[0].x;
+    Real* o        = &out[0].x;
+    const int n    = 3 * count;
+    int i          = 0;
+    for (; i + 4 <= n; i += 4) {
+        Store(Exp(LoadReal4(in + i)), o + i);
+    }
+    for (; i < n; i++) {
+        o[i] = std::exp(in[i]);
+    }
+}
+
+} // namespace elma
@@ -0,0 +1,368 @@
+#pragma once
+
+#include "Elma.hpp"
+#include "Spectrum.hpp"
+#include "Vector.hpp"
+
+// Four lanes of Real in one SIMD register, used two ways:
+//  - PackedVector3 / PackedSpectrum: one Vector3 padded to four lanes (the fourth lane is unspecified),
+//    for chains of operations on values that stay packed in between.
+//  - Batched kernels: four Vector3 at a time transposed into x, y and z registers (see Simd.cpp).
+// Vector3 itself stays three Reals: its layout is shared with Embree's vertex buffers and the mesh cache.
+//
+// The backend is chosen at compile time. With ELMA_SIMD (the CMake option of the same name) float builds
+// use SSE4.1 and double builds AVX2, otherwise (or if the compiler doesn't target those) a plain array of
+// four Reals, which computes exactly like the scalar Vector3 code.
+#if defined(ELMA_SIMD) && defined(ELMA_REAL_FLOAT) && (defined(__SSE4_1__) || defined(__AVX__))
+#define ELMA_SIMD_SSE
+#elif defined(ELMA_SIMD) && !defined(ELMA_REAL_FLOAT) && defined(__AVX2__)
+#define ELMA_SIMD_AVX
+#endif
+
+#if defined(ELMA_SIMD_SSE) || defined(ELMA_SIMD_AVX)
+#include <immintrin.h>
+#if defined(__FMA__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define ELMA_SIMD_FMA
+#endif
+#endif
+
+namespace elma {
+
+#if defined(ELMA_SIMD_SSE)
+constexpr const char* kSimdBackend = "sse";
+#elif defined(ELMA_SIMD_AVX)
+constexpr const char* kSimdBackend = "avx2";
+#else
+constexpr const char* kSimdBackend = "scalar";
+#endif
+
+struct Real4
+{
+#if defined(ELMA_SIMD_SSE)
+    __m128 v;
+#elif defined(ELMA_SIMD_AVX)
+    __m256d v;
+#else
+    alignas(4 * sizeof(Real)) Real v[4];
+#endif
+};
+
+inline Real4 MakeReal4(Real a, Real b, Real c, Real d)
+{
+#if defined(ELMA_SIMD_SSE)
+    return Real4{_mm_set_ps(d, c, b, a)};
+#elif defined(ELMA_SIMD_AVX)
+    return Real4{_mm256_set_pd(d, c, b, a)};
+#else
+    return Real4{{a, b, c, d}};
+#endif
+}
+
+inline Real4 MakeReal4(Real a)
+{
+#if defined(ELMA_SIMD_SSE)
+    return Real4{_mm_set1_ps(a)};
+#elif defined(ELMA_SIMD_AVX)
+    return Real4{_mm256_set1_pd(a)};
+#else
+    return Real4{{a, a, a, a}};
+#endif
+}
+
+/// Four Reals from memory, no alignment required
+inline Real4 LoadReal4(const Real* p)
+{
+#if defined(ELMA_SIMD_SSE)
+    return Real4{_mm_loadu_ps(p)};
+#elif defined(ELMA_SIMD_AVX)
+    return Real4{_mm256_loadu_pd(p)};
+#else
+    return Real4{{p[0], p[1], p[2], p[3]}};
+#endif
+}
+
+inline void Store(const Real4& a, Real* p)
+{
+#if defined(ELMA_SIMD_SSE)
+    _mm_storeu_ps(p, a.v);
+#elif defined(ELMA_SIMD_AVX)
+    _mm256_storeu_pd(p, a.v);
+#else
+    for (int i = 0; i < 4; i++) {
+        p[i] = a.v[i];
+    }
+#endif
+}
+
+inline Real Lane(const Real4& a, int i)
+{
+    alignas(4 * sizeof(Real)) Real lanes[4];
+    Store(a, lanes);
+    return lanes[i];
+}
+
+inline Real4 operator+(const Real4& a, const Real4& b)
+{
+#if defined(ELMA_SIMD_SSE)
+    return Real4{_mm_add_ps(a.v, b.v)};
+#elif defined(ELMA_SIMD_AVX)
+    return Real4{_mm256_add_pd(a.v, b.v)};
+#else
+    return Real4{{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+#endif
+}
+
+inline Real4 operator-(const Real4& a, const Real4& b)
+{
+#if defined(ELMA_SIMD_SSE)
+    return Real4{_mm_sub_ps(a.v, b.v)};
+#elif defined(ELMA_SIMD_AVX)
+    return Real4{_mm256_sub_pd(a.v, b.v)};
+#else
+    return Real4{{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}};
+#endif
+}
+
+inline Real4 operator*(const Real4& a, const Real4& b)
+{
+#if defined(ELMA_SIMD_SSE)
+    return Real4{_mm_mul_ps(a.v, b.v)};
+#elif defined(ELMA_SIMD_AVX)
+    return Real4{_mm256_mul_pd(a.v, b.v)};
+#else
+    return Real4{{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}};
+#endif
+}
+
+inline Real4 operator/(const Real4& a, const Real4& b)
+{
+#if defined(ELMA_SIMD_SSE)
+    return Real4{_mm_div_ps(a.v, b.v)};
+#elif defined(ELMA_SIMD_AVX)
+    return Real4{_mm256_div_pd(a.v, b.v)};
+#else
+    return Real4{{a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3]}};
+#endif
+}
+
+/// a * b + c, fused when the target has FMA
+inline Real4 MulAdd(const Real4& a, const Real4& b, const Real4& c)
+{
+#if defined(ELMA_SIMD_SSE) && defined(ELMA_SIMD_FMA)
+    return Real4{_mm_fmadd_ps(a.v, b.v, c.v)};
+#elif defined(ELMA_SIMD_AVX) && defined(ELMA_SIMD_FMA)
+    return Real4{_mm256_fmadd_pd(a.v, b.v, c.v)};
+#else
+    return a * b + c;
+#endif
+}
+
+inline Real4 Min(const Real4& a, const Real4& b)
+{
+#if defined(ELMA_SIMD_SSE)
+    return Real4{_mm_min_ps(a.v, b.v)};
+#elif defined(ELMA_SIMD_AVX)
+    return Real4{_mm256_min_pd(a.v, b.v)};
+#else
+    return Real4{{Min(a.v[0], b.v[0]), Min(a.v[1], b.v[1]), Min(a.v[2], b.v[2]), Min(a.v[3], b.v[3])}};
+#endif
+}
+
+inline Real4 Max(const Real4& a, const Real4& b)
+{
+#if defined(ELMA_SIMD_SSE)
+    return Real4{_mm_max_ps(a.v, b.v)};
+#elif defined(ELMA_SIMD_AVX)
+    return Real4{_mm256_max_pd(a.v, b.v)};
+#else
+    return Real4{{Max(a.v[0], b.v[0]), Max(a.v[1], b.v[1]), Max(a.v[2], b.v[2]), Max(a.v[3], b.v[3])}};
+#endif
+}
+
+inline Real4 Sqrt(const Real4& a)
+{
+#if defined(ELMA_SIMD_SSE)
+    return Real4{_mm_sqrt_ps(a.v)};
+#elif defined(ELMA_SIMD_AVX)
+    return Real4{_mm256_sqrt_pd(a.v)};
+#else
+    return Real4{{std::sqrt(a.v[0]), std::sqrt(a.v[1]), std::sqrt(a.v[2]), std::sqrt(a.v[3])}};
+#endif
+}
+
+/// Lane-wise e^x. The SIMD backends reduce x = n ln2 + r with |r| <= ln2 / 2 and evaluate the Taylor
+/// polynomial of e^r (degree 7 for float, 12 for double), within a few ulps of std::exp. Results that would
+/// overflow or underflow saturate to the largest or smallest normal power of two instead of inf or 0.
+inline Real4 Exp(const Real4& a)
+{
+#if defined(ELMA_SIMD_SSE)
+    const __m128 x = _mm_min_ps(_mm_max_ps(a.v, _mm_set1_ps(-87.3f)), _mm_set1_ps(88.7f));
+    __m128i ni     = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.44269504f)));
+    ni             = _mm_min_epi32(_mm_max_epi32(ni, _mm_set1_epi32(-126)), _mm_set1_epi32(127));
+    const Real4 n  = Real4{_mm_cvtepi32_ps(ni)};
+    const Real4 r  = MulAdd(n, MakeReal4(2.12194440e-4f), MulAdd(n, MakeReal4(-0.693359375f), Real4{x}));
+    // 1/k! for k = 7 down to 0
+    constexpr float kInvFactorials[] = {1.f / 5040, 1.f / 720, 1.f / 120, 1.f / 24, 1.f / 6, 1.f / 2, 1.f, 1.f};
+    Real4 p = MakeReal4(kInvFactorials[0]);
+    for (int k = 1; k < 8; k++) {
+        p = MulAdd(p, r, MakeReal4(kInvFactorials[k]));
+    }
+    const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(ni, _mm_set1_epi32(127)), 23));
+    return Real4{_mm_mul_ps(p.v, scale)};
+#elif defined(ELMA_SIMD_AVX)
+    const __m256d x = _mm256_min_pd(_mm256_max_pd(a.v, _mm256_set1_pd(-708.3)), _mm256_set1_pd(709.7));
+    __m256d nd      = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634)),
+                                      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    nd              = _mm256_min_pd(_mm256_max_pd(nd, _mm256_set1_pd(-1022)), _mm256_set1_pd(1023));
+    const Real4 n   = Real4{nd};
+    const Real4 r   = MulAdd(n, MakeReal4(-1.42860682030941723212e-6),
+                             MulAdd(n, MakeReal4(-6.93145751953125e-1), Real4{x}));
+    // 1/k! for k = 12 down to 0
+    constexpr double kInvFactorials[] = {1.0 / 479001600, 1.0 / 39916800, 1.0 / 3628800, 1.0 / 362880, 1.0 / 40320,
+                                         1.0 / 5040,      1.0 / 720,      1.0 / 120,     1.0 / 24,     1.0 / 6,
+                                         1.0 / 2,         1.0,            1.0};
+    Real4 p = MakeReal4(kInvFactorials[0]);
+    for (int k = 1; k < 13; k++) {
+        p = MulAdd(p, r, MakeReal4(kInvFactorials[k]));
+    }
+    // Adding 1.5 * 2^52 moves the integer n into the low bits of the mantissa
+    const __m256d magic = _mm256_set1_pd(6755399441055744.0);
+    const __m256i ni    = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(nd, magic)), _mm256_castpd_si256(magic));
+    const __m256d scale = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(ni, _mm256_set1_epi64x(1023)), 52));
+    return Real4{_mm256_mul_pd(p.v, scale)};
+#else
+    return Real4{{std::exp(a.v[0]), std::exp(a.v[1]), std::exp(a.v[2]), std::exp(a.v[3])}};
+#endif
+}
+
+/// (x, y, z, 0) without reading past the vector
+inline Real4 LoadVector3(const Vector3& p)
+{
+#if defined(ELMA_SIMD_SSE)
+    return Real4{_mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)&p.x), _mm_load_ss(&p.z))};
+#elif defined(ELMA_SIMD_AVX)
+    return Real4{_mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(&p.x)), _mm_load_sd(&p.z), 1)};
+#else
+    return MakeReal4(p.x, p.y, p.z, 0);
+#endif
+}
+
+/// (y, z, x, w) of (x, y, z, w)
+inline Real4 SwizzleYZX(const Real4& a)
+{
+#if defined(ELMA_SIMD_SSE)
+    return Real4{_mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(3, 0, 2, 1))};
+#elif defined(ELMA_SIMD_AVX)
+    return Real4{_mm256_permute4x64_pd(a.v, _MM_SHUFFLE(3, 0, 2, 1))};
+#else
+    return Real4{{a.v[1], a.v[2], a.v[0], a.v[3]}};
+#endif
+}
+
+/// A Vector3 (or Spectrum) padded to four lanes. Only worth it for a chain of operations: packing and
+/// unpacking cost about as much as one scalar Vector3 operation, so a single bilinear blend of four texels
+/// is slower packed than the scalar code (see Tests/bench_simd.cpp). The same goes for the majorant
+/// transmittance of SampleMajorantCollisions: kept packed between collisions it measured no faster in
+/// bench_volpath (and up to 1.5x slower with SSE floats), so the volumetric tracking stays scalar.
+struct PackedVector3
+{
+    PackedVector3() { }
+
+    explicit PackedVector3(const Real4& v) : v(v) { }
+
+    explicit PackedVector3(const Vector3& p) : v(LoadVector3(p)) { }
+
+    Real4 v;
+};
+
+using PackedSpectrum = PackedVector3;
+
+inline Vector3 ToVector3(const PackedVector3& p)
+{
+    Vector3 r;
+#if defined(ELMA_SIMD_SSE)
+    _mm_storel_pi((__m64*)&r.x, p.v.v);
+    _mm_store_ss(&r.z, _mm_movehl_ps(p.v.v, p.v.v));
+#elif defined(ELMA_SIMD_AVX)
+    _mm_storeu_pd(&r.x, _mm256_castpd256_pd128(p.v.v));
+    _mm_store_sd(&r.z, _mm256_extractf128_pd(p.v.v, 1));
+#else
+    r = Vector3{p.v.v[0], p.v.v[1], p.v.v[2]};
+#endif
+    return r;
+}
+
+inline PackedVector3 operator+(const PackedVector3& a, const PackedVector3& b)
+{
+    return PackedVector3{a.v + b.v};
+}
+
+inline PackedVector3 operator-(const PackedVector3& a, const PackedVector3& b)
+{
+    return PackedVector3{a.v - b.v};
+}
+
+inline PackedVector3 operator*(const PackedVector3& a, const PackedVector3& b)
+{
+    return PackedVector3{a.v * b.v};
+}
+
+inline PackedVector3 operator*(const PackedVector3& a, Real s)
+{
+    return PackedVector3{a.v * MakeReal4(s)};
+}
+
+inline PackedVector3 operator*(Real s, const PackedVector3& a)
+{
+    return PackedVector3{MakeReal4(s) * a.v};
+}
+
+inline PackedVector3 operator/(const PackedVector3& a, Real s)
+{
+    return PackedVector3{a.v * MakeReal4(Real(1) / s)};
+}
+
+/// a * s + b
+inline PackedVector3 MulAdd(const PackedVector3& a, Real s, const PackedVector3& b)
+{
+    return PackedVector3{MulAdd(a.v, MakeReal4(s), b.v)};
+}
+
+inline Real Dot(const PackedVector3& a, const PackedVector3& b)
+{
+    alignas(4 * sizeof(Real)) Real lanes[4];
+    Store(a.v * b.v, lanes);
+    return lanes[0] + lanes[1] + lanes[2];
+}
+
+inline PackedVector3 Cross(const PackedVector3& a, const PackedVector3& b)
+{
+    // a x b = (a * b.yzx - a.yzx * b).yzx
+    return PackedVector3{SwizzleYZX(a.v * SwizzleYZX(b.v) - SwizzleYZX(a.v) * b.v)};
+}
+
+inline Real Length(const PackedVector3& a)
+{
+    return std::sqrt(Dot(a, a));
+}
+
+/// Zero for the zero vector, like Normalize(Vector3)
+inline PackedVector3 Normalize(const PackedVector3& a)
+{
+    const Real l = Length(a);
+    return l <= 0 ? PackedVector3{MakeReal4(0)} : a / l;
+}
+
+inline PackedSpectrum Exp(const PackedSpectrum& s)
+{
+    return PackedSpectrum{Exp(s.v)};
+}
+
+/// Batched kernels over arrays of count elements, four at a time on the SIMD backends.
+/// out may alias the input.
+void BatchDot(const Vector3* a, const Vector3* b, Real* out, int count);
+void BatchCross(const Vector3* a, const Vector3* b, Vector3* out, int count);
+void BatchNormalize(const Vector3* v, Vector3* out, int count);
+void BatchExp(const Spectrum* s, Spectrum* out, int count);
+
+} // namespace elma
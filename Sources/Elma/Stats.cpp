@@ -0,0 +1,224 @@
+#include "Stats.hpp"
+#include "Common/Error.hpp"
+
+#include <algorithm>
+#include <format>
+#include <mutex>
+
+namespace elma {
+
+struct StatInfo
+{
+    std::string title;
+    StatType type;
+    int slot;
+};
+
+static int num_slots(StatType type)
+{
+    switch (type) {
+    case StatType::Counter:      return 1;
+    case StatType::Ratio:        return 2;
+    case StatType::Distribution: return 4;
+    }
+    return 1;
+}
+
+/// The registered statistics and the slots of the running threads, behind one mutex. A function static, so that
+/// statistics can register during static initialization.
+struct StatsRegistry
+{
+    std::mutex mutex;
+    std::vector<StatInfo> stats;
+    int numSlots = 0;
+    std::vector<ThreadStats*> threads;
+    // Statistics of threads that have exited
+    int64_t retired[kMaxStatSlots] = {};
+};
+
+static StatsRegistry& get_registry()
+{
+    static StatsRegistry registry;
+    return registry;
+}
+
+thread_local ThreadStats tThreadStats;
+
+/// Adds the slots of a thread to the sums, registry mutex held.
+static void accumulate_slots(const StatsRegistry& registry, const std::atomic<int64_t>* slots, int64_t* sums)
+{
+    for (const StatInfo& info : registry.stats) {
+        const int i = info.slot;
+        if (info.type != StatType::Distribution) {
+            for (int k = 0; k < num_slots(info.type); k++) {
+                sums[i + k] += slots[i + k].load(std::memory_order_relaxed);
+            }
+            continue;
+        }
+        const int64_t count = slots[i].load(std::memory_order_relaxed);
+        if (count == 0) {
+            continue;
+        }
+        const int64_t min = slots[i + 2].load(std::memory_order_relaxed);
+        const int64_t max = slots[i + 3].load(std::memory_order_relaxed);
+        sums[i + 2]       = sums[i] == 0 ? min : std::min(sums[i + 2], min);
+        sums[i + 3]       = sums[i] == 0 ? max : std::max(sums[i + 3], max);
+        sums[i]          += count;
+        sums[i + 1]      += slots[i + 1].load(std::memory_order_relaxed);
+    }
+}
+
+ThreadStats::ThreadStats()
+{
+    StatsRegistry& registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.threads.push_back(this);
+}
+
+ThreadStats::~ThreadStats()
+{
+    StatsRegistry& registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    accumulate_slots(registry, slots, registry.retired);
+    std::erase(registry.threads, this);
+}
+
+int RegisterStat(const char* title, StatType type)
+{
+    StatsRegistry& registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const StatInfo& info : registry.stats) {
+        if (info.title == title) {
+            if (info.type != type) {
+                ELMA_THROW("统计项 {} 的类型不一致", title);
+            }
+            return info.slot;
+        }
+    }
+    if (registry.numSlots + num_slots(type) > kMaxStatSlots) {
+        ELMA_THROW("统计项过多，无法注册 {}", title);
+    }
+    registry.stats.push_back(StatInfo{title, type, registry.numSlots});
+    registry.numSlots += num_slots(type);
+    return registry.stats.back().slot;
+}
+
+StatsReport GetStats()
+{
+    StatsRegistry& registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    int64_t sums[kMaxStatSlots];
+    std::copy(registry.retired, registry.retired + kMaxStatSlots, sums);
+    for (const ThreadStats* thread : registry.threads) {
+        accumulate_slots(registry, thread->slots, sums);
+    }
+
+    StatsReport report;
+    for (const StatInfo& info : registry.stats) {
+        StatEntry entry{info.title, info.type};
+        entry.count = sums[info.slot];
+        if (info.type == StatType::Ratio) {
+            entry.total = sums[info.slot + 1];
+        }
+        else if (info.type == StatType::Distribution && entry.count > 0) {
+            entry.total = sums[info.slot + 1];
+            entry.min   = sums[info.slot + 2];
+            entry.max   = sums[info.slot + 3];
+        }
+        report.push_back(entry);
+    }
+    std::sort(report.begin(), report.end(), [](const StatEntry& a, const StatEntry& b) { return a.title < b.title; });
+    return report;
+}
+
+void ResetStats()
+{
+    StatsRegistry& registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::fill(registry.retired, registry.retired + kMaxStatSlots, 0);
+    for (ThreadStats* thread : registry.threads) {
+        for (std::atomic<int64_t>& slot : thread->slots) {
+            slot.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void MergeStats(StatsReport& a, const StatsReport& b)
+{
+    for (const StatEntry& entry : b) {
+        auto it = std::lower_bound(
+          a.begin(), a.end(), entry.title, [](const StatEntry& e, const std::string& title) { return e.title < title; });
+        if (it == a.end() || it->title != entry.title) {
+            a.insert(it, entry);
+            continue;
+        }
+        if (entry.type == StatType::Distribution && entry.count > 0) {
+            it->min = it->count == 0 ? entry.min : std::min(it->min, entry.min);
+            it->max = it->count == 0 ? entry.max : std::max(it->max, entry.max);
+        }
+        it->count += entry.count;
+        it->total += entry.total;
+    }
+}
+
+const StatEntry* FindStat(const StatsReport& report, std::string_view title)
+{
+    for (const StatEntry& entry : report) {
+        if (entry.title == title) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+std::string FormatStats(const StatsReport& report)
+{
+    std::string table;
+    std::string_view last_category;
+    for (const StatEntry& entry : report) {
+        // Titles without a category have an empty one
+        const std::string_view title    = entry.title;
+        const size_t slash              = std::min(title.find('/'), title.size());
+        const std::string_view category = title.substr(0, slash);
+        const std::string_view name     = title.substr(std::min(slash + 1, title.size()));
+        if (table.empty() || category != last_category) {
+            table         += std::format("{}\n", category);
+            last_category  = category;
+        }
+        if (entry.type == StatType::Counter) {
+            table += std::format("    {:<44}{:>16}\n", name, entry.count);
+        }
+        else if (entry.type == StatType::Ratio) {
+            const double percent = entry.total > 0 ? 100.0 * entry.count / entry.total : 0.0;
+            table += std::format("    {:<44}{:>16} / {} ({:.2f}%)\n", name, entry.count, entry.total, percent);
+        }
+        else {
+            const double mean = entry.count > 0 ? double(entry.total) / entry.count : 0.0;
+            table += std::format("    {:<44}{:>16.3f} avg [{} - {}] over {}\n", name, mean, entry.min, entry.max,
+                                 entry.count);
+        }
+    }
+    return table;
+}
+
+std::string StatsToJson(const StatsReport& report)
+{
+    std::string json = "{";
+    for (const StatEntry& entry : report) {
+        json += json.size() > 1 ? ", " : "";
+        json += std::format("\"{}\": ", entry.title);
+        if (entry.type == StatType::Counter) {
+            json += std::format("{}", entry.count);
+        }
+        else if (entry.type == StatType::Ratio) {
+            json += std::format("{{\"count\": {}, \"total\": {}}}", entry.count, entry.total);
+        }
+        else {
+            json += std::format("{{\"count\": {}, \"sum\": {}, \"min\": {}, \"max\": {}}}", entry.count, entry.total,
+                                entry.min, entry.max);
+        }
+    }
+    return json + "}";
+}
+
+} // namespace elma
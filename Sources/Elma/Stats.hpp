@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Elma.hpp"
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace elma {
+
+// Render statistics in the spirit of pbrt's: counters, ratios and distributions declared with the macros at the
+// end of this file next to the code they measure, e.g.
+//     ELMA_STAT_COUNTER("Integrator/Camera rays", sCameraRays);
+//     ...
+//     ++sCameraRays;
+// Titles are "Category/Name". Every thread counts into its own slots, so counting is a plain load and store of a
+// thread local (no locked add, no contention), and GetStats() sums the slots of all threads.
+
+enum class StatType
+{
+    Counter,     // a count
+    Ratio,       // a count out of a total, e.g. terminated paths out of all paths
+    Distribution // the number, sum, minimum and maximum of reported values
+};
+
+/// Slots of all the statistics together: counters take one, ratios two and distributions four.
+constexpr int kMaxStatSlots = 128;
+
+/// The slots of one thread. Only its thread writes them, GetStats() reads all of them.
+struct ThreadStats
+{
+    ThreadStats();
+    ~ThreadStats();
+
+    std::atomic<int64_t> slots[kMaxStatSlots] = {};
+};
+
+extern thread_local ThreadStats tThreadStats;
+
+/// Registers a statistic and returns its first slot. Registering a title again (a header declaring the statistic
+/// in several translation units) returns the same slots.
+int RegisterStat(const char* title, StatType type);
+
+/// A slot of the statistics of the calling thread.
+struct StatSlot
+{
+    void operator+=(int64_t n) const
+    {
+        // Single writer, so a plain load and store is enough
+        std::atomic<int64_t>& slot = tThreadStats.slots[index];
+        slot.store(slot.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void operator++() const { *this += 1; }
+
+    int index;
+};
+
+struct StatDistribution
+{
+    void report(int64_t value) const
+    {
+        std::atomic<int64_t>* slots = tThreadStats.slots + index;
+        const int64_t count         = slots[0].load(std::memory_order_relaxed);
+        if (count == 0 || value < slots[2].load(std::memory_order_relaxed)) {
+            slots[2].store(value, std::memory_order_relaxed);
+        }
+        if (count == 0 || value > slots[3].load(std::memory_order_relaxed)) {
+            slots[3].store(value, std::memory_order_relaxed);
+        }
+        slots[1].store(slots[1].load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        slots[0].store(count + 1, std::memory_order_relaxed);
+    }
+
+    int index;
+};
+
+/// A statistic summed over all threads.
+struct StatEntry
+{
+    std::string title;
+    StatType type;
+    // Counter: the value in count. Ratio: count out of total.
+    // Distribution: count values that sum to total, between min and max.
+    int64_t count = 0;
+    int64_t total = 0;
+    int64_t min   = 0;
+    int64_t max   = 0;
+};
+
+/// Sorted by title, so that the statistics of a category are together.
+using StatsReport = std::vector<StatEntry>;
+
+/// The statistics of all threads since the last ResetStats(), or since the program started.
+StatsReport GetStats();
+
+/// Zeroes the statistics of all threads. Only call it while no other thread is counting.
+void ResetStats();
+
+/// Adds the statistics of b to a, e.g. of several renders.
+void MergeStats(StatsReport& a, const StatsReport& b);
+
+/// The statistic with the title, nullptr if it's not in the report.
+const StatEntry* FindStat(const StatsReport& report, std::string_view title);
+
+/// A table of the statistics by category, to print.
+std::string FormatStats(const StatsReport& report);
+
+/// A JSON object of the statistics by title.
+std::string StatsToJson(const StatsReport& report);
+
+} // namespace elma
+
+#define ELMA_STAT_COUNTER(title, var) static const elma::StatSlot var{elma::RegisterStat(title, elma::StatType::Counter)}
+
+#define ELMA_STAT_RATIO(title, numerator, denominator)                                                                 \
+    static const elma::StatSlot numerator{elma::RegisterStat(title, elma::StatType::Ratio)};                           \
+    static const elma::StatSlot denominator{numerator.index + 1}
+
+#define ELMA_STAT_DISTRIBUTION(title, var)                                                                             \
+    static const elma::StatDistribution var{elma::RegisterStat(title, elma::StatType::Distribution)}
@@ -2,7 +2,37 @@
 
 namespace elma {
 
-TableDist1D MakeTableDist1d(const std::vector<Real>& f)
+/// Vose, "A Linear Algorithm for Generating Random Numbers with a Given Distribution", 1991
+static std::vector<AliasBin> MakeAliasBins(const std::vector<Real>& pmf)
+{
+    const int n = (int)pmf.size();
+    std::vector<AliasBin> bins(n);
+    // Probabilities scaled by n: bins below 1 are filled up by the excess of bins above 1
+    std::vector<double> scaled(n);
+    std::vector<int> small, large;
+    for (int i = 0; i < n; i++) {
+        scaled[i] = double(pmf[i]) * n;
+        (scaled[i] < 1 ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+        const int s = small.back(), l = large.back();
+        small.pop_back();
+        large.pop_back();
+        bins[s]   = AliasBin{Real(scaled[s]), l};
+        scaled[l] = (scaled[l] + scaled[s]) - 1;
+        (scaled[l] < 1 ? small : large).push_back(l);
+    }
+    // What is left is 1 up to rounding errors
+    for (int i : large) {
+        bins[i] = AliasBin{Real(1), i};
+    }
+    for (int i : small) {
+        bins[i] = AliasBin{Real(1), i};
+    }
+    return bins;
+}
+
+TableDist1D MakeTableDist1d(const std::vector<Real>& f, TableDistMethod method)
 {
     std::vector<Real> pmf = f;
     std::vector<Real> cdf(f.size() + 1);
@@ -25,13 +55,22 @@ TableDist1D MakeTableDist1d(const std::vector<Real>& f)
         }
         cdf.back() = 1;
     }
-    return TableDist1D{pmf, cdf};
+    if (method == TableDistMethod::Alias) {
+        return TableDist1D{pmf, {}, MakeAliasBins(pmf)};
+    }
+    return TableDist1D{pmf, cdf, {}};
 }
 
 int Sample(const TableDist1D& table, Real rnd_param)
 {
     int size = table.pmf.size();
     assert(size > 0);
+    if (!table.aliasBins.empty()) {
+        const double scaled = std::clamp(double(rnd_param), 0.0, 1.0) * size;
+        const int bin       = std::min(int(scaled), size - 1);
+        const AliasBin& b   = table.aliasBins[bin];
+        return scaled - bin < b.prob ? bin : b.alias;
+    }
     const Real* ptr = std::upper_bound(table.cdf.data(), table.cdf.data() + size + 1, rnd_param);
     int offset      = std::clamp(int(ptr - table.cdf.data() - 1), 0, size - 1);
     return offset;
@@ -43,6 +82,48 @@ Real Pmf(const TableDist1D& table, int id)
     return table.pmf[id];
 }
 
+constexpr int kCdfSearchFanout = 16;
+
+/// Builds the search levels of `count` cdfs with `size` values each, stored one after the other.
+static CdfSearchLevels MakeCdfSearchLevels(const std::vector<Real>& cdfs, int count, int size)
+{
+    CdfSearchLevels search;
+    while (size > kCdfSearchFanout) {
+        const std::vector<Real>& below = search.levels.empty() ? cdfs : search.levels.back();
+        const int coarse_size           = (size + kCdfSearchFanout - 1) / kCdfSearchFanout;
+        std::vector<Real> coarse(size_t(count) * coarse_size);
+        for (int c = 0; c < count; c++) {
+            for (int i = 0; i < coarse_size; i++) {
+                coarse[size_t(c) * coarse_size + i] = below[size_t(c) * size + i * kCdfSearchFanout];
+            }
+        }
+        search.levels.push_back(std::move(coarse));
+        search.sizes.push_back(coarse_size);
+        size = coarse_size;
+    }
+    return search;
+}
+
+/// Finds i with cdf[i] <= u < cdf[i + 1] in the cdf `cdf_id` of the search levels, clamped to [0, size - 2]
+/// like the upper_bound search it replaces.
+static int SearchCdf(const Real* cdf, int size, const CdfSearchLevels& search, int cdf_id, Real u)
+{
+    int i = 0;
+    for (int l = (int)search.levels.size() - 1; l >= -1; l--) {
+        const int level_size = l >= 0 ? search.sizes[l] : size;
+        const Real* values   = l >= 0 ? &search.levels[l][size_t(cdf_id) * level_size] : cdf;
+        // The block under value i of the level above, whose first value is known to be <= u.
+        // Counting instead of searching avoids branching on u.
+        const int begin = i * kCdfSearchFanout, end = std::min(begin + kCdfSearchFanout, level_size);
+        int count       = 0;
+        for (int k = begin + 1; k < end; k++) {
+            count += values[k] <= u;
+        }
+        i = begin + count;
+    }
+    return std::clamp(i, 0, size - 2);
+}
+
 TableDist2D MakeTableDist2d(const std::vector<Real>& f, int width, int height)
 {
     // Construct a 1D distribution for each row
@@ -113,24 +194,25 @@ TableDist2D MakeTableDist2d(const std::vector<Real>& f, int width, int height)
         cdf_rows[y * (width + 1) + width] = 1;
     }
 
-    return TableDist2D{cdf_rows, pdf_rows, cdf_marginals, pdf_marginals, total_values, width, height};
+    CdfSearchLevels row_levels      = MakeCdfSearchLevels(cdf_rows, height, width + 1);
+    CdfSearchLevels marginal_levels = MakeCdfSearchLevels(cdf_marginals, 1, height + 1);
+    return TableDist2D{
+        cdf_rows, pdf_rows, cdf_marginals, pdf_marginals, total_values, width, height, row_levels, marginal_levels};
 }
 
 Vector2 Sample(const TableDist2D& table, const Vector2& rnd_param)
 {
     int w = table.width, h = table.height;
     // We first sample a row from the marginal distribution
-    const Real* y_ptr = std::upper_bound(table.cdfMarginals.data(), table.cdfMarginals.data() + h + 1, rnd_param[1]);
-    int y_offset      = std::clamp(int(y_ptr - table.cdfMarginals.data() - 1), 0, h - 1);
+    int y_offset = SearchCdf(table.cdfMarginals.data(), h + 1, table.marginalLevels, 0, rnd_param[1]);
     // Uniformly remap rnd_param[1] to find the continuous offset
     Real dy = rnd_param[1] - table.cdfMarginals[y_offset];
     if ((table.cdfMarginals[y_offset + 1] - table.cdfMarginals[y_offset]) > 0) {
         dy /= (table.cdfMarginals[y_offset + 1] - table.cdfMarginals[y_offset]);
     }
     // Sample a column at the row y_offset
-    const Real* cdf   = &table.cdfRows[y_offset * (w + 1)];
-    const Real* x_ptr = std::upper_bound(cdf, cdf + w + 1, rnd_param[0]);
-    int x_offset      = std::clamp(int(x_ptr - cdf - 1), 0, w - 1);
+    const Real* cdf = &table.cdfRows[y_offset * (w + 1)];
+    int x_offset    = SearchCdf(cdf, w + 1, table.rowLevels, y_offset, rnd_param[0]);
     // Uniformly remap rnd_param[0]
     Real dx = rnd_param[0] - cdf[x_offset];
     if (cdf[x_offset + 1] - cdf[x_offset] > 0) {
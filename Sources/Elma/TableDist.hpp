@@ -6,24 +6,50 @@
 #include <vector>
 
 namespace elma {
+/// How Sample() picks an entry of a TableDist1D.
+enum class TableDistMethod
+{
+    Cdf,  // binary search of the cdf, O(log n). Keeps the entries in order of the random number.
+    Alias // Vose's alias method, O(1) with a single memory access
+};
+
+/// A bin of the alias table: the bin's own entry is taken with probability `prob`, `alias` otherwise.
+struct AliasBin
+{
+    Real prob;
+    int alias;
+};
+
 /// TableDist1D stores a tabular discrete distribution
 /// that we can Sample from using the functions below.
 /// Useful for light source sampling.
 struct TableDist1D
 {
     std::vector<Real> pmf;
-    std::vector<Real> cdf;
+    std::vector<Real> cdf;           // only for TableDistMethod::Cdf
+    std::vector<AliasBin> aliasBins; // only for TableDistMethod::Alias
 };
 
 /// Construct the tabular discrete distribution given a vector of positive numbers.
-TableDist1D MakeTableDist1d(const std::vector<Real>& f);
+TableDist1D MakeTableDist1d(const std::vector<Real>& f, TableDistMethod method = TableDistMethod::Cdf);
 
 /// Sample an entry from the discrete table given a random number in [0, 1]
+/// The alias method uses the random number twice, its integer part after scaling by the size selects
+/// a bin and the fraction decides between the bin and its alias.
 int Sample(const TableDist1D& table, Real rnd_param);
 
 /// The probability mass function of the sampling procedure above.
 Real Pmf(const TableDist1D& table, int id);
 
+/// Coarse copies of one or more cdfs of the same length. Each level holds every 16th value of the level
+/// below, the last level has at most 16 values per cdf. Searching them from the top reads one block of
+/// 16 values per level, where a binary search over a long cdf touches a new cache line at every step.
+struct CdfSearchLevels
+{
+    std::vector<std::vector<Real>> levels;
+    std::vector<int> sizes; // values per cdf in each level
+};
+
 /// TableDist2D stores a 2D piecewise constant distribution
 /// that we can Sample from using the functions below.
 /// Useful for envmap sampling.
@@ -37,6 +63,8 @@ struct TableDist2D
     std::vector<Real> cdfMarginals, pdfMarginals;
     Real totalValues;
     int width, height;
+    // For searching cdfRows and cdfMarginals
+    CdfSearchLevels rowLevels, marginalLevels;
 };
 
 /// Construct the 2D piecewise constant distribution given a vector of positive numbers
@@ -44,7 +72,7 @@ struct TableDist2D
 TableDist2D MakeTableDist2d(const std::vector<Real>& f, int width, int height);
 
 /// Given two random number in [0, 1]^2, Sample a point in the 2D domain [0, 1]^2
-/// with distribution proportional to f above.
+/// with distribution proportional to f above. The mapping is monotone in each random number.
 Vector2 Sample(const TableDist2D& table, const Vector2& rnd_param);
 
 /// Probability density of the sampling procedure above.
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Elma.hpp"
+#include <array>
+#include <cstring>
+
+namespace elma {
+// Storage formats for texture texels. Texels are decoded to Real when they are fetched,
+// so the formats only affect memory (and the texture cache's hit rate), not the filtering code.
+
+enum class TexelFormat
+{
+    U8,   // 8-bit gamma encoded, for LDR images (jpg, png, ...)
+    Half, // IEEE 754 binary16, for HDR images
+    Float // IEEE 754 binary32
+};
+
+inline int TexelSize(TexelFormat format)
+{
+    switch (format) {
+    case TexelFormat::U8:    return 1;
+    case TexelFormat::Half:  return 2;
+    case TexelFormat::Float: return 4;
+    }
+    return 4;
+}
+
+/// Largest finite half value.
+constexpr float kMaxHalf = 65504.f;
+
+/// Round to nearest even. Values above kMaxHalf become infinity.
+inline uint16_t FloatToHalf(float f)
+{
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    const uint16_t sign = uint16_t((x >> 16) & 0x8000);
+    x                  &= 0x7fffffff;
+    if (x >= 0x7f800000) {
+        // Inf or NaN
+        return sign | 0x7c00 | (x > 0x7f800000 ? 0x200 : 0);
+    }
+    if (x >= 0x477ff000) {
+        // Rounds to a value above kMaxHalf
+        return sign | 0x7c00;
+    }
+    if (x < 0x38800000) {
+        // Subnormal half, the float to int conversion does the rounding
+        float a;
+        std::memcpy(&a, &x, sizeof(a));
+        return sign | uint16_t(std::lrint(a * 0x1p24f));
+    }
+    // Rebias the exponent from 127 to 15 and round the mantissa to 10 bits
+    x += 0xc8000fff + ((x >> 13) & 1);
+    return sign | uint16_t(x >> 13);
+}
+
+inline float HalfToFloat(uint16_t h)
+{
+    const uint32_t sign = uint32_t(h & 0x8000) << 16;
+    const uint32_t exp  = (h >> 10) & 0x1f;
+    const uint32_t mant = h & 0x3ff;
+    uint32_t x;
+    if (exp == 0) {
+        float f = float(mant) * 0x1p-24f;
+        std::memcpy(&x, &f, sizeof(x));
+        x |= sign;
+    }
+    else if (exp == 31) {
+        x = sign | 0x7f800000 | (mant << 13);
+    }
+    else {
+        x = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+/// stb_image converts 8-bit images to linear values with a 2.2 gamma (stbi_loadf),
+/// we use the same curve so that U8 textures look exactly like before.
+constexpr float kTexelGamma = 2.2f;
+
+inline const std::array<float, 256> kU8ToLinear = []() {
+    std::array<float, 256> table;
+    for (int i = 0; i < 256; i++) {
+        table[i] = std::pow(i / 255.f, kTexelGamma);
+    }
+    return table;
+}();
+
+/// Inverse of kU8ToLinear, exact for the 256 values of the table.
+inline uint8_t LinearToU8(Real v)
+{
+    float encoded = std::pow(std::clamp(float(v), 0.f, 1.f), 1 / kTexelGamma) * 255.f;
+    return uint8_t(std::lrint(encoded));
+}
+
+inline Real DecodeTexel(TexelFormat format, const void* texels, int index)
+{
+    switch (format) {
+    case TexelFormat::U8:    return kU8ToLinear[static_cast<const uint8_t*>(texels)[index]];
+    case TexelFormat::Half:  return HalfToFloat(static_cast<const uint16_t*>(texels)[index]);
+    case TexelFormat::Float: return static_cast<const float*>(texels)[index];
+    }
+    return 0;
+}
+
+inline void EncodeTexel(TexelFormat format, void* texels, int index, Real v)
+{
+    switch (format) {
+    case TexelFormat::U8:    static_cast<uint8_t*>(texels)[index] = LinearToU8(v); break;
+    case TexelFormat::Half:  static_cast<uint16_t*>(texels)[index] = FloatToHalf(float(v)); break;
+    case TexelFormat::Float: static_cast<float*>(texels)[index] = float(v); break;
+    }
+}
+
+} // namespace elma
@@ -4,20 +4,23 @@
 #include "Image.hpp"
 #include "Intersection.hpp"
 #include "Mipmap.hpp"
+#include "TextureCache.hpp"
 #include <map>
 #include <variant>
 
 namespace elma {
-/// Can be replaced by a more advanced texture caching system,
-/// where we only load images from files when necessary.
-/// See OpenImageIO for example https://github.com/OpenImageIO/oiio
+/// Images are registered with a shared TextureCache (see TextureCache.hpp) and loaded lazily,
+/// tile by tile, when they are first looked up.
+/// Copies of a pool share the same cache.
 struct TexturePool
 {
     std::map<std::string, int> image1sMap;
     std::map<std::string, int> image3sMap;
 
-    std::vector<Mipmap1> image1s;
-    std::vector<Mipmap3> image3s;
+    std::vector<CachedMipmap1> image1s;
+    std::vector<CachedMipmap3> image3s;
+
+    std::shared_ptr<TextureCache> cache = MakeTextureCache();
 };
 
 inline bool TextureIdExists(const TexturePool& pool, const std::string& texture_name)
@@ -26,6 +29,12 @@ inline bool TextureIdExists(const TexturePool& pool, const std::string& texture_
            pool.image3sMap.find(texture_name) != pool.image3sMap.end();
 }
 
+template<typename T> inline CachedMipmap<T> MakeCachedMipmap(const TexturePool& pool, int texture_id)
+{
+    Vector2i size = GetResolution(*pool.cache, texture_id);
+    return CachedMipmap<T>{pool.cache.get(), texture_id, size.x, size.y, GetNumMipmapLevels(size.x, size.y)};
+}
+
 inline int InsertImage1(TexturePool& pool, const std::string& texture_name, const fs::path& filename)
 {
     if (pool.image1sMap.find(texture_name) != pool.image1sMap.end()) {
@@ -34,7 +43,9 @@ inline int InsertImage1(TexturePool& pool, const std::string& texture_name, cons
     }
     int id                        = (int)pool.image1s.size();
     pool.image1sMap[texture_name] = id;
-    pool.image1s.push_back(MakeMipmap(ImageRead1(filename)));
+    // Only reads the resolution, the texels are loaded on first use.
+    int texture_id                = AddTexture(*pool.cache, filename, 1);
+    pool.image1s.push_back(MakeCachedMipmap<Real>(pool, texture_id));
     return id;
 }
 
@@ -46,7 +57,8 @@ inline int InsertImage1(TexturePool& pool, const std::string& texture_name, cons
     }
     int id                        = (int)pool.image1s.size();
     pool.image1sMap[texture_name] = id;
-    pool.image1s.push_back(MakeMipmap(img));
+    int texture_id                = AddTexture(*pool.cache, img);
+    pool.image1s.push_back(MakeCachedMipmap<Real>(pool, texture_id));
     return id;
 }
 
@@ -58,7 +70,9 @@ inline int InsertImage3(TexturePool& pool, const std::string& texture_name, cons
     }
     int id                        = (int)pool.image3s.size();
     pool.image3sMap[texture_name] = id;
-    pool.image3s.push_back(MakeMipmap(ImageRead3(filename)));
+    // Only reads the resolution, the texels are loaded on first use.
+    int texture_id                = AddTexture(*pool.cache, filename, 3);
+    pool.image3s.push_back(MakeCachedMipmap<Vector3>(pool, texture_id));
     return id;
 }
 
@@ -70,17 +84,18 @@ inline int InsertImage3(TexturePool& pool, const std::string& texture_name, cons
     }
     int id                        = (int)pool.image3s.size();
     pool.image3sMap[texture_name] = id;
-    pool.image3s.push_back(MakeMipmap(img));
+    int texture_id                = AddTexture(*pool.cache, img);
+    pool.image3s.push_back(MakeCachedMipmap<Vector3>(pool, texture_id));
     return id;
 }
 
-inline const Mipmap1& GetImage1(const TexturePool& pool, int texture_id)
+inline const CachedMipmap1& GetImage1(const TexturePool& pool, int texture_id)
 {
     assert(texture_id >= 0 && texture_id < (int)pool.image1s.size());
     return pool.image1s[texture_id];
 }
 
-inline const Mipmap3& GetImage3(const TexturePool& pool, int texture_id)
+inline const CachedMipmap3& GetImage3(const TexturePool& pool, int texture_id)
 {
     assert(texture_id >= 0 && texture_id < (int)pool.image3s.size());
     return pool.image3s[texture_id];
@@ -105,17 +120,14 @@ template<typename T> struct CheckerboardTexture
     Real uOffset, vOffset;
 };
 
-template<typename T> inline const Mipmap<T>& GetImage(const ImageTexture<T>& t, const TexturePool& pool)
-{
-    return Mipmap<T>{};
-}
+template<typename T> inline const CachedMipmap<T>& GetImage(const ImageTexture<T>& t, const TexturePool& pool);
 
-template<> inline const Mipmap<Real>& GetImage(const ImageTexture<Real>& t, const TexturePool& pool)
+template<> inline const CachedMipmap<Real>& GetImage(const ImageTexture<Real>& t, const TexturePool& pool)
 {
     return GetImage1(pool, t.texture_id);
 }
 
-template<> inline const Mipmap<Vector3>& GetImage(const ImageTexture<Vector3>& t, const TexturePool& pool)
+template<> inline const CachedMipmap<Vector3>& GetImage(const ImageTexture<Vector3>& t, const TexturePool& pool)
 {
     return GetImage3(pool, t.texture_id);
 }
@@ -169,6 +181,12 @@ template<typename T> T Eval(const Texture<T>& texture, const Vector2& uv, Real f
     return std::visit(EvalTextureOp<T>{uv, footprint, pool}, texture);
 }
 
+/// Whether the texture has the same value everywhere.
+template<typename T> bool IsConstant(const Texture<T>& texture)
+{
+    return std::holds_alternative<ConstantTexture<T>>(texture);
+}
+
 inline ConstantTexture<Spectrum> MakeConstantSpectrumTexture(const Spectrum& spec)
 {
     return ConstantTexture<Spectrum>{spec};
@@ -0,0 +1,507 @@
+#include "TextureCache.hpp"
+#include "Pcg.hpp"
+#include "Common/Error.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <format>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace elma {
+
+namespace {
+
+constexpr int kNumShards       = 16;
+constexpr int kThreadTileSlots = 32;
+// Bits of a tile key from the lowest: 18 for tile x, 18 for tile y, 5 for the level, the rest for the texture.
+// Five bits hold all the 25 levels of the largest resolution NewTexture() accepts, kTextureTileSize << 18.
+constexpr int kTileKeyLevelShift   = 36;
+constexpr int kTileKeyTextureShift = 41;
+static_assert(kMaxMipmapLevels <= (1 << (kTileKeyTextureShift - kTileKeyLevelShift)));
+constexpr uint32_t kTileFileMagic   = 0x4c495445; // "ETIL"
+constexpr uint32_t kTileFileVersion = 4;
+
+struct TileFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    int32_t channels;
+    int32_t width;
+    int32_t height;
+    int32_t numLevels;
+    int32_t format;
+    int32_t layout;
+};
+
+struct TextureTile
+{
+    TexelFormat format;
+    TileLayout layout;
+    std::vector<uint8_t> texels;
+};
+
+using TilePtr = std::shared_ptr<const TextureTile>;
+
+/// Everything the cache knows about one image.
+struct CachedTexture
+{
+    fs::path filename; // empty for images inserted from memory
+    int channels;
+    int width;
+    int height;
+    int numLevels;
+    TexelFormat format = TexelFormat::Float;
+    TileLayout layout  = TileLayout::RowMajor;
+    // Tiles of all levels are numbered consecutively, level by level in row-major order.
+    std::vector<int> tilesX;
+    std::vector<int64_t> firstTile;
+    int64_t numTiles;
+
+    // The source image is decoded and converted to the tile file on first use.
+    std::once_flag baked;
+    fs::path tileFilename;
+    std::mutex fileMutex;
+    std::ifstream file;
+    // Images inserted from memory, or whose tile file could not be written, stay resident.
+    std::vector<TilePtr> residentTiles;
+};
+
+struct CacheShard
+{
+    std::mutex mutex;
+    // Most recently used tiles at the front.
+    std::list<std::pair<uint64_t, TilePtr>> lru;
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, TilePtr>>::iterator> entries;
+    int64_t bytes = 0;
+};
+
+/// Per-thread direct mapped cache of recently used tiles in front of the shared cache.
+/// Tiles are immutable, so a slot stays usable even after the shared cache evicted the tile.
+struct ThreadTileSlot
+{
+    uint64_t cacheId = 0;
+    uint64_t key     = 0;
+    TilePtr tile;
+};
+
+std::atomic<uint64_t> sNextCacheId{1};
+thread_local std::array<ThreadTileSlot, kThreadTileSlots> tTileSlots;
+
+} // namespace
+
+struct TextureCache
+{
+    uint64_t id;
+    std::atomic<int64_t> budget;
+    std::atomic<TileLayout> layout = TileLayout::RowMajor;
+    fs::path directory;
+    std::vector<std::unique_ptr<CachedTexture>> textures;
+    // Lookups go through a const TextureCache, the shared tiles are an implementation detail.
+    mutable std::array<CacheShard, kNumShards> shards;
+
+    mutable std::atomic<int64_t> tileLoads{0};
+    mutable std::atomic<int64_t> tileEvictions{0};
+};
+
+namespace {
+
+int64_t TileBytes(TexelFormat format, int channels)
+{
+    return int64_t(kTextureTileSize) * kTextureTileSize * channels * TexelSize(format);
+}
+
+int64_t TileBytes(const CachedTexture& tex)
+{
+    return TileBytes(tex.format, tex.channels);
+}
+
+/// Texture id, level and tile coordinates packed into one key.
+uint64_t TileKey(int texture_id, int level, int tile_x, int tile_y)
+{
+    return (uint64_t(texture_id) << kTileKeyTextureShift) | (uint64_t(level) << kTileKeyLevelShift) |
+           (uint64_t(tile_y) << 18) | uint64_t(tile_x);
+}
+
+int64_t TileIndex(const CachedTexture& tex, int level, int tile_x, int tile_y)
+{
+    return tex.firstTile[level] + int64_t(tile_y) * tex.tilesX[level] + tile_x;
+}
+
+CachedTexture& NewTexture(TextureCache& cache, int channels, int width, int height)
+{
+    if (width <= 0 || height <= 0 || width > (kTextureTileSize << 18) || height > (kTextureTileSize << 18)) {
+        ELMA_THROW("纹理分辨率 {}x{} 不受支持。", width, height);
+    }
+    if (cache.textures.size() >= (size_t(1) << (64 - kTileKeyTextureShift))) {
+        ELMA_THROW("纹理数量超出了纹理缓存的上限。");
+    }
+    auto tex       = std::make_unique<CachedTexture>();
+    tex->channels  = channels;
+    tex->width     = width;
+    tex->height    = height;
+    tex->numLevels = GetNumMipmapLevels(width, height);
+    tex->numTiles  = 0;
+    for (int level = 0; level < tex->numLevels; level++) {
+        int w       = Max(width >> level, 1);
+        int h       = Max(height >> level, 1);
+        int tiles_x = (w + kTextureTileSize - 1) / kTextureTileSize;
+        int tiles_y = (h + kTextureTileSize - 1) / kTextureTileSize;
+        tex->tilesX.push_back(tiles_x);
+        tex->firstTile.push_back(tex->numTiles);
+        tex->numTiles += int64_t(tiles_x) * tiles_y;
+    }
+    cache.textures.push_back(std::move(tex));
+    return *cache.textures.back();
+}
+
+/// Cuts every level of a mipmap into tiles, encoded in tex.format.
+/// Texels of border tiles that lie outside the image are zero.
+template<typename T> std::vector<TilePtr> MakeTiles(const CachedTexture& tex, const Mipmap<T>& mipmap)
+{
+    std::vector<TilePtr> tiles;
+    tiles.reserve(tex.numTiles);
+    for (int level = 0; level < tex.numLevels; level++) {
+        const Image<T>& img = mipmap.images[level];
+        int tiles_y         = (img.height + kTextureTileSize - 1) / kTextureTileSize;
+        for (int ty = 0; ty < tiles_y; ty++) {
+            for (int tx = 0; tx < tex.tilesX[level]; tx++) {
+                auto tile    = std::make_shared<TextureTile>();
+                tile->format = tex.format;
+                tile->layout = tex.layout;
+                tile->texels.resize(TileBytes(tex), 0);
+                int x0 = tx * kTextureTileSize;
+                int y0 = ty * kTextureTileSize;
+                int x1 = Min(x0 + kTextureTileSize, img.width);
+                int y1 = Min(y0 + kTextureTileSize, img.height);
+                for (int y = y0; y < y1; y++) {
+                    for (int x = x0; x < x1; x++) {
+                        const int index = TexelIndexInTile(tex.layout, x, y) * tex.channels;
+                        if constexpr (std::is_same_v<T, Real>) {
+                            EncodeTexel(tex.format, tile->texels.data(), index, img(x, y));
+                        }
+                        else {
+                            EncodeTexel(tex.format, tile->texels.data(), index, img(x, y)[0]);
+                            EncodeTexel(tex.format, tile->texels.data(), index + 1, img(x, y)[1]);
+                            EncodeTexel(tex.format, tile->texels.data(), index + 2, img(x, y)[2]);
+                        }
+                    }
+                }
+                tiles.push_back(std::move(tile));
+            }
+        }
+    }
+    return tiles;
+}
+
+fs::path TileDirectory()
+{
+    return fs::temp_directory_path() / "elma_texture_cache";
+}
+
+/// Checks an existing tile file and takes the texel format from it. The file is kept open in tex.file, so that it
+/// stays readable if another cache trims it.
+bool OpenExistingTileFile(CachedTexture& tex)
+{
+    tex.file.open(tex.tileFilename, std::ios::binary);
+    TileFileHeader header;
+    if (!tex.file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        tex.file.close();
+        return false;
+    }
+    std::error_code ec;
+    const auto file_size = fs::file_size(tex.tileFilename, ec);
+    if (header.magic != kTileFileMagic || header.version != kTileFileVersion || header.channels != tex.channels ||
+        header.width != tex.width || header.height != tex.height || header.numLevels != tex.numLevels ||
+        header.format < int(TexelFormat::U8) || header.format > int(TexelFormat::Float) ||
+        header.layout != int(tex.layout) || ec ||
+        file_size != sizeof(TileFileHeader) + tex.numTiles * TileBytes(TexelFormat(header.format), tex.channels))
+    {
+        tex.file.close();
+        return false;
+    }
+    tex.format = TexelFormat(header.format);
+    // The modification time tells TrimTileFiles() when the file was last used
+    fs::last_write_time(tex.tileFilename, fs::file_time_type::clock::now(), ec);
+    return true;
+}
+
+/// Picks the most compact format for the decoded image: 8-bit sources go back to 8 bits without loss,
+/// HDR images are stored as half unless they exceed its range.
+template<typename T> TexelFormat ChooseTexelFormat(const fs::path& filename, const Image<T>& img)
+{
+    if (!IsHdrImage(filename)) {
+        return TexelFormat::U8;
+    }
+    Real max_value = 0;
+    for (const T& v : img.data) {
+        if constexpr (std::is_same_v<T, Real>) {
+            max_value = Max(max_value, std::abs(v));
+        }
+        else {
+            max_value = Max(max_value, Max(std::abs(v[0]), Max(std::abs(v[1]), std::abs(v[2]))));
+        }
+    }
+    return max_value <= kMaxHalf ? TexelFormat::Half : TexelFormat::Float;
+}
+
+template<typename T> std::vector<TilePtr> DecodeToTiles(CachedTexture& tex, const Image<T>& img)
+{
+    tex.format = ChooseTexelFormat(tex.filename, img);
+    return MakeTiles(tex, MakeMipmap(img));
+}
+
+/// Writes the encoded tiles to a temporary file that is then renamed, so that concurrent
+/// renders never see a partially written tile file.
+bool WriteTileFile(const CachedTexture& tex, const std::vector<TilePtr>& tiles)
+{
+    std::error_code ec;
+    fs::create_directories(tex.tileFilename.parent_path(), ec);
+    fs::path tmp_filename = tex.tileFilename;
+    tmp_filename         += std::format(".{:x}.tmp", wyhash64(uint64_t(uintptr_t(&tex))));
+    {
+        std::ofstream out(tmp_filename, std::ios::binary);
+        if (!out) {
+            return false;
+        }
+        TileFileHeader header{kTileFileMagic,
+                              kTileFileVersion,
+                              tex.channels,
+                              tex.width,
+                              tex.height,
+                              tex.numLevels,
+                              int(tex.format),
+                              int(tex.layout)};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const TilePtr& tile : tiles) {
+            out.write(reinterpret_cast<const char*>(tile->texels.data()), tile->texels.size());
+        }
+        if (!out) {
+            out.close();
+            fs::remove(tmp_filename, ec);
+            return false;
+        }
+    }
+    fs::rename(tmp_filename, tex.tileFilename, ec);
+    if (ec) {
+        fs::remove(tmp_filename, ec);
+        return false;
+    }
+    return true;
+}
+
+void Bake(const TextureCache& cache, CachedTexture& tex)
+{
+    if (tex.filename.empty()) {
+        return;
+    }
+    // The tile file is identified by the source file and its modification time, and the layout of the tiles.
+    tex.layout = cache.layout.load(std::memory_order_relaxed);
+    std::error_code ec;
+    uint64_t hash = std::hash<std::string>{}(tex.filename.string());
+    hash          = wyhash64(hash ^ uint64_t(fs::last_write_time(tex.filename, ec).time_since_epoch().count()));
+    hash          = wyhash64(hash ^ uint64_t(fs::file_size(tex.filename, ec)));
+    hash          = wyhash64(hash ^ uint64_t(tex.channels));
+    hash          = wyhash64(hash ^ uint64_t(tex.layout));
+    tex.tileFilename = cache.directory / std::format("{:016x}.tiles", hash);
+
+    if (OpenExistingTileFile(tex)) {
+        return;
+    }
+    std::vector<TilePtr> tiles = tex.channels == 1 ? DecodeToTiles(tex, ImageRead1(tex.filename))
+                                                   : DecodeToTiles(tex, ImageRead3(tex.filename));
+    if (!WriteTileFile(tex, tiles)) {
+        LogWarn("无法写入纹理缓存文件 {}，纹理 {} 将常驻内存。",
+                tex.tileFilename.string(),
+                tex.filename.string());
+        tex.residentTiles = std::move(tiles);
+        return;
+    }
+    tex.file.open(tex.tileFilename, std::ios::binary);
+    if (!tex.file) {
+        ELMA_THROW("无法打开纹理缓存文件 {}。", tex.tileFilename.string());
+    }
+}
+
+TilePtr ReadTile(CachedTexture& tex, int64_t tile_index)
+{
+    const int64_t tile_bytes = TileBytes(tex);
+    auto tile                = std::make_shared<TextureTile>();
+    tile->format             = tex.format;
+    tile->layout             = tex.layout;
+    tile->texels.resize(tile_bytes);
+    std::lock_guard<std::mutex> lock(tex.fileMutex);
+    tex.file.seekg(sizeof(TileFileHeader) + tile_index * tile_bytes);
+    if (!tex.file.read(reinterpret_cast<char*>(tile->texels.data()), tile_bytes)) {
+        ELMA_THROW("读取纹理缓存文件 {} 失败。", tex.tileFilename.string());
+    }
+    return tile;
+}
+
+TilePtr FindOrLoadTile(const TextureCache& cache, uint64_t key, int texture_id, int level, int tile_x, int tile_y)
+{
+    CachedTexture& tex = *cache.textures[texture_id];
+    CacheShard& shard  = cache.shards[wyhash64(key) % kNumShards];
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return it->second->second;
+        }
+    }
+
+    std::call_once(tex.baked, [&]() { Bake(cache, tex); });
+    const int64_t tile_index = TileIndex(tex, level, tile_x, tile_y);
+    if (!tex.residentTiles.empty()) {
+        return tex.residentTiles[tile_index];
+    }
+
+    // Read without holding the shard lock. If another thread loaded the same tile meanwhile, keep theirs.
+    TilePtr tile = ReadTile(tex, tile_index);
+    cache.tileLoads++;
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.entries.find(key);
+    if (it != shard.entries.end()) {
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return it->second->second;
+    }
+    shard.lru.emplace_front(key, tile);
+    shard.entries[key]  = shard.lru.begin();
+    shard.bytes        += TileBytes(tex);
+    // Evict least recently used tiles, but always keep the one we just loaded.
+    const int64_t shard_budget = cache.budget.load(std::memory_order_relaxed) / kNumShards;
+    while (shard.bytes > shard_budget && shard.lru.size() > 1) {
+        uint64_t evicted_key = shard.lru.back().first;
+        const int evicted_id = int(evicted_key >> kTileKeyTextureShift);
+        shard.bytes         -= TileBytes(*cache.textures[evicted_id]);
+        shard.entries.erase(evicted_key);
+        shard.lru.pop_back();
+        cache.tileEvictions++;
+    }
+    return tile;
+}
+
+} // namespace
+
+std::shared_ptr<TextureCache> MakeTextureCache(int64_t budget)
+{
+    TrimTileFiles(kTileFileBudget);
+    auto cache       = std::make_shared<TextureCache>();
+    cache->id        = sNextCacheId++;
+    cache->budget    = budget;
+    cache->directory = TileDirectory();
+    return cache;
+}
+
+void TrimTileFiles(int64_t budget)
+{
+    struct TileFile
+    {
+        fs::path path;
+        fs::file_time_type lastUse;
+        int64_t bytes;
+    };
+    std::vector<TileFile> files;
+    int64_t total = 0;
+    std::error_code ec;
+    for (auto it = fs::directory_iterator(TileDirectory(), ec); !ec && it != fs::directory_iterator();
+         it.increment(ec))
+    {
+        std::error_code entry_ec;
+        if (it->path().extension() != ".tiles" || !it->is_regular_file(entry_ec)) {
+            continue;
+        }
+        const int64_t bytes = int64_t(it->file_size(entry_ec));
+        const auto last_use = it->last_write_time(entry_ec);
+        if (!entry_ec) {
+            files.push_back(TileFile{it->path(), last_use, bytes});
+            total += bytes;
+        }
+    }
+    if (total <= budget) {
+        return;
+    }
+    // Caches reading a deleted file keep it open and can still read it (on Windows the delete fails instead)
+    std::sort(files.begin(), files.end(), [](const TileFile& a, const TileFile& b) { return a.lastUse < b.lastUse; });
+    for (const TileFile& file : files) {
+        if (total <= budget) {
+            break;
+        }
+        if (fs::remove(file.path, ec)) {
+            total -= file.bytes;
+        }
+    }
+}
+
+void SetTextureCacheBudget(TextureCache& cache, int64_t budget)
+{
+    cache.budget = budget;
+}
+
+void SetTextureCacheLayout(TextureCache& cache, TileLayout layout)
+{
+    cache.layout = layout;
+}
+
+int AddTexture(TextureCache& cache, const fs::path& filename, int channels)
+{
+    assert(channels == 1 || channels == 3);
+    // The scene parser changes the working directory while parsing, and the file is only opened later.
+    fs::path absolute_filename = fs::absolute(filename);
+    Vector2i size              = ImageResolution(absolute_filename);
+    CachedTexture& tex         = NewTexture(cache, channels, size.x, size.y);
+    tex.filename               = absolute_filename;
+    return (int)cache.textures.size() - 1;
+}
+
+int AddTexture(TextureCache& cache, const Image1& img)
+{
+    CachedTexture& tex = NewTexture(cache, 1, img.width, img.height);
+    tex.layout         = cache.layout;
+    tex.residentTiles  = MakeTiles(tex, MakeMipmap(img));
+    return (int)cache.textures.size() - 1;
+}
+
+int AddTexture(TextureCache& cache, const Image3& img)
+{
+    CachedTexture& tex = NewTexture(cache, 3, img.width, img.height);
+    tex.layout         = cache.layout;
+    tex.residentTiles  = MakeTiles(tex, MakeMipmap(img));
+    return (int)cache.textures.size() - 1;
+}
+
+Vector2i GetResolution(const TextureCache& cache, int texture_id)
+{
+    assert(texture_id >= 0 && texture_id < (int)cache.textures.size());
+    const CachedTexture& tex = *cache.textures[texture_id];
+    return Vector2i{tex.width, tex.height};
+}
+
+TextureTileView GetTile(const TextureCache& cache, int texture_id, int level, int tile_x, int tile_y)
+{
+    assert(texture_id >= 0 && texture_id < (int)cache.textures.size());
+    const uint64_t key   = TileKey(texture_id, level, tile_x, tile_y);
+    ThreadTileSlot& slot = tTileSlots[((key * 0x9e3779b97f4a7c15ull) >> 32) % kThreadTileSlots];
+    if (slot.cacheId != cache.id || slot.key != key || !slot.tile) {
+        slot.tile    = FindOrLoadTile(cache, key, texture_id, level, tile_x, tile_y);
+        slot.cacheId = cache.id;
+        slot.key     = key;
+    }
+    return TextureTileView{slot.tile->texels.data(), slot.tile->format, slot.tile->layout};
+}
+
+TextureCacheStats GetStats(const TextureCache& cache)
+{
+    TextureCacheStats stats{cache.tileLoads.load(), cache.tileEvictions.load(), 0};
+    for (CacheShard& shard : cache.shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.residentBytes += shard.bytes;
+    }
+    return stats;
+}
+
+} // namespace elma
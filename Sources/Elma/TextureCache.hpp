@@ -0,0 +1,205 @@
+#pragma once
+
+#include "Elma.hpp"
+#include "Image.hpp"
+#include "Mipmap.hpp"
+#include "Texel.hpp"
+#include <array>
+#include <memory>
+
+namespace elma {
+// A texture cache in the spirit of OpenImageIO's ImageCache: at scene load we only read the
+// resolution of each image. The first time a texel of an image is needed, the image is decoded once,
+// its mipmap is built and written as square tiles to a tile file in the temporary directory. Tile files are
+// shared with other caches and kept across runs while the source file is unchanged, so later runs skip decoding;
+// the least recently used ones are deleted once they take more than kTileFileBudget.
+// From then on tiles are read on demand and kept in a shared LRU cache bounded by a memory budget,
+// with a small per-thread cache in front of it to avoid locking on the common path.
+// Tiles keep the precision of their source (see Texel.hpp): 8-bit images take 3 bytes per RGB texel
+// instead of 3 Reals.
+
+constexpr int kTextureTileShift = 6;
+/// Side length of the square tiles, in texels.
+constexpr int kTextureTileSize = 1 << kTextureTileShift;
+
+/// Order of the texels within a tile.
+enum class TileLayout
+{
+    RowMajor,
+    // Morton (Z-curve) order, so that the four taps of a bilinear lookup usually share a cache line, whichever
+    // direction the lookups move in. Slower than row-major in bench_texture_fetch so far, hence not the default.
+    Morton
+};
+
+/// Spreads the bits of a coordinate within a tile to the even bits, for the Morton layout.
+inline constexpr std::array<uint16_t, kTextureTileSize> kTileMortonSpread = []() {
+    std::array<uint16_t, kTextureTileSize> table{};
+    for (int i = 0; i < kTextureTileSize; i++) {
+        for (int b = 0; b < kTextureTileShift; b++) {
+            table[i] |= uint16_t(((i >> b) & 1) << (2 * b));
+        }
+    }
+    return table;
+}();
+
+/// Index of texel (x, y) within its tile, x and y can be image coordinates.
+inline int TexelIndexInTile(TileLayout layout, int x, int y)
+{
+    x &= kTextureTileSize - 1;
+    y &= kTextureTileSize - 1;
+    if (layout == TileLayout::Morton) {
+        return kTileMortonSpread[x] | (kTileMortonSpread[y] << 1);
+    }
+    return (y << kTextureTileShift) | x;
+}
+
+/// Default memory budget for the tiles of all textures.
+constexpr int64_t kDefaultTextureCacheBudget = int64_t(1) << 30;
+/// Disk space for the tile files kept across runs.
+constexpr int64_t kTileFileBudget = int64_t(8) << 30;
+
+struct TextureCache;
+
+struct TextureCacheStats
+{
+    int64_t tileLoads;     // tiles read from the tile files
+    int64_t tileEvictions; // tiles dropped to stay within the budget
+    int64_t residentBytes; // tiles currently held by the shared cache
+};
+
+/// Creating a cache trims the tile files of earlier runs to kTileFileBudget.
+std::shared_ptr<TextureCache> MakeTextureCache(int64_t budget = kDefaultTextureCacheBudget);
+
+/// Deletes the least recently used tile files until the others take at most `budget` bytes.
+void TrimTileFiles(int64_t budget);
+
+/// Budget for the tiles loaded from disk. Images inserted from memory are not counted,
+/// and each thread can keep a few recently used tiles alive beyond it.
+void SetTextureCacheBudget(TextureCache& cache, int64_t budget);
+
+/// Layout of the tiles of the images registered or first looked up from now on, row-major by default.
+/// Every tile keeps the layout it was made with.
+void SetTextureCacheLayout(TextureCache& cache, TileLayout layout);
+
+/// Registers an image file with 1 or 3 channels. Only the header of the file is read here.
+int AddTexture(TextureCache& cache, const fs::path& filename, int channels);
+
+/// Registers an image that already lives in memory. Its tiles stay resident, stored as floats.
+int AddTexture(TextureCache& cache, const Image1& img);
+int AddTexture(TextureCache& cache, const Image3& img);
+
+Vector2i GetResolution(const TextureCache& cache, int texture_id);
+
+/// The texels of a tile, in TexelIndexInTile() order with the channels interleaved.
+struct TextureTileView
+{
+    const void* texels;
+    TexelFormat format;
+    TileLayout layout;
+};
+
+/// The returned texels stay valid until the calling thread fetches its next tile.
+TextureTileView GetTile(const TextureCache& cache, int texture_id, int level, int tile_x, int tile_y);
+
+TextureCacheStats GetStats(const TextureCache& cache);
+
+/// A mipmapped image in the texture cache. Only the resolution is known up front,
+/// the texels are fetched tile by tile on demand.
+template<typename T> struct CachedMipmap
+{
+    const TextureCache* cache;
+    int textureId;
+    int width;
+    int height;
+    int numLevels;
+};
+
+using CachedMipmap1 = CachedMipmap<Real>;
+using CachedMipmap3 = CachedMipmap<Vector3>;
+
+template<typename T> inline int GetWidth(const CachedMipmap<T>& mipmap)
+{
+    return mipmap.width;
+}
+
+template<typename T> inline int GetHeight(const CachedMipmap<T>& mipmap)
+{
+    return mipmap.height;
+}
+
+/// Texel (x, y) of the image, read from the tile that holds it.
+template<typename T> inline T DecodeTileTexel(const TextureTileView& tile, int x, int y)
+{
+    const int offset = TexelIndexInTile(tile.layout, x, y);
+    if constexpr (std::is_same_v<T, Real>) {
+        return DecodeTexel(tile.format, tile.texels, offset);
+    }
+    else {
+        return T{DecodeTexel(tile.format, tile.texels, 3 * offset),
+                 DecodeTexel(tile.format, tile.texels, 3 * offset + 1),
+                 DecodeTexel(tile.format, tile.texels, 3 * offset + 2)};
+    }
+}
+
+template<typename T> inline T FetchTexel(const CachedMipmap<T>& mipmap, int level, int x, int y)
+{
+    TextureTileView tile =
+        GetTile(*mipmap.cache, mipmap.textureId, level, x >> kTextureTileShift, y >> kTextureTileShift);
+    return DecodeTileTexel<T>(tile, x, y);
+}
+
+/// Bilinear Lookup of a cached mipmap at location (uv) with an integer level.
+/// Same filtering as Lookup() on an in-memory Mipmap.
+template<typename T> inline T Lookup(const CachedMipmap<T>& mipmap, Real u, Real v, int level)
+{
+    assert(level >= 0 && level < mipmap.numLevels);
+    const int w = Max(mipmap.width >> level, 1);
+    const int h = Max(mipmap.height >> level, 1);
+    // (-0.5 to match Mitsuba's coordinates)
+    u          = u * w - Real(0.5);
+    v          = v * h - Real(0.5);
+    int ufi    = Modulo(int(u), w);
+    int vfi    = Modulo(int(v), h);
+    int uci    = Modulo(ufi + 1, w);
+    int vci    = Modulo(vfi + 1, h);
+    Real u_off = u - ufi;
+    Real v_off = v - vfi;
+    T val_ff, val_fc, val_cf, val_cc;
+    const int tile_x = ufi >> kTextureTileShift;
+    const int tile_y = vfi >> kTextureTileShift;
+    if (uci >> kTextureTileShift == tile_x && vci >> kTextureTileShift == tile_y) {
+        // All four taps in one tile: fetch it once
+        TextureTileView tile = GetTile(*mipmap.cache, mipmap.textureId, level, tile_x, tile_y);
+        val_ff               = DecodeTileTexel<T>(tile, ufi, vfi);
+        val_fc               = DecodeTileTexel<T>(tile, ufi, vci);
+        val_cf               = DecodeTileTexel<T>(tile, uci, vfi);
+        val_cc               = DecodeTileTexel<T>(tile, uci, vci);
+    }
+    else {
+        val_ff = FetchTexel(mipmap, level, ufi, vfi);
+        val_fc = FetchTexel(mipmap, level, ufi, vci);
+        val_cf = FetchTexel(mipmap, level, uci, vfi);
+        val_cc = FetchTexel(mipmap, level, uci, vci);
+    }
+    return val_ff * (1 - u_off) * (1 - v_off) + val_fc * (1 - u_off) * v_off + val_cf * u_off * (1 - v_off) +
+           val_cc * u_off * v_off;
+}
+
+/// Trilinear look of of a cached mipmap at (u, v, level)
+template<typename T> inline T Lookup(const CachedMipmap<T>& mipmap, Real u, Real v, Real level)
+{
+    if (level <= 0) {
+        return Lookup(mipmap, u, v, 0);
+    }
+    else if (level < Real(mipmap.numLevels - 1)) {
+        int flevel     = std::clamp((int)std::floor(level), 0, mipmap.numLevels - 1);
+        int clevel     = std::clamp(flevel + 1, 0, mipmap.numLevels - 1);
+        Real level_off = level - flevel;
+        return Lookup(mipmap, u, v, flevel) * (1 - level_off) + Lookup(mipmap, u, v, clevel) * level_off;
+    }
+    else {
+        return Lookup(mipmap, u, v, mipmap.numLevels - 1);
+    }
+}
+
+} // namespace elma
@@ -13,11 +13,12 @@ struct Timer
     std::chrono::time_point<std::chrono::system_clock> last;
 };
 
+/// Returns the seconds since the last tick.
 inline Real tick(Timer& timer)
 {
     const auto now     = std::chrono::system_clock::now();
     const auto elapsed = now - timer.last;
-    Real ret           = elapsed.count();
+    Real ret           = std::chrono::duration<Real>(elapsed).count();
     timer.last         = now;
     return ret;
 }
@@ -251,6 +251,11 @@ template<typename T> inline TVector3<T> Max(const TVector3<T>& v0, const TVector
     return TVector3<T>{std::max(v0.x, v1.x), std::max(v0.y, v1.y), std::max(v0.z, v1.z)};
 }
 
+template<typename T> inline TVector3<T> Min(const TVector3<T>& v0, const TVector3<T>& v1)
+{
+    return TVector3<T>{std::min(v0.x, v1.x), std::min(v0.y, v1.y), std::min(v0.z, v1.z)};
+}
+
 template<typename T> inline bool IsNan(const TVector2<T>& v)
 {
     return std::isnan(v[0]) || std::isnan(v[1]);
@@ -1,16 +1,428 @@
 #pragma once
 
+#include "Scene.hpp"
+#include "Sampler.hpp"
+#include "Stats.hpp"
+
 namespace elma {
+// The volumetric path tracer follows pbrt-v4's VolPathIntegrator: null-scattering path integral formulation
+// ("A Null-Scattering Path Integral Formulation of Light Transport", Miller et al. 2019) with delta tracking
+// for free-flight sampling and ratio tracking for the transmittance of shadow rays.
+//
+// Media are chromatic, so tracking samples distances with the majorant of one spectral channel picked per path
+// (the "hero" channel), and every estimate is divided by the average of the path pdfs of all channels, which
+// makes it a spectral MIS estimator. Instead of the pdfs themselves we track their ratios to the pdf of the
+// sampled path: r_u for unidirectional sampling and r_l for light sampling, rescaled the same way as the path
+// throughput beta.
+//
+// The majorants come from the majorant segments of the media (GetMajorantIterator), so in grid volumes the
+// tracking takes steps with the local bound of each majorant grid cell instead of the global maximum.
+
+// Tentative collisions of the tracking that turned out to be null collisions, counted once per path
+ELMA_STAT_COUNTER("Volume/Null collisions", sNullCollisions);
+
+/// The medium on the other side of a boundary that a ray in direction dir crosses at vertex,
+/// or medium_id if the shape doesn't separate media.
+inline int UpdateMedium(const Vector3& dir, const PathVertex& vertex, int medium_id)
+{
+    if (vertex.interiorMediumId != vertex.exteriorMediumId) {
+        return Dot(dir, vertex.normal) > 0 ? vertex.exteriorMediumId : vertex.interiorMediumId;
+    }
+    return medium_id;
+}
+
+/// Random numbers for the collisions along one ray: their count is unbounded, so they come from a PCG
+/// stream seeded by two dimensions of the sampler instead of the sampler itself.
+inline Pcg32State MakeTrackingRng(Sampler& sampler)
+{
+    const Real seed   = Next1D(sampler);
+    const Real stream = Next1D(sampler);
+    return InitPcg32(wyhash64(uint64_t(stream * Real(0x1p32))), wyhash64(uint64_t(seed * Real(0x1p32))));
+}
+
+/// Next event estimation from p, where eval_scatter(dir_light) returns the BSDF (with the cosine) or the phase
+/// function towards the light and its sampling pdf. surface is the path vertex of p, null in media, and medium_id
+/// the medium of the ray that arrived at p. The transmittance is estimated by ratio tracking through the media
+/// and the index-matched boundaries on the way to the light.
+/// Returns the contribution to be multiplied by the path throughput, MIS weighted against eval_scatter's
+/// sampling through r_p, the rescaled unidirectional path pdfs of the vertex.
+template<typename EvalScatter>
+Spectrum SampleLd(const Scene& scene,
+                  const Vector3& p,
+                  const PathVertex* surface,
+                  int medium_id,
+                  int channel,
+                  const Spectrum& r_p,
+                  EvalScatter eval_scatter,
+                  Sampler& sampler,
+                  int64_t& null_collisions)
+{
+    // The same sampler dimensions are drawn whether or not a light is found
+    Vector2 light_uv                     = Next2D(sampler);
+    Real light_w                         = Next1D(sampler);
+    Real shape_w                         = Next1D(sampler);
+    Pcg32State rng                       = MakeTrackingRng(sampler);
+    const Vector3 n                      = surface ? surface->normal : Vector3{0, 0, 0};
+    const LightSampleRecord light_sample = SampleLight(scene, p, n, light_w);
+    if (light_sample.lightId < 0) {
+        return MakeZeroSpectrum();
+    }
+    const Light& light            = scene.lights[light_sample.lightId];
+    PointAndNormal point_on_light = SamplePointOnLight(light, p, light_uv, shape_w, scene);
+
+    // The light pdf in the solid angle measure, which the phase functions and BSDFs use as well
+    Vector3 dir_light;
+    Real dist_light;
+    Real pdf_light;
+    Spectrum L;
+    if (const Envmap* envmap = std::get_if<Envmap>(&light)) {
+        // The direction from envmap towards the point is stored in point_on_light.normal.
+        dir_light                        = -point_on_light.normal;
+        dist_light                       = Infinity<Real>();
+        const EnvmapDirection envmap_dir = ToEnvmapDirection(*envmap, point_on_light.normal);
+        pdf_light                        = light_sample.pmf * PdfPointOnLight(*envmap, envmap_dir);
+        L                                = Emission(*envmap, envmap_dir, Real(0), scene);
+    }
+    else {
+        dir_light            = Normalize(point_on_light.position - p);
+        dist_light           = Distance(point_on_light.position, p);
+        const Real cos_light = -Dot(dir_light, point_on_light.normal);
+        if (cos_light <= 0) {
+            return MakeZeroSpectrum();
+        }
+        pdf_light = light_sample.pmf * PdfPointOnLight(light, point_on_light, p, scene) * dist_light * dist_light /
+                    cos_light;
+        L = Emission(light, -dir_light, Real(0), point_on_light, scene);
+    }
+    if (pdf_light <= 0 || Max(L) <= 0) {
+        return MakeZeroSpectrum();
+    }
+    const auto [f, pdf_scatter] = eval_scatter(dir_light);
+    if (Max(f) <= 0) {
+        return MakeZeroSpectrum();
+    }
+
+    // Ratio tracking along the shadow ray, restarted at every boundary between media
+    if (surface) {
+        medium_id = UpdateMedium(dir_light, *surface, medium_id);
+    }
+    Spectrum T_ray = MakeConstSpectrum(1);
+    Spectrum r_l   = MakeConstSpectrum(1);
+    Spectrum r_u   = MakeConstSpectrum(1);
+    Vector3 org    = p;
+    while (true) {
+        const Real dist = Distance(point_on_light.position, org);
+        Ray shadow_ray{org,
+                       dir_light,
+                       GetShadowEpsilon(scene),
+                       std::isinf(dist_light) ? Infinity<Real>() : (1 - GetShadowEpsilon(scene)) * dist};
+        std::optional<PathVertex> blocker = Intersect(scene, shadow_ray);
+        if (blocker && blocker->materialId >= 0) {
+            // Blocked by an opaque or refractive surface
+            return MakeZeroSpectrum();
+        }
+        if (medium_id >= 0) {
+            const Real t_max     = blocker ? Distance(org, blocker->position) : shadow_ray.tFar;
+            int ray_collisions   = 0;
+            const Spectrum T_maj = SampleMajorantCollisions(
+              scene.media[medium_id],
+              shadow_ray,
+              t_max,
+              channel,
+              rng,
+              [&](const Vector3&, const MediumProperties& mp, const Spectrum& sigma_maj, const Spectrum& T_maj) {
+                  null_collisions++;
+                  if (++ray_collisions >= scene.options.maxNullCollisions) {
+                      T_ray = MakeZeroSpectrum();
+                      return false;
+                  }
+                  const Spectrum sigma_n = Max(sigma_maj - mp.sigmaA - mp.sigmaS, MakeZeroSpectrum());
+                  const Real pdf         = T_maj[channel] * sigma_maj[channel];
+                  if (pdf <= 0) {
+                      T_ray = MakeZeroSpectrum();
+                      return false;
+                  }
+                  T_ray *= T_maj * sigma_n / pdf;
+                  r_l   *= T_maj * sigma_maj / pdf;
+                  r_u   *= T_maj * sigma_n / pdf;
+                  // Russian roulette on low transmittance
+                  const Spectrum Tr = T_ray / Avg(r_l + r_u);
+                  if (Max(Tr) < Real(0.05)) {
+                      if (NextPcg32Real<Real>(rng) < Real(0.75)) {
+                          T_ray = MakeZeroSpectrum();
+                      }
+                      else {
+                          T_ray /= Real(0.25);
+                      }
+                  }
+                  return Max(T_ray) > 0;
+              });
+            if (T_maj[channel] <= 0 || Max(T_ray) <= 0) {
+                return MakeZeroSpectrum();
+            }
+            T_ray *= T_maj / T_maj[channel];
+            r_l   *= T_maj / T_maj[channel];
+            r_u   *= T_maj / T_maj[channel];
+        }
+        if (!blocker) {
+            break;
+        }
+        medium_id = UpdateMedium(dir_light, *blocker, medium_id);
+        org       = blocker->position;
+    }
+
+    r_l *= r_p * pdf_light;
+    r_u *= r_p * pdf_scatter;
+    return f * T_ray * L / Avg(r_l + r_u);
+}
+
+// The final volumetric renderer:
+// multiple chromatic heterogeneous volumes with multiple scattering
+// with MIS between next event estimation and phase function sampling
+// with surface lighting
+Spectrum VolPathTracing(const Scene& scene,
+                        int x,
+                        int y, /* pixel coordinates */
+                        Sampler& sampler)
+{
+    int w = scene.camera.width, h = scene.camera.height;
+    Vector2 pixel_uv = Next2D(sampler);
+    Vector2 screen_pos((x + pixel_uv.x) / w, (y + pixel_uv.y) / h);
+    Ray ray                  = SamplePrimary(scene.camera, screen_pos);
+    RayDifferential ray_diff = InitRayDifferential(w, h);
+    int medium_id            = scene.camera.mediumId;
+    const int channel        = Min(int(Next1D(sampler) * 3), 2);
+
+    Spectrum radiance = MakeZeroSpectrum();
+    // beta is the path throughput divided by the path pdf of the hero channel,
+    // r_u and r_l the rescaled path pdfs of all channels, see above.
+    Spectrum beta = MakeConstSpectrum(1);
+    Spectrum r_u  = MakeConstSpectrum(1);
+    Spectrum r_l  = MakeConstSpectrum(1);
+    // eta_scale stores the scale introduced by Snell-Descartes law to the BSDF (eta^2), see PathTracing().
+    Real eta_scale = Real(1);
+    // The last scattering vertex, for the light pdfs of MIS when the path hits a light. n is zero in media.
+    Vector3 prev_p = ray.org, prev_n{0, 0, 0};
+    int64_t null_collisions = 0;
+
+    int max_depth = scene.options.maxDepth;
+    for (int bounces = 0;;) {
+        std::optional<PathVertex> vertex_ = Intersect(scene, ray, ray_diff);
+
+        // Delta tracking through the current medium, up to the surface
+        bool scattered = false, terminated = false;
+        Vector3 scatter_p;
+        if (medium_id >= 0) {
+            const Medium& medium = scene.media[medium_id];
+            const Real t_max     = vertex_ ? Distance(ray.org, vertex_->position) : Infinity<Real>();
+            Pcg32State rng       = MakeTrackingRng(sampler);
+            int ray_collisions   = 0;
+            const Spectrum T_maj = SampleMajorantCollisions(
+              medium,
+              ray,
+              t_max,
+              channel,
+              rng,
+              [&](const Vector3& p, const MediumProperties& mp, const Spectrum& sigma_maj, const Spectrum& T_maj) {
+                  // Absorption, real scattering and null scattering with probabilities of the hero channel
+                  const Real pdf_absorb  = mp.sigmaA[channel] / sigma_maj[channel];
+                  const Real pdf_scatter = mp.sigmaS[channel] / sigma_maj[channel];
+                  const Real u           = NextPcg32Real<Real>(rng);
+                  if (u < pdf_absorb) {
+                      terminated = true;
+                      return false;
+                  }
+                  if (u < pdf_absorb + pdf_scatter) {
+                      const Real pdf = T_maj[channel] * mp.sigmaS[channel];
+                      beta          *= T_maj * mp.sigmaS / pdf;
+                      r_u           *= T_maj * mp.sigmaS / pdf;
+                      scattered      = true;
+                      scatter_p      = p;
+                      return false;
+                  }
+                  null_collisions++;
+                  if (++ray_collisions >= scene.options.maxNullCollisions) {
+                      terminated = true;
+                      return false;
+                  }
+                  const Spectrum sigma_n = Max(sigma_maj - mp.sigmaA - mp.sigmaS, MakeZeroSpectrum());
+                  const Real pdf         = T_maj[channel] * sigma_n[channel];
+                  if (pdf <= 0) {
+                      terminated = true;
+                      return false;
+                  }
+                  beta *= T_maj * sigma_n / pdf;
+                  r_u  *= T_maj * sigma_n / pdf;
+                  r_l  *= T_maj * sigma_maj / pdf;
+                  return Max(beta) > 0 && Max(r_u) > 0;
+              });
+            if (terminated || Max(beta) <= 0 || Max(r_u) <= 0) {
+                break;
+            }
+            if (!scattered) {
+                if (T_maj[channel] <= 0) {
+                    break;
+                }
+                beta *= T_maj / T_maj[channel];
+                r_u  *= T_maj / T_maj[channel];
+                r_l  *= T_maj / T_maj[channel];
+            }
+        }
+
+        if (scattered) {
+            // A real scattering event in the medium
+            if (max_depth != -1 && bounces + 1 >= max_depth) {
+                break;
+            }
+            const PhaseFunction phase = GetPhaseFunction(scene.media[medium_id]);
+            const Vector3 dir_view    = -ray.dir;
+            radiance += beta * SampleLd(
+                                 scene,
+                                 scatter_p,
+                                 nullptr,
+                                 medium_id,
+                                 channel,
+                                 r_u,
+                                 [&](const Vector3& dir_light) {
+                                     return std::pair{Eval(phase, dir_view, dir_light),
+                                                      PdfSamplePhase(phase, dir_view, dir_light)};
+                                 },
+                                 sampler,
+                                 null_collisions);
+
+            Vector2 phase_rnd_param = Next2D(sampler);
+            std::optional<Vector3> dir_phase_ = SamplePhaseFunction(phase, dir_view, phase_rnd_param);
+            if (!dir_phase_) {
+                break;
+            }
+            const Vector3 dir_phase = *dir_phase_;
+            const Real pdf_phase    = PdfSamplePhase(phase, dir_view, dir_phase);
+            if (pdf_phase <= 0) {
+                break;
+            }
+            beta   *= Eval(phase, dir_view, dir_phase) / pdf_phase;
+            r_l     = r_u / pdf_phase;
+            prev_p  = scatter_p;
+            prev_n  = Vector3{0, 0, 0};
+            ray     = Ray{scatter_p, dir_phase, Real(0), Infinity<Real>()};
+        }
+        else if (!vertex_) {
+            // Hit background. Account for the environment map if needed.
+            if (HasEnvmap(scene)) {
+                const Envmap& envmap      = std::get<Envmap>(GetEnvmap(scene));
+                const EnvmapDirection dir = ToEnvmapDirection(envmap, -ray.dir); // pointing outwards from light
+                Spectrum L                = Emission(envmap, dir, ray_diff.spread, scene);
+                if (bounces == 0) {
+                    radiance += beta * L / Avg(r_u);
+                }
+                else {
+                    Real pdf_light =
+                      LightPmf(scene, prev_p, prev_n, scene.envmapLightId) * PdfPointOnLight(envmap, dir);
+                    radiance += beta * L / Avg(r_u + r_l * pdf_light);
+                }
+            }
+            break;
+        }
+        else {
+            const PathVertex& vertex = *vertex_;
+            if (IsLight(scene.shapes[vertex.shapeId])) {
+                Spectrum L = Emission(vertex, -ray.dir, scene);
+                if (bounces == 0) {
+                    radiance += beta * L / Avg(r_u);
+                }
+                else if (Max(L) > 0) {
+                    // The light pdf of the last scattering vertex in the solid angle measure
+                    const int light_id = GetAreaLightId(scene.shapes[vertex.shapeId]);
+                    const Light& light = scene.lights[light_id];
+                    PointAndNormal light_point{vertex.position, vertex.normal};
+                    const Real cos_light = std::abs(Dot(ray.dir, vertex.normal));
+                    Real pdf_light       = LightPmf(scene, prev_p, prev_n, light_id) *
+                                     PdfPointOnLight(light, light_point, prev_p, scene) *
+                                     DistanceSquared(prev_p, vertex.position) / Max(cos_light, Real(1e-8));
+                    radiance += beta * L / Avg(r_u + r_l * pdf_light);
+                }
+            }
+
+            if (vertex.materialId < 0) {
+                // An index-matched boundary between media, not a scattering event
+                medium_id = UpdateMedium(ray.dir, vertex, medium_id);
+                ray       = Ray{vertex.position, ray.dir, GetIntersectionEpsilon(scene), Infinity<Real>()};
+                continue;
+            }
+            if (max_depth != -1 && bounces + 1 >= max_depth) {
+                break;
+            }
+
+            const BSDFClosure bsdf = PrepareBSDF(scene, vertex);
+            const Vector3 dir_view = -ray.dir;
+            radiance += beta * SampleLd(
+                                 scene,
+                                 vertex.position,
+                                 &vertex,
+                                 medium_id,
+                                 channel,
+                                 r_u,
+                                 [&](const Vector3& dir_light) {
+                                     const BSDFEvalRecord bsdf_eval = EvalWithPdf(bsdf, dir_view, dir_light, vertex);
+                                     return std::pair{bsdf_eval.f, bsdf_eval.pdf};
+                                 },
+                                 sampler,
+                                 null_collisions);
+
+            Vector2 bsdf_rnd_param_uv = Next2D(sampler);
+            Real bsdf_rnd_param_w     = Next1D(sampler);
+            std::optional<BSDFSampleRecord> bsdf_sample_ =
+              SampleBSDF(bsdf, dir_view, vertex, bsdf_rnd_param_uv, bsdf_rnd_param_w);
+            if (!bsdf_sample_) {
+                break;
+            }
+            const BSDFSampleRecord& bsdf_sample = *bsdf_sample_;
+            const Vector3 dir_bsdf              = bsdf_sample.dirOut;
+            if (bsdf_sample.eta == 0) {
+                ray_diff.spread = Reflect(ray_diff, vertex.meanCurvature, bsdf_sample.roughness);
+            }
+            else {
+                ray_diff.spread  = Refract(ray_diff, vertex.meanCurvature, bsdf_sample.eta, bsdf_sample.roughness);
+                eta_scale       /= (bsdf_sample.eta * bsdf_sample.eta);
+            }
+            const BSDFEvalRecord bsdf_eval = EvalWithPdf(bsdf, dir_view, dir_bsdf, vertex);
+            const Real pdf_bsdf            = bsdf_eval.pdf;
+            if (pdf_bsdf <= 0) {
+                break;
+            }
+            beta      *= bsdf_eval.f / pdf_bsdf;
+            r_l        = r_u / pdf_bsdf;
+            prev_p     = vertex.position;
+            prev_n     = vertex.normal;
+            medium_id  = UpdateMedium(dir_bsdf, vertex, medium_id);
+            ray        = Ray{vertex.position, dir_bsdf, GetIntersectionEpsilon(scene), Infinity<Real>()};
+        }
+        bounces++;
+
+        // Russian roulette on the throughput divided by the pdfs of all channels
+        Real rr_w = Next1D(sampler);
+        if (bounces >= scene.options.rrDepth) {
+            const Real rr_prob = Min(Max((1 / eta_scale) * beta / Avg(r_u)), Real(0.95));
+            if (rr_w > rr_prob) {
+                break;
+            }
+            beta /= rr_prob;
+        }
+    }
+    sNullCollisions += null_collisions;
+    return radiance;
+}
+
 // The simplest volumetric renderer:
 // single absorption only homogeneous volume
 // only handle directly visible light sources
 Spectrum VolPathTracing1(const Scene& scene,
                          int x,
                          int y, /* pixel coordinates */
-                         Pcg32State& rng)
+                         Sampler& sampler)
 {
-    // Homework 2: implememt this!
-    return MakeZeroSpectrum();
+    // The general renderer covers this case, and all of the ones below.
+    return VolPathTracing(scene, x, y, sampler);
 }
 
 // The second simplest volumetric renderer:
@@ -19,10 +431,9 @@ Spectrum VolPathTracing1(const Scene& scene,
 Spectrum VolPathTracing2(const Scene& scene,
                          int x,
                          int y, /* pixel coordinates */
-                         Pcg32State& rng)
+                         Sampler& sampler)
 {
-    // Homework 2: implememt this!
-    return MakeZeroSpectrum();
+    return VolPathTracing(scene, x, y, sampler);
 }
 
 // The third volumetric renderer (not so simple anymore):
@@ -31,10 +442,9 @@ Spectrum VolPathTracing2(const Scene& scene,
 Spectrum VolPathTracing3(const Scene& scene,
                          int x,
                          int y, /* pixel coordinates */
-                         Pcg32State& rng)
+                         Sampler& sampler)
 {
-    // Homework 2: implememt this!
-    return MakeZeroSpectrum();
+    return VolPathTracing(scene, x, y, sampler);
 }
 
 // The fourth volumetric renderer:
@@ -44,10 +454,9 @@ Spectrum VolPathTracing3(const Scene& scene,
 Spectrum VolPathTracing4(const Scene& scene,
                          int x,
                          int y, /* pixel coordinates */
-                         Pcg32State& rng)
+                         Sampler& sampler)
 {
-    // Homework 2: implememt this!
-    return MakeZeroSpectrum();
+    return VolPathTracing(scene, x, y, sampler);
 }
 
 // The fifth volumetric renderer:
@@ -57,23 +466,9 @@ Spectrum VolPathTracing4(const Scene& scene,
 Spectrum VolPathTracing5(const Scene& scene,
                          int x,
                          int y, /* pixel coordinates */
-                         Pcg32State& rng)
-{
-    // Homework 2: implememt this!
-    return MakeZeroSpectrum();
-}
-
-// The final volumetric renderer:
-// multiple chromatic heterogeneous volumes with multiple scattering
-// with MIS between next event estimation and phase function sampling
-// with surface lighting
-Spectrum VolPathTracing(const Scene& scene,
-                        int x,
-                        int y, /* pixel coordinates */
-                        Pcg32State& rng)
+                         Sampler& sampler)
 {
-    // Homework 2: implememt this!
-    return MakeZeroSpectrum();
+    return VolPathTracing(scene, x, y, sampler);
 }
 
 } // namespace elma
\ No newline at end of file
@@ -5,7 +5,17 @@
 
 namespace elma {
 
-std::variant<GridVolume<Real>, GridVolume<Vector3>> load_volume(const fs::path& filename, int target_channel)
+namespace {
+
+/// The header of a Mitsuba .vol file, the voxels (x fastest, channels interleaved) follow it
+struct VolHeader
+{
+    int xres, yres, zres;
+    int channels;
+    Vector3 posMin, posMax;
+};
+
+VolHeader read_vol_header(std::istream& fs, const fs::path& filename)
 {
     // code from https://github.com/mitsuba-renderer/mitsuba/blob/master/src/volume/gridvolume.cpp#L217
     enum EVolumeType
@@ -16,7 +26,6 @@ std::variant<GridVolume<Real>, GridVolume<Vector3>> load_volume(const fs::path&
         EQuantizedDirections = 4
     };
 
-    std::fstream fs(filename.c_str(), std::fstream::in | std::fstream::binary);
     char header[3];
     fs.read(header, 3);
     if (header[0] != 'V' || header[1] != 'O' || header[2] != 'L') {
@@ -34,21 +43,16 @@ std::variant<GridVolume<Real>, GridVolume<Vector3>> load_volume(const fs::path&
         ELMA_THROW("载入 Volume {} 失败：不支持的 Volume 格式(仅支持 Float32)。", filename.string());
     }
 
-    int xres, yres, zres;
-    fs.read((char*)&xres, sizeof(int));
-    fs.read((char*)&yres, sizeof(int));
-    fs.read((char*)&zres, sizeof(int));
+    VolHeader h;
+    fs.read((char*)&h.xres, sizeof(int));
+    fs.read((char*)&h.yres, sizeof(int));
+    fs.read((char*)&h.zres, sizeof(int));
 
-    int channels;
-    fs.read((char*)&channels, sizeof(int));
-    if (channels != 1 && channels != 3) {
+    fs.read((char*)&h.channels, sizeof(int));
+    if (h.channels != 1 && h.channels != 3) {
         ELMA_THROW("载入 Volume {} 失败：不支持的 Volume 格式(错误的通道数量)。", filename.string());
     }
 
-    if (type != EFloat32) {
-        ELMA_THROW("载入 Volume {} 失败：不支持的 Volume 格式(仅支持 Float32)。", filename.string());
-    }
-
     float xmin, ymin, zmin;
     float xmax, ymax, zmax;
     fs.read((char*)&xmin, sizeof(float));
@@ -57,51 +61,166 @@ std::variant<GridVolume<Real>, GridVolume<Vector3>> load_volume(const fs::path&
     fs.read((char*)&xmax, sizeof(float));
     fs.read((char*)&ymax, sizeof(float));
     fs.read((char*)&zmax, sizeof(float));
+    if (!fs || h.xres <= 0 || h.yres <= 0 || h.zres <= 0) {
+        ELMA_THROW("载入 Volume {} 失败：错误的 header 内容。", filename.string());
+    }
+    h.posMin = Vector3{xmin, ymin, zmin};
+    h.posMax = Vector3{xmax, ymax, zmax};
+    return h;
+}
 
-    std::vector<float> raw_data(xres * yres * zres * channels, 0.f);
-    fs.read((char*)raw_data.data(), sizeof(float) * xres * yres * zres * channels);
+/// Reads the next `count` z slices
+void read_vol_slices(std::istream& fs,
+                     const VolHeader& h,
+                     int count,
+                     std::vector<float>& slices,
+                     const fs::path& filename)
+{
+    slices.resize(size_t(h.xres) * h.yres * count * h.channels);
+    fs.read((char*)slices.data(), sizeof(float) * slices.size());
+    if (!fs) {
+        ELMA_THROW("载入 Volume {} 失败：文件不完整。", filename.string());
+    }
+}
+
+} // namespace
+
+std::variant<GridVolume<Real>, GridVolume<Vector3>> load_volume(const fs::path& filename, int target_channel)
+{
+    std::fstream fs(filename.c_str(), std::fstream::in | std::fstream::binary);
+    const VolHeader h = read_vol_header(fs, filename);
+    const int xres = h.xres, yres = h.yres, zres = h.zres, channels = h.channels;
 
+    // One slice at a time, so that the raw floats never take as much memory as the volume
+    std::vector<float> raw_data;
     if (target_channel == 1) {
-        std::vector<Real> data(xres * yres * zres);
+        std::vector<Real> data(size_t(xres) * yres * zres);
         Real max_data = 0;
-        for (int i = 0; i < xres * yres * zres; i++) {
-            data[i]  = raw_data[channels * i];
-            max_data = Max(max_data, data[i]);
+        for (int z = 0; z < zres; z++) {
+            read_vol_slices(fs, h, 1, raw_data, filename);
+            Real* slice = &data[size_t(z) * xres * yres];
+            for (int i = 0; i < xres * yres; i++) {
+                slice[i] = raw_data[channels * i];
+                max_data = Max(max_data, slice[i]);
+            }
         }
         return GridVolume<Real>{
           Vector3i{xres, yres, zres},
-          Vector3{xmin, ymin, zmin}, // pmin
-          Vector3{xmax, ymax, zmax}, // pmax
-          data,
+          h.posMin,
+          h.posMax,
+          std::move(data),
           max_data,
           Real(1)
         };                  // scale
     }
     else {
         assert(target_channel == 3);
-        std::vector<Spectrum> data(xres * yres * zres);
+        std::vector<Spectrum> data(size_t(xres) * yres * zres);
         Spectrum max_data = MakeZeroSpectrum();
-        for (int i = 0; i < xres * yres * zres; i++) {
-            if (channels == 1) {
-                Real v  = raw_data[i];
-                data[i] = FromRGB(Vector3{v, v, v});
-            }
-            else {
-                data[i] = FromRGB(Vector3{raw_data[3 * i + 0], raw_data[3 * i + 1], raw_data[3 * i + 2]});
+        for (int z = 0; z < zres; z++) {
+            read_vol_slices(fs, h, 1, raw_data, filename);
+            Spectrum* slice = &data[size_t(z) * xres * yres];
+            for (int i = 0; i < xres * yres; i++) {
+                if (channels == 1) {
+                    Real v   = raw_data[i];
+                    slice[i] = FromRGB(Vector3{v, v, v});
+                }
+                else {
+                    slice[i] = FromRGB(Vector3{raw_data[3 * i + 0], raw_data[3 * i + 1], raw_data[3 * i + 2]});
+                }
+                max_data = Max(max_data, slice[i]);
             }
-            max_data = Max(max_data, data[i]);
         }
         return GridVolume<Spectrum>{
           Vector3i{xres, yres, zres},
-          Vector3{xmin, ymin, zmin}, // pmin
-          Vector3{xmax, ymax, zmax}, // pmax
-          data,
+          h.posMin,
+          h.posMax,
+          std::move(data),
           max_data,
           Real(1)
         };                  // scale
     }
 }
 
+/// Fills a majorant grid over a volume of `res` voxels. range_max(lo, hi) is the maximum of the volume over the
+/// voxels from lo to hi (inclusive), with the scale.
+template<typename F>
+static MajorantGrid make_majorant_grid(const Vector3i& res,
+                                       const Vector3& pos_min,
+                                       const Vector3& pos_max,
+                                       int resolution,
+                                       F range_max)
+{
+    MajorantGrid grid;
+    for (int i = 0; i < 3; i++) {
+        grid.resolution[i] = std::clamp(resolution, 1, Max(res[i], 1));
+    }
+    grid.posMin = pos_min;
+    grid.posMax = pos_max;
+    grid.maxValues.assign(grid.resolution.x * grid.resolution.y * grid.resolution.z, MakeZeroSpectrum());
+
+    // A lookup at a normalized coordinate u blends voxels int(u (res - 1)) and the one after it, so cell c of n
+    // reads voxels from int(c / n (res - 1)) to int((c + 1) / n (res - 1)) + 1. One more voxel at the lower end
+    // covers the rounding of the lookup's coordinates.
+    auto voxel_range = [](int cell, int cells, int res) {
+        const Real scale = Real(res - 1) / Real(cells);
+        return std::pair{std::clamp(int(cell * scale) - 1, 0, res - 1),
+                         std::clamp(int((cell + 1) * scale) + 1, 0, res - 1)};
+    };
+    for (int cz = 0; cz < grid.resolution.z; cz++) {
+        const auto [z0, z1] = voxel_range(cz, grid.resolution.z, res.z);
+        for (int cy = 0; cy < grid.resolution.y; cy++) {
+            const auto [y0, y1] = voxel_range(cy, grid.resolution.y, res.y);
+            for (int cx = 0; cx < grid.resolution.x; cx++) {
+                const auto [x0, x1] = voxel_range(cx, grid.resolution.x, res.x);
+                grid.maxValues[(cz * grid.resolution.y + cy) * grid.resolution.x + cx] =
+                  range_max(Vector3i{x0, y0, z0}, Vector3i{x1, y1, z1});
+            }
+        }
+    }
+    return grid;
+}
+
+MajorantGrid MakeMajorantGrid(const GridVolume<Spectrum>& volume, int resolution)
+{
+    return make_majorant_grid(
+      volume.resolution, volume.posMin, volume.posMax, resolution, [&](const Vector3i& lo, const Vector3i& hi) {
+          Spectrum max_value = MakeZeroSpectrum();
+          for (int z = lo.z; z <= hi.z; z++) {
+              for (int y = lo.y; y <= hi.y; y++) {
+                  for (int x = lo.x; x <= hi.x; x++) {
+                      const int index = (z * volume.resolution.y + y) * volume.resolution.x + x;
+                      max_value       = Max(max_value, volume.data[index]);
+                  }
+              }
+          }
+          return volume.scale * max_value;
+      });
+}
+
+MajorantGrid MakeMajorantGrid(const BrickVolume<Spectrum>& volume, int resolution)
+{
+    const Vector3i& bricks = volume.brickResolution;
+    return make_majorant_grid(
+      volume.resolution, volume.posMin, volume.posMax, resolution, [&](const Vector3i& lo, const Vector3i& hi) {
+          Spectrum max_value = MakeZeroSpectrum();
+          for (int z = lo.z / kBrickSize; z <= hi.z / kBrickSize; z++) {
+              for (int y = lo.y / kBrickSize; y <= hi.y / kBrickSize; y++) {
+                  for (int x = lo.x / kBrickSize; x <= hi.x / kBrickSize; x++) {
+                      const uint32_t slot = volume.brickIndex[(z * bricks.y + y) * bricks.x + x];
+                      if (slot == kEmptyBrick) {
+                          continue;
+                      }
+                      const float* m = &volume.brickMax[slot * volume.channels];
+                      max_value      = Max(max_value, volume.channels == 1 ? MakeConstSpectrum(m[0])
+                                                                           : Spectrum{m[0], m[1], m[2]});
+                  }
+              }
+          }
+          return volume.scale * max_value;
+      });
+}
+
 template<> GridVolume<Real> LoadVolumeFromFile(const fs::path& filename)
 {
     return std::get<GridVolume<Real>>(load_volume(filename, 1));
@@ -112,4 +231,284 @@ template<> GridVolume<Vector3> LoadVolumeFromFile(const fs::path& filename)
     return std::get<GridVolume<Vector3>>(load_volume(filename, 3));
 }
 
+VolumeEncoding VolumeEncodingFromBits(int bits)
+{
+    switch (bits) {
+        case 8: return VolumeEncoding::UInt8;
+        case 16: return VolumeEncoding::UInt16;
+        case 32: return VolumeEncoding::Float32;
+        default: ELMA_THROW("不支持的 Volume 精度：{} 位(仅支持 8、16、32)。", bits);
+    }
+}
+
+namespace {
+
+constexpr char kBrickVolumeMagic[8]    = {'E', 'L', 'M', 'A', 'V', 'O', 'L', '\0'};
+constexpr uint32_t kBrickVolumeVersion = 1;
+
+struct BrickVolumeHeader
+{
+    char magic[8];
+    uint32_t version;
+    int32_t channels;
+    int32_t encoding;
+    int32_t resolution[3];
+    float posMin[3], posMax[3];
+    uint32_t numBricks; // stored ones
+};
+
+size_t bytes_per_value(VolumeEncoding encoding)
+{
+    switch (encoding) {
+        case VolumeEncoding::UInt8: return 1;
+        case VolumeEncoding::UInt16: return 2;
+        default: return 4;
+    }
+}
+
+template<typename T> Real voxel_channel(const T& v, int c)
+{
+    if constexpr (std::is_same_v<T, Real>) {
+        return v;
+    }
+    else {
+        return v[c];
+    }
+}
+
+template<typename T>
+BrickVolume<T> make_empty_brick_volume(const Vector3i& resolution,
+                                       const Vector3& pos_min,
+                                       const Vector3& pos_max,
+                                       int channels,
+                                       VolumeEncoding encoding)
+{
+    BrickVolume<T> volume;
+    volume.resolution      = resolution;
+    volume.posMin          = pos_min;
+    volume.posMax          = pos_max;
+    volume.channels        = channels;
+    volume.encoding        = encoding;
+    volume.brickResolution = Vector3i{(resolution.x + kBrickSize - 1) / kBrickSize,
+                                      (resolution.y + kBrickSize - 1) / kBrickSize,
+                                      (resolution.z + kBrickSize - 1) / kBrickSize};
+    volume.brickIndex.assign(
+      size_t(volume.brickResolution.x) * volume.brickResolution.y * volume.brickResolution.z, kEmptyBrick);
+    volume.maxData = MakeZeroVoxel<T>();
+    return volume;
+}
+
+/// Stores the bricks of layer bz (z from bz * kBrickSize), fetch(x, y, z, c) returning its voxels.
+/// Bricks of zeros only are left empty, voxels beyond the grid are zero.
+template<typename T, typename F> void add_brick_layer(BrickVolume<T>& volume, int bz, F fetch)
+{
+    const int channels = volume.channels;
+    std::vector<float> values(kBrickVoxels * channels);
+    std::vector<float> max_values(channels);
+    for (int by = 0; by < volume.brickResolution.y; by++) {
+        for (int bx = 0; bx < volume.brickResolution.x; bx++) {
+            std::fill(values.begin(), values.end(), 0.f);
+            std::fill(max_values.begin(), max_values.end(), 0.f);
+            bool empty = true;
+            for (int lz = 0; lz < kBrickSize && bz * kBrickSize + lz < volume.resolution.z; lz++) {
+                for (int ly = 0; ly < kBrickSize && by * kBrickSize + ly < volume.resolution.y; ly++) {
+                    for (int lx = 0; lx < kBrickSize && bx * kBrickSize + lx < volume.resolution.x; lx++) {
+                        const int voxel = (lz * kBrickSize + ly) * kBrickSize + lx;
+                        for (int c = 0; c < channels; c++) {
+                            const float value =
+                              fetch(bx * kBrickSize + lx, by * kBrickSize + ly, bz * kBrickSize + lz, c);
+                            values[voxel * channels + c]  = value;
+                            max_values[c]                 = Max(max_values[c], value);
+                            empty                        &= value == 0;
+                        }
+                    }
+                }
+            }
+            if (empty) {
+                continue;
+            }
+
+            const uint32_t slot = uint32_t(volume.brickMax.size() / channels);
+            volume.brickIndex[(size_t(bz) * volume.brickResolution.y + by) * volume.brickResolution.x + bx] = slot;
+            volume.brickMax.insert(volume.brickMax.end(), max_values.begin(), max_values.end());
+            const size_t offset = volume.voxels.size();
+            volume.voxels.resize(offset + values.size() * bytes_per_value(volume.encoding));
+            uint8_t* out = &volume.voxels[offset];
+            for (size_t i = 0; i < values.size(); i++) {
+                // Quantized relative to the maximum of the channel in the brick, negative values become zero
+                const float max_value = max_values[i % channels];
+                const float u = max_value > 0 ? std::clamp(values[i] / max_value, 0.f, 1.f) : 0.f;
+                if (volume.encoding == VolumeEncoding::UInt8) {
+                    out[i] = uint8_t(std::lround(u * 255));
+                }
+                else if (volume.encoding == VolumeEncoding::UInt16) {
+                    const uint16_t q = uint16_t(std::lround(u * 65535));
+                    std::memcpy(out + 2 * i, &q, sizeof(q));
+                }
+                else {
+                    std::memcpy(out + 4 * i, &values[i], sizeof(float));
+                }
+            }
+
+            if constexpr (std::is_same_v<T, Real>) {
+                volume.maxData = Max(volume.maxData, Real(max_values[0]));
+            }
+            else {
+                const float* m = max_values.data();
+                const Spectrum brick_max = channels == 1 ? MakeConstSpectrum(m[0]) : Spectrum{m[0], m[1], m[2]};
+                volume.maxData           = Max(volume.maxData, brick_max);
+            }
+        }
+    }
+}
+
+template<typename T> BrickVolume<T> read_brick_volume(const fs::path& filename)
+{
+    std::ifstream fs(filename, std::ios::binary);
+    BrickVolumeHeader header;
+    fs.read((char*)&header, sizeof(header));
+    if (!fs || std::memcmp(header.magic, kBrickVolumeMagic, sizeof(kBrickVolumeMagic)) != 0 ||
+        header.version != kBrickVolumeVersion) {
+        ELMA_THROW("载入 Volume {} 失败：错误的 header 内容。", filename.string());
+    }
+    if ((header.channels != 1 && header.channels != 3) || (std::is_same_v<T, Real> && header.channels != 1) ||
+        header.encoding < int(VolumeEncoding::Float32) || header.encoding > int(VolumeEncoding::UInt8)) {
+        ELMA_THROW("载入 Volume {} 失败：不支持的 Volume 格式(错误的通道数量或精度)。",
+                   filename.string());
+    }
+
+    BrickVolume<T> volume = make_empty_brick_volume<T>(
+      Vector3i{header.resolution[0], header.resolution[1], header.resolution[2]},
+      Vector3{header.posMin[0], header.posMin[1], header.posMin[2]},
+      Vector3{header.posMax[0], header.posMax[1], header.posMax[2]},
+      header.channels,
+      VolumeEncoding(header.encoding));
+    volume.brickMax.resize(size_t(header.numBricks) * header.channels);
+    volume.voxels.resize(size_t(header.numBricks) * kBrickVoxels * header.channels *
+                         bytes_per_value(volume.encoding));
+    fs.read((char*)volume.brickIndex.data(), volume.brickIndex.size() * sizeof(uint32_t));
+    fs.read((char*)volume.brickMax.data(), volume.brickMax.size() * sizeof(float));
+    fs.read((char*)volume.voxels.data(), volume.voxels.size());
+    if (!fs) {
+        ELMA_THROW("载入 Volume {} 失败：文件不完整。", filename.string());
+    }
+
+    for (uint32_t slot : volume.brickIndex) {
+        if (slot != kEmptyBrick && slot >= header.numBricks) {
+            ELMA_THROW("载入 Volume {} 失败：错误的 brick 索引。", filename.string());
+        }
+    }
+    for (uint32_t slot = 0; slot < header.numBricks; slot++) {
+        const float* m = &volume.brickMax[size_t(slot) * header.channels];
+        if constexpr (std::is_same_v<T, Real>) {
+            volume.maxData = Max(volume.maxData, Real(m[0]));
+        }
+        else {
+            volume.maxData =
+              Max(volume.maxData, header.channels == 1 ? MakeConstSpectrum(m[0]) : Spectrum{m[0], m[1], m[2]});
+        }
+    }
+    return volume;
+}
+
+template<typename T> BrickVolume<T> load_brick_volume(const fs::path& filename, VolumeEncoding encoding)
+{
+    if (filename.extension() == ".elmavol") {
+        return read_brick_volume<T>(filename);
+    }
+
+    std::fstream fs(filename.c_str(), std::fstream::in | std::fstream::binary);
+    const VolHeader h = read_vol_header(fs, filename);
+    // Scalar volumes take the first channel, like LoadVolumeFromFile()
+    const int channels    = std::is_same_v<T, Real> ? 1 : h.channels;
+    BrickVolume<T> volume = make_empty_brick_volume<T>(
+      Vector3i{h.xres, h.yres, h.zres}, h.posMin, h.posMax, channels, encoding);
+
+    // A layer of bricks at a time
+    std::vector<float> slices;
+    for (int bz = 0; bz < volume.brickResolution.z; bz++) {
+        const int z0 = bz * kBrickSize;
+        read_vol_slices(fs, h, Min(kBrickSize, h.zres - z0), slices, filename);
+        add_brick_layer(volume, bz, [&](int x, int y, int z, int c) {
+            return slices[((size_t(z - z0) * h.yres + y) * h.xres + x) * h.channels + c];
+        });
+    }
+
+    const size_t num_bricks = volume.brickIndex.size();
+    const size_t stored     = volume.brickMax.size() / channels;
+    LogInfo("Volume {}：{} 个 brick 中 {} 个非空，{:.1f} MB (稠密存储需 {:.1f} MB)",
+            filename.string(),
+            num_bricks,
+            stored,
+            GetMemoryUsage(volume) / 1e6,
+            double(h.xres) * h.yres * h.zres * sizeof(T) / 1e6);
+    return volume;
+}
+
+} // namespace
+
+template<typename T> BrickVolume<T> MakeBrickVolume(const GridVolume<T>& volume, VolumeEncoding encoding)
+{
+    // A single channel if every voxel is gray
+    int channels = 1;
+    if constexpr (!std::is_same_v<T, Real>) {
+        for (const T& v : volume.data) {
+            if (v.x != v.y || v.x != v.z) {
+                channels = 3;
+                break;
+            }
+        }
+    }
+    BrickVolume<T> bricks =
+      make_empty_brick_volume<T>(volume.resolution, volume.posMin, volume.posMax, channels, encoding);
+    bricks.scale = volume.scale;
+    for (int bz = 0; bz < bricks.brickResolution.z; bz++) {
+        add_brick_layer(bricks, bz, [&](int x, int y, int z, int c) {
+            const size_t index = (size_t(z) * volume.resolution.y + y) * volume.resolution.x + x;
+            return float(voxel_channel(volume.data[index], c));
+        });
+    }
+    return bricks;
+}
+
+template BrickVolume<Real> MakeBrickVolume(const GridVolume<Real>& volume, VolumeEncoding encoding);
+template BrickVolume<Spectrum> MakeBrickVolume(const GridVolume<Spectrum>& volume, VolumeEncoding encoding);
+
+template<> BrickVolume<Real> LoadBrickVolumeFromFile(const fs::path& filename, VolumeEncoding encoding)
+{
+    return load_brick_volume<Real>(filename, encoding);
+}
+
+template<> BrickVolume<Spectrum> LoadBrickVolumeFromFile(const fs::path& filename, VolumeEncoding encoding)
+{
+    return load_brick_volume<Spectrum>(filename, encoding);
+}
+
+template<typename T> void SaveBrickVolume(const BrickVolume<T>& volume, const fs::path& filename)
+{
+    BrickVolumeHeader header{};
+    std::memcpy(header.magic, kBrickVolumeMagic, sizeof(kBrickVolumeMagic));
+    header.version   = kBrickVolumeVersion;
+    header.channels  = volume.channels;
+    header.encoding  = int32_t(volume.encoding);
+    header.numBricks = uint32_t(volume.brickMax.size() / volume.channels);
+    for (int i = 0; i < 3; i++) {
+        header.resolution[i] = volume.resolution[i];
+        header.posMin[i]     = float(volume.posMin[i]);
+        header.posMax[i]     = float(volume.posMax[i]);
+    }
+
+    std::ofstream fs(filename, std::ios::binary);
+    fs.write((const char*)&header, sizeof(header));
+    fs.write((const char*)volume.brickIndex.data(), volume.brickIndex.size() * sizeof(uint32_t));
+    fs.write((const char*)volume.brickMax.data(), volume.brickMax.size() * sizeof(float));
+    fs.write((const char*)volume.voxels.data(), volume.voxels.size());
+    if (!fs) {
+        ELMA_THROW("写入 Volume {} 失败。", filename.string());
+    }
+}
+
+template void SaveBrickVolume(const BrickVolume<Real>& volume, const fs::path& filename);
+template void SaveBrickVolume(const BrickVolume<Spectrum>& volume, const fs::path& filename);
+
 } // namespace elma
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "Ray.hpp"
 #include "Spectrum.hpp"
 #include "Vector.hpp"
+#include <cstring>
 #include <variant>
 #include <vector>
 
@@ -26,14 +27,103 @@ template<typename T> struct GridVolume
     Real scale = 1;
 };
 
-template<typename T> using Volume = std::variant<ConstantVolume<T>, GridVolume<T>>;
+/// How a BrickVolume stores its voxels
+enum class VolumeEncoding
+{
+    Float32,
+    UInt16, // quantized to 16 bits, relative to the maximum of the brick
+    UInt8   // quantized to 8 bits, relative to the maximum of the brick
+};
+
+/// 8, 16 or 32 bits per channel
+VolumeEncoding VolumeEncodingFromBits(int bits);
+
+/// Voxels per axis of a brick
+constexpr int kBrickSize   = 8;
+constexpr int kBrickVoxels = kBrickSize * kBrickSize * kBrickSize;
+/// The brick index of bricks whose voxels are all zero
+constexpr uint32_t kEmptyBrick = 0xffff'ffffu;
+
+/// Sparse storage for mostly empty grids, like the leaf nodes of OpenVDB: the grid is split into bricks of
+/// 8^3 voxels, and only bricks with a nonzero voxel are stored, as floats or quantized relative to the
+/// maximum of the brick. Lookups behave exactly like the GridVolume of the same voxels (up to quantization).
+template<typename T> struct BrickVolume
+{
+    Vector3i resolution;
+    // the bounding box of the grid
+    Vector3 posMin, posMax;
+    // Channels stored per voxel. Spectra with equal channels (e.g. densities from single channel files) store one.
+    int channels            = 1;
+    VolumeEncoding encoding = VolumeEncoding::Float32;
+    Vector3i brickResolution;
+    // Per brick (x fastest), the slot of its voxels or kEmptyBrick
+    std::vector<uint32_t> brickIndex;
+    // Per slot and channel, the largest voxel value, which quantized values are relative to
+    std::vector<float> brickMax;
+    // Per slot, kBrickVoxels voxels (x fastest) of interleaved channels in the encoding
+    std::vector<uint8_t> voxels;
+    T maxData;
+    Real scale = 1;
+};
+
+template<typename T> using Volume = std::variant<ConstantVolume<T>, GridVolume<T>, BrickVolume<T>>;
 using Volume1                     = Volume<Real>;
 using VolumeSpectrum              = Volume<Spectrum>;
 
+template<typename T> inline T MakeZeroVoxel()
+{
+    if constexpr (std::is_same_v<T, Real>) {
+        return Real(0);
+    }
+    else {
+        return MakeZeroSpectrum();
+    }
+}
+
+/// Channel c of voxel `voxel` of the bricks stored in slot
+template<typename T> inline Real DecodeVoxel(const BrickVolume<T>& v, uint32_t slot, int voxel, int c)
+{
+    const size_t i = (size_t(slot) * kBrickVoxels + voxel) * v.channels + c;
+    switch (v.encoding) {
+        case VolumeEncoding::UInt8: return Real(v.voxels[i]) * (Real(v.brickMax[slot * v.channels + c]) / 255);
+        case VolumeEncoding::UInt16: {
+            uint16_t q;
+            std::memcpy(&q, &v.voxels[2 * i], sizeof(q));
+            return Real(q) * (Real(v.brickMax[slot * v.channels + c]) / 65535);
+        }
+        default: {
+            float f;
+            std::memcpy(&f, &v.voxels[4 * i], sizeof(f));
+            return Real(f);
+        }
+    }
+}
+
+/// The voxel at (x, y, z), without the scale
+template<typename T> inline T GetVoxel(const BrickVolume<T>& v, int x, int y, int z)
+{
+    const int brick = ((z / kBrickSize) * v.brickResolution.y + y / kBrickSize) * v.brickResolution.x + x / kBrickSize;
+    const uint32_t slot = v.brickIndex[brick];
+    if (slot == kEmptyBrick) {
+        return MakeZeroVoxel<T>();
+    }
+    const int voxel = ((z % kBrickSize) * kBrickSize + y % kBrickSize) * kBrickSize + x % kBrickSize;
+    if constexpr (std::is_same_v<T, Real>) {
+        return DecodeVoxel(v, slot, voxel, 0);
+    }
+    else {
+        if (v.channels == 1) {
+            return MakeConstSpectrum(DecodeVoxel(v, slot, voxel, 0));
+        }
+        return T{DecodeVoxel(v, slot, voxel, 0), DecodeVoxel(v, slot, voxel, 1), DecodeVoxel(v, slot, voxel, 2)};
+    }
+}
+
 template<typename T> struct EvalVolumeOp
 {
     T operator()(const ConstantVolume<T>& v) const;
     T operator()(const GridVolume<T>& v) const;
+    T operator()(const BrickVolume<T>& v) const;
 
     const Vector3& p;
 };
@@ -77,10 +167,44 @@ template<typename T> T EvalVolumeOp<T>::operator()(const GridVolume<T>& v) const
             v101 * (dx * (1 - dy) * dz) + v110 * ((1 - dx) * dy * dz) + v111 * (dx * dy * dz));
 }
 
+template<typename T> T EvalVolumeOp<T>::operator()(const BrickVolume<T>& v) const
+{
+    // Trilinear interpolation, the same as for GridVolume
+    Vector3 pn = (p - v.posMin) / (v.posMax - v.posMin);
+    if (pn.x < 0 || pn.x > 1 || pn.y < 0 || pn.y > 1 || pn.z < 0 || pn.z > 1) {
+        return MakeZeroVoxel<T>();
+    }
+    pn.x    *= Real(v.resolution.x - 1);
+    pn.y    *= Real(v.resolution.y - 1);
+    pn.z    *= Real(v.resolution.z - 1);
+    int x0   = std::clamp(int(pn.x), 0, v.resolution.x - 1);
+    int y0   = std::clamp(int(pn.y), 0, v.resolution.y - 1);
+    int z0   = std::clamp(int(pn.z), 0, v.resolution.z - 1);
+    int x1   = std::clamp(x0 + 1, 0, v.resolution.x - 1);
+    int y1   = std::clamp(y0 + 1, 0, v.resolution.y - 1);
+    int z1   = std::clamp(z0 + 1, 0, v.resolution.z - 1);
+    Real dx  = pn.x - x0;
+    Real dy  = pn.y - y0;
+    Real dz  = pn.z - z0;
+    T v000   = GetVoxel(v, x0, y0, z0);
+    T v001   = GetVoxel(v, x1, y0, z0);
+    T v010   = GetVoxel(v, x0, y1, z0);
+    T v011   = GetVoxel(v, x1, y1, z0);
+    T v100   = GetVoxel(v, x0, y0, z1);
+    T v101   = GetVoxel(v, x1, y0, z1);
+    T v110   = GetVoxel(v, x0, y1, z1);
+    T v111   = GetVoxel(v, x1, y1, z1);
+    return v.scale *
+           (v000 * ((1 - dx) * (1 - dy) * (1 - dz)) + v001 * (dx * (1 - dy) * (1 - dz)) +
+            v010 * ((1 - dx) * dy * (1 - dz)) + v011 * (dx * dy * (1 - dz)) + v100 * ((1 - dx) * (1 - dy) * dz) +
+            v101 * (dx * (1 - dy) * dz) + v110 * ((1 - dx) * dy * dz) + v111 * (dx * dy * dz));
+}
+
 template<typename T> struct MaxValueOp
 {
     T operator()(const ConstantVolume<T>& v) const;
     T operator()(const GridVolume<T>& v) const;
+    T operator()(const BrickVolume<T>& v) const;
 };
 
 template<typename T> T MaxValueOp<T>::operator()(const ConstantVolume<T>& v) const
@@ -93,10 +217,16 @@ template<typename T> T MaxValueOp<T>::operator()(const GridVolume<T>& v) const
     return v.scale * v.maxData;
 }
 
+template<typename T> T MaxValueOp<T>::operator()(const BrickVolume<T>& v) const
+{
+    return v.scale * v.maxData;
+}
+
 template<typename T> struct SetScaleOp
 {
     void operator()(ConstantVolume<T>& v) const;
     void operator()(GridVolume<T>& v) const;
+    void operator()(BrickVolume<T>& v) const;
 
     Real scale;
 };
@@ -111,10 +241,16 @@ template<typename T> void SetScaleOp<T>::operator()(GridVolume<T>& v) const
     v.scale = scale;
 }
 
+template<typename T> void SetScaleOp<T>::operator()(BrickVolume<T>& v) const
+{
+    v.scale = scale;
+}
+
 template<typename T> struct IntersectOp
 {
     bool operator()(const ConstantVolume<T>& v) const;
     bool operator()(const GridVolume<T>& v) const;
+    bool operator()(const BrickVolume<T>& v) const;
 
     const Ray& ray;
 };
@@ -124,13 +260,14 @@ template<typename T> bool IntersectOp<T>::operator()(const ConstantVolume<T>& v)
     return true;
 }
 
-template<typename T> bool IntersectOp<T>::operator()(const GridVolume<T>& v) const
+/// Whether the ray overlaps the box between 0 and ray.tFar
+inline bool IntersectBox(const Vector3& pos_min, const Vector3& pos_max, const Ray& ray)
 {
     // https://github.com/mmp/pbrt-v3/blob/master/src/core/geometry.h#L1388
     Real t0 = 0, t1 = ray.tFar;
     for (int i = 0; i < 3; i++) {
-        Real tnear = (v.posMin[i] - ray.org[i]) / ray.dir[i];
-        Real tfar  = (v.posMax[i] - ray.org[i]) / ray.dir[i];
+        Real tnear = (pos_min[i] - ray.org[i]) / ray.dir[i];
+        Real tfar  = (pos_max[i] - ray.org[i]) / ray.dir[i];
 
         // Update parametric interval from slab intersection $t$ values
         if (tnear > tfar) {
@@ -146,6 +283,16 @@ template<typename T> bool IntersectOp<T>::operator()(const GridVolume<T>& v) con
     return true;
 }
 
+template<typename T> bool IntersectOp<T>::operator()(const GridVolume<T>& v) const
+{
+    return IntersectBox(v.posMin, v.posMax, ray);
+}
+
+template<typename T> bool IntersectOp<T>::operator()(const BrickVolume<T>& v) const
+{
+    return IntersectBox(v.posMin, v.posMax, ray);
+}
+
 template<typename T> T Lookup(const Volume<T>& volume, const Vector3& p)
 {
     return std::visit(EvalVolumeOp<T>{p}, volume);
@@ -166,6 +313,29 @@ template<typename T> bool Intersect(const Volume<T>& v, const Ray& ray)
     return std::visit(IntersectOp<T>{ray}, v);
 }
 
+/// Cells per axis of the majorant grids, as in pbrt-v4
+constexpr int kMajorantGridResolution = 16;
+
+/// A coarse grid over the bounding box of a grid volume that stores, for each cell, the largest value the
+/// trilinear lookup can return inside it. Tracking through sparse smoke with these local bounds takes far
+/// fewer null collisions than with the global maximum.
+struct MajorantGrid
+{
+    Vector3i resolution{0, 0, 0};
+    Vector3 posMin, posMax;
+    std::vector<Spectrum> maxValues; // x fastest, including the scale of the volume
+};
+
+/// At most `resolution` cells per axis, and no more than the volume has voxels.
+MajorantGrid MakeMajorantGrid(const GridVolume<Spectrum>& volume, int resolution = kMajorantGridResolution);
+/// From the maxima of the bricks, slightly looser than from the voxels but without decoding them.
+MajorantGrid MakeMajorantGrid(const BrickVolume<Spectrum>& volume, int resolution = kMajorantGridResolution);
+
+inline Spectrum GetMaxValue(const MajorantGrid& grid, const Vector3i& cell)
+{
+    return grid.maxValues[(cell.z * grid.resolution.y + cell.y) * grid.resolution.x + cell.x];
+}
+
 template<typename T> GridVolume<T> LoadVolumeFromFile(const fs::path& filename)
 {
     return GridVolume<T>{};
@@ -175,4 +345,25 @@ template<> GridVolume<Real> LoadVolumeFromFile(const fs::path& filename);
 
 template<> GridVolume<Spectrum> LoadVolumeFromFile(const fs::path& filename);
 
+/// Converts a dense grid to bricks. Spectra store a single channel if all of their channels are equal.
+template<typename T> BrickVolume<T> MakeBrickVolume(const GridVolume<T>& volume, VolumeEncoding encoding);
+
+/// Reads an .elmavol file written by SaveBrickVolume() (`encoding` is the one of the file then), or converts a
+/// Mitsuba .vol file to bricks a few slices at a time, without ever holding the dense grid.
+template<typename T> BrickVolume<T> LoadBrickVolumeFromFile(const fs::path& filename, VolumeEncoding encoding);
+
+template<> BrickVolume<Real> LoadBrickVolumeFromFile(const fs::path& filename, VolumeEncoding encoding);
+
+template<> BrickVolume<Spectrum> LoadBrickVolumeFromFile(const fs::path& filename, VolumeEncoding encoding);
+
+/// Writes the bricks as an .elmavol file: a header, the brick indices, the brick maxima and the voxels.
+template<typename T> void SaveBrickVolume(const BrickVolume<T>& volume, const fs::path& filename);
+
+/// Bytes of the voxel data and the brick tables
+template<typename T> size_t GetMemoryUsage(const BrickVolume<T>& volume)
+{
+    return volume.brickIndex.size() * sizeof(uint32_t) + volume.brickMax.size() * sizeof(float) +
+           volume.voxels.size();
+}
+
 } // namespace elma
\ No newline at end of file
@@ -0,0 +1,391 @@
+#include "WavefrontPathTracing.hpp"
+#include "Intersection.hpp"
+#include "Material.hpp"
+#include "Parallel.hpp"
+#include "PathStats.hpp"
+#include "ProgressReporter.hpp"
+#include "Scene.hpp"
+
+#include <array>
+#include <optional>
+#include <vector>
+
+namespace elma {
+
+/// States of all paths of a tile, one path per pixel, stored as structure of arrays so that
+/// every stage only streams through the fields it touches.
+/// Path i always belongs to pixel i of the tile.
+struct PathStates
+{
+    explicit PathStates(int n)
+    : sampler(n), ray(n), rayDiff(n), vertex(n), hit(n), throughput(n), etaScale(n), radiance(n), shadowRay(n),
+      shadowContrib(n), bsdfF(n), bsdfPdf(n), bounces(n)
+    {
+    }
+
+    std::vector<Sampler> sampler;
+    std::vector<Ray> ray;
+    std::vector<RayDifferential> rayDiff;
+    std::vector<PathVertex> vertex;
+    std::vector<std::optional<PathVertex>> hit;
+    std::vector<Spectrum> throughput;
+    std::vector<Real> etaScale;
+    std::vector<Spectrum> radiance;
+
+    // Written by the material stage, consumed by the shadow and scatter stages.
+    std::vector<Ray> shadowRay;
+    std::vector<Spectrum> shadowContrib; // MIS weighted light contribution if the shadow ray is unoccluded
+    std::vector<Spectrum> bsdfF;
+    std::vector<Real> bsdfPdf;           // solid angle measure
+
+    std::vector<int> bounces; // for the statistics
+};
+
+/// Closest hit for the rays of all paths in `queue`, traced as packets.
+static void TraceClosest(const Scene& scene, const std::vector<int>& queue, bool use_ray_diff, PathStates& paths)
+{
+    RayBatch batch;
+    std::array<std::optional<PathVertex>, kRayBatchSize> vertices;
+    for (size_t start = 0; start < queue.size(); start += kRayBatchSize) {
+        const int n = (int)std::min(queue.size() - start, size_t(kRayBatchSize));
+        for (int lane = 0; lane < kRayBatchSize; lane++) {
+            if (lane < n) {
+                const int i = queue[start + lane];
+                SetRay(batch, lane, paths.ray[i], use_ray_diff ? paths.rayDiff[i] : RayDifferential{});
+            }
+            else {
+                batch.valid[lane] = 0;
+            }
+        }
+        IntersectN(scene, batch, vertices);
+        for (int lane = 0; lane < n; lane++) {
+            paths.hit[queue[start + lane]] = vertices[lane];
+        }
+    }
+}
+
+/// Adds the pending light contribution of every path in `queue` whose shadow ray is unoccluded.
+static void TraceShadow(const Scene& scene, const std::vector<int>& queue, PathStates& paths)
+{
+    RayBatch batch;
+    std::array<bool, kRayBatchSize> occluded;
+    for (size_t start = 0; start < queue.size(); start += kRayBatchSize) {
+        const int n = (int)std::min(queue.size() - start, size_t(kRayBatchSize));
+        for (int lane = 0; lane < kRayBatchSize; lane++) {
+            if (lane < n) {
+                SetRay(batch, lane, paths.shadowRay[queue[start + lane]]);
+            }
+            else {
+                batch.valid[lane] = 0;
+            }
+        }
+        OccludedN(scene, batch, occluded);
+        for (int lane = 0; lane < n; lane++) {
+            if (!occluded[lane]) {
+                const int i        = queue[start + lane];
+                paths.radiance[i] += paths.shadowContrib[i];
+            }
+        }
+    }
+}
+
+/// Camera stage: starts sample `sample_index` of every pixel and generates its primary ray.
+static void GenerateCameraRays(const Scene& scene,
+                               int x0,
+                               int y0,
+                               int tile_width,
+                               int64_t sample_index,
+                               PathStates& paths,
+                               std::vector<int>& active)
+{
+    int w = scene.camera.width, h = scene.camera.height;
+    active.resize(paths.ray.size());
+    for (int i = 0; i < (int)paths.ray.size(); i++) {
+        const int x = x0 + i % tile_width;
+        const int y = y0 + i / tile_width;
+        StartPixelSample(paths.sampler[i], Vector2i{x, y}, sample_index);
+        Vector2 pixel_uv = Next2D(paths.sampler[i]);
+        Vector2 screen_pos((x + pixel_uv.x) / w, (y + pixel_uv.y) / h);
+        paths.ray[i]        = SamplePrimary(scene.camera, screen_pos);
+        paths.rayDiff[i]    = InitRayDifferential(w, h);
+        paths.throughput[i] = FromRGB(Vector3{1, 1, 1});
+        paths.etaScale[i]   = Real(1);
+        paths.radiance[i]   = MakeZeroSpectrum();
+        paths.bounces[i]    = 0;
+        active[i]           = i;
+    }
+}
+
+/// Primary hits: environment map on a miss, surface emission on a hit.
+static void ShadePrimaryHits(const Scene& scene, PathStates& paths, std::vector<int>& active)
+{
+    size_t num_alive = 0;
+    for (int i : active) {
+        if (!paths.hit[i]) {
+            if (HasEnvmap(scene)) {
+                const Light& envmap = GetEnvmap(scene);
+                paths.radiance[i] =
+                    Emission(envmap, -paths.ray[i].dir, paths.rayDiff[i].spread, PointAndNormal{}, scene);
+            }
+            continue;
+        }
+        paths.vertex[i] = *paths.hit[i];
+        if (IsLight(scene.shapes[paths.vertex[i].shapeId])) {
+            paths.radiance[i] += paths.throughput[i] * Emission(paths.vertex[i], -paths.ray[i].dir, scene);
+        }
+        active[num_alive++] = i;
+    }
+    active.resize(num_alive);
+}
+
+/// Groups paths by material type, so that the material stage runs one variant alternative at a time.
+static void
+SortByMaterial(const Scene& scene, const PathStates& paths, std::vector<int>& active, std::vector<int>& scratch)
+{
+    constexpr int num_types = (int)std::variant_size_v<Material>;
+    std::array<int, num_types + 1> offsets{};
+    for (int i : active) {
+        offsets[scene.materials[paths.vertex[i].materialId].index() + 1]++;
+    }
+    for (int t = 0; t < num_types; t++) {
+        offsets[t + 1] += offsets[t];
+    }
+    scratch.resize(active.size());
+    for (int i : active) {
+        scratch[offsets[scene.materials[paths.vertex[i].materialId].index()]++] = i;
+    }
+    active.swap(scratch);
+}
+
+/// Material stage: sample a light and set up the shadow ray with its MIS weighted contribution,
+/// then sample the BSDF for the continuation ray. Paths whose BSDF sampling fails are removed.
+static void
+SampleLightsAndBSDFs(const Scene& scene, PathStates& paths, std::vector<int>& active, std::vector<int>& shadow_queue)
+{
+    shadow_queue.clear();
+    size_t num_alive = 0;
+    for (int i : active) {
+        Sampler& sampler         = paths.sampler[i];
+        const PathVertex& vertex = paths.vertex[i];
+        const BSDFClosure bsdf   = PrepareBSDF(scene, vertex);
+        const Vector3 dir_view   = -paths.ray[i].dir;
+        paths.bounces[i]++;
+
+        // Next event estimation, see PathTracing() for the derivation.
+        Vector2 light_uv                     = Next2D(sampler);
+        Real light_w                         = Next1D(sampler);
+        Real shape_w                         = Next1D(sampler);
+        const LightSampleRecord light_sample = SampleLight(scene, vertex.position, vertex.normal, light_w);
+        const int light_id                   = light_sample.lightId;
+        // No light is picked if none of them can reach the vertex
+        if (light_id >= 0) {
+            const Light& light            = scene.lights[light_id];
+            PointAndNormal point_on_light = SamplePointOnLight(light, vertex.position, light_uv, shape_w, scene);
+
+            // G assuming the shadow ray is unoccluded, the shadow stage handles visibility.
+            Real G = 0;
+            Vector3 dir_light;
+            Ray shadow_ray;
+            const Envmap* envmap = std::get_if<Envmap>(&light);
+            EnvmapDirection envmap_dir;
+            if (!envmap) {
+                dir_light  = Normalize(point_on_light.position - vertex.position);
+                shadow_ray = Ray{vertex.position,
+                                 dir_light,
+                                 GetShadowEpsilon(scene),
+                                 (1 - GetShadowEpsilon(scene)) * Distance(point_on_light.position, vertex.position)};
+                G          = Max(-Dot(dir_light, point_on_light.normal), Real(0)) /
+                    DistanceSquared(point_on_light.position, vertex.position);
+            }
+            else {
+                dir_light  = -point_on_light.normal;
+                shadow_ray = Ray{vertex.position, dir_light, GetShadowEpsilon(scene), Infinity<Real>()};
+                G          = 1;
+                // Shared by the pdf and the emission below
+                envmap_dir = ToEnvmapDirection(*envmap, point_on_light.normal);
+            }
+
+            Real p1 = light_sample.pmf * (envmap ? PdfPointOnLight(*envmap, envmap_dir)
+                                                 : PdfPointOnLight(light, point_on_light, vertex.position, scene));
+            if (G > 0 && p1 > 0) {
+                const BSDFEvalRecord bsdf_eval = EvalWithPdf(bsdf, dir_view, dir_light, vertex);
+                Spectrum L                     = envmap ? Emission(*envmap, envmap_dir, Real(0), scene)
+                                                        : Emission(light, -dir_light, Real(0), point_on_light, scene);
+                Real p2                        = bsdf_eval.pdf * G;
+                Real w1                        = (p1 * p1) / (p1 * p1 + p2 * p2);
+
+                paths.shadowRay[i]     = shadow_ray;
+                paths.shadowContrib[i] = paths.throughput[i] * (G * bsdf_eval.f * L / p1) * w1;
+                shadow_queue.push_back(i);
+            }
+        }
+
+        // BSDF sampling
+        Vector2 bsdf_rnd_param_uv = Next2D(sampler);
+        Real bsdf_rnd_param_w     = Next1D(sampler);
+        auto bsdf_sample_         = SampleBSDF(bsdf, dir_view, vertex, bsdf_rnd_param_uv, bsdf_rnd_param_w);
+        if (!bsdf_sample_) {
+            ++sBSDFSamplingFailures;
+            continue;
+        }
+        const BSDFSampleRecord& bsdf_sample = *bsdf_sample_;
+        if (bsdf_sample.eta == 0) {
+            paths.rayDiff[i].spread = Reflect(paths.rayDiff[i], vertex.meanCurvature, bsdf_sample.roughness);
+        }
+        else {
+            paths.rayDiff[i].spread =
+                Refract(paths.rayDiff[i], vertex.meanCurvature, bsdf_sample.eta, bsdf_sample.roughness);
+            paths.etaScale[i] /= (bsdf_sample.eta * bsdf_sample.eta);
+        }
+
+        const BSDFEvalRecord bsdf_eval = EvalWithPdf(bsdf, dir_view, bsdf_sample.dirOut, vertex);
+        paths.bsdfF[i]                 = bsdf_eval.f;
+        paths.bsdfPdf[i]               = bsdf_eval.pdf;
+        paths.ray[i] = Ray{vertex.position, bsdf_sample.dirOut, GetIntersectionEpsilon(scene), Infinity<Real>()};
+        active[num_alive++] = i;
+    }
+    active.resize(num_alive);
+}
+
+/// Scatter stage: MIS weighted emission at the BSDF sampled hit, Russian roulette, and
+/// advancing the surviving paths to their next vertex.
+static void ScatterAndRoulette(const Scene& scene, int num_vertices, PathStates& paths, std::vector<int>& active)
+{
+    size_t num_alive = 0;
+    for (int i : active) {
+        const PathVertex& vertex             = paths.vertex[i];
+        const std::optional<PathVertex>& hit = paths.hit[i];
+        const Vector3 dir_bsdf               = paths.ray[i].dir;
+
+        Real G;
+        if (hit) {
+            G = fabs(Dot(dir_bsdf, hit->normal)) / DistanceSquared(hit->position, vertex.position);
+        }
+        else {
+            G = 1;
+        }
+
+        Real p2 = paths.bsdfPdf[i];
+        if (p2 <= 0) {
+            // Numerical issue -- we generated some invalid rays.
+            ++sZeroPdfBSDFSamples;
+            continue;
+        }
+        p2                *= G;
+        const Spectrum& f  = paths.bsdfF[i];
+
+        if (hit && IsLight(scene.shapes[hit->shapeId])) {
+            Spectrum L   = Emission(*hit, -dir_bsdf, scene);
+            int light_id = GetAreaLightId(scene.shapes[hit->shapeId]);
+            assert(light_id >= 0);
+            const Light& light            = scene.lights[light_id];
+            PointAndNormal light_point{hit->position, hit->normal};
+            Real p1 = LightPmf(scene, vertex.position, vertex.normal, light_id) *
+                      PdfPointOnLight(light, light_point, vertex.position, scene);
+            Real w2 = (p2 * p2) / (p1 * p1 + p2 * p2);
+
+            paths.radiance[i] += paths.throughput[i] * (G * f * L / p2) * w2;
+        }
+        else if (!hit && HasEnvmap(scene)) {
+            // The direction is converted to the envmap's coordinates once for the emission and the pdf
+            const Envmap& envmap      = std::get<Envmap>(GetEnvmap(scene));
+            const EnvmapDirection dir = ToEnvmapDirection(envmap, -dir_bsdf);
+            Spectrum L                = Emission(envmap, dir, paths.rayDiff[i].spread, scene);
+            Real p1                   = LightPmf(scene, vertex.position, vertex.normal, scene.envmapLightId) *
+                                        PdfPointOnLight(envmap, dir);
+            Real w2                   = (p2 * p2) / (p1 * p1 + p2 * p2);
+
+            paths.radiance[i] += paths.throughput[i] * (G * f * L / p2) * w2;
+        }
+
+        if (!hit) {
+            continue;
+        }
+
+        // Drawn unconditionally to keep the sampler dimensions in step with PathTracing().
+        Real rr_prob = 1;
+        Real rr_w    = Next1D(paths.sampler[i]);
+        if (num_vertices - 1 >= scene.options.rrDepth) {
+            rr_prob = Min(Max((1 / paths.etaScale[i]) * paths.throughput[i]), Real(0.95));
+            if (rr_w > rr_prob) {
+                ++sRussianRouletteTerminations;
+                continue;
+            }
+        }
+
+        paths.throughput[i] = paths.throughput[i] * (G * f) / (p2 * rr_prob);
+        paths.vertex[i]     = *hit;
+        active[num_alive++] = i;
+    }
+    active.resize(num_alive);
+}
+
+Image3 WavefrontPathRender(const Scene& scene, const RenderCancel* cancel)
+{
+    int w = scene.camera.width, h = scene.camera.height;
+    Image3 img(w, h);
+
+    constexpr int tile_size = 16;
+    int num_tiles_x         = (w + tile_size - 1) / tile_size;
+    int num_tiles_y         = (h + tile_size - 1) / tile_size;
+    int num_acc             = scene.options.accumulateCount;
+    int spp                 = SamplesPerPass(scene.options);
+    int max_depth           = scene.options.maxDepth;
+
+    ProgressReporter reporter(num_tiles_x * num_tiles_y);
+    ParallelFor(
+        [&](const Vector2i& tile) {
+            if (IsCancelled(cancel)) {
+                return;
+            }
+            int x0         = tile[0] * tile_size;
+            int x1         = Min(x0 + tile_size, w);
+            int y0         = tile[1] * tile_size;
+            int y1         = Min(y0 + tile_size, h);
+            int tile_width = x1 - x0;
+            int num_pixels = tile_width * (y1 - y0);
+
+            PathStates paths(num_pixels);
+            std::vector<Spectrum> accumulated(num_pixels, MakeZeroSpectrum());
+            std::vector<int> active, shadow_queue, scratch;
+            active.reserve(num_pixels);
+            shadow_queue.reserve(num_pixels);
+
+            // Paths run in lockstep, so each pixel needs its own sampler.
+            for (int i = 0; i < num_pixels; i++) {
+                paths.sampler[i] = MakeSampler(scene.options.sampler, w, h, scene.options.samplesPerPixel);
+            }
+
+            for (int s = 0; s < spp; s++) {
+                GenerateCameraRays(scene, x0, y0, tile_width, int64_t(num_acc) * spp + s, paths, active);
+                TraceClosest(scene, active, true, paths);
+                ShadePrimaryHits(scene, paths, active);
+
+                for (int num_vertices = 3; !active.empty() && (max_depth == -1 || num_vertices <= max_depth + 1);
+                     num_vertices++)
+                {
+                    SortByMaterial(scene, paths, active, scratch);
+                    SampleLightsAndBSDFs(scene, paths, active, shadow_queue);
+                    TraceShadow(scene, shadow_queue, paths);
+                    // Like PathTracing(), continuation rays don't carry ray differentials into the hit.
+                    TraceClosest(scene, active, false, paths);
+                    ScatterAndRoulette(scene, num_vertices, paths, active);
+                }
+
+                for (int i = 0; i < num_pixels; i++) {
+                    accumulated[i] += CountSample(paths.radiance[i]);
+                    sPathBounces.report(paths.bounces[i]);
+                }
+            }
+
+            for (int i = 0; i < num_pixels; i++) {
+                img(x0 + i % tile_width, y0 + i / tile_width) = accumulated[i] / Real(spp);
+            }
+            reporter.update(1);
+        },
+        Vector2i(num_tiles_x, num_tiles_y));
+    reporter.done();
+    return img;
+}
+
+} // namespace elma
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Elma.hpp"
+#include "Image.hpp"
+#include "Render.hpp"
+
+namespace elma {
+struct Scene;
+
+/// Unidirectional path tracing organized as a wavefront: the paths of a tile are kept in
+/// queues and advanced one stage at a time (camera rays, intersection, material evaluation
+/// sorted by material type, shadow rays, Russian roulette) instead of one path at a time.
+/// Computes the same estimator as PathTracing().
+Image3 WavefrontPathRender(const Scene& scene, const RenderCancel* cancel = nullptr);
+
+} // namespace elma
@@ -0,0 +1,264 @@
+#include "Common/Error.hpp"
+#include "Image.hpp"
+#include "Intersection.hpp"
+#include "Medium.hpp"
+#include "Parallel.hpp"
+#include "Parsers/MeshCache.hpp"
+#include "Parsers/ParseScene.hpp"
+#include "Render.hpp"
+#include "Scene.hpp"
+#include "Stats.hpp"
+
+#include <embree4/rtcore.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+using namespace elma;
+
+// Headless batch renderer: loads a scene, renders it without opening a window, writes the image
+// and prints a one line JSON summary to stdout (the last line of the output).
+
+namespace {
+
+struct CliOptions
+{
+    std::string sceneFilename;
+    std::string outputFilename; // empty: the film filename of the scene
+    int numThreads    = static_cast<int>(std::thread::hardware_concurrency());
+    int spp           = 0; // 0: the sample count of the scene
+    double timeBudget = 0; // seconds, 0: no limit
+    bool quiet        = false;
+    bool meshCache    = true;
+    bool sampleCount  = false; // also write the sample count AOV
+    std::string lightSampler; // empty: the light sampler of the scene
+    // --convert-volume: converts a .vol file to bricks instead of rendering
+    std::string volumeInput;
+    std::string volumeOutput;
+    int volumeBits = 32;
+};
+
+void PrintUsage()
+{
+    fprintf(stderr,
+            "使用方法 elma_cli [options] scene.xml\n"
+            "  -o <file>              output image (.exr or .pfm), defaults to the film filename of the scene\n"
+            "  -t <n>                 number of threads, defaults to all cores\n"
+            "  -spp <n>               samples per pixel, overrides the scene\n"
+            "  --time-budget <secs>   render one sample per pixel at a time, until the samples per pixel\n"
+            "                         are reached or the next pass would exceed the budget\n"
+            "  --sample-count         also write the number of samples taken at every pixel to <output>_spp.exr\n"
+            "  -q                     only log warnings and errors\n"
+            "  --no-mesh-cache        always parse mesh files, don't read or write .elmamesh caches\n"
+            "  --light-sampler <type> power or bvh, how next event estimation picks a light, overrides the scene\n"
+            "使用方法 elma_cli --convert-volume <in.vol> <out.elmavol> [--volume-bits <n>]\n"
+            "  --volume-bits <n>      8, 16 or 32 bits per channel of the bricks, defaults to 32\n");
+}
+
+bool ParseArguments(int argc, char* argv[], CliOptions& options)
+{
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value  = i + 1 < argc;
+        if (arg == "-o" && has_value) {
+            options.outputFilename = argv[++i];
+        }
+        else if (arg == "-t" && has_value) {
+            options.numThreads = std::stoi(argv[++i]);
+        }
+        else if (arg == "-spp" && has_value) {
+            options.spp = std::stoi(argv[++i]);
+        }
+        else if (arg == "--time-budget" && has_value) {
+            options.timeBudget = std::stod(argv[++i]);
+        }
+        else if (arg == "--sample-count") {
+            options.sampleCount = true;
+        }
+        else if (arg == "-q") {
+            options.quiet = true;
+        }
+        else if (arg == "--no-mesh-cache") {
+            options.meshCache = false;
+        }
+        else if (arg == "--light-sampler" && has_value) {
+            options.lightSampler = argv[++i];
+            if (options.lightSampler != "power" && options.lightSampler != "bvh") {
+                return false;
+            }
+        }
+        else if (arg == "--convert-volume" && i + 2 < argc) {
+            options.volumeInput  = argv[++i];
+            options.volumeOutput = argv[++i];
+        }
+        else if (arg == "--volume-bits" && has_value) {
+            options.volumeBits = std::stoi(argv[++i]);
+        }
+        else if (!arg.empty() && arg[0] != '-' && options.sceneFilename.empty()) {
+            options.sceneFilename = arg;
+        }
+        else {
+            return false;
+        }
+    }
+    return !options.sceneFilename.empty() || !options.volumeInput.empty();
+}
+
+std::string JsonEscape(const std::string& str)
+{
+    std::string escaped;
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+int64_t StatCount(const StatsReport& stats, std::string_view title)
+{
+    const StatEntry* entry = FindStat(stats, title);
+    return entry ? entry->count : 0;
+}
+
+int64_t StatTotal(const StatsReport& stats, std::string_view title)
+{
+    const StatEntry* entry = FindStat(stats, title);
+    return entry ? entry->total : 0;
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int RunCli(int argc, char* argv[])
+{
+    CliOptions cli;
+    if (!ParseArguments(argc, argv, cli)) {
+        PrintUsage();
+        return 1;
+    }
+    if (cli.quiet) {
+        Logger::inst().setLevel(Logger::Level::Warning);
+    }
+
+    if (!cli.volumeInput.empty()) {
+        const auto start                   = std::chrono::steady_clock::now();
+        const BrickVolume<Spectrum> bricks = LoadBrickVolumeFromFile<Spectrum>(
+          cli.volumeInput, VolumeEncodingFromBits(cli.volumeBits));
+        SaveBrickVolume(bricks, cli.volumeOutput);
+        LogInfo("Volume 转换完成，花费 '{}' 秒，已保存至 '{}'", SecondsSince(start), cli.volumeOutput);
+        return 0;
+    }
+
+    SetMeshCacheEnabled(cli.meshCache);
+
+    RTCDevice embree_device = rtcNewDevice(nullptr);
+    ParallelInit(cli.numThreads);
+
+    auto start                   = std::chrono::steady_clock::now();
+    std::unique_ptr<Scene> scene = ParseScene(cli.sceneFilename, embree_device);
+    const double load_seconds    = SecondsSince(start);
+    LogInfo("场景构造完成，花费 '{}' 秒", load_seconds);
+
+    RenderOptions& options = scene->options;
+    if (cli.spp > 0) {
+        options.samplesPerPixel = cli.spp;
+    }
+    if (!cli.lightSampler.empty()) {
+        options.lightSampler = cli.lightSampler == "power" ? LightSamplerType::Power : LightSamplerType::BVH;
+    }
+    const int spp = options.samplesPerPixel;
+    const int w = scene->camera.width, h = scene->camera.height;
+
+    start = std::chrono::steady_clock::now();
+    Image3 img;
+    Image1 sample_count;
+    StatsReport stats;
+    int passes = 0;
+    if (cli.timeBudget <= 0) {
+        img    = Render(*scene, cli.sampleCount ? &sample_count : nullptr, nullptr, &stats);
+        passes = 1;
+    }
+    else {
+        // Progressive passes of one sample each, taken in order from the sample sequences of spp samples,
+        // so that all passes add up to the image of a single render
+        if (options.adaptiveThreshold > 0) {
+            LogWarn("设置了时间预算，自适应采样已关闭");
+            options.adaptiveThreshold = 0;
+        }
+        options.samplesPerPass = 1;
+        img                    = Image3(w, h);
+        double last_pass       = 0;
+        while (passes < spp && (passes == 0 || SecondsSince(start) + last_pass <= cli.timeBudget)) {
+            const auto pass_start   = std::chrono::steady_clock::now();
+            options.accumulateCount = passes;
+            StatsReport pass_stats;
+            const Image3 pass = Render(*scene, nullptr, nullptr, &pass_stats);
+            for (int i = 0; i < w * h; i++) {
+                img(i) += pass(i);
+            }
+            MergeStats(stats, pass_stats);
+            passes++;
+            last_pass = SecondsSince(pass_start);
+        }
+        for (int i = 0; i < w * h; i++) {
+            img(i) /= Real(passes);
+        }
+        // Every pixel got one sample per pass
+        sample_count = Image1(w, h);
+        std::fill(sample_count.data.begin(), sample_count.data.end(), Real(passes));
+    }
+    const double render_seconds   = SecondsSince(start);
+    const int64_t rays            = StatTotal(stats, "Intersection/Rays that hit") +
+                                    StatTotal(stats, "Intersection/Occluded shadow rays");
+    const int64_t null_collisions = StatCount(stats, "Volume/Null collisions");
+    const int samples             = cli.timeBudget <= 0 ? spp : passes;
+
+    const std::string output = cli.outputFilename.empty() ? scene->outputFilename : cli.outputFilename;
+    ImageWrite(output, img);
+    LogInfo("渲染完成，花费 '{}' 秒，图像已保存至 '{}'", render_seconds, output);
+    if (cli.sampleCount) {
+        const fs::path path = fs::path(output).replace_extension().string() + "_spp.exr";
+        Image3 count_img(w, h);
+        for (int i = 0; i < w * h; i++) {
+            count_img(i) = Vector3{sample_count(i), sample_count(i), sample_count(i)};
+        }
+        ImageWrite(path, count_img);
+        LogInfo("采样数图像已保存至 '{}'", path.string());
+    }
+    LogInfo("渲染统计：\n{}", FormatStats(stats));
+
+    // Machine readable summary
+    const SceneBuildTimes& t = scene->buildTimes;
+    printf("{\"scene\": \"%s\", \"output\": \"%s\", \"width\": %d, \"height\": %d, \"threads\": %d, "
+           "\"spp\": %d, \"passes\": %d, \"load_seconds\": %.6f, \"load_phases\": {\"parse\": %.6f, "
+           "\"load_meshes\": %.6f, \"register_embree\": %.6f, \"commit_embree\": %.6f, \"shape_sampling\": %.6f, "
+           "\"light_sampling\": %.6f, \"light_power\": %.6f, \"light_bvh\": %.6f}, \"light_sampler\": \"%s\", "
+           "\"render_seconds\": %.6f, \"rays\": %lld, \"rays_per_second\": %.1f, \"samples_per_second\": %.1f, "
+           "\"null_collisions\": %lld, \"null_collisions_per_sample\": %.3f, \"stats\": %s}\n",
+           JsonEscape(cli.sceneFilename).c_str(), JsonEscape(output).c_str(), w, h, Max(cli.numThreads, 1), samples,
+           passes, load_seconds, double(t.parse), double(t.loadMeshes), double(t.registerEmbree),
+           double(t.commitEmbree), double(t.shapeSampling), double(t.lightSampling), double(t.lightPower),
+           double(t.lightBvh), options.lightSampler == LightSamplerType::Power ? "power" : "bvh", render_seconds,
+           static_cast<long long>(rays), rays / Max(render_seconds, 1e-9),
+           double(w) * double(h) * samples / Max(render_seconds, 1e-9), static_cast<long long>(null_collisions),
+           null_collisions / Max(double(w) * double(h) * samples, 1.0), StatsToJson(stats).c_str());
+    fflush(stdout);
+
+    scene.reset();
+    ParallelCleanup();
+    rtcReleaseDevice(embree_device);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    return CatchAndReportAllExceptions([&] { return RunCli(argc, argv); });
+}
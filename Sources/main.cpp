@@ -18,19 +18,17 @@ inline int RunApp(int argc, char* argv[])
     config.inputSceneFilename         = "Data/Scenes/disney_bsdf_test/disney_bsdf_array.xml";
 
     config.numThreads = static_cast<int>(std::thread::hardware_concurrency()) - 1;
-//    std::string outputFile;
-//    std::vector<std::string> filenames;
-//    for (int i = 1; i < argc; ++i) {
-//        if (std::string(argv[i]) == "-t") {
-//            config.numThreads = std::stoi(std::string(argv[++i]));
-//        }
-//        else if (std::string(argv[i]) == "-o") {
-//            config.outputFilename = std::string(argv[++i]);
-//        }
-//        else {
-//            config.inputSceneFilename = argv[i];
-//        }
-//    }
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "-t" && i + 1 < argc) {
+            config.numThreads = std::stoi(std::string(argv[++i]));
+        }
+        else if (std::string(argv[i]) == "-o" && i + 1 < argc) {
+            config.outputFilename = std::string(argv[++i]);
+        }
+        else {
+            config.inputSceneFilename = argv[i];
+        }
+    }
 
     Application app(config);
 
@@ -0,0 +1,81 @@
+#include "Scene.hpp"
+#include "Parallel.hpp"
+#include "Render.hpp"
+#include <cstdio>
+
+using namespace elma;
+
+int main(int argc, char* argv[])
+{
+    ParallelInit(4);
+    RTCDevice embree_device = rtcNewDevice(nullptr);
+
+    // A floor lit by a small spherical light, seen from the origin along +z: the upper part of the image is
+    // black background that converges at once, the floor is noisy
+    std::vector<Material> materials;
+    materials.push_back(Lambertian{MakeConstantSpectrumTexture(MakeConstSpectrum(Real(0.6)))});
+    std::vector<Shape> shapes;
+    shapes.emplace_back(TriangleMesh{
+      {0, -1} /* material, area light */,
+      {Vector3{-4, -1, 0}, Vector3{4, -1, 0}, Vector3{4, -1, 8}, Vector3{-4, -1, 8}},
+      {Vector3i{0, 1, 2}, Vector3i{0, 2, 3}},
+      {}, // normals
+      {}, // uvs
+      Real(0), // total area
+      TableDist1D{}
+    });
+    shapes.emplace_back(Sphere{{0, 0}, Vector3{Real(0.8), Real(0.2), Real(3.5)}, Real(0.2)});
+    std::vector<Light> lights;
+    lights.push_back(DiffuseAreaLight{1, Vector3{10, 10, 10}});
+
+    constexpr int w = 40, h = 30, spp = 16, min_spp = 4;
+    RenderOptions options;
+    options.samplesPerPixel = spp;
+    // Too tight for the floor to converge within the budget, so all of it is spent
+    options.adaptiveThreshold  = Real(0.001);
+    options.adaptiveMinSamples = min_spp;
+    Scene scene(embree_device,
+                Camera(Matrix4x4::identity(), Real(45), w, h, Box{Real(1)}, -1),
+                materials,
+                shapes,
+                lights,
+                {}, /* media */
+                -1, /* envmap id */
+                TexturePool{},
+                options,
+                "" /* output filename */);
+
+    Image1 sample_count;
+    StatsReport stats;
+    const Image3 img = Render(scene, &sample_count, nullptr, &stats);
+
+    bool ok         = sample_count.width == w && sample_count.height == h;
+    int64_t spent   = 0;
+    int num_stopped = 0, max_count = 0;
+    for (int i = 0; ok && i < w * h; i++) {
+        const int count  = int(sample_count(i));
+        spent           += count;
+        max_count        = std::max(max_count, count);
+        // Black pixels have no variance, they stop after the minimum
+        if (Luminance(img(i)) == 0) {
+            ok &= count == min_spp;
+            num_stopped++;
+        }
+        ok &= count >= min_spp;
+    }
+    // The budget is spent exactly, what the black pixels saved went to the noisy ones
+    ok &= spent == int64_t(w) * h * spp;
+    ok &= num_stopped > 0 && max_count > spp;
+    // and the AOV accounts for every sample taken
+    const StatEntry* samples = FindStat(stats, "Render/Non-finite samples");
+    ok &= samples && samples->total == spent;
+
+    rtcReleaseDevice(embree_device);
+    ParallelCleanup();
+    if (!ok) {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("SUCCESS\n");
+    return 0;
+}
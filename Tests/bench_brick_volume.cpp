@@ -0,0 +1,47 @@
+// Benchmark of the brick storage of grid volumes (not run by ctest): memory and lookup time of the dense grid and
+// of the bricks in each encoding, for random points in the bounding box of a .vol file.
+// Usage: bench_brick_volume [smoke.vol] [number of lookups]
+#include "Volume.hpp"
+#include "Pcg.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+using namespace elma;
+
+static double lookup_ns(const VolumeSpectrum& volume, const Vector3& pos_min, const Vector3& pos_max, int n,
+                        Real& sum)
+{
+    Pcg32State rng   = InitPcg32(3);
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        const Vector3 p = pos_min + (pos_max - pos_min) * Vector3{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng),
+                                                                  NextPcg32Real<Real>(rng)};
+        sum            += Lookup(volume, p).x;
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / n * 1e9;
+}
+
+int main(int argc, char* argv[])
+{
+    const std::string filename = argc > 1 ? argv[1] : "Data/Scenes/volpath_test/smoke.vol";
+    const int num_lookups      = argc > 2 ? std::stoi(argv[2]) : 2000000;
+
+    const GridVolume<Spectrum> grid = LoadVolumeFromFile<Spectrum>(filename);
+    printf("%s: %d x %d x %d voxels, %d lookups\n", filename.c_str(), grid.resolution.x, grid.resolution.y,
+           grid.resolution.z, num_lookups);
+    printf("%-8s %12s %12s %12s\n", "storage", "MB", "ns/lookup", "mean");
+
+    Real sum        = 0;
+    double ns       = lookup_ns(grid, grid.posMin, grid.posMax, num_lookups, sum);
+    const double mb = grid.data.size() * sizeof(Spectrum) / 1e6;
+    printf("%-8s %12.3f %12.2f %12.6f\n", "dense", mb, ns, sum / num_lookups);
+    for (int bits : {32, 16, 8}) {
+        const BrickVolume<Spectrum> bricks = MakeBrickVolume(grid, VolumeEncodingFromBits(bits));
+        sum                                = 0;
+        ns                                 = lookup_ns(bricks, grid.posMin, grid.posMax, num_lookups, sum);
+        printf("%-8s %12.3f %12.2f %12.6f\n", ("brick" + std::to_string(bits)).c_str(),
+               GetMemoryUsage(bricks) / 1e6, ns, sum / num_lookups);
+    }
+    return 0;
+}
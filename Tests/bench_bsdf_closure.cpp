@@ -0,0 +1,170 @@
+// Benchmark of preparing the BSDF once per path vertex and compiling it with the scene (not run by ctest): the
+// work PathTracing() does with the BSDF at a vertex (evaluation and pdf towards the light, sampling, evaluation and
+// pdf of the sample), with the Disney BSDF of Data/Scenes/disney_bsdf_test/disney_bsdf.xml. The material API
+// evaluates the textures at every call, the closure API once per vertex, and the compiled closure of constant
+// textures once for all the vertices. The parameters are constant textures as in the scene, image textures of the
+// same values, where the lookups dominate, then a plain dielectric without sheen, clearcoat and transmission.
+// Usage: bench_bsdf_closure [number of vertices]
+#include "Intersection.hpp"
+#include "Material.hpp"
+#include "Pcg.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+using namespace elma;
+
+static Vector3 random_direction(Pcg32State& rng)
+{
+    const Real z   = 1 - 2 * NextPcg32Real<Real>(rng);
+    const Real r   = std::sqrt(Max(1 - z * z, Real(0)));
+    const Real phi = kTwoPi * NextPcg32Real<Real>(rng);
+    return Vector3{r * std::cos(phi), r * std::sin(phi), z};
+}
+
+struct Vertex
+{
+    PathVertex vertex;
+    Vector3 dirView, dirLight;
+    Vector2 rndParamUV;
+    Real rndParamW;
+};
+
+static std::vector<Vertex> make_vertices(int n)
+{
+    Pcg32State rng = InitPcg32();
+    std::vector<Vertex> vertices(n);
+    for (Vertex& v : vertices) {
+        v.vertex.normal       = random_direction(rng);
+        v.vertex.shadingFrame = Frame(v.vertex.normal);
+        v.vertex.uv           = Vector2{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng)};
+        v.vertex.uvScreenSize = Real(1e-3);
+        v.dirView             = random_direction(rng);
+        v.dirLight            = random_direction(rng);
+        v.rndParamUV          = Vector2{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng)};
+        v.rndParamW           = NextPcg32Real<Real>(rng);
+    }
+    return vertices;
+}
+
+/// Nanoseconds per vertex, and a checksum that's the same for both APIs
+template<typename Shade> static double run(const std::vector<Vertex>& vertices, Shade shade, Real& sum)
+{
+    sum              = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const Vertex& v : vertices) {
+        sum += shade(v);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / vertices.size() * 1e9;
+}
+
+static Real shade(const BSDFClosure& bsdf, const Vertex& v)
+{
+    const PathVertex& vertex   = v.vertex;
+    const BSDFEvalRecord light = EvalWithPdf(bsdf, v.dirView, v.dirLight, vertex);
+    Real sum                   = light.f.x + light.pdf;
+
+    const std::optional<BSDFSampleRecord> sample = SampleBSDF(bsdf, v.dirView, vertex, v.rndParamUV, v.rndParamW);
+    if (sample) {
+        const BSDFEvalRecord scattered = EvalWithPdf(bsdf, v.dirView, sample->dirOut, vertex);
+        sum                           += scattered.f.x + scattered.pdf;
+    }
+    return sum;
+}
+
+static void bench(const char* name, const Material& material, const TexturePool& pool,
+                  const std::vector<Vertex>& vertices)
+{
+    Real per_call_sum, prepared_sum, compiled_sum;
+    const double per_call = run(
+      vertices,
+      [&](const Vertex& v) {
+          const PathVertex& vertex = v.vertex;
+          Real sum = Eval(material, v.dirView, v.dirLight, vertex, pool).x +
+                     PdfSampleBSDF(material, v.dirView, v.dirLight, vertex, pool);
+          const std::optional<BSDFSampleRecord> sample =
+            SampleBSDF(material, v.dirView, vertex, pool, v.rndParamUV, v.rndParamW);
+          if (sample) {
+              sum += Eval(material, v.dirView, sample->dirOut, vertex, pool).x +
+                     PdfSampleBSDF(material, v.dirView, sample->dirOut, vertex, pool);
+          }
+          return sum;
+      },
+      per_call_sum);
+    const double prepared = run(
+      vertices,
+      [&](const Vertex& v) { return shade(PrepareBSDF(material, v.vertex, pool), v); },
+      prepared_sum);
+    // As the scene does it: once for all the vertices if the textures are constant
+    const std::optional<BSDFClosure> compiled_bsdf = CompileBSDF(material, pool);
+    const double compiled                          = run(
+      vertices,
+      [&](const Vertex& v) {
+          return shade(compiled_bsdf ? *compiled_bsdf : PrepareBSDF(material, v.vertex, pool), v);
+      },
+      compiled_sum);
+    printf("%-10s %14.1f %14.1f %14.1f %10.2fx %s\n", name, per_call, prepared, compiled, per_call / compiled,
+           per_call_sum == prepared_sum && per_call_sum == compiled_sum ? "" : "(checksums differ!)");
+}
+
+int main(int argc, char* argv[])
+{
+    const int num_vertices = argc > 1 ? std::stoi(argv[1]) : 500000;
+    const std::vector<Vertex> vertices = make_vertices(num_vertices);
+
+    // disney_bsdf.xml
+    const Spectrum base_color{Real(0.82), Real(0.67), Real(0.16)};
+    const Real values[] = {0.5, 0.5, 0.5, 0.5, 0.1, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5};
+    const Real plain[]  = {0, 0, 0, 0.5, 0.3, 0, 0, 0, 0, 0, 0.5};
+    TexturePool pool;
+    auto make_constant = [&](const Real* v) -> Material {
+        return DisneyBSDF{MakeConstantSpectrumTexture(base_color),
+                          MakeConstantFloatTexture(v[0]),
+                          MakeConstantFloatTexture(v[1]),
+                          MakeConstantFloatTexture(v[2]),
+                          MakeConstantFloatTexture(v[3]),
+                          MakeConstantFloatTexture(v[4]),
+                          MakeConstantFloatTexture(v[5]),
+                          MakeConstantFloatTexture(v[6]),
+                          MakeConstantFloatTexture(v[7]),
+                          MakeConstantFloatTexture(v[8]),
+                          MakeConstantFloatTexture(v[9]),
+                          MakeConstantFloatTexture(v[10]),
+                          Real(1.5)};
+    };
+
+    // The same values as 512 x 512 images
+    const int size = 512;
+    Image3 color(size, size);
+    for (int i = 0; i < size * size; i++) {
+        color(i) = base_color;
+    }
+    std::vector<Texture<Real>> floats;
+    for (int k = 0; k < 11; k++) {
+        Image1 img(size, size);
+        for (int i = 0; i < size * size; i++) {
+            img(i) = values[k];
+        }
+        floats.push_back(MakeImageFloatTexture("float" + std::to_string(k), img, pool));
+    }
+    const Material textured = DisneyBSDF{MakeImageSpectrumTexture("baseColor", color, pool),
+                                         floats[0],
+                                         floats[1],
+                                         floats[2],
+                                         floats[3],
+                                         floats[4],
+                                         floats[5],
+                                         floats[6],
+                                         floats[7],
+                                         floats[8],
+                                         floats[9],
+                                         floats[10],
+                                         Real(1.5)};
+
+    printf("%d vertices\n", num_vertices);
+    printf("%-10s %14s %14s %14s %11s\n", "textures", "per call ns", "prepared ns", "compiled ns", "speedup");
+    bench("constant", make_constant(values), pool, vertices);
+    bench("image", textured, pool, vertices);
+    bench("plain", make_constant(plain), pool, vertices);
+    return 0;
+}
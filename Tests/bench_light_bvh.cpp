@@ -0,0 +1,147 @@
+// Benchmark of many-light sampling (not run by ctest): power based light selection (the scene's alias table)
+// against the light BVH, for direct lighting of points on a floor lit by many small area lights.
+// Usage: bench_light_bvh [number of lights]
+// The estimator picks one light and divides its unoccluded contribution by the light's pmf, its variance
+// is computed exactly by summing over all lights. "Equal time" scales the variance by the time of picking
+// the light and evaluating the pmf, leaving out the shadow ray and BSDF evaluation every sample pays
+// for in a renderer, which only makes the comparison harder for the BVH.
+#include "LightBVH.hpp"
+#include "Pcg.hpp"
+#include "TableDist.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+using namespace elma;
+
+struct DiscLight
+{
+    Vector3 center;
+    Vector3 axis;
+    Real phi;
+};
+
+/// Irradiance from a small one sided disc, E = L A cos_light cos_point / d^2 with phi = L A pi
+static Real contribution(const DiscLight& light, const Vector3& p, const Vector3& n)
+{
+    const Vector3 d      = light.center - p;
+    const Real dist2     = LengthSquared(d);
+    const Vector3 w      = d / std::sqrt(dist2);
+    const Real cos_light = Max(-Dot(light.axis, w), Real(0));
+    const Real cos_point = Max(Dot(n, w), Real(0));
+    return light.phi * kInvPi * cos_light * cos_point / dist2;
+}
+
+static volatile double sink; // keeps the timed estimates from being optimized away
+
+template<typename F> static double seconds(F f)
+{
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    const int num_lights = argc > 1 ? std::stoi(argv[1]) : 4096;
+    Pcg32State rng       = InitPcg32();
+
+    // Lamps over a 100 x 100 floor, mostly facing down, a few brighter ones
+    std::vector<DiscLight> lights(num_lights);
+    std::vector<std::optional<LightBounds>> bounds(num_lights);
+    std::vector<Real> power(num_lights);
+    for (int i = 0; i < num_lights; i++) {
+        DiscLight& l = lights[i];
+        l.center     = Vector3{100 * NextPcg32Real<Real>(rng), 100 * NextPcg32Real<Real>(rng),
+                           1 + 4 * NextPcg32Real<Real>(rng)};
+        const Real tilt = Real(0.8) * NextPcg32Real<Real>(rng), phi = kTwoPi * NextPcg32Real<Real>(rng);
+        l.axis          = Vector3{std::sin(tilt) * std::cos(phi), std::sin(tilt) * std::sin(phi), -std::cos(tilt)};
+        l.phi           = (i % 50 == 0 ? 20 : 1) * (Real(0.5) + NextPcg32Real<Real>(rng));
+        power[i]        = l.phi;
+
+        const Real r = Real(0.1);
+        LightBounds b;
+        b.pMin      = l.center - Vector3{r, r, r};
+        b.pMax      = l.center + Vector3{r, r, r};
+        b.axis      = l.axis;
+        b.phi       = l.phi;
+        b.cosThetaO = 1;
+        b.cosThetaE = 0;
+        bounds[i]   = b;
+    }
+
+    LightBVH bvh;
+    TableDist1D power_dist;
+    const double build_bvh   = seconds([&] { bvh = MakeLightBVH(bounds); });
+    const double build_power = seconds([&] { power_dist = MakeTableDist1d(power, TableDistMethod::Alias); });
+    printf("%d lights, build: power table %.2f ms, light BVH %.2f ms (%zu nodes)\n", num_lights, build_power * 1e3,
+           build_bvh * 1e3, bvh.nodes.size());
+
+    const int num_points  = 256;
+    const int num_samples = 4096;
+    std::vector<Vector3> points(num_points);
+    for (Vector3& p : points) {
+        p = Vector3{100 * NextPcg32Real<Real>(rng), 100 * NextPcg32Real<Real>(rng), Real(0)};
+    }
+    const Vector3 n{0, 0, 1};
+
+    struct Result
+    {
+        double relativeVariance = 0; // averaged over the points
+        double seconds          = 0; // per sample
+        int biasedPoints        = 0;
+    };
+    // sample returns the light and its pmf
+    auto evaluate = [&](auto sample, auto pmf) {
+        Result result;
+        for (const Vector3& p : points) {
+            double e = 0, second_moment = 0;
+            for (int i = 0; i < num_lights; i++) {
+                const double c = contribution(lights[i], p, n);
+                const double q = pmf(p, i);
+                e += c;
+                if (c > 0 && q <= 0) {
+                    result.biasedPoints++;
+                }
+                else if (c > 0) {
+                    second_moment += c * c / q;
+                }
+            }
+            result.relativeVariance += (second_moment - e * e) / (e * e) / num_points;
+        }
+        double sum     = 0;
+        result.seconds = seconds([&] {
+            Pcg32State sample_rng = InitPcg32(3);
+            for (const Vector3& p : points) {
+                for (int s = 0; s < num_samples; s++) {
+                    const LightSampleRecord record = sample(p, NextPcg32Real<Real>(sample_rng));
+                    if (record.lightId >= 0) {
+                        sum += contribution(lights[record.lightId], p, n) / record.pmf;
+                    }
+                }
+            }
+        }) / (double(num_points) * num_samples);
+        sink = sum;
+        return result;
+    };
+
+    const Result by_power = evaluate(
+        [&](const Vector3&, Real u) {
+            const int id = Sample(power_dist, u);
+            return LightSampleRecord{id, Pmf(power_dist, id)};
+        },
+        [&](const Vector3&, int id) { return Pmf(power_dist, id); });
+    const Result by_bvh   = evaluate([&](const Vector3& p, Real u) { return Sample(bvh, p, n, u); },
+                                   [&](const Vector3& p, int id) { return Pmf(bvh, p, n, id); });
+
+    printf("%-12s %18s %16s %14s\n", "", "relative variance", "ns per sample", "biased points");
+    printf("%-12s %18.4g %16.1f %14d\n", "power", by_power.relativeVariance, by_power.seconds * 1e9,
+           by_power.biasedPoints);
+    printf("%-12s %18.4g %16.1f %14d\n", "light BVH", by_bvh.relativeVariance, by_bvh.seconds * 1e9,
+           by_bvh.biasedPoints);
+    printf("variance reduction: %.1fx at equal samples, %.1fx at equal time\n",
+           by_power.relativeVariance / by_bvh.relativeVariance,
+           (by_power.relativeVariance * by_power.seconds) / (by_bvh.relativeVariance * by_bvh.seconds));
+    return by_bvh.biasedPoints == 0 ? 0 : 1;
+}
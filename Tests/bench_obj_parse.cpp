@@ -0,0 +1,185 @@
+// Benchmark of OBJ loading (not run by ctest): the previous getline/stringstream/regex parser
+// against ParseObj. Usage: bench_obj_parse [file.obj | grid resolution]
+// Without a file, a grid mesh with positions, uvs and normals is generated.
+#include "Parallel.hpp"
+#include "Parsers/ParseObj.hpp"
+#include "Transform.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace elma;
+
+namespace legacy {
+
+// The parser ParseObj replaced, kept here as the baseline
+
+static std::string& trim(std::string& s)
+{
+    s.erase(std::find_if(s.rbegin(), s.rend(), [](unsigned char ch) { return !std::isspace(ch); }).base(), s.end());
+    s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](unsigned char ch) { return !std::isspace(ch); }));
+    return s;
+}
+
+static std::vector<int> split_face_str(const std::string& s)
+{
+    std::regex rgx("/");
+    std::sregex_token_iterator first{begin(s), end(s), rgx, -1}, last;
+    std::vector<std::string> list{first, last};
+    std::vector<int> result;
+    for (auto& i : list) {
+        result.push_back(i != "" ? std::stoi(i) : 0);
+    }
+    while (result.size() < 3) {
+        result.push_back(0);
+    }
+    return result;
+}
+
+struct ObjVertex
+{
+    ObjVertex(const std::vector<int>& id) : v(id[0] - 1), vt(id[1] - 1), vn(id[2] - 1) { }
+
+    bool operator<(const ObjVertex& o) const { return std::tie(v, vt, vn) < std::tie(o.v, o.vt, o.vn); }
+
+    int v, vt, vn;
+};
+
+static TriangleMesh parse_obj(const fs::path& filename, const Matrix4x4& to_world)
+{
+    std::vector<Vector3> pos_pool, nor_pool;
+    std::vector<Vector2> st_pool;
+    std::map<ObjVertex, size_t> vertex_map;
+    TriangleMesh mesh;
+    auto get_vertex_id = [&](const ObjVertex& vertex) {
+        auto it = vertex_map.find(vertex);
+        if (it != vertex_map.end()) {
+            return it->second;
+        }
+        size_t id = mesh.positions.size();
+        mesh.positions.push_back(TransformPoint(to_world, pos_pool[vertex.v]));
+        if (vertex.vt != -1) {
+            mesh.uvs.push_back(st_pool[vertex.vt]);
+        }
+        if (vertex.vn != -1) {
+            mesh.normals.push_back(TransformNormal(Inverse(to_world), nor_pool[vertex.vn]));
+        }
+        vertex_map[vertex] = id;
+        return id;
+    };
+
+    std::ifstream ifs(filename.c_str(), std::ifstream::in);
+    while (ifs.good()) {
+        std::string line;
+        std::getline(ifs, line);
+        line = trim(line);
+        if (line.size() == 0 || line[0] == '#') {
+            continue;
+        }
+        std::stringstream ss(line);
+        std::string token;
+        ss >> token;
+        if (token == "v") {
+            Real x, y, z, w = 1;
+            ss >> x >> y >> z >> w;
+            pos_pool.push_back(Vector3{x, y, z} / w);
+        }
+        else if (token == "vt") {
+            Real s, t, w;
+            ss >> s >> t >> w;
+            st_pool.push_back(Vector2{s, 1 - t});
+        }
+        else if (token == "vn") {
+            Real x, y, z;
+            ss >> x >> y >> z;
+            nor_pool.push_back(Normalize(Vector3{x, y, z}));
+        }
+        else if (token == "f") {
+            std::string i0, i1, i2, i3;
+            ss >> i0 >> i1 >> i2;
+            size_t v0 = get_vertex_id(split_face_str(i0));
+            size_t v1 = get_vertex_id(split_face_str(i1));
+            size_t v2 = get_vertex_id(split_face_str(i2));
+            mesh.indices.push_back(Vector3i{v0, v1, v2});
+            if (ss >> i3) {
+                size_t v3 = get_vertex_id(split_face_str(i3));
+                mesh.indices.push_back(Vector3i{v0, v2, v3});
+            }
+        }
+    }
+    return mesh;
+}
+
+} // namespace legacy
+
+/// A wavy n x n grid of triangles with positions, uvs and normals
+static fs::path write_grid(int n)
+{
+    fs::path path = fs::temp_directory_path() / "elma_bench_grid.obj";
+    std::ofstream ofs(path, std::ios::binary);
+    char line[128];
+    for (int y = 0; y <= n; y++) {
+        for (int x = 0; x <= n; x++) {
+            const double u = x / double(n), v = y / double(n);
+            ofs.write(line, snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", u, v, 0.05 * std::sin(20 * u)));
+            ofs.write(line, snprintf(line, sizeof(line), "vt %.6f %.6f\n", u, v));
+            ofs.write(line, snprintf(line, sizeof(line), "vn %.6f 0 1\n", -std::cos(20 * u)));
+        }
+    }
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            const int a = y * (n + 1) + x + 1, b = a + 1, c = a + n + 2, d = a + n + 1;
+            ofs.write(line, snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, c, c, c));
+            ofs.write(line, snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, c, c, c, d, d, d));
+        }
+    }
+    return path;
+}
+
+template<typename F> static double seconds(F f)
+{
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    const std::string arg = argc > 1 ? argv[1] : "700";
+    const bool generated  = !arg.empty() && std::all_of(arg.begin(), arg.end(), ::isdigit);
+    const fs::path path   = generated ? write_grid(std::stoi(arg)) : fs::path(arg);
+    printf("%s: %.1f MB\n", path.string().c_str(), fs::file_size(path) / 1e6);
+
+    TriangleMesh old_mesh, new_mesh;
+    const double old_seconds = seconds([&] { old_mesh = legacy::parse_obj(path, Matrix4x4::identity()); });
+    printf("%-32s %8.3f s\n", "getline/stringstream/regex", old_seconds);
+    const int max_threads = std::max(int(std::thread::hardware_concurrency()), 1);
+    for (int threads : {1, max_threads}) {
+        if (threads == max_threads && threads == 1 && new_mesh.indices.size() > 0) {
+            break;
+        }
+        ParallelInit(threads);
+        const double s = seconds([&] { new_mesh = ParseObj(path, Matrix4x4::identity()); });
+        printf("ParseObj, %2d thread(s)            %8.3f s  (%.1fx)\n", threads, s, old_seconds / s);
+        ParallelCleanup();
+    }
+
+    auto same_triangle = [](const Vector3i& a, const Vector3i& b) { return a.x == b.x && a.y == b.y && a.z == b.z; };
+    const bool same    = old_mesh.positions.size() == new_mesh.positions.size() &&
+                      std::equal(old_mesh.indices.begin(),
+                                 old_mesh.indices.end(),
+                                 new_mesh.indices.begin(),
+                                 new_mesh.indices.end(),
+                                 same_triangle);
+    printf("%zu triangles, %zu vertices, %s\n", new_mesh.indices.size(), new_mesh.positions.size(),
+           same ? "same topology" : "MISMATCH");
+    if (generated) {
+        fs::remove(path);
+    }
+    return same ? 0 : 1;
+}
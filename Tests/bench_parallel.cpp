@@ -0,0 +1,194 @@
+// Benchmark of the ParallelFor scheduler (not run by ctest): the work-stealing scheduler against the pbrt-v3 work
+// list it replaced, on a frame of cheap 16x16-pixel tiles as PathRender issues them at low spp, where scheduling
+// overhead dominates. Usage: bench_parallel [work per tile] [frames]
+#include "Parallel.hpp"
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace elma;
+
+namespace legacy {
+
+// The scheduler the work-stealing one replaced, kept here as the baseline: one work list behind one mutex and
+// condition variable, taking the lock twice per tile, 2D loops with one tile per chunk
+
+static std::vector<std::thread> sThreads;
+static bool sShutdownThreads = false;
+struct ParallelForLoop;
+static ParallelForLoop* sWorkList = nullptr;
+static std::mutex sWorkListMutex;
+static std::condition_variable sWorkListCondition;
+
+struct ParallelForLoop
+{
+    ParallelForLoop(const std::function<void(Vector2i)>& f, const Vector2i count)
+    : func2D(f), maxIndex(count[0] * count[1]), chunkSize(1), nX(count[0])
+    {
+    }
+
+    std::function<void(Vector2i)> func2D;
+    const int64_t maxIndex;
+    const int64_t chunkSize;
+    int64_t nextIndex     = 0;
+    int activeWorkers     = 0;
+    ParallelForLoop* next = nullptr;
+    int nX                = -1;
+
+    bool Finished() const { return nextIndex >= maxIndex && activeWorkers == 0; }
+};
+
+/// Runs a chunk of the loop at the head of the work list, lock held on entry and exit
+static void run_chunk(std::unique_lock<std::mutex>& lock)
+{
+    ParallelForLoop& loop    = *sWorkList;
+    const int64_t indexStart = loop.nextIndex;
+    const int64_t indexEnd   = std::min(indexStart + loop.chunkSize, loop.maxIndex);
+    loop.nextIndex           = indexEnd;
+    if (loop.nextIndex == loop.maxIndex) {
+        sWorkList = loop.next;
+    }
+    loop.activeWorkers++;
+
+    lock.unlock();
+    for (int64_t index = indexStart; index < indexEnd; ++index) {
+        loop.func2D(Vector2i{int(index % loop.nX), int(index / loop.nX)});
+    }
+    lock.lock();
+
+    loop.activeWorkers--;
+    if (loop.Finished()) {
+        sWorkListCondition.notify_all();
+    }
+}
+
+static void worker_thread_func()
+{
+    std::unique_lock<std::mutex> lock(sWorkListMutex);
+    while (!sShutdownThreads) {
+        if (!sWorkList) {
+            sWorkListCondition.wait(lock);
+        }
+        else {
+            run_chunk(lock);
+        }
+    }
+}
+
+static void ParallelFor(std::function<void(Vector2i)> func, const Vector2i count)
+{
+    if (sThreads.empty() || count.x * count.y <= 1) {
+        for (int y = 0; y < count.y; ++y) {
+            for (int x = 0; x < count.x; ++x) {
+                func(Vector2i{x, y});
+            }
+        }
+        return;
+    }
+
+    ParallelForLoop loop(std::move(func), count);
+    std::unique_lock<std::mutex> lock(sWorkListMutex);
+    loop.next = sWorkList;
+    sWorkList = &loop;
+    sWorkListCondition.notify_all();
+
+    // Help out with the loop in the calling thread
+    while (!loop.Finished()) {
+        if (sWorkList == &loop) {
+            run_chunk(lock);
+        }
+        else {
+            // All chunks handed out: the original kept retaking the lock until the workers were done
+            lock.unlock();
+            lock.lock();
+        }
+    }
+}
+
+static void ParallelInit(int num_threads)
+{
+    assert(sThreads.empty());
+    for (int i = 0; i < num_threads - 1; ++i) {
+        sThreads.push_back(std::thread(worker_thread_func));
+    }
+}
+
+static void ParallelCleanup()
+{
+    {
+        std::lock_guard<std::mutex> lock(sWorkListMutex);
+        sShutdownThreads = true;
+        sWorkListCondition.notify_all();
+    }
+    for (std::thread& thread : sThreads) {
+        thread.join();
+    }
+    sThreads.clear();
+    sShutdownThreads = false;
+}
+
+} // namespace legacy
+
+/// The tiles of a 1920 x 1080 frame, each doing work iterations of an LCG
+static const Vector2i kNumTiles{120, 68};
+
+static uint64_t shade_tile(Vector2i tile, int work)
+{
+    uint64_t h = uint64_t(tile.y * kNumTiles.x + tile.x);
+    for (int k = 0; k < work; k++) {
+        h = h * 6364136223846793005ull + 1442695040888963407ull;
+    }
+    return h & 1;
+}
+
+/// Milliseconds per frame and a checksum that's the same for both schedulers
+template<typename Loop> static double ms_per_frame(Loop parallel_for, int work, int frames, uint64_t& checksum)
+{
+    std::atomic<uint64_t> sum = 0;
+    const auto start          = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++) {
+        parallel_for([&](Vector2i tile) { sum += shade_tile(tile, work); }, kNumTiles);
+    }
+    checksum = sum.load();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+}
+
+int main(int argc, char* argv[])
+{
+    const int work   = argc > 1 ? std::stoi(argv[1]) : 2'000;
+    const int frames = argc > 2 ? std::stoi(argv[2]) : 20;
+
+    printf("%d x %d tiles, %d iterations per tile, %u hardware threads\n", kNumTiles.x, kNumTiles.y, work,
+           std::thread::hardware_concurrency());
+    printf("%8s %16s %16s %10s\n", "threads", "work list ms", "stealing ms", "speedup");
+    bool same = true;
+    for (int num_threads : {1, 4, 16, 64}) {
+        uint64_t legacy_sum, stealing_sum;
+        legacy::ParallelInit(num_threads);
+        const double legacy_ms = ms_per_frame(
+          [](std::function<void(Vector2i)> f, Vector2i count) { legacy::ParallelFor(std::move(f), count); },
+          work,
+          frames,
+          legacy_sum);
+        legacy::ParallelCleanup();
+
+        ParallelInit(num_threads);
+        const double stealing_ms = ms_per_frame(
+          [](std::function<void(Vector2i)> f, Vector2i count) { ParallelFor(std::move(f), count); },
+          work,
+          frames,
+          stealing_sum);
+        ParallelCleanup();
+
+        same &= legacy_sum == stealing_sum;
+        printf("%8d %16.3f %16.3f %9.2fx\n", num_threads, legacy_ms, stealing_ms, legacy_ms / stealing_ms);
+    }
+    if (!same) {
+        printf("checksums differ!\n");
+    }
+    return same ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+// Benchmark of the vector math in Simd.hpp (not run by ctest): scalar Vector3 loops against the batched
+// kernels, and scalar Spectrum arithmetic against PackedSpectrum. Build with ELMA_SIMD to compare against
+// the SSE / AVX2 backends, without it both columns run scalar code.
+// Usage: bench_simd [number of vectors]
+#include "Pcg.hpp"
+#include "Simd.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace elma;
+
+static volatile double sink; // keeps the results from being optimized away
+
+/// Nanoseconds per element of f(), which processes count elements, best of a few runs
+template<typename F> static double ns_per_element(int count, F f)
+{
+    const int repeats = Max(1, (1 << 24) / count);
+    double best       = 1e30;
+    for (int run = 0; run < 5; run++) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            f();
+        }
+        const double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best           = std::min(best, t);
+    }
+    return best / (double(repeats) * count) * 1e9;
+}
+
+static void report(const char* name, double scalar, double simd)
+{
+    printf("%-22s %10.2f %10.2f %8.2fx\n", name, scalar, simd, scalar / simd);
+}
+
+int main(int argc, char* argv[])
+{
+    const int n    = argc > 1 ? std::stoi(argv[1]) : 4096;
+    Pcg32State rng = InitPcg32();
+    std::vector<Vector3> a(n), b(n), out(n);
+    std::vector<Real> dots(n);
+    for (int i = 0; i < n; i++) {
+        a[i] = Vector3{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng)};
+        b[i] = Vector3{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng)};
+    }
+
+    printf("%d vectors, %s backend, %s\n", n, kSimdBackend, std::is_same_v<Real, float> ? "float" : "double");
+    printf("%-22s %10s %10s %9s\n", "ns per element", "scalar", "simd", "speedup");
+
+    report("dot",
+           ns_per_element(n,
+                          [&] {
+                              for (int i = 0; i < n; i++) {
+                                  dots[i] = Dot(a[i], b[i]);
+                              }
+                              sink = dots[n / 2];
+                          }),
+           ns_per_element(n, [&] {
+               BatchDot(a.data(), b.data(), dots.data(), n);
+               sink = dots[n / 2];
+           }));
+    report("cross",
+           ns_per_element(n,
+                          [&] {
+                              for (int i = 0; i < n; i++) {
+                                  out[i] = Cross(a[i], b[i]);
+                              }
+                              sink = out[n / 2].x;
+                          }),
+           ns_per_element(n, [&] {
+               BatchCross(a.data(), b.data(), out.data(), n);
+               sink = out[n / 2].x;
+           }));
+    report("normalize",
+           ns_per_element(n,
+                          [&] {
+                              for (int i = 0; i < n; i++) {
+                                  out[i] = Normalize(a[i]);
+                              }
+                              sink = out[n / 2].x;
+                          }),
+           ns_per_element(n, [&] {
+               BatchNormalize(a.data(), out.data(), n);
+               sink = out[n / 2].x;
+           }));
+    // Transmittance-like arguments, exp(-sigma_t * t)
+    for (Vector3& v : b) {
+        v = Real(-4) * v;
+    }
+    report("exp (spectrum)",
+           ns_per_element(n,
+                          [&] {
+                              for (int i = 0; i < n; i++) {
+                                  out[i] = Exp(b[i]);
+                              }
+                              sink = out[n / 2].x;
+                          }),
+           ns_per_element(n, [&] {
+               BatchExp(b.data(), out.data(), n);
+               sink = out[n / 2].x;
+           }));
+
+    // A bilinear blend as in the texture lookups, gathering four texels from a table like a texture would.
+    // The packed version has to pack every texel and unpack the result.
+    const int mask = (1 << int(std::log2(Max(n - 4, 1)))) - 1;
+    std::vector<Real> t(n);
+    for (Real& x : t) {
+        x = NextPcg32Real<Real>(rng);
+    }
+    auto bilinear = [&](auto blend) {
+        return ns_per_element(n, [&] {
+            Spectrum sum = MakeZeroSpectrum();
+            for (int i = 0; i < n; i++) {
+                const int j  = (i * 7) & mask;
+                sum         += blend(&a[j], t[i], t[n - 1 - i]);
+            }
+            sink = sum.x;
+        });
+    };
+    report("bilinear blend",
+           bilinear([](const Spectrum* v, Real u, Real w) {
+               return v[0] * (1 - u) * (1 - w) + v[1] * (1 - u) * w + v[2] * u * (1 - w) + v[3] * u * w;
+           }),
+           bilinear([](const Spectrum* v, Real u, Real w) {
+               const PackedSpectrum v0(v[0]), v2(v[2]);
+               const PackedSpectrum f = MulAdd(PackedSpectrum(v[1]) - v0, w, v0);
+               const PackedSpectrum c = MulAdd(PackedSpectrum(v[3]) - v2, w, v2);
+               return ToVector3(MulAdd(c - f, u, f));
+           }));
+
+    // Eight throughput updates t = t * f / p in a row, with the operands already packed
+    std::vector<PackedSpectrum> packed(n);
+    for (int i = 0; i < n; i++) {
+        packed[i] = PackedSpectrum(b[i]);
+    }
+    report("throughput x8",
+           ns_per_element(n,
+                          [&] {
+                              Spectrum sum = MakeZeroSpectrum();
+                              for (int i = 0; i < n; i++) {
+                                  Spectrum throughput = a[i];
+                                  for (int k = 0; k < 8; k++) {
+                                      throughput = throughput * b[(i + k) & mask] / t[(i + k) & mask];
+                                  }
+                                  sum += throughput;
+                              }
+                              sink = sum.x;
+                          }),
+           ns_per_element(n, [&] {
+               PackedSpectrum sum(MakeReal4(0));
+               for (int i = 0; i < n; i++) {
+                   PackedSpectrum throughput(a[i]);
+                   for (int k = 0; k < 8; k++) {
+                       throughput = throughput * packed[(i + k) & mask] / t[(i + k) & mask];
+                   }
+                   sum = sum + throughput;
+               }
+               sink = ToVector3(sum).x;
+           }));
+    return 0;
+}
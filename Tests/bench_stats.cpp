@@ -0,0 +1,60 @@
+// Benchmark of the statistics counters (not run by ctest): nanoseconds per increment from every thread at once,
+// for a statistics counter, a plain thread local and a shared atomic counter (what a naive global counter costs).
+// Usage: bench_stats [number of threads] [increments per thread]
+#include "Stats.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace elma;
+
+ELMA_STAT_COUNTER("Bench/Increments", sIncrements);
+
+static std::atomic<int64_t> sShared = 0;
+static thread_local int64_t tPlain  = 0;
+
+template<typename Increment> static double ns_per_increment(int num_threads, int64_t n, Increment increment)
+{
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back([&] {
+            for (int64_t i = 0; i < n; i++) {
+                increment(i);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / n * 1e9;
+}
+
+int main(int argc, char* argv[])
+{
+    const int num_threads = argc > 1 ? std::stoi(argv[1]) : int(std::thread::hardware_concurrency());
+    const int64_t n       = argc > 2 ? std::stoll(argv[2]) : 100000000;
+
+    // The fence keeps the compiler from folding a loop into one add
+    const double plain = ns_per_increment(num_threads, n, [](int64_t i) {
+        tPlain += i * 3;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    });
+    const double stat  = ns_per_increment(num_threads, n, [](int64_t i) {
+        sIncrements += i * 3;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    });
+    const double shared = ns_per_increment(num_threads, n, [](int64_t i) {
+        sShared.fetch_add(i * 3, std::memory_order_relaxed);
+    });
+
+    printf("%d threads, %lld increments per thread\n", num_threads, (long long)n);
+    printf("%-14s %10s\n", "counter", "ns");
+    printf("%-14s %10.3f\n", "thread local", plain);
+    printf("%-14s %10.3f\n", "statistics", stat);
+    printf("%-14s %10.3f\n", "shared atomic", shared);
+    printf("%s", FormatStats(GetStats()).c_str());
+    return 0;
+}
@@ -0,0 +1,84 @@
+// Benchmark of TableDist1D sampling (not run by ctest): binary search of the cdf against the alias
+// table, for tables of 10, 10k and 1M entries with random weights. Then TableDist2D for envmap sizes:
+// the previous binary searches of the cdfs against the search through coarse cdf levels.
+#include "Pcg.hpp"
+#include "TableDist.hpp"
+#include <chrono>
+#include <cstdio>
+
+using namespace elma;
+
+/// Best of three runs of f over all random numbers, in nanoseconds per call
+template<typename F> static double ns_per_call(const std::vector<Real>& rnd, F f)
+{
+    double best = 1e30;
+    for (int run = 0; run < 3; run++) {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i + 1 < rnd.size(); i += 2) {
+            f(rnd[i], rnd[i + 1]);
+        }
+        const double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best           = std::min(best, s);
+    }
+    return best * 1e9 / (rnd.size() / 2);
+}
+
+/// The x coordinate TableDist2D sampled before the search levels, kept here as the baseline
+static Real binary_search_sample(const TableDist2D& table, Real u, Real v)
+{
+    const int w = table.width, h = table.height;
+    const Real* y_ptr = std::upper_bound(table.cdfMarginals.data(), table.cdfMarginals.data() + h + 1, v);
+    const int y       = std::clamp(int(y_ptr - table.cdfMarginals.data() - 1), 0, h - 1);
+    const Real* cdf   = &table.cdfRows[y * (w + 1)];
+    const Real* x_ptr = std::upper_bound(cdf, cdf + w + 1, u);
+    const int x       = std::clamp(int(x_ptr - cdf - 1), 0, w - 1);
+    Real dx           = u - cdf[x];
+    if (cdf[x + 1] - cdf[x] > 0) {
+        dx /= (cdf[x + 1] - cdf[x]);
+    }
+    return (x + dx) / w;
+}
+
+int main(int argc, char* argv[])
+{
+    Pcg32State rng = InitPcg32();
+    std::vector<Real> rnd(1 << 22);
+    for (Real& u : rnd) {
+        u = NextPcg32Real<Real>(rng);
+    }
+
+    int64_t checksum = 0;
+    printf("%10s %12s %12s\n", "entries", "cdf ns", "alias ns");
+    for (int n : {10, 10'000, 1'000'000}) {
+        std::vector<Real> f(n);
+        for (Real& w : f) {
+            w = NextPcg32Real<Real>(rng);
+        }
+        const TableDist1D cdf   = MakeTableDist1d(f);
+        const TableDist1D alias = MakeTableDist1d(f, TableDistMethod::Alias);
+        const double cdf_ns     = ns_per_call(rnd, [&](Real u, Real) { checksum += Sample(cdf, u); });
+        const double alias_ns   = ns_per_call(rnd, [&](Real u, Real) { checksum += Sample(alias, u); });
+        printf("%10d %12.2f %12.2f  (%.1fx)\n", n, cdf_ns, alias_ns, cdf_ns / alias_ns);
+    }
+
+    printf("\n%10s %12s %12s\n", "envmap", "binary ns", "levels ns");
+    for (auto [w, h] : {std::pair{1024, 512}, std::pair{4096, 2048}, std::pair{8192, 4096}}) {
+        // A sky-like gradient with a few bright texels, weighted by the sine of the elevation like Envmap
+        std::vector<Real> f(size_t(w) * h);
+        for (int y = 0; y < h; y++) {
+            const Real sin_elevation = std::sin(kPi * (y + Real(0.5)) / h);
+            for (int x = 0; x < w; x++) {
+                const Real sun       = NextPcg32Real<Real>(rng) < Real(1e-4) ? Real(1000) : Real(0);
+                f[size_t(y) * w + x] = (Real(1) + Real(y) / h + sun) * sin_elevation;
+            }
+        }
+        const TableDist2D table = MakeTableDist2d(f, w, h);
+        Real sum                = 0;
+        const double binary_ns  = ns_per_call(rnd, [&](Real u, Real v) { sum += binary_search_sample(table, u, v); });
+        const double levels_ns  = ns_per_call(rnd, [&](Real u, Real v) { sum += Sample(table, Vector2{u, v}).x; });
+        printf("%5dx%-4d %12.2f %12.2f  (%.1fx)\n", w, h, binary_ns, levels_ns, binary_ns / levels_ns);
+        checksum += int64_t(sum);
+    }
+    printf("checksum %lld\n", (long long)checksum);
+    return 0;
+}
@@ -0,0 +1,122 @@
+// Microbenchmark of incoherent texture fetches (not run by ctest).
+// Compares bilinear lookups on the same texels stored row-major and in Morton ordered tiles
+// (the optional layout of the texture cache), and the old in-memory Mipmap against the texture cache with both
+// tile layouts.
+#include "Image.hpp"
+#include "Mipmap.hpp"
+#include "Pcg.hpp"
+#include "TextureCache.hpp"
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+using namespace elma;
+
+constexpr int kSize       = 2048;
+constexpr int kNumLookups = 1 << 22;
+
+static int row_major_index(int x, int y)
+{
+    return y * kSize + x;
+}
+
+static int tiled_index(int x, int y)
+{
+    const int tiles_x = kSize / kTextureTileSize;
+    const int tile    = (y >> kTextureTileShift) * tiles_x + (x >> kTextureTileShift);
+    return tile * kTextureTileSize * kTextureTileSize + TexelIndexInTile(TileLayout::Morton, x, y);
+}
+
+template<typename Index> static Vector3 bilinear(const std::vector<Vector3f>& texels, Index index, Vector2 uv)
+{
+    Real u     = uv.x * kSize - Real(0.5);
+    Real v     = uv.y * kSize - Real(0.5);
+    int ufi    = Modulo(int(u), kSize);
+    int vfi    = Modulo(int(v), kSize);
+    int uci    = Modulo(ufi + 1, kSize);
+    int vci    = Modulo(vfi + 1, kSize);
+    Real u_off = u - ufi;
+    Real v_off = v - vfi;
+    return Vector3(texels[index(ufi, vfi)]) * (1 - u_off) * (1 - v_off) +
+           Vector3(texels[index(ufi, vci)]) * (1 - u_off) * v_off + Vector3(texels[index(uci, vfi)]) * u_off * (1 - v_off) +
+           Vector3(texels[index(uci, vci)]) * u_off * v_off;
+}
+
+/// Lookup positions like secondary rays produce them: short runs of nearby uvs,
+/// each run starting at a random place and heading in a random direction.
+static std::vector<Vector2> make_lookups()
+{
+    Pcg32State rng = InitPcg32();
+    std::vector<Vector2> uvs(kNumLookups);
+    for (int i = 0; i < kNumLookups; i += 4) {
+        Vector2 p{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng)};
+        Vector2 d{NextPcg32Real<Real>(rng) - Real(0.5), NextPcg32Real<Real>(rng) - Real(0.5)};
+        for (int j = 0; j < 4; j++) {
+            uvs[i + j] = Vector2{Modulo(p.x + d.x * j * 4 / kSize, Real(1)), Modulo(p.y + d.y * j * 4 / kSize, Real(1))};
+        }
+    }
+    return uvs;
+}
+
+/// Best of a few runs, the machine is rarely quiet enough for a single one.
+template<typename F> static void run(const char* name, const std::vector<Vector2>& uvs, F lookup)
+{
+    double best = std::numeric_limits<double>::max();
+    Vector3 sum{0, 0, 0};
+    for (int r = 0; r < 3; r++) {
+        const auto start = std::chrono::steady_clock::now();
+        for (const Vector2& uv : uvs) {
+            sum += lookup(uv);
+        }
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    // Print the sum so that the lookups can't be optimized away
+    printf("%-32s %7.1f ns/lookup  (checksum %.3f)\n", name, best / uvs.size(), Average(sum));
+}
+
+int main(int argc, char* argv[])
+{
+    Pcg32State rng = InitPcg32(1);
+    Image3 img(kSize, kSize);
+    for (Vector3& v : img.data) {
+        v = Vector3{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng)};
+    }
+    std::vector<Vector3f> row_major(kSize * kSize), tiled(kSize * kSize);
+    for (int y = 0; y < kSize; y++) {
+        for (int x = 0; x < kSize; x++) {
+            row_major[row_major_index(x, y)] = Vector3f(img(x, y));
+            tiled[tiled_index(x, y)]         = Vector3f(img(x, y));
+        }
+    }
+    const std::vector<Vector2> uvs = make_lookups();
+
+    printf("%d bilinear lookups on a %dx%d RGB texture\n", kNumLookups, kSize, kSize);
+    run("row-major float texels", uvs, [&](const Vector2& uv) { return bilinear(row_major, row_major_index, uv); });
+    run("Morton tiled float texels", uvs, [&](const Vector2& uv) { return bilinear(tiled, tiled_index, uv); });
+
+    // End to end: trilinear lookups with a random footprint
+    Mipmap3 mipmap = MakeMipmap(img);
+    auto cache     = MakeTextureCache();
+    CachedMipmap3 cached{cache.get(), AddTexture(*cache, img), kSize, kSize, GetNumMipmapLevels(kSize, kSize)};
+    SetTextureCacheLayout(*cache, TileLayout::Morton);
+    CachedMipmap3 cached_morton{cache.get(), AddTexture(*cache, img), kSize, kSize, GetNumMipmapLevels(kSize, kSize)};
+    std::vector<Real> levels(kNumLookups);
+    for (Real& l : levels) {
+        l = NextPcg32Real<Real>(rng) * 3;
+    }
+    int i = 0;
+    run("Mipmap3 (row-major Real)", uvs, [&](const Vector2& uv) {
+        return Lookup(mipmap, uv.x, uv.y, levels[i++ % kNumLookups]);
+    });
+    i = 0;
+    run("CachedMipmap3 (row-major tiles)", uvs, [&](const Vector2& uv) {
+        return Lookup(cached, uv.x, uv.y, levels[i++ % kNumLookups]);
+    });
+    i = 0;
+    run("CachedMipmap3 (Morton tiles)", uvs, [&](const Vector2& uv) {
+        return Lookup(cached_morton, uv.x, uv.y, levels[i++ % kNumLookups]);
+    });
+    return 0;
+}
@@ -0,0 +1,120 @@
+// Benchmark of the tracking in the volumetric path tracer (not run by ctest): random walks through the smoke of
+// Data/Scenes/volpath_test/hetvol.xml, with delta tracking between scattering events and ratio tracking towards
+// the light at each of them, like VolPathTracing() does inside the medium. The walks are repeated with majorant
+// grids of different resolutions, 1 being the single global majorant.
+// Usage: bench_volpath [smoke.vol] [number of paths]
+#include "Medium.hpp"
+#include "Pcg.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+using namespace elma;
+
+static Vector3 random_direction(Pcg32State& rng)
+{
+    const Real z   = 1 - 2 * NextPcg32Real<Real>(rng);
+    const Real r   = std::sqrt(Max(1 - z * z, Real(0)));
+    const Real phi = kTwoPi * NextPcg32Real<Real>(rng);
+    return Vector3{r * std::cos(phi), r * std::sin(phi), z};
+}
+
+struct Result
+{
+    double nullCollisions = 0; // per path
+    double realCollisions = 0; // per path
+    double radiance       = 0; // mean estimate, the same for every majorant up to noise
+    double nsPerPath      = 0;
+};
+
+static Result run(const Medium& medium, const Vector3& camera, const Vector3& light, int num_paths)
+{
+    const GridVolume<Spectrum>& volume = std::get<GridVolume<Spectrum>>(std::get<HeterogeneousMedium>(medium).density);
+    Pcg32State rng                     = InitPcg32(7);
+    int64_t null_collisions = 0, real_collisions = 0;
+    double radiance  = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_paths; i++) {
+        // Towards a random point of the bounding box, as the camera rays hitting the smoke do
+        const Vector3 target = volume.posMin + (volume.posMax - volume.posMin) *
+                                                 Vector3{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng),
+                                                         NextPcg32Real<Real>(rng)};
+        Ray ray{camera, Normalize(target - camera), Real(0), Infinity<Real>()};
+        for (int depth = 0; depth < 256; depth++) {
+            bool scattered = false;
+            Vector3 scatter_p;
+            SampleMajorantCollisions(
+              medium,
+              ray,
+              Infinity<Real>(),
+              0,
+              rng,
+              [&](const Vector3& p, const MediumProperties& mp, const Spectrum& sigma_maj, const Spectrum&) {
+                  const Real u = NextPcg32Real<Real>(rng);
+                  if (u < mp.sigmaA[0] / sigma_maj[0]) {
+                      return false;
+                  }
+                  if (u < (mp.sigmaA[0] + mp.sigmaS[0]) / sigma_maj[0]) {
+                      scattered = true;
+                      scatter_p = p;
+                      return false;
+                  }
+                  null_collisions++;
+                  return true;
+              });
+            if (!scattered) {
+                break;
+            }
+            real_collisions++;
+
+            // Ratio tracking towards the light
+            const Vector3 dir_light = Normalize(light - scatter_p);
+            Real T_ray              = 1;
+            SampleMajorantCollisions(
+              medium,
+              Ray{scatter_p, dir_light, Real(0), Infinity<Real>()},
+              Distance(light, scatter_p),
+              0,
+              rng,
+              [&](const Vector3&, const MediumProperties& mp, const Spectrum& sigma_maj, const Spectrum&) {
+                  null_collisions++;
+                  T_ray *= Max(1 - (mp.sigmaA[0] + mp.sigmaS[0]) / sigma_maj[0], Real(0));
+                  return T_ray > 0;
+              });
+            radiance += T_ray * kInvFourPi / DistanceSquared(light, scatter_p);
+            ray       = Ray{scatter_p, random_direction(rng), Real(0), Infinity<Real>()};
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return Result{double(null_collisions) / num_paths, double(real_collisions) / num_paths, radiance / num_paths,
+                  seconds / num_paths * 1e9};
+}
+
+int main(int argc, char* argv[])
+{
+    const std::string filename = argc > 1 ? argv[1] : "Data/Scenes/volpath_test/smoke.vol";
+    const int num_paths        = argc > 2 ? std::stoi(argv[2]) : 20000;
+
+    // The medium of hetvol.xml: density scaled by 100, albedo 0.9
+    GridVolume<Spectrum> density = LoadVolumeFromFile<Spectrum>(filename);
+    density.scale                = 100;
+    const VolumeSpectrum albedo  = ConstantVolume<Spectrum>{MakeConstSpectrum(Real(0.9))};
+    const Vector3 camera{-0.61423, 0.154197, -1.43132};
+    const Vector3 light{0, -2, -1};
+
+    printf("%s: %d x %d x %d voxels, %d paths\n", filename.c_str(), density.resolution.x, density.resolution.y,
+           density.resolution.z, num_paths);
+    printf("%-10s %10s %12s %12s %12s %12s\n", "majorants", "build ms", "null/path", "real/path", "us/path",
+           "estimate");
+    for (int resolution : {1, 4, 8, 16, 32, 64}) {
+        const auto start      = std::chrono::steady_clock::now();
+        MajorantGrid grid     = MakeMajorantGrid(density, resolution);
+        const double build_ms = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e3;
+        const Medium medium   = HeterogeneousMedium{{IsotropicPhase{}}, albedo, density, std::move(grid)};
+        const Result r        = run(medium, camera, light, num_paths);
+        printf("%-10s %10.2f %12.1f %12.2f %12.2f %12.5f\n",
+               (std::to_string(resolution) + "^3").c_str(), build_ms, r.nullCollisions, r.realCollisions,
+               r.nsPerPath * 1e-3, r.radiance);
+    }
+    return 0;
+}
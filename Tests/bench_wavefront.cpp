@@ -0,0 +1,69 @@
+// Benchmark of the wavefront path tracer (not run by ctest): renders a scene with PathRender and
+// WavefrontPathRender at the same sample count and reports the time of both and the mean luminance of both
+// images, which agree up to noise. Usage: bench_wavefront [scene.xml ...] [-spp n]
+// Without scenes, Data/Scenes/sponza/sponza.xml and Data/Scenes/veach_mi/mi.xml are rendered.
+#include "Parallel.hpp"
+#include "Parsers/ParseScene.hpp"
+#include "Render.hpp"
+#include "Scene.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+using namespace elma;
+
+static Real mean_luminance(const Image3& img)
+{
+    Real sum = 0;
+    for (int i = 0; i < img.width * img.height; i++) {
+        sum += Luminance(img(i));
+    }
+    return sum / (img.width * img.height);
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> filenames;
+    int spp = 0;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "-spp" && i + 1 < argc) {
+            spp = std::stoi(argv[++i]);
+        }
+        else {
+            filenames.push_back(argv[i]);
+        }
+    }
+    if (filenames.empty()) {
+        filenames = {"Data/Scenes/sponza/sponza.xml", "Data/Scenes/veach_mi/mi.xml"};
+    }
+
+    RTCDevice embree_device = rtcNewDevice(nullptr);
+    ParallelInit(std::max(int(std::thread::hardware_concurrency()), 1));
+    printf("%-32s %6s %12s %12s %10s %12s %12s\n", "scene", "spp", "path s", "wavefront s", "speedup", "path mean",
+           "wave mean");
+    for (const std::string& filename : filenames) {
+        std::unique_ptr<Scene> scene = ParseScene(filename, embree_device);
+        if (spp > 0) {
+            scene->options.samplesPerPixel = spp;
+        }
+        // The same uniform sample count for both
+        scene->options.adaptiveThreshold = 0;
+
+        double seconds[2];
+        Real mean[2];
+        for (int k = 0; k < 2; k++) {
+            scene->options.integrator = k == 0 ? Integrator::Path : Integrator::WavefrontPath;
+            const auto start          = std::chrono::steady_clock::now();
+            const Image3 img          = Render(*scene);
+            seconds[k] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            mean[k]    = mean_luminance(img);
+        }
+        printf("%-32s %6d %12.3f %12.3f %9.2fx %12.5f %12.5f\n", fs::path(filename).filename().string().c_str(),
+               scene->options.samplesPerPixel, seconds[0], seconds[1], seconds[0] / seconds[1], double(mean[0]),
+               double(mean[1]));
+    }
+    ParallelCleanup();
+    rtcReleaseDevice(embree_device);
+    return 0;
+}
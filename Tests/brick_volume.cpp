@@ -0,0 +1,159 @@
+#include "Volume.hpp"
+#include "Pcg.hpp"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+using namespace elma;
+
+/// A few blobs in empty space, with a different density per channel unless gray
+static GridVolume<Spectrum> make_volume(const Vector3i& res, bool gray, Pcg32State& rng)
+{
+    GridVolume<Spectrum> volume;
+    volume.resolution = res;
+    volume.posMin     = Vector3{-1, -2, 0};
+    volume.posMax     = Vector3{1, 1, 3};
+    volume.data.assign(res.x * res.y * res.z, MakeZeroSpectrum());
+    volume.maxData = MakeZeroSpectrum();
+    for (int blob = 0; blob < 3; blob++) {
+        const Vector3 c{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng)};
+        const Real r = Real(0.1) + Real(0.1) * NextPcg32Real<Real>(rng);
+        for (int z = 0; z < res.z; z++) {
+            for (int y = 0; y < res.y; y++) {
+                for (int x = 0; x < res.x; x++) {
+                    const Vector3 p{Real(x) / (res.x - 1), Real(y) / (res.y - 1), Real(z) / (res.z - 1)};
+                    const Real d   = Max(1 - Distance(p, c) / r, Real(0));
+                    Spectrum& v    = volume.data[(z * res.y + y) * res.x + x];
+                    v              = v + (gray ? MakeConstSpectrum(d) : Vector3{d, Real(0.5) * d, 2 * d});
+                    volume.maxData = Max(volume.maxData, v);
+                }
+            }
+        }
+    }
+    volume.scale = 3;
+    return volume;
+}
+
+/// Writes a Mitsuba .vol file of 32 bit floats
+static void write_vol(const GridVolume<Spectrum>& volume, int channels, const fs::path& filename)
+{
+    std::ofstream fs(filename, std::ios::binary);
+    const uint8_t version = 3;
+    const int header[]    = {1, volume.resolution.x, volume.resolution.y, volume.resolution.z, channels};
+    const float bounds[]  = {float(volume.posMin.x), float(volume.posMin.y), float(volume.posMin.z),
+                             float(volume.posMax.x), float(volume.posMax.y), float(volume.posMax.z)};
+    fs.write("VOL", 3);
+    fs.write((const char*)&version, 1);
+    fs.write((const char*)header, sizeof(header));
+    fs.write((const char*)bounds, sizeof(bounds));
+    for (const Spectrum& v : volume.data) {
+        for (int c = 0; c < channels; c++) {
+            const float f = float(v[c]);
+            fs.write((const char*)&f, sizeof(f));
+        }
+    }
+}
+
+/// The lookups of the bricks against the ones of the dense grid, relative to the maximum
+static bool same_lookups(const GridVolume<Spectrum>& grid, const BrickVolume<Spectrum>& bricks, Real tolerance,
+                         Pcg32State& rng)
+{
+    const VolumeSpectrum dense = grid, sparse = bricks;
+    const Real max_value       = Max(GetMaxValue(dense));
+    bool ok                    = true;
+    for (int i = 0; i < 20000; i++) {
+        // Slightly outside the box as well
+        const Vector3 u{Real(1.1) * NextPcg32Real<Real>(rng) - Real(0.05),
+                        Real(1.1) * NextPcg32Real<Real>(rng) - Real(0.05),
+                        Real(1.1) * NextPcg32Real<Real>(rng) - Real(0.05)};
+        const Vector3 p  = grid.posMin + (grid.posMax - grid.posMin) * u;
+        const Spectrum a = Lookup(dense, p), b = Lookup(sparse, p);
+        for (int c = 0; c < 3; c++) {
+            ok &= std::abs(a[c] - b[c]) <= tolerance * max_value;
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    bool ok        = true;
+    Pcg32State rng = InitPcg32();
+
+    // Resolutions that aren't multiples of the brick size
+    const GridVolume<Spectrum> grid = make_volume(Vector3i{37, 20, 29}, false, rng);
+    const GridVolume<Spectrum> gray = make_volume(Vector3i{24, 17, 9}, true, rng);
+    const Real float_tolerance      = std::is_same_v<Real, float> ? Real(1e-5) : Real(1e-6);
+
+    for (VolumeEncoding encoding : {VolumeEncoding::Float32, VolumeEncoding::UInt16, VolumeEncoding::UInt8}) {
+        const Real tolerance = encoding == VolumeEncoding::UInt8    ? Real(1) / 255
+                               : encoding == VolumeEncoding::UInt16 ? Real(1) / 65535 + float_tolerance
+                                                                    : float_tolerance;
+        BrickVolume<Spectrum> bricks = MakeBrickVolume(grid, encoding);
+        bricks.scale                 = grid.scale;
+        ok &= bricks.channels == 3 && bricks.brickResolution.x == 5 && bricks.brickResolution.z == 4;
+        ok &= same_lookups(grid, bricks, tolerance, rng);
+
+        // Empty space takes no voxels
+        const size_t stored = bricks.brickMax.size() / bricks.channels;
+        ok &= stored > 0 && stored < bricks.brickIndex.size();
+        ok &= GetMemoryUsage(bricks) < grid.data.size() * sizeof(float) * 3;
+
+        // The maximum is the one of the grid, up to float precision
+        const VolumeSpectrum sparse = bricks;
+        const Spectrum max_value    = GetMaxValue(sparse);
+        for (int c = 0; c < 3; c++) {
+            ok &= std::abs(max_value[c] - grid.scale * grid.maxData[c]) <= float_tolerance * max_value[c];
+        }
+
+        // The majorants from the brick maxima bound the ones from the voxels
+        const MajorantGrid from_voxels = MakeMajorantGrid(grid), from_bricks = MakeMajorantGrid(bricks);
+        ok &= from_bricks.maxValues.size() == from_voxels.maxValues.size();
+        for (size_t i = 0; i < from_voxels.maxValues.size(); i++) {
+            for (int c = 0; c < 3; c++) {
+                ok &= from_bricks.maxValues[i][c] >= from_voxels.maxValues[i][c] * (1 - float_tolerance);
+            }
+        }
+
+        // Gray spectra store a single channel
+        BrickVolume<Spectrum> gray_bricks = MakeBrickVolume(gray, encoding);
+        gray_bricks.scale                 = gray.scale;
+        ok &= gray_bricks.channels == 1;
+        ok &= same_lookups(gray, gray_bricks, tolerance, rng);
+
+        // Saving and loading gives the same bricks
+        const fs::path filename = fs::temp_directory_path() / "elma_brick_volume_test.elmavol";
+        SaveBrickVolume(bricks, filename);
+        BrickVolume<Spectrum> loaded = LoadBrickVolumeFromFile<Spectrum>(filename, VolumeEncoding::Float32);
+        ok &= loaded.encoding == encoding && loaded.channels == bricks.channels;
+        ok &= loaded.brickIndex == bricks.brickIndex && loaded.brickMax == bricks.brickMax;
+        ok &= loaded.voxels == bricks.voxels;
+        fs::remove(filename);
+    }
+
+    // Converting a .vol file a few slices at a time gives the bricks of the dense grid
+    const fs::path vol_filename = fs::temp_directory_path() / "elma_brick_volume_test.vol";
+    write_vol(grid, 3, vol_filename);
+    const GridVolume<Spectrum> dense     = LoadVolumeFromFile<Spectrum>(vol_filename);
+    const BrickVolume<Spectrum> streamed = LoadBrickVolumeFromFile<Spectrum>(vol_filename, VolumeEncoding::UInt16);
+    const BrickVolume<Spectrum> in_core  = MakeBrickVolume(dense, VolumeEncoding::UInt16);
+    ok &= streamed.brickIndex == in_core.brickIndex && streamed.brickMax == in_core.brickMax;
+    ok &= streamed.voxels == in_core.voxels;
+    write_vol(gray, 1, vol_filename);
+    const BrickVolume<Real> scalar = LoadBrickVolumeFromFile<Real>(vol_filename, VolumeEncoding::Float32);
+    ok &= scalar.channels == 1 && std::abs(scalar.maxData - gray.maxData.x) <= float_tolerance * gray.maxData.x;
+    fs::remove(vol_filename);
+
+    // Rays only hit the box
+    const VolumeSpectrum sparse = MakeBrickVolume(grid, VolumeEncoding::UInt8);
+    ok &= Intersect(sparse, Ray{Vector3{0, 0, -1}, Vector3{0, 0, 1}, Real(0), Infinity<Real>()});
+    ok &= !Intersect(sparse, Ray{Vector3{0, 0, -1}, Vector3{0, 0, -1}, Real(0), Infinity<Real>()});
+    ok &= !Intersect(sparse, Ray{Vector3{0, 0, -1}, Vector3{0, 0, 1}, Real(0), Real(0.5)});
+
+    if (!ok) {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("SUCCESS\n");
+    return 0;
+}
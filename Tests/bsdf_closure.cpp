@@ -0,0 +1,153 @@
+#include "Intersection.hpp"
+#include "Material.hpp"
+#include "Pcg.hpp"
+#include <cstdio>
+
+using namespace elma;
+
+static Vector3 random_direction(Pcg32State& rng)
+{
+    const Real z   = 1 - 2 * NextPcg32Real<Real>(rng);
+    const Real r   = std::sqrt(Max(1 - z * z, Real(0)));
+    const Real phi = kTwoPi * NextPcg32Real<Real>(rng);
+    return Vector3{r * std::cos(phi), r * std::sin(phi), z};
+}
+
+/// Textures that vary over the surface, so a closure prepared at another uv would differ
+static Texture<Spectrum> spectrum_texture(Pcg32State& rng)
+{
+    return MakeCheckerboardSpectrumTexture(
+      Vector3{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng)},
+      Vector3{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng)},
+      3,
+      5);
+}
+
+static Texture<Real> float_texture(Pcg32State& rng)
+{
+    // Roughnesses out of [0.01, 1] too
+    const Real value0 = NextPcg32Real<Real>(rng);
+    const Real value1 = Real(1.2) * NextPcg32Real<Real>(rng) - Real(0.1);
+    return MakeCheckerboardFloatTexture(value0, value1, 4, 2);
+}
+
+static bool same(const Spectrum& a, const Spectrum& b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+int main(int argc, char* argv[])
+{
+    bool ok        = true;
+    Pcg32State rng = InitPcg32();
+    TexturePool pool;
+
+    std::vector<Material> materials;
+    for (int i = 0; i < 3; i++) {
+        materials.push_back(Lambertian{spectrum_texture(rng)});
+        materials.push_back(RoughPlastic{spectrum_texture(rng), spectrum_texture(rng), float_texture(rng), Real(1.5)});
+        materials.push_back(
+          RoughDielectric{spectrum_texture(rng), spectrum_texture(rng), float_texture(rng), Real(1.5)});
+        materials.push_back(DisneyDiffuse{spectrum_texture(rng), float_texture(rng), float_texture(rng)});
+        materials.push_back(DisneyMetal{spectrum_texture(rng), float_texture(rng), float_texture(rng)});
+        materials.push_back(DisneyGlass{spectrum_texture(rng), float_texture(rng), float_texture(rng), Real(1.4)});
+        materials.push_back(DisneyClearcoat{float_texture(rng)});
+        materials.push_back(DisneySheen{spectrum_texture(rng), float_texture(rng)});
+        materials.push_back(DisneyBSDF{spectrum_texture(rng),
+                                       float_texture(rng),
+                                       float_texture(rng),
+                                       float_texture(rng),
+                                       float_texture(rng),
+                                       float_texture(rng),
+                                       float_texture(rng),
+                                       float_texture(rng),
+                                       float_texture(rng),
+                                       float_texture(rng),
+                                       float_texture(rng),
+                                       float_texture(rng),
+                                       Real(1.5)});
+    }
+
+    // A closure gives exactly what the material gives at the same vertex, for every call
+    for (const Material& material : materials) {
+        for (int i = 0; i < 200; i++) {
+            PathVertex vertex;
+            vertex.normal       = random_direction(rng);
+            vertex.shadingFrame = Frame(Normalize(vertex.normal + Real(0.3) * random_direction(rng)));
+            vertex.uv           = Vector2{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng)};
+            vertex.uvScreenSize = 0;
+
+            const Vector3 dir_in = random_direction(rng), dir_out = random_direction(rng);
+            const Vector2 rnd_param_uv{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng)};
+            const Real rnd_param_w       = NextPcg32Real<Real>(rng);
+            const TransportDirection dir = i % 2 == 0 ? TransportDirection::TO_LIGHT : TransportDirection::TO_VIEW;
+
+            const BSDFClosure bsdf      = PrepareBSDF(material, vertex, pool);
+            const Spectrum f            = Eval(material, dir_in, dir_out, vertex, pool, dir);
+            const Real pdf              = PdfSampleBSDF(material, dir_in, dir_out, vertex, pool, dir);
+            const BSDFEvalRecord record = EvalWithPdf(bsdf, dir_in, dir_out, vertex, dir);
+            ok &= bsdf.index() == material.index();
+            ok &= same(Eval(bsdf, dir_in, dir_out, vertex, dir), f);
+            ok &= PdfSampleBSDF(bsdf, dir_in, dir_out, vertex, dir) == pdf;
+            ok &= same(record.f, f) && record.pdf == pdf;
+
+            const std::optional<BSDFSampleRecord> a =
+              SampleBSDF(material, dir_in, vertex, pool, rnd_param_uv, rnd_param_w, dir);
+            const std::optional<BSDFSampleRecord> b = SampleBSDF(bsdf, dir_in, vertex, rnd_param_uv, rnd_param_w, dir);
+            ok &= bool(a) == bool(b);
+            if (a && b) {
+                ok &= same(a->dirOut, b->dirOut) && a->eta == b->eta && a->roughness == b->roughness;
+            }
+        }
+    }
+
+    // Roughnesses are clamped when preparing
+    PathVertex vertex;
+    vertex.uv           = Vector2{Real(0.5), Real(0.5)};
+    vertex.uvScreenSize = 0;
+
+    const Texture<Spectrum> gray = MakeConstantSpectrumTexture(MakeConstSpectrum(Real(0.5)));
+    const Material smooth        = RoughPlastic{gray, gray, MakeConstantFloatTexture(0), Real(1.5)};
+    ok &= std::get<RoughPlasticClosure>(PrepareBSDF(smooth, vertex, pool)).roughness == Real(0.01);
+
+    // Materials with constant textures compile to the closure of any vertex
+    const Material plastic = RoughPlastic{gray, gray, MakeConstantFloatTexture(Real(0.3)), Real(1.5)};
+    const Material disney  = DisneyBSDF{gray,
+                                       MakeConstantFloatTexture(0),
+                                       MakeConstantFloatTexture(Real(0.5)),
+                                       MakeConstantFloatTexture(Real(0.2)),
+                                       MakeConstantFloatTexture(Real(0.5)),
+                                       MakeConstantFloatTexture(Real(0.4)),
+                                       MakeConstantFloatTexture(0),
+                                       MakeConstantFloatTexture(0),
+                                       MakeConstantFloatTexture(0),
+                                       MakeConstantFloatTexture(0),
+                                       MakeConstantFloatTexture(0),
+                                       MakeConstantFloatTexture(1),
+                                       Real(1.5)};
+    for (const Material& material : {plastic, disney}) {
+        const std::optional<BSDFClosure> compiled = CompileBSDF(material, pool);
+        ok &= compiled && compiled->index() == material.index();
+        if (compiled) {
+            const Vector3 dir_in{Real(0), Real(0.6), Real(0.8)}, dir_out{Real(0.6), Real(0), Real(0.8)};
+            vertex.normal       = Vector3{Real(0), Real(0), Real(1)};
+            vertex.shadingFrame = Frame(vertex.normal);
+            ok &= same(Eval(*compiled, dir_in, dir_out, vertex), Eval(material, dir_in, dir_out, vertex, pool));
+            ok &= PdfSampleBSDF(*compiled, dir_in, dir_out, vertex) ==
+                  PdfSampleBSDF(material, dir_in, dir_out, vertex, pool);
+        }
+    }
+    ok &= !CompileBSDF(materials[0], pool);
+
+    // Lobes of zero weight are never sampled
+    const DisneyBSDFClosure closure = std::get<DisneyBSDFClosure>(*CompileBSDF(disney, pool));
+    ok &= closure.glassWeight == 0 && closure.clearcoatWeight == 0;
+    ok &= std::abs(closure.diffuseWeight + closure.metalWeight - 1) < Real(1e-6);
+
+    if (!ok) {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("SUCCESS\n");
+    return 0;
+}
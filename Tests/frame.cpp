@@ -1,12 +1,14 @@
 #include "Frame.hpp"
 #include <cstdio>
 
+using namespace elma;
+
 int main(int argc, char* argv[])
 {
-    Frame f(Normalize(Vector3{0.3, 0.4, 0.5}));
+    Frame f(Normalize(Vector3{Real(0.3), Real(0.4), Real(0.5)}));
     Vector3 v       = Vector3{-1, -2, -3};
-    Vector3 local_v = to_local(f, v);
-    Vector3 world_v = to_world(f, local_v);
+    Vector3 local_v = ToLocal(f, v);
+    Vector3 world_v = ToWorld(f, local_v);
     if (Distance(v, world_v) > Real(1e-3)) {
         printf("FAIL\n");
         return 1;
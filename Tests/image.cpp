@@ -1,6 +1,8 @@
 #include "Image.hpp"
 #include <cstdio>
 
+using namespace elma;
+
 int main(int argc, char* argv[])
 {
     Image3 img(32, 24);
@@ -13,8 +15,8 @@ int main(int argc, char* argv[])
     }
 
     // round trip test
-    imwrite("test.exr", img);
-    Image3 rimg = imread3("test.exr");
+    ImageWrite("test.exr", img);
+    Image3 rimg = ImageRead3("test.exr");
     for (int y = 0; y < img.height; y++) {
         for (int x = 0; x < img.width; x++) {
             Vector3 target = Vector3{3 * (img.width * y + x) / Real(1'024),
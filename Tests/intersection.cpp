@@ -1,12 +1,16 @@
 #include "Scene.hpp"
 #include "Intersection.hpp"
+#include "Transform.hpp"
+#include <array>
+
+using namespace elma;
 
 int main(int argc, char* argv[])
 {
     RTCDevice embree_device = rtcNewDevice(nullptr);
     Camera cam;
     std::vector<Shape> shapes;
-    shapes.emplace_back(TriangleMesh{
+    TriangleMesh triangle{
       {}  /*default parameters for ShapeBase*/,
       {Vector3{-1, -1, -1}, Vector3{1, -1, -1}, Vector3{0, 1, -1}},
       {Vector3i{0, 1, 2}},
@@ -14,7 +18,15 @@ int main(int argc, char* argv[])
       {}, // uvs
       Real(0), // total area
       TableDist1D{}
-    });
+    };
+    shapes.emplace_back(triangle);
+    // The same triangle as a shape group, instanced twice further down the -z axis
+    triangle.materialId = 3;
+    auto group          = std::make_shared<const ShapeGroup>(embree_device, std::vector<Shape>{triangle});
+    for (Real offset : {Real(-4), Real(-8)}) {
+        Matrix4x4 to_world = Translate(Vector3{Real(0), Real(0), offset}) * Scale(Vector3{Real(2), Real(2), Real(2)});
+        shapes.emplace_back(Instance{{}, group, to_world, Inverse(to_world)});
+    }
     Scene scene(embree_device,
                 Camera(),
                 {}, /* materials */
@@ -29,10 +41,10 @@ int main(int argc, char* argv[])
     Ray ray{
       Vector3{0, 0,  0},
       Vector3{0, 0, -1},
-      Real(0), infinity<Real>()
+      Real(0), Infinity<Real>()
     };
     RayDifferential ray_diff;
-    std::optional<PathVertex> vertex = intersect(scene, ray, ray_diff);
+    std::optional<PathVertex> vertex = Intersect(scene, ray, ray_diff);
     if (!vertex) {
         printf("FAIL\n");
         return 1;
@@ -42,6 +54,73 @@ int main(int argc, char* argv[])
         return 1;
     }
 
+    // Starting behind the plain triangle, the ray hits the first instance (its triangle is at z = -2 - 4)
+    ray.org = Vector3{0, 0, -2};
+    vertex  = Intersect(scene, ray, ray_diff);
+    if (!vertex || vertex->shapeId != 1 || vertex->groupShapeId != 0 || vertex->materialId != 3 ||
+        Distance(vertex->position, Vector3{0, 0, -6}) > Real(1e-3) || fabs(vertex->shadingFrame.n.y - 1) > Real(1e-3))
+    {
+        printf("FAIL\n");
+        return 1;
+    }
+    if (!Occluded(scene, Ray{Vector3{0, 0, -7}, Vector3{0, 0, -1}, Real(0), Real(10)})) {
+        printf("FAIL\n");
+        return 1;
+    }
+
+    // A packet mixing invalid lanes, misses, hits on the triangle and on both instances, and segments that end
+    // before the geometry gives what ray by ray queries give
+    RayBatch batch;
+    for (int i = 0; i < kRayBatchSize; i++) {
+        const Real x     = Real(i % 4) * Real(0.2) - Real(0.3);
+        const Real z     = i % 3 == 0 ? Real(0) : (i % 3 == 1 ? Real(-2) : Real(-7));
+        const Real t_far = i % 5 == 4 ? Real(0.5) : Infinity<Real>();
+        // Lanes 6 and 7 point away from everything
+        const Vector3 dir = i == 6 || i == 7 ? Vector3{0, 0, 1} : Vector3{0, 0, -1};
+        SetRay(batch, i, Ray{Vector3{x, Real(0), z}, dir, Real(0), t_far}, RayDifferential{Real(0.01), Real(0.001)});
+        batch.valid[i] = i % 7 != 3;
+    }
+    std::array<std::optional<PathVertex>, kRayBatchSize> vertices;
+    std::array<bool, kRayBatchSize> occluded;
+    IntersectN(scene, batch, vertices);
+    OccludedN(scene, batch, occluded);
+    int num_hits = 0, num_instance_hits = 0;
+    for (int i = 0; i < kRayBatchSize; i++) {
+        const Ray lane_ray = GetRay(batch, i);
+        if (!batch.valid[i]) {
+            if (vertices[i] || occluded[i]) {
+                printf("FAIL\n");
+                return 1;
+            }
+            continue;
+        }
+        const std::optional<PathVertex> expected = Intersect(scene, lane_ray, GetRayDifferential(batch, i));
+        if (bool(expected) != bool(vertices[i]) || Occluded(scene, lane_ray) != occluded[i] ||
+            occluded[i] != bool(vertices[i]))
+        {
+            printf("FAIL\n");
+            return 1;
+        }
+        if (!expected) {
+            continue;
+        }
+        if (vertices[i]->shapeId != expected->shapeId || vertices[i]->groupShapeId != expected->groupShapeId ||
+            vertices[i]->primitiveId != expected->primitiveId || vertices[i]->materialId != expected->materialId ||
+            Distance(vertices[i]->position, expected->position) > Real(1e-4) ||
+            fabs(vertices[i]->rayRadius - expected->rayRadius) > Real(1e-4))
+        {
+            printf("FAIL\n");
+            return 1;
+        }
+        num_hits++;
+        num_instance_hits += vertices[i]->groupShapeId >= 0;
+    }
+    // The packet has to exercise both kinds of hits
+    if (num_hits == 0 || num_instance_hits == 0 || num_instance_hits == num_hits) {
+        printf("FAIL\n");
+        return 1;
+    }
+
     printf("SUCCESS\n");
     return 0;
 }
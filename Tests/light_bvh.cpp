@@ -0,0 +1,130 @@
+#include "LightBVH.hpp"
+#include "Pcg.hpp"
+#include <cmath>
+#include <cstdio>
+
+using namespace elma;
+
+static Vector3 random_direction(Pcg32State& rng)
+{
+    const Real z   = 1 - 2 * NextPcg32Real<Real>(rng);
+    const Real r   = std::sqrt(Max(1 - z * z, Real(0)));
+    const Real phi = kTwoPi * NextPcg32Real<Real>(rng);
+    return Vector3{r * std::cos(phi), r * std::sin(phi), z};
+}
+
+/// One sided discs (a cone of a single direction), spheres (normals in all directions),
+/// two sided discs, lights without power and infinite lights
+static std::vector<std::optional<LightBounds>> make_lights(int n, Pcg32State& rng)
+{
+    std::vector<std::optional<LightBounds>> lights;
+    for (int i = 0; i < n; i++) {
+        const Vector3 c{10 * NextPcg32Real<Real>(rng), 10 * NextPcg32Real<Real>(rng), 10 * NextPcg32Real<Real>(rng)};
+        const Real r = Real(0.01) + Real(0.2) * NextPcg32Real<Real>(rng);
+        LightBounds b;
+        b.pMin      = c - Vector3{r, r, r};
+        b.pMax      = c + Vector3{r, r, r};
+        b.axis      = random_direction(rng);
+        b.phi       = i % 17 == 3 ? Real(0) : Real(0.1) + NextPcg32Real<Real>(rng);
+        b.cosThetaO = i % 5 == 0 ? Real(-1) : Real(1);
+        b.cosThetaE = 0;
+        b.twoSided  = i % 7 == 0;
+        lights.push_back(b);
+    }
+    lights.insert(lights.begin() + n / 2, std::nullopt);
+    return lights;
+}
+
+/// Checks that sampling follows the pmfs and that every light that can illuminate the point can be sampled.
+/// The pmfs may sum to less than one: a subtree whose children both turn out to have no importance returns
+/// no light, which only happens where the parent's bounds were too conservative.
+static bool check(const LightBVH& bvh,
+                  const std::vector<std::optional<LightBounds>>& lights,
+                  const Vector3& p,
+                  const Vector3& n,
+                  Pcg32State& rng)
+{
+    const int num_lights = (int)lights.size();
+    bool ok              = true;
+    std::vector<double> pmf(num_lights);
+    double sum = 0;
+    for (int i = 0; i < num_lights; i++) {
+        pmf[i]  = Pmf(bvh, p, n, i);
+        sum    += pmf[i];
+        ok     &= pmf[i] >= 0;
+        if (!lights[i]) {
+            ok &= pmf[i] > 0;
+            continue;
+        }
+        const LightBounds& b = *lights[i];
+        const Vector3 c      = (b.pMin + b.pMax) / Real(2);
+        const Real cos_light = Dot(b.axis, Normalize(p - c));
+        const bool faces_p   = b.cosThetaO < 0 || (b.twoSided ? std::abs(cos_light) : cos_light) > 0;
+        const bool p_faces   = LengthSquared(n) == 0 || Dot(n, c - p) != 0;
+        if (b.phi == 0) {
+            ok &= pmf[i] == 0;
+        }
+        else if (faces_p && p_faces) {
+            ok &= pmf[i] > 0;
+        }
+    }
+    ok &= sum < 1 + 1e-4 && sum > 0.5;
+
+    const int num_samples = 200000;
+    std::vector<int> counts(num_lights + 1, 0); // the last one counts the samples without a light
+    for (int s = 0; s < num_samples; s++) {
+        const LightSampleRecord sample = Sample(bvh, p, n, NextPcg32Real<Real>(rng));
+        const int id                   = sample.lightId;
+        ok &= id == -1 || (id >= 0 && id < num_lights && pmf[id] > 0);
+        ok &= id == -1 ? sample.pmf == 0 : std::abs(sample.pmf - pmf[id]) <= 1e-4 * pmf[id];
+        counts[id >= 0 && id < num_lights ? id : num_lights]++;
+    }
+    pmf.push_back(Max(1 - sum, 0.0));
+    for (int i = 0; i <= num_lights; i++) {
+        const double expected = pmf[i] * num_samples;
+        ok &= std::abs(counts[i] - expected) <= 5 * std::sqrt(expected) + 2;
+    }
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    bool ok        = true;
+    Pcg32State rng = InitPcg32();
+
+    const std::vector<std::optional<LightBounds>> lights = make_lights(300, rng);
+    const LightBVH bvh                                   = MakeLightBVH(lights);
+    ok &= bvh.infiniteLights.size() == 1 && bvh.nodes.size() == bvh.parents.size();
+    for (int i = 0; i < 20; i++) {
+        const Vector3 p{12 * NextPcg32Real<Real>(rng) - 1, 12 * NextPcg32Real<Real>(rng) - 1,
+                        12 * NextPcg32Real<Real>(rng) - 1};
+        ok &= check(bvh, lights, p, i % 4 == 0 ? Vector3{0, 0, 0} : random_direction(rng), rng);
+    }
+
+    // Without infinite lights, a single light, only infinite lights
+    std::vector<std::optional<LightBounds>> finite(lights.begin(), lights.begin() + 150);
+    ok &= check(MakeLightBVH(finite), finite, Vector3{5, 5, 5}, Vector3{0, 1, 0}, rng);
+    std::vector<std::optional<LightBounds>> single(lights.begin() + 1, lights.begin() + 2);
+    ok &= check(MakeLightBVH(single), single, Vector3{5, 5, 5}, Vector3{0, 0, 0}, rng);
+    std::vector<std::optional<LightBounds>> infinite = {std::nullopt, std::nullopt};
+    ok &= check(MakeLightBVH(infinite), infinite, Vector3{0, 0, 0}, Vector3{0, 0, 1}, rng);
+
+    // A one sided light facing away from the point, nothing to sample
+    LightBounds away;
+    away.pMin      = Vector3{-1, -1, -1};
+    away.pMax      = Vector3{1, 1, 1};
+    away.axis      = Vector3{0, 0, 1};
+    away.phi       = 1;
+    away.cosThetaE = 0;
+    const LightBVH away_bvh = MakeLightBVH({away, away});
+    ok &= Sample(away_bvh, Vector3{0, 0, -5}, Vector3{0, 0, 0}, Real(0.5)).lightId == -1;
+    ok &= Pmf(away_bvh, Vector3{0, 0, -5}, Vector3{0, 0, 0}, 0) == 0;
+    ok &= Pmf(away_bvh, Vector3{0, 0, 5}, Vector3{0, 0, 0}, 0) == Real(0.5);
+
+    if (!ok) {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("SUCCESS\n");
+    return 0;
+}
@@ -1,16 +1,22 @@
+#include "Intersection.hpp"
 #include "Material.hpp"
 #include "Microfacet.hpp"
 #include <cstdio>
 
+using namespace elma;
+
+// Finite differences need a larger step in single precision
+static const Real kEpsilon = std::is_same_v<Real, float> ? Real(1e-3) : Real(1e-6);
+
 Real compute_determinant(
     const Material& m, const PathVertex& vertex, const Vector3& dir_in, const Vector2& rnd_param, Real w)
 {
-    Real eps                               = Real(1e-6);
-    std::optional<BSDFSampleRecord> sample = sample_bsdf(m, dir_in, vertex, TexturePool(), rnd_param, w);
+    Real eps                               = kEpsilon;
+    std::optional<BSDFSampleRecord> sample = SampleBSDF(m, dir_in, vertex, TexturePool(), rnd_param, w);
     std::optional<BSDFSampleRecord> sample_u =
-        sample_bsdf(m, dir_in, vertex, TexturePool(), rnd_param + Vector2{eps, Real(0)}, w);
+        SampleBSDF(m, dir_in, vertex, TexturePool(), rnd_param + Vector2{eps, Real(0)}, w);
     std::optional<BSDFSampleRecord> sample_v =
-        sample_bsdf(m, dir_in, vertex, TexturePool(), rnd_param + Vector2{Real(0), eps}, w);
+        SampleBSDF(m, dir_in, vertex, TexturePool(), rnd_param + Vector2{Real(0), eps}, w);
     if (!sample || !sample_u || !sample_v) {
         printf("FAIL\n");
         exit(1);
@@ -39,7 +45,7 @@ int main(int argc, char* argv[])
     // We'll just make sure sampling & PDF are consistent
     Vector2 rnd_param_uv{Real(0.3), Real(0.4)};
     Real rnd_param_w{Real(0.6)};
-    Vector3 dir_in = Normalize(Vector3{0.3, 0.4, 0.5});
+    Vector3 dir_in = Normalize(Vector3{Real(0.3), Real(0.4), Real(0.5)});
     PathVertex vertex;
     vertex.normal           = Vector3{0, 0, 1};
     vertex.shadingFrame     = Frame(vertex.normal);
@@ -48,8 +54,8 @@ int main(int argc, char* argv[])
 
         Real det = compute_determinant(m, vertex, dir_in, rnd_param_uv, rnd_param_w);
         std::optional<BSDFSampleRecord> sample =
-            sample_bsdf(m, dir_in, vertex, TexturePool(), rnd_param_uv, rnd_param_w);
-        Real pdf = pdf_sample_bsdf(m, dir_in, sample->dirOut, vertex, TexturePool());
+            SampleBSDF(m, dir_in, vertex, TexturePool(), rnd_param_uv, rnd_param_w);
+        Real pdf = PdfSampleBSDF(m, dir_in, sample->dirOut, vertex, TexturePool());
         if (fabs((1 / det) - pdf) / fabs(pdf) > Real(1e-2)) {
             printf("FAIL\n");
             return 1;
@@ -66,8 +72,8 @@ int main(int argc, char* argv[])
         Real det0 = compute_determinant(m, vertex, dir_in, rnd_param_uv, Real(0));
         Real det1 = compute_determinant(m, vertex, dir_in, rnd_param_uv, Real(1));
         std::optional<BSDFSampleRecord> sample =
-            sample_bsdf(m, dir_in, vertex, TexturePool(), rnd_param_uv, Real(0) /* w shouldn't matter here */);
-        Real pdf = pdf_sample_bsdf(m, dir_in, sample->dirOut, vertex, TexturePool());
+            SampleBSDF(m, dir_in, vertex, TexturePool(), rnd_param_uv, Real(0) /* w shouldn't matter here */);
+        Real pdf = PdfSampleBSDF(m, dir_in, sample->dirOut, vertex, TexturePool());
         if (fabs(((1 / det0) + (1 / det1)) / 2 - pdf) / fabs(pdf) > Real(1e-2)) {
             printf("FAIL\n");
             return 1;
@@ -84,10 +90,10 @@ int main(int argc, char* argv[])
         {
             Real det0 = compute_determinant(m, vertex, dir_in, rnd_param_uv, Real(0));
             std::optional<BSDFSampleRecord> sample_0 =
-                sample_bsdf(m, dir_in, vertex, TexturePool(), rnd_param_uv, Real(0));
-            Real pdf0 = pdf_sample_bsdf(m, dir_in, sample_0->dirOut, vertex, TexturePool());
+                SampleBSDF(m, dir_in, vertex, TexturePool(), rnd_param_uv, Real(0));
+            Real pdf0 = PdfSampleBSDF(m, dir_in, sample_0->dirOut, vertex, TexturePool());
             // Unfortunately we need to manually add the Fresnel term
-            bool reflect = dot(vertex.normal, dir_in) * dot(vertex.normal, sample_0->dirOut) > 0;
+            bool reflect = Dot(vertex.normal, dir_in) * Dot(vertex.normal, sample_0->dirOut) > 0;
             Vector3 half_vector;
             if (reflect) {
                 half_vector = Normalize(dir_in + sample_0->dirOut);
@@ -95,8 +101,8 @@ int main(int argc, char* argv[])
             else {
                 half_vector = Normalize(dir_in + sample_0->dirOut * Real(1.5));
             }
-            Real h_dot_in = dot(half_vector, dir_in);
-            Real F        = fresnel_dielectric(h_dot_in, Real(1.5));
+            Real h_dot_in = Dot(half_vector, dir_in);
+            Real F        = FresnelDielectric(h_dot_in, Real(1.5));
             Real inv_det0 = Real(1) / det0;
             if (reflect) {
                 inv_det0 *= F;
@@ -114,10 +120,10 @@ int main(int argc, char* argv[])
         {
             Real det1 = compute_determinant(m, vertex, dir_in, rnd_param_uv, Real(1));
             std::optional<BSDFSampleRecord> sample_1 =
-                sample_bsdf(m, dir_in, vertex, TexturePool(), rnd_param_uv, Real(1));
-            Real pdf1 = pdf_sample_bsdf(m, dir_in, sample_1->dirOut, vertex, TexturePool());
+                SampleBSDF(m, dir_in, vertex, TexturePool(), rnd_param_uv, Real(1));
+            Real pdf1 = PdfSampleBSDF(m, dir_in, sample_1->dirOut, vertex, TexturePool());
             // Unfortunately we need to manually add the Fresnel term
-            bool reflect = dot(vertex.normal, dir_in) * dot(vertex.normal, sample_1->dirOut) > 0;
+            bool reflect = Dot(vertex.normal, dir_in) * Dot(vertex.normal, sample_1->dirOut) > 0;
             Vector3 half_vector;
             if (reflect) {
                 half_vector = Normalize(dir_in + sample_1->dirOut);
@@ -125,8 +131,8 @@ int main(int argc, char* argv[])
             else {
                 half_vector = Normalize(dir_in + sample_1->dirOut * Real(1.5));
             }
-            Real h_dot_in = dot(half_vector, dir_in);
-            Real F        = fresnel_dielectric(h_dot_in, Real(1.5));
+            Real h_dot_in = Dot(half_vector, dir_in);
+            Real F        = FresnelDielectric(h_dot_in, Real(1.5));
             Real inv_det1 = Real(1) / det1;
             if (reflect) {
                 inv_det1 *= F;
@@ -1,6 +1,8 @@
 #include "Matrix.hpp"
 #include <cstdio>
 
+using namespace elma;
+
 int main(int argc, char* argv[])
 {
     Matrix4x4 m = Matrix4x4(
@@ -11,7 +13,7 @@ int main(int argc, char* argv[])
         Real(13), Real(14), Real(15), Real(26)
         // clang-format on
     );
-    Matrix4x4 m_inv   = inverse(m);
+    Matrix4x4 m_inv   = Inverse(m);
     Matrix4x4 m_inv_m = m_inv * m;
     for (int i = 0; i < 4; i++) {
         for (int j = 0; j < 4; j++) {
@@ -0,0 +1,75 @@
+#include "Parsers/MeshCache.hpp"
+#include "Parsers/ParseObj.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+using namespace elma;
+
+static void write_file(const fs::path& path, const std::string& content)
+{
+    std::ofstream ofs(path, std::ios::binary);
+    ofs << content;
+}
+
+static bool same_bins(const std::vector<AliasBin>& a, const std::vector<AliasBin>& b)
+{
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const AliasBin& x, const AliasBin& y) {
+        return x.prob == y.prob && x.alias == y.alias;
+    });
+}
+
+static bool same_mesh(const TriangleMesh& a, const TriangleMesh& b)
+{
+    return same_bins(a.triangleSampler.aliasBins, b.triangleSampler.aliasBins) && a.positions.size() == b.positions.size() && a.indices.size() == b.indices.size() &&
+           a.normals.size() == b.normals.size() && a.uvs.size() == b.uvs.size() &&
+           a.triangleSampler.cdf == b.triangleSampler.cdf && a.triangleSampler.pmf == b.triangleSampler.pmf &&
+           a.totalArea == b.totalArea &&
+           memcmp(a.positions.data(), b.positions.data(), a.positions.size() * sizeof(Vector3f)) == 0 &&
+           memcmp(a.indices.data(), b.indices.data(), a.indices.size() * sizeof(Vector3i)) == 0 &&
+           memcmp(a.normals.data(), b.normals.data(), a.normals.size() * sizeof(Vector3)) == 0 &&
+           memcmp(a.uvs.data(), b.uvs.data(), a.uvs.size() * sizeof(Vector2)) == 0;
+}
+
+int main(int argc, char* argv[])
+{
+    const fs::path source = fs::temp_directory_path() / "elma_test_cache.obj";
+    write_file(source, "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nvt 0 0\nvn 0 0 1\nf 1/1/1 2/1/1 3/1/1 4/1/1\n");
+    const Matrix4x4 to_world = Matrix4x4::identity();
+
+    TriangleMesh mesh    = ParseObj(source, to_world);
+    mesh.triangleSampler = MakeTableDist1d({Real(0.25), Real(0.75)}, TableDistMethod::Alias);
+    mesh.totalArea       = 1;
+
+    const MeshCacheEntry entry = GetMeshCacheEntry(source, "obj", 0, to_world, false);
+    bool ok                    = !ReadMeshCache(entry, source); // not written yet
+    ok &= GetMeshCacheEntry(source, "obj", 0, to_world, true).key != entry.key;
+
+    WriteMeshCache(entry, source, mesh);
+    std::optional<TriangleMesh> cached = ReadMeshCache(entry, source);
+    ok &= cached && same_mesh(*cached, mesh);
+
+    // A damaged file is rejected
+    {
+        std::fstream fs(entry.cacheFile, std::ios::binary | std::ios::in | std::ios::out);
+        fs.seekp(-1, std::ios::end);
+        fs.put('\x7f');
+    }
+    ok &= !ReadMeshCache(entry, source);
+
+    // So is a cache older than its source
+    WriteMeshCache(entry, source, mesh);
+    ok &= ReadMeshCache(entry, source).has_value();
+    fs::last_write_time(source, fs::last_write_time(entry.cacheFile) + std::chrono::seconds(1));
+    ok &= !ReadMeshCache(entry, source);
+
+    fs::remove(entry.cacheFile);
+    fs::remove(source);
+    if (!ok) {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("SUCCESS\n");
+    return 0;
+}
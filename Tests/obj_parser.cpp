@@ -0,0 +1,123 @@
+#include "Parallel.hpp"
+#include "Parsers/ParseObj.hpp"
+#include <cstdio>
+#include <fstream>
+
+using namespace elma;
+
+static fs::path write_file(const char* name, const std::string& content)
+{
+    fs::path path = fs::temp_directory_path() / name;
+    std::ofstream ofs(path, std::ios::binary);
+    ofs << content;
+    return path;
+}
+
+template<typename T> static bool equal(const TVector2<T>& a, const TVector2<T>& b)
+{
+    return a.x == b.x && a.y == b.y;
+}
+
+template<typename T> static bool equal(const TVector3<T>& a, const TVector3<T>& b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+template<typename Array> static bool equal_arrays(const Array& a, const Array& b)
+{
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const auto& x, const auto& y) { return equal(x, y); });
+}
+
+/// A grid of quads, big enough to be parsed in several chunks. Faces use absolute or
+/// (counting back from the last vertex) relative indices, the meshes have to come out the same.
+static std::string make_grid(int n, bool relative)
+{
+    std::string obj = "# grid\r\n";
+    for (int y = 0; y <= n; y++) {
+        for (int x = 0; x <= n; x++) {
+            obj += "v " + std::to_string(x) + " " + std::to_string(y) + " 0\r\n";
+            obj += "vt " + std::to_string(x / double(n)) + " " + std::to_string(y / double(n)) + "\n";
+            if (y > 0 && x > 0) {
+                const int vid[4] = {(y - 1) * (n + 1) + x, (y - 1) * (n + 1) + x + 1, y * (n + 1) + x + 1,
+                                    y * (n + 1) + x};
+                const int num_defined = y * (n + 1) + x + 1;
+                obj += "f";
+                for (int k = 0; k < 4; k++) {
+                    const std::string id = std::to_string(relative ? vid[k] - num_defined - 1 : vid[k]);
+                    obj += " " + id + "/" + id;
+                }
+                obj += "\n";
+            }
+        }
+    }
+    return obj;
+}
+
+int main(int argc, char* argv[])
+{
+    ParallelInit(4);
+    bool ok = true;
+
+    {
+        // A quad and a triangle sharing two corners, normals only, a w coordinate and a comment
+        const fs::path path = write_file("elma_test_small.obj",
+                                         "# comment\n"
+                                         "v 0 0 0\n"
+                                         "v 2 0 0 2\n"
+                                         "v 1 1 0\n"
+                                         "  v 0 1 0   \r\n"
+                                         "vn 0 0 2\n"
+                                         "o object\n"
+                                         "f 1//1 2//1 3//1 4//1\n"
+                                         "f -4//-1 -2//-1 -1//-1\n");
+        const Matrix4x4 to_world{2, 0, 0, 1, 0, 2, 0, 0, 0, 0, 2, 0, 0, 0, 0, 1};
+        TriangleMesh mesh = ParseObj(path, to_world);
+        ok &= mesh.positions.size() == 4 && mesh.normals.size() == 4 && mesh.uvs.empty();
+        ok &= mesh.indices.size() == 3;
+        ok &= equal(mesh.indices[0], Vector3i{0, 1, 2}) && equal(mesh.indices[1], Vector3i{0, 2, 3}) &&
+              equal(mesh.indices[2], Vector3i{0, 2, 3});
+        ok &= equal(mesh.positions[1], Vector3f{3, 0, 0}) && equal(mesh.positions[3], Vector3f{1, 2, 0});
+        ok &= equal(mesh.normals[0], Vector3{0, 0, 1});
+        fs::remove(path);
+    }
+
+    {
+        const fs::path abs_path = write_file("elma_test_abs.obj", make_grid(300, false));
+        const fs::path rel_path = write_file("elma_test_rel.obj", make_grid(300, true));
+        TriangleMesh a          = ParseObj(abs_path, Matrix4x4::identity());
+        TriangleMesh b          = ParseObj(rel_path, Matrix4x4::identity());
+        ok &= fs::file_size(abs_path) > (size_t(2) << 20);
+        ok &= a.indices.size() == 2 * 300 * 300 && a.positions.size() == 301 * 301 && a.uvs.size() == 301 * 301;
+        ok &= equal_arrays(a.indices, b.indices) && equal_arrays(a.positions, b.positions) &&
+              equal_arrays(a.uvs, b.uvs);
+        // The first quad of the second row of quads
+        ok &= equal(a.positions[a.indices[600][0]], Vector3f{0, 1, 0});
+        fs::remove(abs_path);
+        fs::remove(rel_path);
+    }
+
+    {
+        // Polygons with more than four corners and indices out of range are errors
+        const char* pentagon     = "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 0 2 0\nf 1 2 3 4 5\n";
+        const char* out_of_range = "v 0 0 0\nf 1 2 3\n";
+        for (const char* content : {pentagon, out_of_range}) {
+            const fs::path path = write_file("elma_test_bad.obj", content);
+            bool threw          = false;
+            try {
+                ParseObj(path, Matrix4x4::identity());
+            } catch (const std::exception&) {
+                threw = true;
+            }
+            ok &= threw;
+            fs::remove(path);
+        }
+    }
+
+    ParallelCleanup();
+    if (!ok) {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("SUCCESS\n");
+    return 0;
+}
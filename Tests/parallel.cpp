@@ -0,0 +1,60 @@
+#include "Parallel.hpp"
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+using namespace elma;
+
+static bool check_counts(const std::vector<std::atomic<int>>& counts, int expected)
+{
+    for (const auto& c : counts) {
+        if (c.load() != expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    for (int num_threads : {1, 4, 16, 64}) {
+        ParallelInit(num_threads);
+
+        // Every index is visited exactly once, for several chunk sizes
+        for (int64_t chunk_size : {1, 3, 64}) {
+            std::vector<std::atomic<int>> counts(10'007);
+            ParallelFor([&](int64_t i) { counts[i]++; }, (int64_t)counts.size(), chunk_size);
+            if (!check_counts(counts, 1)) {
+                printf("FAIL\n");
+                return 1;
+            }
+        }
+
+        // 2D loop
+        {
+            const Vector2i count{37, 23};
+            std::vector<std::atomic<int>> counts(count.x * count.y);
+            ParallelFor([&](Vector2i tile) { counts[tile.y * count.x + tile.x]++; }, count);
+            if (!check_counts(counts, 1)) {
+                printf("FAIL\n");
+                return 1;
+            }
+        }
+
+        // Nested loops
+        {
+            std::vector<std::atomic<int>> counts(64 * 64);
+            ParallelFor(
+                [&](int64_t i) { ParallelFor([&](int64_t j) { counts[i * 64 + j]++; }, 64); }, 64);
+            if (!check_counts(counts, 1)) {
+                printf("FAIL\n");
+                return 1;
+            }
+        }
+
+        ParallelCleanup();
+    }
+
+    printf("SUCCESS\n");
+    return 0;
+}
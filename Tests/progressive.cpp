@@ -0,0 +1,91 @@
+#include "Scene.hpp"
+#include "Parallel.hpp"
+#include "Render.hpp"
+#include <cstdio>
+
+using namespace elma;
+
+constexpr int kWidth = 32, kHeight = 24, kNumPasses = 4;
+
+int main(int argc, char* argv[])
+{
+    ParallelInit(4);
+    RTCDevice embree_device = rtcNewDevice(nullptr);
+
+    // A floor and a plastic ball lit by a small spherical light, seen from the origin along +z
+    std::vector<Material> materials;
+    materials.push_back(Lambertian{MakeConstantSpectrumTexture(MakeConstSpectrum(Real(0.6)))});
+    materials.push_back(RoughPlastic{MakeConstantSpectrumTexture(FromRGB(Vector3{Real(0.2), Real(0.5), Real(0.8)})),
+                                     MakeConstantSpectrumTexture(MakeConstSpectrum(Real(1))),
+                                     MakeConstantFloatTexture(Real(0.2)),
+                                     Real(1.5)});
+    std::vector<Shape> shapes;
+    shapes.emplace_back(TriangleMesh{
+      {0, -1} /* material, area light */,
+      {Vector3{-4, -1, 0}, Vector3{4, -1, 0}, Vector3{4, -1, 8}, Vector3{-4, -1, 8}},
+      {Vector3i{0, 1, 2}, Vector3i{0, 2, 3}},
+      {}, // normals
+      {}, // uvs
+      Real(0), // total area
+      TableDist1D{}
+    });
+    shapes.emplace_back(Sphere{{1, -1}, Vector3{Real(0), Real(-0.3), Real(4)}, Real(0.7)});
+    shapes.emplace_back(Sphere{{0, 0}, Vector3{Real(0.8), Real(1.2), Real(3.5)}, Real(0.3)});
+    std::vector<Light> lights;
+    lights.push_back(DiffuseAreaLight{2, Vector3{10, 10, 10}});
+
+    RenderOptions options;
+    options.samplesPerPixel = kNumPasses;
+    options.maxDepth        = 6;
+    options.rrDepth         = 3;
+    Scene scene(embree_device,
+                Camera(Matrix4x4::identity(), Real(45), kWidth, kHeight, Box{Real(1)}, -1),
+                materials,
+                shapes,
+                lights,
+                {}, /* media */
+                -1, /* envmap id */
+                TexturePool{},
+                options,
+                "" /* output filename */);
+
+    // Passes of one sample (like elma_cli with a time budget) have to add up to the single render of all samples,
+    // also for the samplers whose sequences depend on the sample count
+    bool ok      = true;
+    Real lit_sum = 0;
+    for (SamplerType sampler : {SamplerType::PaddedSobol, SamplerType::ZSobol}) {
+        for (Integrator integrator : {Integrator::Path, Integrator::WavefrontPath}) {
+            scene.options.sampler         = sampler;
+            scene.options.integrator      = integrator;
+            scene.options.samplesPerPass  = 0;
+            scene.options.accumulateCount = 0;
+            const Image3 single           = Render(scene);
+
+            Image3 passes(kWidth, kHeight);
+            scene.options.samplesPerPass = 1;
+            for (int pass = 0; pass < kNumPasses; pass++) {
+                scene.options.accumulateCount = pass;
+                const Image3 img              = Render(scene);
+                for (int i = 0; i < kWidth * kHeight; i++) {
+                    passes(i) += img(i);
+                }
+            }
+            for (int i = 0; i < kWidth * kHeight; i++) {
+                const Vector3 averaged = passes(i) / Real(kNumPasses);
+                ok &= Distance(averaged, single(i)) <= Real(1e-4) * (1 + Length(single(i)));
+                lit_sum += Luminance(single(i));
+            }
+        }
+    }
+    // The scene has to be lit for the comparison to mean anything
+    ok &= lit_sum > 0;
+
+    rtcReleaseDevice(embree_device);
+    ParallelCleanup();
+    if (!ok) {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("SUCCESS\n");
+    return 0;
+}
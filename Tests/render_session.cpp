@@ -0,0 +1,87 @@
+#include "Scene.hpp"
+#include "Parallel.hpp"
+#include "RenderSession.hpp"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+using namespace elma;
+
+// Waits for the next frame of the session, returns false on a timeout
+static bool wait_for_frame(RenderSession& session, Image3f& frame)
+{
+    for (int i = 0; i < 10000; i++) {
+        if (session.present(frame)) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+int main(int argc, char* argv[])
+{
+    ParallelInit(4);
+    RTCDevice embree_device = rtcNewDevice(nullptr);
+    std::vector<Shape> shapes;
+    shapes.emplace_back(TriangleMesh{
+      {}  /*default parameters for ShapeBase*/,
+      {Vector3{-1, -1, 2}, Vector3{1, -1, 2}, Vector3{0, 1, 2}},
+      {Vector3i{0, 1, 2}},
+      {}, // normals
+      {}, // uvs
+      Real(0), // total area
+      TableDist1D{}
+    });
+    RenderOptions options;
+    options.integrator      = Integrator::Depth;
+    options.samplesPerPixel = 1;
+    Scene scene(embree_device,
+                Camera(Matrix4x4::identity(), Real(45), 64, 48, Box{Real(1)}, -1),
+                {}, /* materials */
+                shapes,
+                {}, /* lights */
+                {}, /* media */
+                -1, /* envmap id */
+                TexturePool{},
+                options,
+                "" /* output filename */);
+
+    Image3f frame;
+    {
+        RenderSession session(scene);
+        session.start();
+        if (!wait_for_frame(session, frame) || frame.width != 64 || frame.height != 48) {
+            printf("FAIL\n");
+            return 1;
+        }
+        RenderSessionStats stats = session.getStats();
+        if (stats.passes < 1 || stats.timeToFirstFrame < 0) {
+            printf("FAIL\n");
+            return 1;
+        }
+
+        // A restart applies the edit before the accumulation starts over
+        session.restart([](Scene& s) {
+            s.camera = Camera(Matrix4x4::identity(), Real(45), 32, 16, Box{Real(1)}, -1);
+        });
+        do {
+            if (!wait_for_frame(session, frame)) {
+                printf("FAIL\n");
+                return 1;
+            }
+        } while (frame.width != 32);
+        // (the scene belongs to the session until it stops)
+        session.stop();
+        stats = session.getStats();
+        if (frame.height != 16 || stats.passes < 1 || scene.options.accumulateCount != stats.passes) {
+            printf("FAIL\n");
+            return 1;
+        }
+    }
+
+    rtcReleaseDevice(embree_device);
+    ParallelCleanup();
+    printf("SUCCESS\n");
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "Sampler.hpp"
+#include <cmath>
+#include <cstdio>
+
+using namespace elma;
+
+// Smooth integrand over [0, 1]^2 with a closed-form integral
+static Real integrand(const Vector2& u)
+{
+    return std::exp(-u.x * u.x - u.y * u.y);
+}
+
+// RMSE of per-pixel estimates over a 32x32 image. The integrand uses the dimensions after
+// the pixel position and a 1D draw, like a light sample in the path tracer does.
+static Real estimate_rmse(SamplerType type, int spp, bool* in_range)
+{
+    const Real reference = Real(0.25) * kPi * std::erf(Real(1)) * std::erf(Real(1));
+    constexpr int res    = 32;
+    Sampler sampler      = MakeSampler(type, res, res, spp);
+    Real sum_sq_error    = 0;
+    for (int y = 0; y < res; y++) {
+        for (int x = 0; x < res; x++) {
+            Real estimate = 0;
+            for (int s = 0; s < spp; s++) {
+                StartPixelSample(sampler, Vector2i{x, y}, s);
+                Vector2 pixel_uv = Next2D(sampler);
+                Real w           = Next1D(sampler);
+                Vector2 u        = Next2D(sampler);
+                for (Real v : {pixel_uv.x, pixel_uv.y, w, u.x, u.y}) {
+                    if (!(v >= 0 && v < 1)) {
+                        *in_range = false;
+                    }
+                }
+                estimate += integrand(u);
+            }
+            estimate     /= spp;
+            sum_sq_error += (estimate - reference) * (estimate - reference);
+        }
+    }
+    return std::sqrt(sum_sq_error / (res * res));
+}
+
+int main(int argc, char* argv[])
+{
+    const char* names[] = {"independent", "paddedSobol", "zsobol"};
+    const SamplerType types[] = {SamplerType::Independent, SamplerType::PaddedSobol, SamplerType::ZSobol};
+    const int spps[]          = {4, 16, 64, 256};
+
+    Real rmse[3][4];
+    bool in_range = true;
+    for (int t = 0; t < 3; t++) {
+        printf("%12s:", names[t]);
+        for (int i = 0; i < 4; i++) {
+            rmse[t][i] = estimate_rmse(types[t], spps[i], &in_range);
+            printf(" %4d spp %.3e", spps[i], rmse[t][i]);
+        }
+        printf("\n");
+    }
+
+    if (!in_range) {
+        printf("FAIL\n");
+        return 1;
+    }
+    for (int t = 0; t < 3; t++) {
+        // Error has to go down with the sample count
+        for (int i = 1; i < 4; i++) {
+            if (rmse[t][i] >= rmse[t][i - 1]) {
+                printf("FAIL\n");
+                return 1;
+            }
+        }
+    }
+    // Independent sampling converges at O(N^-1/2): 64x the samples should give about 8x less error,
+    // the scrambled Sobol samplers should do much better than that on a smooth integrand.
+    for (int t = 1; t < 3; t++) {
+        if (rmse[t][3] * 4 > rmse[0][3] || rmse[t][0] / rmse[t][3] < 4 * rmse[0][0] / rmse[0][3]) {
+            printf("FAIL\n");
+            return 1;
+        }
+    }
+
+    printf("SUCCESS\n");
+    return 0;
+}
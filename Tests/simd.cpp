@@ -0,0 +1,95 @@
+#include "Pcg.hpp"
+#include "Simd.hpp"
+#include <cstdio>
+#include <vector>
+
+using namespace elma;
+
+// The SIMD backends round differently (fused multiply-adds, reciprocals), so compare with a tolerance
+static const Real kTolerance = std::is_same_v<Real, float> ? Real(1e-5) : Real(1e-12);
+
+static bool close(Real a, Real b, Real tolerance = kTolerance)
+{
+    return std::abs(a - b) <= tolerance * Max(Real(1), Max(std::abs(a), std::abs(b)));
+}
+
+static bool close(const Vector3& a, const Vector3& b, Real tolerance = kTolerance)
+{
+    return close(a.x, b.x, tolerance) && close(a.y, b.y, tolerance) && close(a.z, b.z, tolerance);
+}
+
+static Vector3 random_vector(Pcg32State& rng, Real scale)
+{
+    return Vector3{scale * (2 * NextPcg32Real<Real>(rng) - 1), scale * (2 * NextPcg32Real<Real>(rng) - 1),
+                   scale * (2 * NextPcg32Real<Real>(rng) - 1)};
+}
+
+int main(int argc, char* argv[])
+{
+    bool ok        = true;
+    Pcg32State rng = InitPcg32();
+
+    // Packed vectors against Vector3
+    for (int i = 0; i < 1000; i++) {
+        const Vector3 a = random_vector(rng, 10), b = random_vector(rng, 10);
+        const Real s    = Real(0.5) + NextPcg32Real<Real>(rng);
+        const PackedVector3 pa(a), pb(b);
+        ok &= close(ToVector3(pa + pb), a + b);
+        ok &= close(ToVector3(pa - pb), a - b);
+        ok &= close(ToVector3(pa * pb), a * b);
+        ok &= close(ToVector3(pa * s), a * s) && close(ToVector3(s * pa), s * a);
+        ok &= close(ToVector3(pa / s), a / s);
+        ok &= close(ToVector3(MulAdd(pa, s, pb)), a * s + b);
+        ok &= close(Dot(pa, pb), Dot(a, b));
+        ok &= close(ToVector3(Cross(pa, pb)), Cross(a, b));
+        ok &= close(ToVector3(Normalize(pa)), Normalize(a));
+        ok &= close(Length(pa), Length(a));
+        const Vector3 e = random_vector(rng, 20);
+        ok &= close(ToVector3(Exp(PackedSpectrum(e))), Exp(e));
+    }
+    ok &= LengthSquared(ToVector3(Normalize(PackedVector3(Vector3{0, 0, 0})))) == 0;
+
+    // e^x over the whole range, relative error
+    const Real exp_tolerance = std::is_same_v<Real, float> ? Real(1e-6) : Real(1e-14);
+    const Real max_x         = std::is_same_v<Real, float> ? Real(85) : Real(700);
+    for (int i = 0; i < 10000; i++) {
+        const Real x = max_x * (2 * NextPcg32Real<Real>(rng) - 1);
+        ok &= std::abs(Lane(Exp(MakeReal4(x)), 2) / std::exp(x) - 1) <= exp_tolerance;
+    }
+    ok &= Lane(Exp(MakeReal4(0)), 0) == 1;
+
+    // Batched kernels, with a tail that doesn't fill four lanes, and in place
+    const int n = 4 * 50 + 3;
+    std::vector<Vector3> a(n), b(n), out(n);
+    std::vector<Real> dots(n);
+    for (int i = 0; i < n; i++) {
+        a[i] = random_vector(rng, 10);
+        b[i] = random_vector(rng, 10);
+    }
+    a[5] = Vector3{0, 0, 0};
+    BatchDot(a.data(), b.data(), dots.data(), n);
+    for (int i = 0; i < n; i++) {
+        ok &= close(dots[i], Dot(a[i], b[i]));
+    }
+    BatchCross(a.data(), b.data(), out.data(), n);
+    for (int i = 0; i < n; i++) {
+        ok &= close(out[i], Cross(a[i], b[i]));
+    }
+    BatchNormalize(a.data(), out.data(), n);
+    for (int i = 0; i < n; i++) {
+        ok &= close(out[i], Normalize(a[i]));
+    }
+    ok &= LengthSquared(out[5]) == 0;
+    out = a;
+    BatchExp(out.data(), out.data(), n);
+    for (int i = 0; i < n; i++) {
+        ok &= close(out[i], Exp(a[i]), exp_tolerance);
+    }
+
+    if (!ok) {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("SUCCESS\n");
+    return 0;
+}
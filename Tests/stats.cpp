@@ -0,0 +1,71 @@
+#include "Stats.hpp"
+#include <cstdio>
+#include <thread>
+
+using namespace elma;
+
+ELMA_STAT_COUNTER("Test/Counter", sCounter);
+ELMA_STAT_RATIO("Test/Ratio", sHits, sTries);
+ELMA_STAT_DISTRIBUTION("Test/Distribution", sValues);
+
+/// The same title again, as a header declaring a statistic in several translation units does
+ELMA_STAT_COUNTER("Test/Counter", sCounterAgain);
+
+int main(int argc, char* argv[])
+{
+    bool ok = true;
+    ok &= sCounterAgain.index == sCounter.index && sTries.index == sHits.index + 1;
+
+    // Threads that have exited count as well
+    constexpr int num_threads = 4, n = 100000;
+    ResetStats();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back([t] {
+            for (int i = 0; i < n; i++) {
+                ++sCounter;
+                ++sTries;
+                sHits += i % 4 == 0;
+                sValues.report(t * n + i);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    sCounter += 5;
+
+    StatsReport report       = GetStats();
+    const StatEntry* counter = FindStat(report, "Test/Counter");
+    const StatEntry* ratio   = FindStat(report, "Test/Ratio");
+    const StatEntry* values  = FindStat(report, "Test/Distribution");
+    ok &= counter && counter->type == StatType::Counter && counter->count == num_threads * n + 5;
+    ok &= ratio && ratio->count == num_threads * n / 4 && ratio->total == num_threads * n;
+    const int64_t num_values = int64_t(num_threads) * n;
+    ok &= values && values->count == num_values && values->total == num_values * (num_values - 1) / 2;
+    ok &= values && values->min == 0 && values->max == num_values - 1;
+    ok &= FindStat(report, "Test/Missing") == nullptr;
+
+    // Merging the statistics of two renders
+    MergeStats(report, report);
+    ok &= FindStat(report, "Test/Counter")->count == 2 * (num_threads * n + 5);
+    ok &= FindStat(report, "Test/Distribution")->max == num_values - 1;
+
+    const std::string table = FormatStats(report), json = StatsToJson(report);
+    ok &= table.find("Test\n") != std::string::npos && table.find("Distribution") != std::string::npos;
+    ok &= json.front() == '{' && json.back() == '}' && json.find("\"Test/Ratio\": {\"count\": ") != std::string::npos;
+
+    // Resetting zeroes every thread, distributions start over
+    ResetStats();
+    sValues.report(-3);
+    report = GetStats();
+    ok &= FindStat(report, "Test/Counter")->count == 0 && FindStat(report, "Test/Ratio")->total == 0;
+    ok &= FindStat(report, "Test/Distribution")->count == 1 && FindStat(report, "Test/Distribution")->max == -3;
+
+    if (!ok) {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("SUCCESS\n");
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "Pcg.hpp"
+#include "TableDist.hpp"
+#include <cmath>
+#include <cstdio>
+
+using namespace elma;
+
+/// The probability of each entry under the alias table, summed over the bins that can return it
+static std::vector<double> alias_probabilities(const TableDist1D& table)
+{
+    const int n = (int)table.aliasBins.size();
+    std::vector<double> p(n, 0);
+    for (int i = 0; i < n; i++) {
+        p[i] += double(table.aliasBins[i].prob) / n;
+        p[table.aliasBins[i].alias] += (1 - double(table.aliasBins[i].prob)) / n;
+    }
+    return p;
+}
+
+int main(int argc, char* argv[])
+{
+    bool ok = true;
+
+    std::vector<std::vector<Real>> weights = {{1}, {0, 3, 0, 1}, {1, 1, 1, 1, 1}, {5, 0, 0.25, 2, 7, 0, 1e-3}};
+    std::vector<Real> ramp(1000);
+    for (int i = 0; i < (int)ramp.size(); i++) {
+        ramp[i] = Real((i * 37) % 101);
+    }
+    weights.push_back(ramp);
+
+    for (const std::vector<Real>& f : weights) {
+        const TableDist1D cdf   = MakeTableDist1d(f);
+        const TableDist1D alias = MakeTableDist1d(f, TableDistMethod::Alias);
+        const int n             = (int)f.size();
+        ok &= alias.cdf.empty() && (int)alias.aliasBins.size() == n && cdf.aliasBins.empty();
+        ok &= cdf.pmf == alias.pmf;
+
+        const std::vector<double> p = alias_probabilities(alias);
+        for (int i = 0; i < n; i++) {
+            ok &= std::abs(p[i] - double(alias.pmf[i])) < 1e-5;
+            ok &= Pmf(alias, i) == Pmf(cdf, i);
+        }
+
+        // Zero weight entries are never sampled, even at the ends of the random number range
+        for (int k = 0; k <= 4096; k++) {
+            const Real u = std::min(Real(k / 4096.0), Real(1));
+            const int id = Sample(alias, u);
+            ok &= id >= 0 && id < n && f[id] > 0;
+        }
+    }
+
+    // TableDist2D searches its cdfs top down through coarse copies, the samples have to match a binary search
+    for (auto [w, h] : {std::pair{1, 1}, std::pair{7, 5}, std::pair{300, 17}, std::pair{5000, 2}}) {
+        std::vector<Real> f(w * h);
+        for (int i = 0; i < w * h; i++) {
+            f[i] = (i % 3 == 1) ? 0 : Real((i * 13) % 17 + 1);
+        }
+        const TableDist2D table = MakeTableDist2d(f, w, h);
+        auto reference          = [&](const Real* cdf, int n, Real u) {
+            return std::clamp(int(std::upper_bound(cdf, cdf + n + 1, u) - cdf - 1), 0, n - 1);
+        };
+        Pcg32State rng = InitPcg32();
+        for (int i = 0; i < 100000; i++) {
+            // Also the ends of the range and exact cdf values
+            Vector2 u{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng)};
+            if (i < 4) {
+                u = Vector2{Real(i % 2), Real(i / 2)};
+            }
+            else if (i % 7 == 0) {
+                u.x = table.cdfRows[NextPcg32(rng) % table.cdfRows.size()];
+            }
+            const int y      = reference(table.cdfMarginals.data(), h, u.y);
+            const int x      = reference(&table.cdfRows[y * (w + 1)], w, u.x);
+            const Vector2 xy = Sample(table, u);
+            // Exact cdf values land on the start of their entry, up to rounding
+            ok &= xy.x * w > x - Real(1e-3) && xy.x * w < x + 1 + Real(1e-3);
+            ok &= xy.y * h > y - Real(1e-3) && xy.y * h < y + 1 + Real(1e-3);
+            // A random number of exactly one picks the last entry, like the binary search did
+            ok &= f[y * w + x] > 0 || u.x == 1 || u.y == 1;
+        }
+    }
+
+    if (!ok) {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("SUCCESS\n");
+    return 0;
+}
@@ -0,0 +1,186 @@
+#include "Image.hpp"
+#include "Mipmap.hpp"
+#include "Parallel.hpp"
+#include "TextureCache.hpp"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+
+using namespace elma;
+
+static bool close(const Vector3& a, const Vector3& b, Real tolerance = Real(1e-3))
+{
+    // Mipmap levels of HDR images are rounded to half precision.
+    return fabs(a.x - b.x) < tolerance && fabs(a.y - b.y) < tolerance && fabs(a.z - b.z) < tolerance;
+}
+
+// Uncompressed 24-bit TGA, stored top to bottom
+static void write_tga(const fs::path& filename, int width, int height, const std::vector<uint8_t>& rgb)
+{
+    std::ofstream out(filename, std::ios::binary);
+    uint8_t header[18] = {0, 0, 2};
+    header[12]         = uint8_t(width & 0xff);
+    header[13]         = uint8_t(width >> 8);
+    header[14]         = uint8_t(height & 0xff);
+    header[15]         = uint8_t(height >> 8);
+    header[16]         = 24;
+    header[17]         = 0x20;
+    out.write((const char*)header, sizeof(header));
+    for (int i = 0; i < width * height; i++) {
+        uint8_t bgr[3] = {rgb[3 * i + 2], rgb[3 * i + 1], rgb[3 * i]};
+        out.write((const char*)bgr, 3);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // Texel encodings round trip
+    for (int i = 0; i < 256; i++) {
+        if (LinearToU8(kU8ToLinear[i]) != i) {
+            printf("FAIL\n");
+            return 1;
+        }
+    }
+    for (float f : {0.f, 1.f, -2.5f, 0.1f, 1e-6f, 65504.f}) {
+        if (fabs(HalfToFloat(FloatToHalf(f)) - f) > fabs(f) * 1e-3f + 6e-8f) {
+            printf("FAIL\n");
+            return 1;
+        }
+    }
+
+    ParallelInit(4);
+
+    // Tile files left in the temporary directory by earlier runs
+    const fs::path tile_directory = fs::temp_directory_path() / "elma_texture_cache";
+    auto count_tile_files         = [&]() {
+        std::error_code ec;
+        int count = 0;
+        for (auto it = fs::directory_iterator(tile_directory, ec); !ec && it != fs::directory_iterator(); ++it) {
+            count++;
+        }
+        return count;
+    };
+    const int num_tile_files = count_tile_files();
+
+    // An image that is not a multiple of the tile size, so that border tiles are partially filled
+    Image3 img(300, 200);
+    for (int y = 0; y < img.height; y++) {
+        for (int x = 0; x < img.width; x++) {
+            img(x, y) = Vector3{Real(x) / img.width, Real(y) / img.height, Real((x * 7 + y * 13) % 17) / 17};
+        }
+    }
+    fs::path filename = fs::temp_directory_path() / "elma_test_texture_cache.exr";
+    ImageWrite(filename, img);
+    Mipmap3 reference = MakeMipmap(ImageRead3(filename));
+
+    // Room for about one tile (of half texels) per shard, so lookups keep evicting tiles
+    const int64_t budget = 16 * int64_t(kTextureTileSize) * kTextureTileSize * 3 * sizeof(uint16_t);
+    auto cache           = MakeTextureCache(budget);
+    int texture_id       = AddTexture(*cache, filename, 3);
+    CachedMipmap3 mipmap{cache.get(), texture_id, img.width, img.height, GetNumMipmapLevels(img.width, img.height)};
+    if (GetStats(*cache).tileLoads != 0 || mipmap.numLevels != (int)reference.images.size()) {
+        printf("FAIL\n");
+        return 1;
+    }
+
+    // Cached lookups match the in-memory mipmap, also when many threads share the cache
+    std::atomic<int> num_errors = 0;
+    const int n                 = 97;
+    ParallelFor(
+        [&](int64_t i) {
+            for (int j = 0; j < n; j++) {
+                Real u     = (i + Real(0.37)) / n;
+                Real v     = (j + Real(0.61)) / n;
+                Real level = Real((i + j) % 40) / 4;
+                if (!close(Lookup(mipmap, u, v, level), Lookup(reference, u, v, level))) {
+                    num_errors++;
+                }
+            }
+        },
+        n);
+    TextureCacheStats stats = GetStats(*cache);
+    if (num_errors > 0 || stats.tileEvictions == 0 || stats.residentBytes > budget) {
+        printf("FAIL\n");
+        return 1;
+    }
+
+    // A second cache picks up the existing tile file, and in-memory images are served the same way
+    auto other_cache = MakeTextureCache();
+    CachedMipmap3 from_file{other_cache.get(), AddTexture(*other_cache, filename, 3), img.width, img.height,
+                            mipmap.numLevels};
+    CachedMipmap3 from_memory{other_cache.get(), AddTexture(*other_cache, img), img.width, img.height,
+                              mipmap.numLevels};
+    // (the exr file is stored with half precision, so compare the in-memory image against its own mipmap)
+    Mipmap3 memory_reference = MakeMipmap(img);
+    for (int l = 0; l < mipmap.numLevels; l++) {
+        if (!close(Lookup(from_file, Real(0.9), Real(0.2), l), Lookup(reference, Real(0.9), Real(0.2), l)) ||
+            !close(Lookup(from_memory, Real(0.9), Real(0.2), l), Lookup(memory_reference, Real(0.9), Real(0.2), l)))
+        {
+            printf("FAIL\n");
+            return 1;
+        }
+    }
+
+    // 8-bit images keep their 8-bit values: 3 bytes per texel, and level 0 decodes exactly like ImageRead3
+    // (with the tiles in Morton order, so that both layouts are covered)
+    fs::path ldr_filename = fs::temp_directory_path() / "elma_test_texture_cache.tga";
+    std::vector<uint8_t> rgb(3 * img.width * img.height);
+    for (int i = 0; i < (int)rgb.size(); i++) {
+        rgb[i] = uint8_t((i * 31) % 256);
+    }
+    write_tga(ldr_filename, img.width, img.height, rgb);
+    Mipmap3 ldr_reference = MakeMipmap(ImageRead3(ldr_filename));
+    auto ldr_cache        = MakeTextureCache();
+    SetTextureCacheLayout(*ldr_cache, TileLayout::Morton);
+    CachedMipmap3 ldr{ldr_cache.get(), AddTexture(*ldr_cache, ldr_filename, 3), img.width, img.height,
+                      mipmap.numLevels};
+    for (int l = 0; l < mipmap.numLevels; l++) {
+        // Coarser levels are requantized to 8 bits
+        Real tolerance = l == 0 ? Real(1e-6) : Real(1e-2);
+        if (!close(Lookup(ldr, Real(0.3), Real(0.7), l), Lookup(ldr_reference, Real(0.3), Real(0.7), l), tolerance)) {
+            printf("FAIL\n");
+            return 1;
+        }
+    }
+    TextureCacheStats ldr_stats = GetStats(*ldr_cache);
+    if (ldr_stats.residentBytes != ldr_stats.tileLoads * kTextureTileSize * kTextureTileSize * 3) {
+        printf("FAIL\n");
+        return 1;
+    }
+
+    // Both tile files were written by the caches above and outlive them, for the next run to pick up
+    cache.reset();
+    other_cache.reset();
+    ldr_cache.reset();
+    auto next_run = MakeTextureCache();
+    CachedMipmap3 reused{next_run.get(), AddTexture(*next_run, filename, 3), img.width, img.height,
+                         mipmap.numLevels};
+    if (count_tile_files() != num_tile_files + 2 ||
+        !close(Lookup(reused, Real(0.9), Real(0.2), 0), Lookup(reference, Real(0.9), Real(0.2), 0)) ||
+        count_tile_files() != num_tile_files + 2)
+    {
+        printf("FAIL\n");
+        return 1;
+    }
+    // Trimming deletes the least recently used files first: down to the size of the file just read, only it is left
+    fs::path last_used;
+    for (const fs::directory_entry& entry : fs::directory_iterator(tile_directory)) {
+        if (last_used.empty() || entry.last_write_time() > fs::last_write_time(last_used)) {
+            last_used = entry.path();
+        }
+    }
+    TrimTileFiles(int64_t(fs::file_size(last_used)));
+    const bool kept_last_used = count_tile_files() == 1 && fs::exists(last_used);
+    TrimTileFiles(0);
+    next_run.reset();
+    if (!kept_last_used || count_tile_files() != 0) {
+        printf("FAIL\n");
+        return 1;
+    }
+
+    ParallelCleanup();
+    fs::remove(filename);
+    fs::remove(ldr_filename);
+    printf("SUCCESS\n");
+    return 0;
+}
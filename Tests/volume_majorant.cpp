@@ -0,0 +1,174 @@
+#include "Medium.hpp"
+#include "Pcg.hpp"
+#include <cmath>
+#include <cstdio>
+
+using namespace elma;
+
+/// A sparse volume: a few dense blobs in empty space, with a different density per channel
+static GridVolume<Spectrum> make_volume(const Vector3i& res, Pcg32State& rng)
+{
+    GridVolume<Spectrum> volume;
+    volume.resolution = res;
+    volume.posMin     = Vector3{-1, -2, 0};
+    volume.posMax     = Vector3{1, 1, 3};
+    volume.data.assign(res.x * res.y * res.z, MakeZeroSpectrum());
+    volume.maxData = MakeZeroSpectrum();
+    for (int blob = 0; blob < 4; blob++) {
+        const Vector3 c{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng)};
+        const Real r = Real(0.05) + Real(0.15) * NextPcg32Real<Real>(rng);
+        for (int z = 0; z < res.z; z++) {
+            for (int y = 0; y < res.y; y++) {
+                for (int x = 0; x < res.x; x++) {
+                    const Vector3 p{Real(x) / (res.x - 1), Real(y) / (res.y - 1), Real(z) / (res.z - 1)};
+                    const Real d = Max(1 - Distance(p, c) / r, Real(0));
+                    Spectrum& v    = volume.data[(z * res.y + y) * res.x + x];
+                    v              = v + Vector3{d, Real(0.5) * d, 2 * d};
+                    volume.maxData = Max(volume.maxData, v);
+                }
+            }
+        }
+    }
+    volume.scale = 4;
+    return volume;
+}
+
+static Ray random_ray(const GridVolume<Spectrum>& volume, Pcg32State& rng)
+{
+    // From outside the box through a point inside, or from inside
+    const Vector3 extent = volume.posMax - volume.posMin;
+    const Vector3 target = volume.posMin + extent * Vector3{NextPcg32Real<Real>(rng), NextPcg32Real<Real>(rng),
+                                                            NextPcg32Real<Real>(rng)};
+    Vector3 dir{2 * NextPcg32Real<Real>(rng) - 1, 2 * NextPcg32Real<Real>(rng) - 1, 2 * NextPcg32Real<Real>(rng) - 1};
+    const Real parallel = NextPcg32Real<Real>(rng);
+    if (parallel < Real(0.1)) {
+        dir = Vector3{0, 0, 1}; // parallel to two axes
+    }
+    else if (parallel < Real(0.2)) {
+        dir = Vector3{-Real(0), -Real(0), Real(-1)}; // the same with negative zeros
+    }
+    dir             = Normalize(dir);
+    const Real back = NextPcg32Real<Real>(rng) < Real(0.5) ? Real(4) : Real(0);
+    return Ray{target - back * dir, dir, Real(0), Infinity<Real>()};
+}
+
+/// exp(-integral of sigma_t) along the ray, by the midpoint rule
+static Spectrum transmittance(const Medium& medium, const Ray& ray, Real t_max)
+{
+    const int steps = 20000;
+    Spectrum tau    = MakeZeroSpectrum();
+    for (int i = 0; i < steps; i++) {
+        const Vector3 p = ray.org + ray.dir * ((i + Real(0.5)) / steps * t_max);
+        tau            += GetSigmaA(medium, p) + GetSigmaS(medium, p);
+    }
+    return Exp(-tau * (t_max / steps));
+}
+
+int main(int argc, char* argv[])
+{
+    bool ok        = true;
+    Pcg32State rng = InitPcg32();
+
+    const GridVolume<Spectrum> grid_volume = make_volume(Vector3i{40, 24, 33}, rng);
+    const VolumeSpectrum volume            = grid_volume;
+    const MajorantGrid grid                = MakeMajorantGrid(grid_volume);
+    ok &= grid.resolution.x == kMajorantGridResolution && grid.resolution.y == kMajorantGridResolution;
+    ok &= MakeMajorantGrid(grid_volume, 64).resolution.y == 24;
+    const VolumeSpectrum albedo = ConstantVolume<Spectrum>{MakeConstSpectrum(Real(0.8))};
+    const Medium medium         = HeterogeneousMedium{{IsotropicPhase{}}, albedo, volume, grid};
+
+    // The segments are contiguous, cover the box and bound the density everywhere on them
+    for (int i = 0; i < 2000; i++) {
+        const Ray ray         = random_ray(grid_volume, rng);
+        const Real t_max      = i % 3 == 0 ? Real(5) : Infinity<Real>();
+        MajorantIterator iter = GetMajorantIterator(medium, ray, t_max);
+        Real t                = -1;
+        while (std::optional<MajorantSegment> segment = Next(iter)) {
+            ok &= t < 0 || std::abs(segment->tMin - t) <= Real(1e-5);
+            ok &= segment->tMin <= segment->tMax && segment->tMax <= t_max;
+            t = segment->tMax;
+            for (int k = 0; k < 8; k++) {
+                const Real s     = segment->tMin + (segment->tMax - segment->tMin) * NextPcg32Real<Real>(rng);
+                const Spectrum d = Lookup(volume, ray.org + ray.dir * s);
+                for (int c = 0; c < 3; c++) {
+                    ok &= d[c] <= segment->sigmaMaj[c] * (1 + Real(1e-4)) + Real(1e-4);
+                }
+            }
+        }
+        // Nothing is left out after the last segment
+        if (t >= 0 && t < t_max) {
+            const Vector3 p = ray.org + ray.dir * (t + Real(1e-3));
+            ok &= LengthSquared(Lookup(volume, p)) == 0;
+        }
+    }
+
+    // The local majorants are tighter than the global one, and a single cell is the global one
+    const MajorantGrid coarse = MakeMajorantGrid(grid_volume, 1);
+    ok &= coarse.maxValues.size() == 1 && Max(coarse.maxValues[0] - GetMaxValue(volume)) == 0;
+    Real mean_max = 0;
+    for (const Spectrum& m : grid.maxValues) {
+        mean_max += m.x / grid.maxValues.size();
+    }
+    ok &= mean_max < Real(0.5) * coarse.maxValues[0].x;
+
+    // Ratio tracking against the majorant segments estimates the transmittance without bias, in every channel
+    for (int i = 0; i < 6; i++) {
+        const Ray ray    = random_ray(grid_volume, rng);
+        const Real t_max = Real(8);
+        const Spectrum T = transmittance(medium, ray, t_max);
+        const int n      = 20000;
+        Spectrum sum     = MakeZeroSpectrum();
+        Spectrum sum_sq  = MakeZeroSpectrum();
+        for (int s = 0; s < n; s++) {
+            Spectrum T_ray       = MakeConstSpectrum(1);
+            const Spectrum T_maj = SampleMajorantCollisions(
+              medium,
+              ray,
+              t_max,
+              0,
+              rng,
+              [&](const Vector3&, const MediumProperties& mp, const Spectrum& sigma_maj, const Spectrum& T_maj) {
+                  const Spectrum sigma_n = Max(sigma_maj - mp.sigmaA - mp.sigmaS, MakeZeroSpectrum());
+                  T_ray                 *= T_maj * sigma_n / (T_maj[0] * sigma_maj[0]);
+                  return true;
+              });
+            T_ray  *= T_maj / T_maj[0];
+            sum    += T_ray;
+            sum_sq += T_ray * T_ray;
+        }
+        for (int c = 0; c < 3; c++) {
+            const Real mean  = sum[c] / n;
+            const Real sigma = std::sqrt(Max(sum_sq[c] / n - mean * mean, Real(0)) / n);
+            ok &= std::abs(mean - T[c]) <= 5 * sigma + Real(2e-3);
+        }
+    }
+
+    // Negative zero direction components don't start the walk at t = -inf
+    for (const Vector3& dir : {Vector3{-Real(0), Real(0.6), Real(0.8)}, Vector3{-Real(0), -Real(0), Real(1)}}) {
+        const Ray ray{Vector3{Real(0.1), Real(-0.5), Real(-1)}, dir, Real(0), Infinity<Real>()};
+        MajorantIterator iter = GetMajorantIterator(medium, ray, Infinity<Real>());
+        int num_segments      = 0;
+        while (std::optional<MajorantSegment> segment = Next(iter)) {
+            ok &= std::isfinite(segment->tMin) && std::isfinite(segment->tMax) && segment->tMin <= segment->tMax;
+            num_segments++;
+        }
+        ok &= num_segments > 0;
+        const Spectrum T_maj = SampleMajorantCollisions(
+          medium, ray, Infinity<Real>(), 0, rng, [](const Vector3&, const MediumProperties&, const Spectrum&,
+                                                    const Spectrum&) { return true; });
+        ok &= IsFinite(T_maj);
+    }
+
+    // A homogeneous medium is a single segment
+    const Medium homogeneous = HomogeneousMedium{{IsotropicPhase{}}, MakeConstSpectrum(1), MakeConstSpectrum(2)};
+    MajorantIterator iter    = GetMajorantIterator(homogeneous, Ray{Vector3{0, 0, 0}, Vector3{1, 0, 0}}, Real(3));
+    std::optional<MajorantSegment> segment = Next(iter);
+    ok &= segment && segment->tMin == 0 && segment->tMax == 3 && segment->sigmaMaj.x == 3 && !Next(iter);
+
+    if (!ok) {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("SUCCESS\n");
+    return 0;
+}
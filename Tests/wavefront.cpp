@@ -0,0 +1,112 @@
+#include "Scene.hpp"
+#include "Parallel.hpp"
+#include "Render.hpp"
+#include <cstdio>
+
+using namespace elma;
+
+constexpr int kWidth = 32, kHeight = 24, kBlockSize = 8;
+constexpr int kNumBlocks = (kWidth / kBlockSize) * (kHeight / kBlockSize);
+
+/// Mean luminance of every 8x8 block of the image
+static std::vector<Real> block_means(const Image3& img)
+{
+    std::vector<Real> means(kNumBlocks, 0);
+    for (int y = 0; y < kHeight; y++) {
+        for (int x = 0; x < kWidth; x++) {
+            means[(y / kBlockSize) * (kWidth / kBlockSize) + x / kBlockSize] += Luminance(img(x, y));
+        }
+    }
+    for (Real& m : means) {
+        m /= kBlockSize * kBlockSize;
+    }
+    return means;
+}
+
+int main(int argc, char* argv[])
+{
+    ParallelInit(4);
+    RTCDevice embree_device = rtcNewDevice(nullptr);
+
+    // A floor and a plastic ball lit by a small spherical light, seen from the origin along +z
+    std::vector<Material> materials;
+    materials.push_back(Lambertian{MakeConstantSpectrumTexture(MakeConstSpectrum(Real(0.6)))});
+    materials.push_back(RoughPlastic{MakeConstantSpectrumTexture(FromRGB(Vector3{Real(0.2), Real(0.5), Real(0.8)})),
+                                     MakeConstantSpectrumTexture(MakeConstSpectrum(Real(1))),
+                                     MakeConstantFloatTexture(Real(0.2)),
+                                     Real(1.5)});
+    std::vector<Shape> shapes;
+    shapes.emplace_back(TriangleMesh{
+      {0, -1} /* material, area light */,
+      {Vector3{-4, -1, 0}, Vector3{4, -1, 0}, Vector3{4, -1, 8}, Vector3{-4, -1, 8}},
+      {Vector3i{0, 1, 2}, Vector3i{0, 2, 3}},
+      {}, // normals
+      {}, // uvs
+      Real(0), // total area
+      TableDist1D{}
+    });
+    shapes.emplace_back(Sphere{{1, -1}, Vector3{Real(0), Real(-0.3), Real(4)}, Real(0.7)});
+    shapes.emplace_back(Sphere{{0, 0}, Vector3{Real(0.8), Real(1.2), Real(3.5)}, Real(0.3)});
+    std::vector<Light> lights;
+    lights.push_back(DiffuseAreaLight{2, Vector3{10, 10, 10}});
+
+    RenderOptions options;
+    options.samplesPerPixel = 4;
+    options.maxDepth        = 6;
+    options.rrDepth         = 3;
+    Scene scene(embree_device,
+                Camera(Matrix4x4::identity(), Real(45), kWidth, kHeight, Box{Real(1)}, -1),
+                materials,
+                shapes,
+                lights,
+                {}, /* media */
+                -1, /* envmap id */
+                TexturePool{},
+                options,
+                "" /* output filename */);
+
+    // Independent passes of both integrators (with sample indices that don't overlap), so that the block means
+    // of the two can be compared within their standard errors
+    constexpr int num_passes = 16;
+    std::vector<Real> sum[2], sum_sq[2];
+    for (int k = 0; k < 2; k++) {
+        sum[k].assign(kNumBlocks, 0);
+        sum_sq[k].assign(kNumBlocks, 0);
+        scene.options.integrator = k == 0 ? Integrator::Path : Integrator::WavefrontPath;
+        for (int pass = 0; pass < num_passes; pass++) {
+            scene.options.accumulateCount = k * num_passes + pass;
+            const std::vector<Real> means = block_means(Render(scene));
+            for (int b = 0; b < kNumBlocks; b++) {
+                sum[k][b]    += means[b];
+                sum_sq[k][b] += means[b] * means[b];
+            }
+        }
+    }
+
+    bool ok      = true;
+    Real lit_sum = 0;
+    for (int b = 0; b < kNumBlocks; b++) {
+        Real mean[2], variance_of_mean[2];
+        for (int k = 0; k < 2; k++) {
+            mean[k]             = sum[k][b] / num_passes;
+            const Real variance = Max(sum_sq[k][b] / num_passes - mean[k] * mean[k], Real(0)) * num_passes /
+                                  (num_passes - 1);
+            variance_of_mean[k] = variance / num_passes;
+        }
+        // Five standard errors: a false failure is very unlikely even over all the blocks
+        const Real bound = 5 * std::sqrt(variance_of_mean[0] + variance_of_mean[1]) + Real(1e-4);
+        ok &= std::abs(mean[0] - mean[1]) <= bound;
+        lit_sum += mean[0];
+    }
+    // The scene has to be lit for the comparison to mean anything
+    ok &= lit_sum > 0;
+
+    rtcReleaseDevice(embree_device);
+    ParallelCleanup();
+    if (!ok) {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("SUCCESS\n");
+    return 0;
+}